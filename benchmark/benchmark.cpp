@@ -0,0 +1,615 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file benchmark.cpp
+ * \brief Microbenchmarks of the relighting kernels on synthetic data.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * IBR_Benchmark [--images N] [--rows R] [--cols C] [--envmap-width W] [--envmap-height H] [--lights L] [--conditions K]
+ *               [--wavelet-coefficients N] [--repetitions R] [--filter text] [--output results.json]
+ *
+ * The reflectance field, the environment map, the light sources and the masks of the office room are generated with a fixed seed in a temporary data folder :
+ * no data of the framework is needed. Each benchmark is run once to warm up, then R times.
+ * The results are written as JSON (in the output file or on the standard output) : the configuration and, for each benchmark,
+ * the minimum, median and mean times in milliseconds and the throughput (work items per second, for the median time).
+ * The weights of the wavelet path (one offset, N coefficients) use the pixels of the environment map as work items : their throughput compares with computeVoronoiWeightsRGB.
+ * The messages printed by the framework during the benchmarks are sent to the error output : the standard output only contains the JSON.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QTemporaryDir>
+
+#include "relighting.h"
+#include "voronoi.h"
+#include "optimisation.h"
+#include "PFMReadWrite.h"
+#include "loadFiles.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Relighting whose reflectance field, weights, environment map and mask are generated procedurally.
+ * It gives access to the methods of the Relighting class without loading any data.
+ */
+class BenchmarkRelighting : public Relighting
+{
+    public:
+
+        /**
+         * Generates a reflectance field of uniform random values, random weights, a mask (ellipse in the middle) and a constant relit result.
+         * @brief BenchmarkRelighting
+         * @param INPUT : numberOfImages number of images of the reflectance field.
+         * @param INPUT : rows number of rows of the images.
+         * @param INPUT : cols number of columns of the images.
+         * @param INPUT : environmentMap environment map (CV_32FC3).
+         * @param INPUT : rng random number generator.
+         */
+        BenchmarkRelighting(unsigned int numberOfImages, int rows, int cols, const Mat &environmentMap, RNG &rng): Relighting()
+        {
+            m_numberOfLightingConditions = numberOfImages;
+            m_reflectanceField.create(numberOfImages, rows, cols);
+
+            Mat image(rows, cols, CV_32FC3);
+            m_weightsRGB.assign(numberOfImages, std::vector<float>(3, 0.0));
+
+            for(unsigned int i = 0 ; i<numberOfImages ; i++)
+            {
+                rng.fill(image, RNG::UNIFORM, Scalar::all(0.0), Scalar::all(1.0));
+                m_reflectanceField.setImage(i, image);
+
+                for(int c = 0 ; c<3 ; c++)
+                {
+                    m_weightsRGB[i][c] = rng.uniform(0.0f, 1.0f);
+                }
+            }
+
+            //White is the background
+            m_objectMask = Mat(rows, cols, CV_32FC3, Scalar::all(1.0));
+            ellipse(m_objectMask, Point(cols/2, rows/2), Size(cols/3, rows/3), 0.0, 0.0, 360.0, Scalar::all(0.0), -1);
+
+            m_relitResult = Mat(rows, cols, CV_32FC3, Scalar::all(0.5));
+
+            m_environmentMap = environmentMap;
+            m_environmentMapWidth = environmentMap.cols;
+            m_environmentMapHeight = environmentMap.rows;
+        }
+
+        bool relighting() { return EXIT_SUCCESS; }
+        bool loadReflectanceField() { return EXIT_SUCCESS; }
+        void clearRelighting() {}
+        void updateProgressWindow(QString, int) {}
+};
+
+/**
+ * Data shared by the benchmarks.
+ */
+struct BenchmarkData
+{
+    BenchmarkRelighting* relighting; /*!< Relighting with the synthetic reflectance field*/
+    Voronoi* voronoi; /*!< Voronoi diagram of the synthetic light sources*/
+    Mat environmentMap; /*!< Synthetic environment map*/
+    std::string pfmPath; /*!< Path of the PFM file written and read by the benchmarks*/
+    column_vector variables; /*!< Variables given to the function optimised in the office room relighting*/
+    unsigned int waveletCoefficients; /*!< Number of wavelet coefficients kept by the wavelet path*/
+    WaveletApproximation wavelet; /*!< Wavelet approximation of the synthetic environment map*/
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkData &data);
+
+/**
+ * Benchmark : Linear combination of the synthetic reflectance field with the random weights (Relighting::computeFinalRelighting).
+ * @brief benchmarkComputeFinalRelighting
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkComputeFinalRelighting(BenchmarkData &data)
+{
+    data.relighting->computeFinalRelighting();
+}
+
+/**
+ * Benchmark : RGB weights of the Voronoi cells of the light stage for the synthetic environment map rotated by 1 radian (Voronoi::computeVoronoiWeightsRGB).
+ * @brief benchmarkVoronoiWeightsRGB
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkVoronoiWeightsRGB(BenchmarkData &data)
+{
+    data.voronoi->clearWeights();
+    data.voronoi->computeVoronoiWeightsRGB(data.environmentMap, 1.0);
+}
+
+/**
+ * Benchmark : Weights of the pictures of the office room for the synthetic environment map rotated by 1 radian (Voronoi::computeVoronoiWeightsOR).
+ * @brief benchmarkVoronoiWeightsOR
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkVoronoiWeightsOR(BenchmarkData &data)
+{
+    data.voronoi->clearWeights();
+    data.voronoi->computeVoronoiWeightsOR(data.environmentMap, 1.0);
+}
+
+/**
+ * Benchmark : Weights of the Voronoi cells with Gaussian light sources for the synthetic environment map rotated by 1 radian (Voronoi::computeVoronoiWeightsGaussian).
+ * @brief benchmarkVoronoiWeightsGaussian
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkVoronoiWeightsGaussian(BenchmarkData &data)
+{
+    data.voronoi->clearWeights();
+    data.voronoi->computeVoronoiWeightsGaussian(data.environmentMap, 1.0);
+}
+
+/**
+ * Benchmark : Haar wavelet transform of the synthetic environment map, keeping its data.waveletCoefficients largest coefficients (environmentMapWavelet).
+ * @brief benchmarkEnvironmentMapWavelet
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkEnvironmentMapWavelet(BenchmarkData &data)
+{
+    WaveletApproximation approximation;
+    environmentMapWavelet(data.environmentMap, data.waveletCoefficients, approximation);
+}
+
+/**
+ * Benchmark : Weights of the Voronoi cells from the wavelet approximation of the synthetic environment map rotated by 1 radian : the cells are rotated (Voronoi::computeVoronoiWeightsWavelet).
+ * @brief benchmarkVoronoiWeightsWavelet
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkVoronoiWeightsWavelet(BenchmarkData &data)
+{
+    data.voronoi->clearWeights();
+    data.voronoi->computeVoronoiWeightsWavelet(data.wavelet, 1.0);
+}
+
+/**
+ * Benchmark : Weights of the Voronoi cells from the wavelet approximation of the synthetic environment map without rotation : sparse dot products only (Voronoi::computeVoronoiWeightsWavelet).
+ * @brief benchmarkVoronoiWeightsWaveletNoRotation
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkVoronoiWeightsWaveletNoRotation(BenchmarkData &data)
+{
+    data.voronoi->clearWeights();
+    data.voronoi->computeVoronoiWeightsWavelet(data.wavelet, 0.0);
+}
+
+/**
+ * Benchmark : Number of pixels of the environment map in each Voronoi cell (Voronoi::numberOfPixelsPerVoronoiCell).
+ * @brief benchmarkNumberOfPixelsPerVoronoiCell
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkNumberOfPixelsPerVoronoiCell(BenchmarkData &data)
+{
+    data.voronoi->numberOfPixelsPerVoronoiCell();
+}
+
+/**
+ * Benchmark : Copy of the synthetic environment map rotated by 1 radian in the background pixels of the relit result (Relighting::rayTraceBackground).
+ * @brief benchmarkRayTraceBackground
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkRayTraceBackground(BenchmarkData &data)
+{
+    data.relighting->rayTraceBackground(1.0);
+}
+
+/**
+ * Benchmark : Gamma correction (2.2) of the relit result (Relighting::gammaCorrection).
+ * @brief benchmarkGammaCorrection
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkGammaCorrection(BenchmarkData &data)
+{
+    data.relighting->gammaCorrection(2.2);
+}
+
+/**
+ * Benchmark : Writes the synthetic environment map in the PFM file data.pfmPath (savePFM).
+ * @brief benchmarkSavePFM
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkSavePFM(BenchmarkData &data)
+{
+    savePFM(data.environmentMap, data.pfmPath);
+}
+
+/**
+ * Benchmark : Reads the PFM file data.pfmPath written by benchmarkSavePFM (loadPFM).
+ * @brief benchmarkLoadPFM
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkLoadPFM(BenchmarkData &data)
+{
+    loadPFM(data.pfmPath);
+}
+
+/**
+ * Benchmark : Cost function of the optimisation of the office room relighting for data.variables (functionToOptimise).
+ * @brief benchmarkFunctionToOptimise
+ * @param INPUT : data data of the benchmarks.
+ */
+void benchmarkFunctionToOptimise(BenchmarkData &data)
+{
+    functionToOptimise(data.variables);
+}
+
+/**
+ * Runs the benchmarks and collects their results.
+ */
+class BenchmarkSuite
+{
+    public:
+
+        /**
+         * Constructor of the BenchmarkSuite class.
+         * @brief BenchmarkSuite
+         * @param INPUT : repetitions number of timed runs of each benchmark.
+         * @param INPUT : filter only the benchmarks whose name contains the filter are run (all if empty).
+         */
+        BenchmarkSuite(unsigned int repetitions, const QString &filter): m_repetitions(repetitions), m_filter(filter), m_results(QJsonArray())
+        {
+
+        }
+
+        /**
+         * Runs a benchmark once to warm up then m_repetitions times and stores its times.
+         * @brief run
+         * @param INPUT : name name of the benchmark.
+         * @param INPUT : function function that runs the benchmark once.
+         * @param INPUT : data data of the benchmarks.
+         * @param INPUT : work number of work items processed by one run (pixels, pixels x images...), used for the throughput.
+         */
+        void run(const QString &name, BenchmarkFunction function, BenchmarkData &data, double work)
+        {
+            if(!m_filter.isEmpty() && !name.contains(m_filter))
+                return;
+
+            function(data);
+
+            std::vector<double> times(m_repetitions);
+            QElapsedTimer timer;
+
+            for(unsigned int r = 0 ; r<m_repetitions ; r++)
+            {
+                timer.start();
+                function(data);
+                times[r] = timer.nsecsElapsed()*1e-6;
+            }
+
+            std::sort(times.begin(), times.end());
+
+            double mean = 0.0;
+            for(unsigned int r = 0 ; r<m_repetitions ; r++)
+            {
+                mean += times[r]/m_repetitions;
+            }
+
+            double median = m_repetitions%2 == 1 ? times[m_repetitions/2] : 0.5*(times[m_repetitions/2-1] + times[m_repetitions/2]);
+
+            QJsonObject result;
+            result.insert("name", name);
+            result.insert("repetitions", (int) m_repetitions);
+            result.insert("min_ms", times[0]);
+            result.insert("median_ms", median);
+            result.insert("mean_ms", mean);
+            result.insert("work", work);
+            result.insert("throughput_per_s", median > 0.0 ? work/(median*1e-3) : 0.0);
+            m_results.append(result);
+
+            cerr << name.toStdString() << " : " << median << " ms (median), " << times[0] << " ms (min)" << endl;
+        }
+
+        /**
+         * Returns the results of the benchmarks that have been run.
+         * @brief getResults
+         */
+        QJsonArray getResults() const
+        {
+            return m_results;
+        }
+
+    private:
+        unsigned int m_repetitions; /*!< Number of timed runs of each benchmark*/
+        QString m_filter; /*!< Only the benchmarks whose name contains the filter are run*/
+        QJsonArray m_results; /*!< Results of the benchmarks*/
+};
+
+/**
+ * Returns the value of an integer option of the command line or its default value.
+ * @brief intOption
+ * @param INPUT : arguments arguments of the command line.
+ * @param INPUT : option name of the option (e.g. --images).
+ * @param INPUT : defaultValue value returned if the option is not given.
+ */
+int intOption(const QStringList &arguments, const QString &option, int defaultValue)
+{
+    int index = arguments.indexOf(option);
+
+    if(index < 0 || index+1 >= arguments.size())
+        return defaultValue;
+
+    return arguments[index+1].toInt();
+}
+
+/**
+ * Returns the value of a text option of the command line or an empty text.
+ * @brief textOption
+ * @param INPUT : arguments arguments of the command line.
+ * @param INPUT : option name of the option (e.g. --filter).
+ */
+QString textOption(const QStringList &arguments, const QString &option)
+{
+    int index = arguments.indexOf(option);
+
+    if(index < 0 || index+1 >= arguments.size())
+        return QString();
+
+    return arguments[index+1];
+}
+
+/**
+ * Writes the synthetic data files read by the framework in the data folder :
+ * light_intensities.txt for the Voronoi weights, the environment map and the masks of the office room for functionToOptimise.
+ * @brief writeDataFolder
+ * @param INPUT : folder data folder.
+ * @param INPUT : environmentMap synthetic environment map.
+ * @param INPUT : numberOfLights number of light sources of the light stage.
+ * @param INPUT : numberOfConditions number of lighting conditions of the office room.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if a file could not be written.
+ */
+bool writeDataFolder(const std::string &folder, const Mat &environmentMap, unsigned int numberOfLights, unsigned int numberOfConditions)
+{
+    ofstream lightIntensities((folder + "/light_intensities.txt").c_str(), ios::out | ios::trunc);
+
+    for(unsigned int n = 0 ; n<numberOfLights ; n++)
+    {
+        lightIntensities << "1.0 1.0 1.0" << endl;
+    }
+
+    if(!lightIntensities)
+        return EXIT_FAILURE;
+
+    QDir().mkpath(QString::fromStdString(folder + "/environment_maps"));
+    savePFM(environmentMap, folder + "/environment_maps/benchmark.pfm");
+
+    //Condition k lights a vertical band of the environment map (black pixels are lit)
+    std::string masksFolder = folder + "/lighting_conditions/office_room/High Frequency";
+    std::string residualMaskFolder = folder + "/lighting_conditions/office_room/high_freq";
+    QDir().mkpath(QString::fromStdString(masksFolder));
+    QDir().mkpath(QString::fromStdString(residualMaskFolder));
+
+    for(unsigned int k = 0 ; k<numberOfConditions ; k++)
+    {
+        Mat mask(environmentMap.rows, environmentMap.cols, CV_8UC3, Scalar::all(255));
+        int bandStart = k*environmentMap.cols/numberOfConditions;
+        int bandEnd = (k+1)*environmentMap.cols/numberOfConditions;
+        mask.colRange(bandStart, bandEnd).setTo(Scalar::all(0));
+
+        ostringstream maskPath;
+        maskPath << masksFolder << "/condition_mask" << (k<10 ? "0" : "") << k << ".png";
+
+        if(!imwrite(maskPath.str(), mask))
+            return EXIT_FAILURE;
+
+        if(k == numberOfConditions-1 && !imwrite(residualMaskFolder + "/residualMask.png", mask))
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+
+    unsigned int numberOfImages = std::max(intOption(arguments, "--images", 253), 1);
+    int rows = std::max(intOption(arguments, "--rows", 512), 1);
+    int cols = std::max(intOption(arguments, "--cols", 512), 1);
+    int environmentMapWidth = std::max(intOption(arguments, "--envmap-width", 1024), 2);
+    int environmentMapHeight = std::max(intOption(arguments, "--envmap-height", 512), 2);
+    unsigned int numberOfLights = std::max(intOption(arguments, "--lights", 253), 1);
+    unsigned int numberOfConditions = std::max(intOption(arguments, "--conditions", 9), 1);
+    unsigned int waveletCoefficients = std::max(intOption(arguments, "--wavelet-coefficients", 1000), 1);
+    unsigned int repetitions = std::max(intOption(arguments, "--repetitions", 5), 1);
+    QString filter = textOption(arguments, "--filter");
+    QString output = textOption(arguments, "--output");
+
+    //The messages of the framework are sent to the error output until the results are written
+    streambuf* standardOutput = cout.rdbuf(cerr.rdbuf());
+
+    //The data read by the framework is written in a temporary folder
+    QTemporaryDir dataFolder;
+
+    if(!dataFolder.isValid())
+    {
+        cerr << "Could not create a temporary folder" << endl;
+        return EXIT_FAILURE;
+    }
+
+    setDataRootPath(dataFolder.path().toStdString());
+
+    RNG rng(0x1B2F);
+
+    Mat environmentMap(environmentMapHeight, environmentMapWidth, CV_32FC3);
+    rng.fill(environmentMap, RNG::UNIFORM, Scalar::all(0.0), Scalar::all(4.0));
+
+    if(writeDataFolder(dataRootPath(), environmentMap, numberOfLights, numberOfConditions) == EXIT_FAILURE)
+    {
+        cerr << "Could not write the data in " << dataRootPath() << endl;
+        return EXIT_FAILURE;
+    }
+
+    //Light sources at distinct random positions of the environment map
+    std::set<std::pair<int, int> > usedPositions;
+    std::vector<Point2i> lightPositions;
+
+    while(lightPositions.size() < numberOfLights && usedPositions.size() < (size_t) environmentMapWidth*environmentMapHeight)
+    {
+        Point2i position(rng.uniform(0, environmentMapWidth), rng.uniform(0, environmentMapHeight));
+
+        if(usedPositions.insert(std::make_pair(position.x, position.y)).second)
+            lightPositions.push_back(position);
+    }
+
+    Voronoi voronoi;
+    voronoi.setEnvironmentMapSize(environmentMapWidth, environmentMapHeight);
+    voronoi.setVoronoi(lightPositions);
+
+    BenchmarkRelighting relighting(numberOfImages, rows, cols, environmentMap, rng);
+
+    //Sets the global variables of the office room optimisation
+    std::vector<std::vector<float> > conditionWeights(numberOfConditions, std::vector<float>(3, 1.0));
+    Optimisation optimisation("benchmark", environmentMapWidth, environmentMapHeight, 3, numberOfConditions, numberOfConditions-1, 1.0,
+                              "benchmark", "High Frequency", conditionWeights);
+
+    BenchmarkData data;
+    data.relighting = &relighting;
+    data.voronoi = &voronoi;
+    data.environmentMap = environmentMap;
+    data.pfmPath = dataRootPath() + "/benchmark_save.pfm";
+    data.waveletCoefficients = waveletCoefficients;
+    data.variables = column_vector(numberOfConditions);
+
+    for(unsigned int k = 0 ; k<numberOfConditions ; k++)
+    {
+        data.variables(k) = 1.0;
+    }
+
+    double relightingWork = (double) numberOfImages*rows*cols;
+    double environmentMapWork = (double) environmentMapWidth*environmentMapHeight;
+
+    BenchmarkSuite suite(repetitions, filter);
+
+    //Linear combination for each layout and storage of the reflectance field
+    const char* layoutNames[2] = {"image_major", "pixel_major"};
+    const char* storageNames[3] = {"float32", "float16", "uint8"};
+
+    for(int layout = IMAGE_MAJOR ; layout <= PIXEL_MAJOR ; layout++)
+    {
+        for(int storage = STORAGE_FLOAT32 ; storage <= STORAGE_UINT8 ; storage++)
+        {
+            relighting.setReflectanceFieldLayout((reflectanceFieldLayout) layout);
+            relighting.setReflectanceFieldStorage((reflectanceFieldStorage) storage);
+
+            suite.run(QString("computeFinalRelighting/%1/%2").arg(layoutNames[layout]).arg(storageNames[storage]),
+                      benchmarkComputeFinalRelighting, data, relightingWork);
+        }
+    }
+
+    relighting.setReflectanceFieldLayout(IMAGE_MAJOR);
+    relighting.setReflectanceFieldStorage(STORAGE_FLOAT32);
+
+    //Voronoi weights searching the subdivision, then reading the label map
+    suite.run("Voronoi::computeVoronoiWeightsRGB", benchmarkVoronoiWeightsRGB, data, environmentMapWork);
+    suite.run("Voronoi::computeVoronoiWeightsOR", benchmarkVoronoiWeightsOR, data, environmentMapWork);
+    suite.run("Voronoi::computeVoronoiWeightsGaussian", benchmarkVoronoiWeightsGaussian, data, environmentMapWork);
+    suite.run("Voronoi::numberOfPixelsPerVoronoiCell", benchmarkNumberOfPixelsPerVoronoiCell, data, environmentMapWork);
+
+    voronoi.computeLabelMap();
+
+    suite.run("Voronoi::computeVoronoiWeightsRGB/labelMap", benchmarkVoronoiWeightsRGB, data, environmentMapWork);
+    suite.run("Voronoi::computeVoronoiWeightsOR/labelMap", benchmarkVoronoiWeightsOR, data, environmentMapWork);
+    suite.run("Voronoi::computeVoronoiWeightsGaussian/labelMap", benchmarkVoronoiWeightsGaussian, data, environmentMapWork);
+    suite.run("Voronoi::numberOfPixelsPerVoronoiCell/labelMap", benchmarkNumberOfPixelsPerVoronoiCell, data, environmentMapWork);
+
+    //Wavelet path : the environment map is transformed once, then each offset rotates the cells (compare with computeVoronoiWeightsRGB/labelMap)
+    voronoi.computeWaveletBasis();
+    environmentMapWavelet(environmentMap, waveletCoefficients, data.wavelet);
+
+    suite.run("environmentMapWavelet", benchmarkEnvironmentMapWavelet, data, environmentMapWork);
+    suite.run("Voronoi::computeVoronoiWeightsWavelet", benchmarkVoronoiWeightsWavelet, data, environmentMapWork);
+    suite.run("Voronoi::computeVoronoiWeightsWavelet/noRotation", benchmarkVoronoiWeightsWaveletNoRotation, data, environmentMapWork);
+
+    suite.run("rayTraceBackground", benchmarkRayTraceBackground, data, (double) rows*cols);
+    suite.run("gammaCorrection", benchmarkGammaCorrection, data, (double) rows*cols);
+
+    suite.run("savePFM", benchmarkSavePFM, data, environmentMapWork);
+    suite.run("loadPFM", benchmarkLoadPFM, data, environmentMapWork);
+
+    suite.run("functionToOptimise", benchmarkFunctionToOptimise, data, environmentMapWork*numberOfConditions);
+
+    QJsonObject configuration;
+    configuration.insert("images", (int) numberOfImages);
+    configuration.insert("rows", rows);
+    configuration.insert("cols", cols);
+    configuration.insert("envmap_width", environmentMapWidth);
+    configuration.insert("envmap_height", environmentMapHeight);
+    configuration.insert("lights", (int) lightPositions.size());
+    configuration.insert("conditions", (int) numberOfConditions);
+    configuration.insert("wavelet_coefficients", (int) waveletCoefficients);
+    configuration.insert("repetitions", (int) repetitions);
+    configuration.insert("threads", cv::getNumThreads());
+
+    QJsonObject results;
+    results.insert("configuration", configuration);
+    results.insert("benchmarks", suite.getResults());
+
+    QByteArray json = QJsonDocument(results).toJson();
+
+    cout.rdbuf(standardOutput);
+
+    if(output.isEmpty())
+    {
+        cout << json.constData();
+        return EXIT_SUCCESS;
+    }
+
+    QFile file(output);
+
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+    {
+        cerr << "Could not write the file : " << output.toStdString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
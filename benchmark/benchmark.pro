@@ -0,0 +1,13 @@
+QT       += core gui network
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = IBR_Benchmark
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../src/IBR_Framework.pri)
+
+SOURCES += \
+    benchmark.cpp
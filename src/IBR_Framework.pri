@@ -0,0 +1,136 @@
+#Sources and libraries shared by the application and the benchmark
+#(everything except main and the graphical interface)
+
+INCLUDEPATH += $$PWD
+
+win32:{
+    #Dlib
+    INCLUDEPATH += C:\Libraries\dlib-18.16
+
+    #OpenCV
+    CONFIG(debug, debug|release)
+    {
+         INCLUDEPATH += "C:\\OpenCV2411\\build\\include"
+
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_core2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_highgui2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_imgproc2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_features2d2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_calib3d2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_contrib2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_flann2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_gpu2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_legacy2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_ml2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_nonfree2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_objdetect2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_ocl2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_photo2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_stitching2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_superres2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_ts2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_video2411.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_videostab2411.lib"
+
+    }
+    CONFIG(release, debug|release)
+    {
+         INCLUDEPATH += "C:\\OpenCV2411\\build\\include"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_core2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_highgui2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_imgproc2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_features2d2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_calib3d2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_contrib2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_flann2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_gpu2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_legacy2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_ml2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_nonfree2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_objdetect2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_ocl2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_photo2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_stitching2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_superres2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_ts2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_video2411d.lib"
+         LIBS += "C:\\OpenCV2411\\build\\x64\\vc12\\lib\\opencv_videostab2411d.lib"
+    }
+}
+else:unix{
+#Dlib
+    INCLUDEPATH += /Users/Libraries/dlib-19.0
+
+#OpenCV
+    INCLUDEPATH += /usr/local/include/
+    LIBS += -L/usr/local/lib
+    LIBS += -lopencv_core
+    LIBS += -lopencv_imgproc
+    LIBS += -lopencv_highgui
+    LIBS += -lopencv_ml
+    LIBS += -lopencv_video
+    LIBS += -lopencv_features2d
+    LIBS += -lopencv_calib3d
+    LIBS += -lopencv_objdetect
+    LIBS += -lopencv_contrib
+    LIBS += -lopencv_legacy
+    LIBS += -lopencv_flann
+}
+
+SOURCES += \
+    $$PWD/mathsFunctions.cpp \
+    $$PWD/LightingBasis.cpp \
+    $$PWD/imageProcessing.cpp \
+    $$PWD/relighting.cpp \
+    $$PWD/voronoi.cpp \
+    $$PWD/optimisation.cpp \
+    $$PWD/lightStageRelighting.cpp \
+    $$PWD/officeRoomRelighting.cpp \
+    $$PWD/freeformlightstage.cpp \
+    $$PWD/manualSelection.cpp \
+    $$PWD/PFMReadWrite.cpp \
+    $$PWD/loadFiles.cpp \
+    $$PWD/relightingKernels.cpp \
+    $$PWD/reflectanceField.cpp \
+    $$PWD/lowRankReflectanceField.cpp \
+    $$PWD/tiledReflectanceField.cpp \
+    $$PWD/reflectanceFieldPack.cpp \
+    $$PWD/reflectanceFieldLoader.cpp \
+    $$PWD/batchRelighting.cpp \
+    $$PWD/relightingServer.cpp \
+    $$PWD/resultCache.cpp \
+    $$PWD/trace.cpp \
+    $$PWD/memoryTracker.cpp \
+    $$PWD/turntableWriter.cpp \
+    $$PWD/sphericalHarmonics.cpp \
+    $$PWD/haarWavelet.cpp \
+    $$PWD/environmentMapPyramid.cpp
+
+HEADERS  += \
+    $$PWD/PFMReadWrite.h \
+    $$PWD/freeformlightstage.h \
+    $$PWD/imageProcessing.h \
+    $$PWD/LightingBasis.h \
+    $$PWD/lightStageRelighting.h \
+    $$PWD/loadFiles.h \
+    $$PWD/manualSelection.h \
+    $$PWD/mathsFunctions.h \
+    $$PWD/officeRoomRelighting.h \
+    $$PWD/optimisation.h \
+    $$PWD/voronoi.h \
+    $$PWD/relighting.h \
+    $$PWD/relightingKernels.h \
+    $$PWD/reflectanceField.h \
+    $$PWD/lowRankReflectanceField.h \
+    $$PWD/tiledReflectanceField.h \
+    $$PWD/reflectanceFieldPack.h \
+    $$PWD/reflectanceFieldLoader.h \
+    $$PWD/batchRelighting.h \
+    $$PWD/relightingServer.h \
+    $$PWD/resultCache.h \
+    $$PWD/trace.h \
+    $$PWD/memoryTracker.h \
+    $$PWD/turntableWriter.h \
+    $$PWD/sphericalHarmonics.h \
+    $$PWD/haarWavelet.h \
+    $$PWD/environmentMapPyramid.h
@@ -253,11 +253,7 @@ void LightingBasis::uniformSamplingAreaLightSources(unsigned int envMapWidth, un
 void LightingBasis::saveBasis()
 {
     ostringstream osstream;
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
 
     osstream << "/basis.txt";
     //Open the file and delete all the text inside
@@ -285,11 +281,7 @@ void LightingBasis::saveBasis()
 void LightingBasis::loadBasis()
 {
     ostringstream osstream;
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
 
     osstream << "/basis.txt";
     //Open the file and delete all the text inside
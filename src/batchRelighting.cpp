@@ -0,0 +1,343 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file batchRelighting.cpp
+ * \brief Runs relighting jobs described in a file, without the graphical interface.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The jobs are read from an ini file (QSettings) and run one after the other with the three relighting methods.
+ */
+
+#include "batchRelighting.h"
+
+using namespace std;
+
+/**
+ * Constructor of the BatchRelighting class.
+ * @brief BatchRelighting
+ */
+BatchRelighting::BatchRelighting(): QObject(),
+    m_LSRelighting(new LightStageRelighting()), m_FFRelighting(new FreeFormLightStage()), m_ORRelighting(new OfficeRoomRelighting())
+{
+    QObject::connect(m_LSRelighting, SIGNAL(statusUpdate(QString)), this, SLOT(printStatus(QString)));
+    QObject::connect(m_LSRelighting, SIGNAL(updateImage(QString)), this, SLOT(printImage(QString)));
+
+    QObject::connect(m_FFRelighting, SIGNAL(statusUpdate(QString)), this, SLOT(printStatus(QString)));
+    QObject::connect(m_FFRelighting, SIGNAL(updateImage(QString)), this, SLOT(printImage(QString)));
+
+    QObject::connect(m_ORRelighting, SIGNAL(statusUpdate(QString)), this, SLOT(printStatus(QString)));
+    QObject::connect(m_ORRelighting, SIGNAL(updateImage(QString)), this, SLOT(printImage(QString)));
+}
+
+/**
+ * Destructor of the BatchRelighting class. Releases the memory.
+ * @brief ~BatchRelighting
+ */
+BatchRelighting::~BatchRelighting()
+{
+    delete m_LSRelighting;
+    delete m_FFRelighting;
+    delete m_ORRelighting;
+}
+
+/**
+ * Runs all the jobs of a job file one after the other. A job that fails does not stop the other jobs.
+ * @brief run
+ * @param INPUT : jobFile path of the ini file that describes the jobs.
+ * @param INPUT : dataRoot folder of the data. If empty, the dataRoot of the job file or the folder of the application is used.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be read or at least one job failed.
+ */
+bool BatchRelighting::run(const QString &jobFile, const QString &dataRoot)
+{
+    if(!QFile::exists(jobFile))
+    {
+        cerr << "Job file does not exist : " << jobFile.toStdString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    QSettings settings(jobFile, QSettings::IniFormat);
+
+    if(settings.status() != QSettings::NoError)
+    {
+        cerr << "Could not read the job file : " << jobFile.toStdString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    //The data root of the command line has priority over the one of the job file
+    if(!dataRoot.isEmpty())
+        setDataRootPath(dataRoot.toStdString());
+    else if(settings.contains("dataRoot"))
+        setDataRootPath(settings.value("dataRoot").toString().toStdString());
+
+    cout << "Data folder : " << dataRootPath() << endl;
+
+    //The results already computed by a previous job or run are read from the cache of the results
+    bool resultCache = settings.value("resultCache", false).toBool();
+    size_t resultCacheSize = (size_t) settings.value("resultCacheSize", 1024).toULongLong()*1024*1024;
+
+    m_LSRelighting->setResultCache(resultCache, resultCacheSize);
+    m_FFRelighting->setResultCache(resultCache, resultCacheSize);
+    m_ORRelighting->setResultCache(resultCache, resultCacheSize);
+
+    //The weights are integrated on the pyramids of the environment maps when a tolerance is given
+    double pyramidTolerance = settings.value("pyramidTolerance", 0.0).toDouble();
+
+    m_LSRelighting->setPyramidTolerance(pyramidTolerance);
+    m_FFRelighting->setPyramidTolerance(pyramidTolerance);
+    m_ORRelighting->setPyramidTolerance(pyramidTolerance);
+
+    QStringList jobs = settings.childGroups();
+    unsigned int numberOfFailures = 0;
+
+    for(int j = 0 ; j<jobs.size() ; j++)
+    {
+        cout << "Job " << j+1 << "/" << jobs.size() << " : " << jobs[j].toStdString() << endl;
+
+        settings.beginGroup(jobs[j]);
+
+        //The peaks of the memory summary are the peaks of this job
+        resetMemoryPeaks();
+
+        if(this->runJob(settings, jobs[j]) == EXIT_FAILURE)
+            numberOfFailures++;
+
+        cout << memorySummary();
+
+        settings.endGroup();
+    }
+
+    cout << jobs.size()-numberOfFailures << "/" << jobs.size() << " jobs done" << endl;
+
+    return numberOfFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Runs the job of the current group of the settings for each of its environment maps.
+ * @brief runJob
+ * @param INPUT : settings job file, the group of the job has been opened.
+ * @param INPUT : name name of the job.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the parameters of the job are not valid or if the relighting failed.
+ */
+bool BatchRelighting::runJob(QSettings &settings, const QString &name)
+{
+    QString method = settings.value("method").toString();
+    QString object = settings.value("object").toString();
+    QString lightType = settings.value("lightType", "Point").toString();
+    QStringList environmentMaps = settings.value("environmentMaps").toStringList();
+    unsigned int numberOfOffsets = settings.value("numberOfOffsets", 1).toUInt();
+    double exposure = settings.value("exposure", 0.0).toDouble();
+    QString identificationMethod = settings.value("identificationMethod").toString();
+
+    if(environmentMaps.isEmpty())
+    {
+        cerr << "Job " << name.toStdString() << " : no environment map" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if(identificationMethod == "Manual")
+    {
+        cerr << "Job " << name.toStdString() << " : the manual identification of the light sources needs the graphical interface" << endl;
+        return EXIT_FAILURE;
+    }
+
+    for(int e = 0 ; e<environmentMaps.size() ; e++)
+    {
+        QString environmentMap = environmentMaps[e].trimmed();
+
+        if(method == "Light Stage")
+        {
+            unsigned int numberOfLightingConditions = settings.value("numberOfLightingConditions", 253).toUInt();
+            bool batch = settings.value("batch", false).toBool();
+
+            if(this->setReflectanceFieldOptions(settings, name, m_LSRelighting) == EXIT_FAILURE)
+                return EXIT_FAILURE;
+
+            //The batch relighting relights all the environment maps of the job at once
+            QStringList batchEnvironmentMaps;
+
+            for(int b = 0 ; batch && b<environmentMaps.size() ; b++)
+                batchEnvironmentMaps.append(environmentMaps[b].trimmed());
+
+            m_LSRelighting->clearRelighting();
+            m_LSRelighting->setRelighting(object, environmentMap, lightType, numberOfLightingConditions, numberOfOffsets);
+            m_LSRelighting->setTurntable(settings.value("turntable", false).toBool(), settings.value("turntableVideo").toString(),
+                                         settings.value("framesPerSecond", 30.0).toDouble());
+
+            //Euler angles in degrees of the rotation of the environment map (spherical harmonics)
+            QStringList angles = settings.value("sphericalHarmonicsRotation").toStringList();
+            double rotation[3] = {0.0, 0.0, 0.0};
+
+            for(int a = 0 ; a<angles.size() && a<3 ; a++)
+                rotation[a] = angles[a].trimmed().toDouble()*M_PI/180.0;
+
+            m_LSRelighting->setSphericalHarmonics(settings.value("sphericalHarmonicsBands", 0).toUInt(), rotation[0], rotation[1], rotation[2]);
+            m_LSRelighting->setWaveletApproximation(settings.value("waveletCoefficients", 0).toUInt());
+            m_LSRelighting->setBatchRelighting(batch, batchEnvironmentMaps);
+            if(m_LSRelighting->relighting() == EXIT_FAILURE)
+            {
+                cerr << "Job " << name.toStdString() << " : the relighting failed" << endl;
+                return EXIT_FAILURE;
+            }
+
+            if(batch)
+                break;
+        }
+        else if(method == "Office Room")
+        {
+            unsigned int numberOfLightingConditions = settings.value("numberOfLightingConditions", 9).toUInt();
+            QString optimisationMethod = settings.value("optimisationMethod", "Disabled").toString();
+            QString masksType = settings.value("masksType", "Low Frequency").toString();
+            unsigned int numberOfSamples = settings.value("numberOfSamples", 1024).toUInt();
+            unsigned int indirectLightPicture = settings.value("indirectLightPicture", 4).toUInt();
+            bool computeBasisMasks = settings.value("computeBasisMasks", true).toBool();
+
+            if(identificationMethod.isEmpty())
+                identificationMethod = QString("Masks");
+
+            if(this->setReflectanceFieldOptions(settings, name, m_ORRelighting) == EXIT_FAILURE)
+                return EXIT_FAILURE;
+
+            //The exposure of the office room is a factor
+            m_ORRelighting->clearRelighting();
+            m_ORRelighting->setRelighting(object, environmentMap, lightType, numberOfLightingConditions, numberOfOffsets, identificationMethod, masksType,
+                                          optimisationMethod, numberOfSamples, indirectLightPicture, computeBasisMasks, pow(2.0, exposure));
+            if(m_ORRelighting->relighting() == EXIT_FAILURE)
+            {
+                cerr << "Job " << name.toStdString() << " : the relighting failed" << endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if(method == "Free Form")
+        {
+            unsigned int numberOfLightingConditions = settings.value("numberOfLightingConditions", 142).toUInt();
+
+            if(this->setReflectanceFieldOptions(settings, name, m_FFRelighting) == EXIT_FAILURE)
+                return EXIT_FAILURE;
+
+            //The light sources are loaded from the file saved by a previous manual identification
+            m_FFRelighting->clearRelighting();
+            m_FFRelighting->setRelighting(environmentMap, lightType, numberOfLightingConditions, numberOfOffsets, exposure, QString("Load"), false);
+            if(m_FFRelighting->relighting() == EXIT_FAILURE)
+            {
+                cerr << "Job " << name.toStdString() << " : the relighting failed" << endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            cerr << "Job " << name.toStdString() << " : unknown method " << method.toStdString() << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Sets the layout, storage and relighting modes of the reflectance field given by the current group of the settings (default values if not given).
+ * @brief setReflectanceFieldOptions
+ * @param INPUT : settings job file, the group of the job has been opened.
+ * @param INPUT : name name of the job.
+ * @param OUTPUT : relighting relighting used by the job.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if an option is not valid.
+ */
+bool BatchRelighting::setReflectanceFieldOptions(QSettings &settings, const QString &name, Relighting* relighting)
+{
+    QString layout = settings.value("reflectanceFieldLayout", "Image Major").toString();
+    QString storage = settings.value("reflectanceFieldStorage", "Float32").toString();
+    QString sparse = settings.value("sparseRelighting", "Disabled").toString();
+
+    if(layout == "Image Major")
+        relighting->setReflectanceFieldLayout(IMAGE_MAJOR);
+    else if(layout == "Pixel Major")
+        relighting->setReflectanceFieldLayout(PIXEL_MAJOR);
+    else
+    {
+        cerr << "Job " << name.toStdString() << " : unknown reflectance field layout " << layout.toStdString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    if(storage == "Float32")
+        relighting->setReflectanceFieldStorage(STORAGE_FLOAT32);
+    else if(storage == "Float16")
+        relighting->setReflectanceFieldStorage(STORAGE_FLOAT16);
+    else if(storage == "UInt8")
+        relighting->setReflectanceFieldStorage(STORAGE_UINT8);
+    else
+    {
+        cerr << "Job " << name.toStdString() << " : unknown reflectance field storage " << storage.toStdString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    double sparseParameter = settings.value("sparseParameter", 1.0).toDouble();
+
+    if(sparse == "Disabled")
+        relighting->setSparseRelighting(SPARSE_DISABLED, sparseParameter);
+    else if(sparse == "Energy")
+        relighting->setSparseRelighting(SPARSE_ENERGY, sparseParameter);
+    else if(sparse == "Top K")
+        relighting->setSparseRelighting(SPARSE_TOP_K, sparseParameter);
+    else
+    {
+        cerr << "Job " << name.toStdString() << " : unknown sparse relighting " << sparse.toStdString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    relighting->setLowRankRelighting(settings.value("lowRankRank", 0).toUInt());
+    relighting->setIncrementalRelighting(settings.value("incrementalRelighting", false).toBool(),
+                                         settings.value("incrementalMaxChangedFraction", 0.25).toDouble());
+    relighting->setOutOfCoreRelighting(settings.value("outOfCore", false).toBool(),
+                                       (size_t) settings.value("outOfCoreMemoryBudget", 512).toULongLong()*1024*1024);
+    relighting->setBakedReflectanceField(settings.value("bakedReflectanceField", false).toBool());
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Qt slot that prints the information sent by a relighting.
+ * @brief printStatus
+ * @param information INPUT : information sent by the relighting.
+ */
+void BatchRelighting::printStatus(QString information)
+{
+    cout << information.toStdString() << endl;
+}
+
+/**
+ * Qt slot that prints the path of an image created by a relighting.
+ * @brief printImage
+ * @param imageName INPUT : path of the image.
+ */
+void BatchRelighting::printImage(QString imageName)
+{
+    cout << "Image saved : " << imageName.toStdString() << endl;
+}
@@ -0,0 +1,167 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file batchRelighting.h
+ * \brief Runs relighting jobs described in a file, without the graphical interface.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The jobs are read from an ini file (QSettings). Each group of the file is a job (the texts in parentheses are descriptions) :
+ *
+ * dataRoot=/path/to/data                      (optional, folder of the images and environment maps. Default : folder of the application)
+ * resultCache=true                            (optional, reads the results already computed from the folder result_cache. Default : false)
+ * resultCacheSize=1024                        (optional, maximum size of the cache of the results in MB)
+ * pyramidTolerance=0.01                       (optional, point lights : weights integrated on the pyramids of the environment map with at most this fraction of the solid angle in a wrong cell. Default : 0, full resolution)
+ *
+ * [helmet]
+ * method=Light Stage                          (Light Stage, Office Room or Free Form)
+ * object=Helmet                               (not used by the free form relighting)
+ * environmentMaps=Grace Cathedral, Pisa courtyard  (list separated by commas)
+ * lightType=Point                             (Point or Gaussian)
+ * numberOfOffsets=4
+ * numberOfLightingConditions=253
+ * exposure=0.0                                (stops, office room and free form)
+ * identificationMethod=Masks                  (office room : Inverse CDF, Median Energy or Masks. Free form : Load)
+ * optimisationMethod=Disabled                 (office room : Disabled, Original Space or PCA Space)
+ * masksType=Low Frequency                     (office room : Low Frequency or High Frequency)
+ * numberOfSamples=1024                        (office room, inverse CDF)
+ * indirectLightPicture=4                      (office room)
+ * computeBasisMasks=true                      (office room)
+ * turntable=false                             (light stage : the offsets are computed in parallel and written in order. Refused with resultCache and the low rank, sparse, incremental and out-of-core relightings)
+ * turntableVideo=helmet.avi                   (light stage turntable : video in Results/light_stage. Default : one JPEG per offset)
+ * framesPerSecond=30                          (light stage turntable video)
+ * sphericalHarmonicsBands=0                   (light stage, point lights : weights from the first bands of the spherical harmonics. Default : 0, disabled)
+ * sphericalHarmonicsRotation=0, 0, 0          (light stage spherical harmonics : Euler angles in degrees of the rotation of the environment map)
+ * waveletCoefficients=0                       (light stage, point lights : weights from the largest Haar wavelet coefficients of the environment map. Default : 0, disabled)
+ * batch=false                                 (light stage : all the offsets of all the environment maps are relit with one pass over the reflectance field per batch)
+ * reflectanceFieldLayout=Image Major          (Image Major or Pixel Major)
+ * reflectanceFieldStorage=Float32             (Float32, Float16 or UInt8)
+ * lowRankRank=0                               (relighting in the compressed domain of a low rank approximation of this rank. Default : 0, disabled)
+ * sparseRelighting=Disabled                   (Disabled, Energy or Top K)
+ * sparseParameter=1.0                         (sparse relighting : fraction of the total contribution (Energy) or number of lighting conditions (Top K) kept)
+ * incrementalRelighting=false                 (only the images whose weights changed are added to the last result)
+ * incrementalMaxChangedFraction=0.25          (incremental relighting : maximum fraction of the weights that changed for an incremental update)
+ * outOfCore=false                             (light stage : the reflectance field is read from a tiled file in the folder out_of_core)
+ * outOfCoreMemoryBudget=512                   (out-of-core relighting : maximum size in MB of the part of the reflectance field in memory)
+ * bakedReflectanceField=false                 (the linear reflectance field is mapped from a pack in the folder baked instead of decoding the images)
+ *
+ * The manual identification of the light sources needs the graphical interface : it is not available in the jobs.
+ * The messages of the relightings are printed on the standard output.
+ */
+
+#ifndef BATCHRELIGHTING_H
+#define BATCHRELIGHTING_H
+
+#include "lightStageRelighting.h"
+#include "officeRoomRelighting.h"
+#include "freeformlightstage.h"
+#include "loadFiles.h"
+
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+
+#include <QObject>
+#include <QSettings>
+#include <QString>
+#include <QStringList>
+#include <QFile>
+
+class BatchRelighting : public QObject
+{
+    Q_OBJECT
+
+    public:
+
+        /**
+         * Constructor of the BatchRelighting class.
+         * @brief BatchRelighting
+         */
+        BatchRelighting();
+
+        /**
+         * Destructor of the BatchRelighting class. Releases the memory.
+         * @brief ~BatchRelighting
+         */
+        virtual ~BatchRelighting();
+
+        /**
+         * Runs all the jobs of a job file one after the other. A job that fails does not stop the other jobs.
+         * @brief run
+         * @param INPUT : jobFile path of the ini file that describes the jobs.
+         * @param INPUT : dataRoot folder of the data. If empty, the dataRoot of the job file or the folder of the application is used.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be read or at least one job failed.
+         */
+        bool run(const QString &jobFile, const QString &dataRoot = QString());
+
+    public slots:
+
+        /**
+         * Qt slot that prints the information sent by a relighting.
+         * @brief printStatus
+         * @param information INPUT : information sent by the relighting.
+         */
+        void printStatus(QString information);
+
+        /**
+         * Qt slot that prints the path of an image created by a relighting.
+         * @brief printImage
+         * @param imageName INPUT : path of the image.
+         */
+        void printImage(QString imageName);
+
+    private:
+
+        /**
+         * Runs the job of the current group of the settings for each of its environment maps.
+         * @brief runJob
+         * @param INPUT : settings job file, the group of the job has been opened.
+         * @param INPUT : name name of the job.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the parameters of the job are not valid or if the relighting failed.
+         */
+        bool runJob(QSettings &settings, const QString &name);
+
+        /**
+         * Sets the layout, storage and relighting modes of the reflectance field given by the current group of the settings (default values if not given).
+         * @brief setReflectanceFieldOptions
+         * @param INPUT : settings job file, the group of the job has been opened.
+         * @param INPUT : name name of the job.
+         * @param OUTPUT : relighting relighting used by the job.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if an option is not valid.
+         */
+        bool setReflectanceFieldOptions(QSettings &settings, const QString &name, Relighting* relighting);
+
+        LightStageRelighting* m_LSRelighting; /*!< Light stage relighting*/
+        FreeFormLightStage* m_FFRelighting; /*!< Free form relighting*/
+        OfficeRoomRelighting* m_ORRelighting; /*!< Office room relighting*/
+};
+
+#endif // BATCHRELIGHTING_H
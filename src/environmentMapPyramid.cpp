@@ -0,0 +1,484 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file environmentMapPyramid.cpp
+ * \brief Area preserving pyramids of the environment maps and of the label maps, to integrate the environment maps over regions at a coarser resolution.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * A pixel of the level n covers 2^n x 2^n pixels of the environment map. The environment map pyramid stores sums weighted by the solid angle :
+ * the integral over a union of blocks is exact at any level. Each level also has a table of the solid angle of its rows.
+ * The label map pyramid gives a label to each block (majority of the 4 blocks below) and measures, at full resolution, the fraction of the solid angle
+ * whose label differs from the label of its block. The weights are integrated at the coarsest level whose error is below a tolerance.
+ * The level 0 (full resolution) is not stored : the integration at full resolution is done by the callers.
+ */
+
+#include "environmentMapPyramid.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Constructor of an empty pyramid.
+ * @brief EnvironmentMapPyramid
+ */
+EnvironmentMapPyramid::EnvironmentMapPyramid(): m_sums(vector<Mat>()), m_moments(vector<Mat>()), m_solidAngles(vector<vector<double> >()), m_environmentMap(Mat())
+{
+
+}
+
+/**
+ * Computes the levels of the pyramid of an environment map. Each pixel of the environment map is weighted by sin(theta) as in computeVoronoiWeightsRGB. NaN values are ignored.
+ * The number of levels is limited by the width of the environment map : the width of each level is exact so that the rotations are exact.
+ * @brief build
+ * @param INPUT : environmentMap is an OpenCV Mat of floats (CV_32FC3, BGR) containing the HDR values of the environment map.
+ * @param INPUT : numberOfLevels maximum number of levels (level 0 included).
+ */
+void EnvironmentMapPyramid::build(const Mat &environmentMap, unsigned int numberOfLevels)
+{
+    this->clear();
+
+    int width = environmentMap.cols;
+    int height = environmentMap.rows;
+
+    //Level 0 : only the solid angles are stored
+    m_sums.push_back(Mat());
+    m_moments.push_back(Mat());
+    m_solidAngles.push_back(vector<double>(height, 0.0));
+
+    for(int i = 0 ; i<height ; i++)
+        m_solidAngles[0][i] = sin((float) i*M_PI/height);
+
+    int previousWidth = width;
+    int previousHeight = height;
+
+    for(unsigned int level = 1 ; level<numberOfLevels ; level++)
+    {
+        if(previousWidth % 2 != 0 || previousWidth < 2 || previousHeight < 2)
+            break;
+
+        int levelWidth = previousWidth/2;
+        int levelHeight = (previousHeight+1)/2;
+
+        Mat sums = Mat::zeros(levelHeight, levelWidth, CV_64FC3);
+        Mat moments = Mat::zeros(levelHeight, levelWidth, CV_64FC2);
+        vector<double> solidAngles(levelHeight, 0.0);
+
+        for(int i = 0 ; i<previousHeight ; i++)
+        {
+            //Two blocks of the previous level per row of a block
+            solidAngles[i/2] += 2.0*m_solidAngles[level-1][i];
+
+            Vec3d* sumsRow = sums.ptr<Vec3d>(i/2);
+            Vec2d* momentsRow = moments.ptr<Vec2d>(i/2);
+
+            for(int j = 0 ; j<previousWidth ; j++)
+            {
+                if(level == 1)
+                {
+                    const Vec3f &pixel = environmentMap.at<Vec3f>(i, j);
+
+                    if(isnan(pixel[0]) && isnan(pixel[1]) && isnan(pixel[2])) //Values in the environment map could be NaN.
+                        continue;
+
+                    //OpenCV uses BGR
+                    double weight = m_solidAngles[0][i];
+                    Vec3d value(isnan(pixel[2]) ? 0.0 : pixel[2], isnan(pixel[1]) ? 0.0 : pixel[1], isnan(pixel[0]) ? 0.0 : pixel[0]);
+                    double intensity = weight*(value[0]+value[1]+value[2])/3.0;
+
+                    sumsRow[j/2] += value*weight;
+                    momentsRow[j/2] += Vec2d(intensity*intensity, 1.0);
+                }
+                else
+                {
+                    sumsRow[j/2] += m_sums[level-1].at<Vec3d>(i, j);
+                    momentsRow[j/2] += m_moments[level-1].at<Vec2d>(i, j);
+                }
+            }
+        }
+
+        m_sums.push_back(sums);
+        m_moments.push_back(moments);
+        m_solidAngles.push_back(solidAngles);
+
+        previousWidth = levelWidth;
+        previousHeight = levelHeight;
+    }
+
+    m_environmentMap = environmentMap;
+}
+
+/**
+ * Returns true if the pyramid has been computed from this environment map (compared by its data).
+ * @brief isBuiltFrom
+ * @param INPUT : environmentMap environment map.
+ */
+bool EnvironmentMapPyramid::isBuiltFrom(const Mat &environmentMap) const
+{
+    //The pyramid keeps a header on its environment map : the data cannot be reused by another environment map
+    return !m_sums.empty() && m_environmentMap.data == environmentMap.data && m_environmentMap.size() == environmentMap.size();
+}
+
+/**
+ * Releases the levels of the pyramid.
+ * @brief clear
+ */
+void EnvironmentMapPyramid::clear()
+{
+    m_sums = vector<Mat>();
+    m_moments = vector<Mat>();
+    m_solidAngles = vector<vector<double> >();
+    m_environmentMap.release();
+}
+
+/**
+ * Returns the number of levels of the pyramid (level 0 included).
+ * @brief getNumberOfLevels
+ */
+unsigned int EnvironmentMapPyramid::getNumberOfLevels() const
+{
+    return m_sums.size();
+}
+
+/**
+ * Returns the RGB sums weighted by the solid angle of the blocks of a level (CV_64FC3, RGB order).
+ * @brief getSums
+ * @param INPUT : level level of the pyramid (at least 1).
+ */
+const Mat &EnvironmentMapPyramid::getSums(unsigned int level) const
+{
+    return m_sums[level];
+}
+
+/**
+ * Returns the sums of the squared intensities and the number of pixels that are not NaN of the blocks of a level (CV_64FC2).
+ * @brief getMoments
+ * @param INPUT : level level of the pyramid (at least 1).
+ */
+const Mat &EnvironmentMapPyramid::getMoments(unsigned int level) const
+{
+    return m_moments[level];
+}
+
+/**
+ * Returns the solid angle of a block of each row of a level (sum of the weights sin(theta) of its pixels).
+ * @brief getSolidAngles
+ * @param INPUT : level level of the pyramid.
+ */
+const vector<double> &EnvironmentMapPyramid::getSolidAngles(unsigned int level) const
+{
+    return m_solidAngles[level];
+}
+
+/**
+ * Returns the size in bytes of the levels of the pyramid.
+ * @brief memorySize
+ */
+size_t EnvironmentMapPyramid::memorySize() const
+{
+    size_t size = 0;
+
+    for(unsigned int level = 0 ; level<m_sums.size() ; level++)
+    {
+        size += m_sums[level].total()*m_sums[level].elemSize() + m_moments[level].total()*m_moments[level].elemSize();
+        size += m_solidAngles[level].size()*sizeof(double);
+    }
+
+    return size;
+}
+
+/**
+ * Constructor of an empty pyramid.
+ * @brief LabelMapPyramid
+ */
+LabelMapPyramid::LabelMapPyramid(): m_labels(vector<Mat>()), m_errors(vector<double>())
+{
+
+}
+
+/**
+ * Computes the labels of the blocks of each level (majority of the 4 blocks of the level below) and the error of each level.
+ * @brief build
+ * @param INPUT : labelMap label of each pixel (CV_32SC1). The pixels with a negative label do not belong to any region.
+ * @param INPUT : numberOfLevels maximum number of levels (level 0 included).
+ */
+void LabelMapPyramid::build(const Mat &labelMap, unsigned int numberOfLevels)
+{
+    this->clear();
+
+    int width = labelMap.cols;
+    int height = labelMap.rows;
+
+    m_labels.push_back(Mat());
+    m_errors.push_back(0.0);
+
+    for(unsigned int level = 1 ; level<numberOfLevels ; level++)
+    {
+        const Mat &previous = (level == 1) ? labelMap : m_labels[level-1];
+
+        if(previous.cols % 2 != 0 || previous.cols < 2 || previous.rows < 2)
+            break;
+
+        Mat labels((previous.rows+1)/2, previous.cols/2, CV_32SC1);
+
+        for(int bi = 0 ; bi<labels.rows ; bi++)
+        {
+            for(int bj = 0 ; bj<labels.cols ; bj++)
+            {
+                //Labels of the blocks below (the last row of blocks may only have 2 blocks)
+                int children[4];
+                int numberOfChildren = 0;
+
+                for(int i = 2*bi ; i<std::min(2*bi+2, previous.rows) ; i++)
+                {
+                    for(int j = 2*bj ; j<2*bj+2 ; j++)
+                        children[numberOfChildren++] = previous.at<int>(i, j);
+                }
+
+                //Majority, the first label wins the ties
+                int majority = children[0];
+                int majorityCount = 0;
+
+                for(int c = 0 ; c<numberOfChildren ; c++)
+                {
+                    int count = 0;
+
+                    for(int d = 0 ; d<numberOfChildren ; d++)
+                    {
+                        if(children[d] == children[c])
+                            count++;
+                    }
+
+                    if(count > majorityCount)
+                    {
+                        majority = children[c];
+                        majorityCount = count;
+                    }
+                }
+
+                labels.at<int>(bi, bj) = majority;
+            }
+        }
+
+        m_labels.push_back(labels);
+        m_errors.push_back(0.0);
+    }
+
+    //Error of each level measured at full resolution
+    double totalSolidAngle = 0.0;
+
+    for(int i = 0 ; i<height ; i++)
+    {
+        const int* labelRow = labelMap.ptr<int>(i);
+        double solidAngle = sin((float) i*M_PI/height);
+
+        totalSolidAngle += solidAngle*width;
+
+        for(int j = 0 ; j<width ; j++)
+        {
+            for(unsigned int level = 1 ; level<m_labels.size() ; level++)
+            {
+                if(m_labels[level].at<int>(i >> level, j >> level) != labelRow[j])
+                    m_errors[level] += solidAngle;
+            }
+        }
+    }
+
+    for(unsigned int level = 1 ; level<m_errors.size() ; level++)
+        m_errors[level] = (totalSolidAngle > 0.0) ? m_errors[level]/totalSolidAngle : 0.0;
+}
+
+/**
+ * Releases the levels of the pyramid.
+ * @brief clear
+ */
+void LabelMapPyramid::clear()
+{
+    m_labels = vector<Mat>();
+    m_errors = vector<double>();
+}
+
+/**
+ * Returns true if the pyramid has not been computed.
+ * @brief empty
+ */
+bool LabelMapPyramid::empty() const
+{
+    return m_labels.empty();
+}
+
+/**
+ * Returns the number of levels of the pyramid (level 0 included).
+ * @brief getNumberOfLevels
+ */
+unsigned int LabelMapPyramid::getNumberOfLevels() const
+{
+    return m_labels.size();
+}
+
+/**
+ * Returns the label of each block of a level (CV_32SC1).
+ * @brief getLabels
+ * @param INPUT : level level of the pyramid (at least 1).
+ */
+const Mat &LabelMapPyramid::getLabels(unsigned int level) const
+{
+    return m_labels[level];
+}
+
+/**
+ * Returns the fraction of the solid angle of the pixels whose label differs from the label of their block at a level (0 at level 0).
+ * @brief getError
+ * @param INPUT : level level of the pyramid.
+ */
+double LabelMapPyramid::getError(unsigned int level) const
+{
+    return m_errors[level];
+}
+
+/**
+ * Returns the coarsest level whose error is below the tolerance and whose blocks are aligned with the rotation (columnOffset is a multiple of the size of a block).
+ * @brief selectLevel
+ * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong label.
+ * @param INPUT : columnOffset rotation of the environment map in pixels.
+ * @param INPUT : maximumLevel maximum level (number of levels of the environment map pyramid minus 1).
+ * @return the level (0 if no coarser level is accurate enough).
+ */
+unsigned int LabelMapPyramid::selectLevel(double tolerance, int columnOffset, unsigned int maximumLevel) const
+{
+    unsigned int selectedLevel = 0;
+
+    for(unsigned int level = 1 ; level<m_labels.size() && level<=maximumLevel ; level++)
+    {
+        //The error grows with the size of the blocks
+        if(m_errors[level] > tolerance || columnOffset % (1 << level) != 0)
+            break;
+
+        selectedLevel = level;
+    }
+
+    return selectedLevel;
+}
+
+/**
+ * Returns the size in bytes of the levels of the pyramid.
+ * @brief memorySize
+ */
+size_t LabelMapPyramid::memorySize() const
+{
+    size_t size = 0;
+
+    for(unsigned int level = 0 ; level<m_labels.size() ; level++)
+        size += m_labels[level].total()*m_labels[level].elemSize();
+
+    return size;
+}
+
+/**
+ * Integrates an environment map over the regions of a label map at a level of their pyramids. The environment map is rotated by columnOffset columns (pixel j reads the column j+columnOffset).
+ * @brief integrateLabels
+ * @param INPUT : environmentMap pyramid of the environment map.
+ * @param INPUT : labels pyramid of the label map (same size as the environment map).
+ * @param INPUT : level level of the integration (at least 1, columnOffset must be a multiple of 2^level).
+ * @param INPUT : columnOffset rotation of the environment map in pixels.
+ * @param INPUT : numberOfLabels number of regions. The labels outside [0 ; numberOfLabels[ are ignored.
+ * @param OUTPUT : integrals integral of the environment map over each region.
+ */
+void integrateLabels(const EnvironmentMapPyramid &environmentMap, const LabelMapPyramid &labels, unsigned int level, int columnOffset,
+                     unsigned int numberOfLabels, vector<PyramidIntegral> &integrals)
+{
+    PyramidIntegral zero;
+    zero.sum = Vec3d(0.0, 0.0, 0.0);
+    zero.squaredIntensity = 0.0;
+    zero.count = 0.0;
+
+    integrals.assign(numberOfLabels, zero);
+
+    const Mat &sums = environmentMap.getSums(level);
+    const Mat &moments = environmentMap.getMoments(level);
+    const Mat &labelsLevel = labels.getLabels(level);
+
+    if(sums.size() != labelsLevel.size())
+    {
+        cerr << "The environment map and the label map of the pyramids do not have the same size" << endl;
+        return;
+    }
+
+    //Rotation in blocks of the level
+    int width = sums.cols;
+    int fullWidth = width << level;
+    int shift = (((columnOffset % fullWidth) + fullWidth) % fullWidth) >> level;
+
+    for(int bi = 0 ; bi<sums.rows ; bi++)
+    {
+        const int* labelRow = labelsLevel.ptr<int>(bi);
+        const Vec3d* sumsRow = sums.ptr<Vec3d>(bi);
+        const Vec2d* momentsRow = moments.ptr<Vec2d>(bi);
+
+        for(int bj = 0 ; bj<width ; bj++)
+        {
+            int label = labelRow[bj];
+
+            if(label < 0 || label >= (int) numberOfLabels)
+                continue;
+
+            int column = (bj+shift) % width;
+
+            integrals[label].sum += sumsRow[column];
+            integrals[label].squaredIntensity += momentsRow[column][0];
+            integrals[label].count += momentsRow[column][1];
+        }
+    }
+}
+
+/**
+ * Converts a mask of the office room (black pixels are the region) to a label map : 0 in the region, -1 outside.
+ * @brief maskToLabelMap
+ * @param INPUT : mask mask read with imread (CV_8UC3).
+ * @param OUTPUT : labelMap label map (CV_32SC1).
+ */
+void maskToLabelMap(const Mat &mask, Mat &labelMap)
+{
+    labelMap.create(mask.rows, mask.cols, CV_32SC1);
+
+    for(int i = 0 ; i<mask.rows ; i++)
+    {
+        const Vec3b* maskRow = mask.ptr<Vec3b>(i);
+        int* labelRow = labelMap.ptr<int>(i);
+
+        for(int j = 0 ; j<mask.cols ; j++)
+        {
+            //Same threshold as computeWeightsMasks
+            bool black = maskRow[j][0] < 127 && maskRow[j][1] < 127 && maskRow[j][2] < 127;
+            labelRow[j] = black ? 0 : -1;
+        }
+    }
+}
@@ -0,0 +1,229 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file environmentMapPyramid.h
+ * \brief Area preserving pyramids of the environment maps and of the label maps, to integrate the environment maps over regions at a coarser resolution.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * A pixel of the level n covers 2^n x 2^n pixels of the environment map. The environment map pyramid stores sums weighted by the solid angle :
+ * the integral over a union of blocks is exact at any level. Each level also has a table of the solid angle of its rows.
+ * The label map pyramid gives a label to each block (majority of the 4 blocks below) and measures, at full resolution, the fraction of the solid angle
+ * whose label differs from the label of its block. The weights are integrated at the coarsest level whose error is below a tolerance.
+ * The level 0 (full resolution) is not stored : the integration at full resolution is done by the callers.
+ */
+
+#ifndef ENVIRONMENTMAPPYRAMID_H
+#define ENVIRONMENTMAPPYRAMID_H
+
+#define _USE_MATH_DEFINES
+#define PYRAMID_MAXIMUM_LEVELS 8
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Integral of an environment map over a region.
+ */
+struct PyramidIntegral
+{
+    cv::Vec3d sum; /*!< RGB sum of the pixels weighted by the solid angle*/
+    double squaredIntensity; /*!< Sum of the squared intensities ((R+G+B)/3) weighted by the solid angle*/
+    double count; /*!< Number of pixels that are not NaN*/
+};
+
+class EnvironmentMapPyramid
+{
+    public:
+        /**
+         * Constructor of an empty pyramid.
+         * @brief EnvironmentMapPyramid
+         */
+        EnvironmentMapPyramid();
+
+        /**
+         * Computes the levels of the pyramid of an environment map. Each pixel of the environment map is weighted by sin(theta) as in computeVoronoiWeightsRGB. NaN values are ignored.
+         * The number of levels is limited by the width of the environment map : the width of each level is exact so that the rotations are exact.
+         * @brief build
+         * @param INPUT : environmentMap is an OpenCV Mat of floats (CV_32FC3, BGR) containing the HDR values of the environment map.
+         * @param INPUT : numberOfLevels maximum number of levels (level 0 included).
+         */
+        void build(const cv::Mat &environmentMap, unsigned int numberOfLevels = PYRAMID_MAXIMUM_LEVELS);
+
+        /**
+         * Returns true if the pyramid has been computed from this environment map (compared by its data).
+         * @brief isBuiltFrom
+         * @param INPUT : environmentMap environment map.
+         */
+        bool isBuiltFrom(const cv::Mat &environmentMap) const;
+
+        /**
+         * Releases the levels of the pyramid.
+         * @brief clear
+         */
+        void clear();
+
+        /**
+         * Returns the number of levels of the pyramid (level 0 included).
+         * @brief getNumberOfLevels
+         */
+        unsigned int getNumberOfLevels() const;
+
+        /**
+         * Returns the RGB sums weighted by the solid angle of the blocks of a level (CV_64FC3, RGB order).
+         * @brief getSums
+         * @param INPUT : level level of the pyramid (at least 1).
+         */
+        const cv::Mat &getSums(unsigned int level) const;
+
+        /**
+         * Returns the sums of the squared intensities and the number of pixels that are not NaN of the blocks of a level (CV_64FC2).
+         * @brief getMoments
+         * @param INPUT : level level of the pyramid (at least 1).
+         */
+        const cv::Mat &getMoments(unsigned int level) const;
+
+        /**
+         * Returns the solid angle of a block of each row of a level (sum of the weights sin(theta) of its pixels).
+         * @brief getSolidAngles
+         * @param INPUT : level level of the pyramid.
+         */
+        const std::vector<double> &getSolidAngles(unsigned int level) const;
+
+        /**
+         * Returns the size in bytes of the levels of the pyramid.
+         * @brief memorySize
+         */
+        size_t memorySize() const;
+
+    private:
+        std::vector<cv::Mat> m_sums; /*!< RGB sums of each level (level 0 empty)*/
+        std::vector<cv::Mat> m_moments; /*!< Sums of the squared intensities and numbers of pixels of each level (level 0 empty)*/
+        std::vector<std::vector<double> > m_solidAngles; /*!< Solid angle of a block of each row of each level*/
+        cv::Mat m_environmentMap; /*!< Header on the environment map of the pyramid*/
+};
+
+class LabelMapPyramid
+{
+    public:
+        /**
+         * Constructor of an empty pyramid.
+         * @brief LabelMapPyramid
+         */
+        LabelMapPyramid();
+
+        /**
+         * Computes the labels of the blocks of each level (majority of the 4 blocks of the level below) and the error of each level.
+         * @brief build
+         * @param INPUT : labelMap label of each pixel (CV_32SC1). The pixels with a negative label do not belong to any region.
+         * @param INPUT : numberOfLevels maximum number of levels (level 0 included).
+         */
+        void build(const cv::Mat &labelMap, unsigned int numberOfLevels = PYRAMID_MAXIMUM_LEVELS);
+
+        /**
+         * Releases the levels of the pyramid.
+         * @brief clear
+         */
+        void clear();
+
+        /**
+         * Returns true if the pyramid has not been computed.
+         * @brief empty
+         */
+        bool empty() const;
+
+        /**
+         * Returns the number of levels of the pyramid (level 0 included).
+         * @brief getNumberOfLevels
+         */
+        unsigned int getNumberOfLevels() const;
+
+        /**
+         * Returns the label of each block of a level (CV_32SC1).
+         * @brief getLabels
+         * @param INPUT : level level of the pyramid (at least 1).
+         */
+        const cv::Mat &getLabels(unsigned int level) const;
+
+        /**
+         * Returns the fraction of the solid angle of the pixels whose label differs from the label of their block at a level (0 at level 0).
+         * @brief getError
+         * @param INPUT : level level of the pyramid.
+         */
+        double getError(unsigned int level) const;
+
+        /**
+         * Returns the coarsest level whose error is below the tolerance and whose blocks are aligned with the rotation (columnOffset is a multiple of the size of a block).
+         * @brief selectLevel
+         * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong label.
+         * @param INPUT : columnOffset rotation of the environment map in pixels.
+         * @param INPUT : maximumLevel maximum level (number of levels of the environment map pyramid minus 1).
+         * @return the level (0 if no coarser level is accurate enough).
+         */
+        unsigned int selectLevel(double tolerance, int columnOffset, unsigned int maximumLevel) const;
+
+        /**
+         * Returns the size in bytes of the levels of the pyramid.
+         * @brief memorySize
+         */
+        size_t memorySize() const;
+
+    private:
+        std::vector<cv::Mat> m_labels; /*!< Labels of each level (level 0 empty)*/
+        std::vector<double> m_errors; /*!< Fraction of the solid angle given to a wrong label at each level*/
+};
+
+/**
+ * Integrates an environment map over the regions of a label map at a level of their pyramids. The environment map is rotated by columnOffset columns (pixel j reads the column j+columnOffset).
+ * @brief integrateLabels
+ * @param INPUT : environmentMap pyramid of the environment map.
+ * @param INPUT : labels pyramid of the label map (same size as the environment map).
+ * @param INPUT : level level of the integration (at least 1, columnOffset must be a multiple of 2^level).
+ * @param INPUT : columnOffset rotation of the environment map in pixels.
+ * @param INPUT : numberOfLabels number of regions. The labels outside [0 ; numberOfLabels[ are ignored.
+ * @param OUTPUT : integrals integral of the environment map over each region.
+ */
+void integrateLabels(const EnvironmentMapPyramid &environmentMap, const LabelMapPyramid &labels, unsigned int level, int columnOffset,
+                     unsigned int numberOfLabels, std::vector<PyramidIntegral> &integrals);
+
+/**
+ * Converts a mask of the office room (black pixels are the region) to a label map : 0 in the region, -1 outside.
+ * @brief maskToLabelMap
+ * @param INPUT : mask mask read with imread (CV_8UC3).
+ * @param OUTPUT : labelMap label map (CV_32SC1).
+ */
+void maskToLabelMap(const cv::Mat &mask, cv::Mat &labelMap);
+
+#endif // ENVIRONMENTMAPPYRAMID_H
@@ -46,9 +46,10 @@ using namespace cv;
  * Constructor of the FreeFormLightStage class.
  * @brief FreeFormLightStage
  */
-FreeFormLightStage::FreeFormLightStage(): Relighting(), m_voronoi(new Voronoi()), m_exposure(0.0)
+FreeFormLightStage::FreeFormLightStage(): Relighting(), m_voronoi(new Voronoi()), m_exposure(0.0), m_identificationMethod(QString()), m_lightsIdentified(false)
 {
-
+    //The computations of the weights stop when the relighting is cancelled
+    m_voronoi->setCancelToken(&m_cancelled);
 }
 
 /**
@@ -56,41 +57,69 @@ FreeFormLightStage::FreeFormLightStage(): Relighting(), m_voronoi(new Voronoi())
   */
 FreeFormLightStage::~FreeFormLightStage()
 {
+    this->stopWorkerThread();
     delete m_voronoi;
 }
 
 /**
  * Computes the relighting of the object using the free form light stage method.
  * @brief relighting
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the environment map or the images could not be loaded, if the relighting failed or if it has been cancelled.
  */
-void FreeFormLightStage::relighting()
+bool FreeFormLightStage::relighting()
 {
+    TraceScope traceScope("FreeFormLightStage::relighting");
+
     m_object = QString("Egg");
     this->updateProgressWindow(QString("Relighting the " + m_object + " in " +m_environmentMapName), 0);
 
+    //The dark room is removed from the images in memory : they cannot be read from a tiled file
+    if(m_outOfCore)
+    {
+        cerr << "The out-of-core relighting is only available for the light stage" << endl;
+        this->updateProgressWindow(QString("Out-of-core relighting not available for the free form light stage"), 100);
+        return EXIT_FAILURE;
+    }
+
+    //The light sources identified before the start are only used by this relighting
+    bool lightsIdentified = m_lightsIdentified;
+    m_lightsIdentified = false;
+
     /*---Loads the EM---*/
-    this->loadEnvironmentMap();
-    m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+    //Already loaded if the light sources have been identified before the start (the size of the environment map clears the Voronoi diagram)
+    if(!lightsIdentified)
+    {
+        this->loadEnvironmentMap();
+        m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+    }
 
     //Load the reflectance field and remove dark room
-    this->loadReflectanceField();
+    if(!m_environmentMap.data)
+    {
+        this->updateProgressWindow(QString("Environment map not loaded"), 100);
+        return EXIT_FAILURE;
+    }
+
+    if(this->loadReflectanceField() == EXIT_FAILURE)
+    {
+        this->updateProgressWindow(QString("Images not loaded"), 100);
+        return EXIT_FAILURE;
+    }
+
     this->removeDarkRoom();
+    this->updateTrackedMemory();
 
-    this->updateProgressWindow(QString("Images loaded"), 25);
+    if(this->isCancelled())
+        return EXIT_FAILURE;
 
-    //Mouse parameters used to identified the lights manually
-    MouseParameters mouseParameters;
-    mouseParameters.voronoi = m_voronoi;
-    mouseParameters.windowName = "Lighting condition";
-    mouseParameters.latLongWidth = m_environmentMapWidth;
-    mouseParameters.latLongHeight = m_environmentMapHeight;
-    mouseParameters.isPressed = false;
-    mouseParameters.numberOfLightSourcesAdded = 0;
+    this->updateProgressWindow(QString("Images loaded"), 25);
 
     //Manual identification of light sources
     if(m_identificationMethod == "Manual")
     {
-        this->identifyLightsUser(mouseParameters);
+        if(!lightsIdentified)
+            this->identifyLightsUser();
+
         if(m_saveVoronoi)
         {
            m_voronoi->saveVoronoi();
@@ -104,55 +133,94 @@ void FreeFormLightStage::relighting()
     this->updateProgressWindow(QString("Voronoi diagram generated"), 50);
 
 
+    //Basis of the result in the cache of the results
+    ostringstream basis;
+    m_voronoi->writeBasis(basis);
+
+    if(m_pyramidTolerance > 0.0)
+        basis << "pyramid" << m_pyramidTolerance << ";";
+
     //Offsets
     float offset = 0.0;
     int progressBarValue = 50;
     for(unsigned int l = 0 ; l<m_numberOfOffsets ; l++)
     {
+        if(this->isCancelled())
+            return EXIT_FAILURE;
+
         offset = (float) 2.0*l*M_PI/m_numberOfOffsets;
 
-        //Save the Voronoi diagram
-        this->saveVoronoiTesselation(l);
+        //The weights and the linear combination are read from the cache of the results when they have already been computed
+        QByteArray key = this->resultCacheKey(offset, basis.str());
 
-        //Compute the weights of the voronoi diagram
-        //The integration can be modulated by a gaussian
-        if(m_lightType.toStdString() == "Gaussian")
+        if(this->loadCachedResult(key) == EXIT_SUCCESS)
         {
-            float* varianceX = new float[m_numberOfLightingConditions];
-            float* varianceY = new float[m_numberOfLightingConditions];
+            progressBarValue += 25/(m_numberOfOffsets);
+            this->updateProgressWindow(QString("Result " + QString::number(l) + " read from the cache"), progressBarValue);
+        }
+        else
+        {
+            //Save the Voronoi diagram
+            this->saveVoronoiTesselation(l);
 
-            for(unsigned int m = 0 ; m<m_numberOfLightingConditions ; m++)
+            //Compute the weights of the voronoi diagram
+            //The integration can be modulated by a gaussian
+            if(m_lightType.toStdString() == "Gaussian")
             {
-                varianceX[m] = 300.0;
-                varianceY[m] = 300.0;
+                float* varianceX = new float[m_numberOfLightingConditions];
+                float* varianceY = new float[m_numberOfLightingConditions];
+
+                for(unsigned int m = 0 ; m<m_numberOfLightingConditions ; m++)
+                {
+                    varianceX[m] = 300.0;
+                    varianceY[m] = 300.0;
+                }
+                m_voronoi->clearWeights(); //Reinitialise the weights
+                m_voronoi->computeVoronoiWeightsGaussianOR(m_environmentMap, offset, varianceX, varianceY);
+                m_weightsRGB = m_voronoi->getRGBWeights();
+
+                delete[] varianceX;
+                delete[] varianceY;
+
             }
-            m_voronoi->clearWeights(); //Reinitialise the weights
-            m_voronoi->computeVoronoiWeightsGaussianOR(m_environmentMap, offset, varianceX, varianceY);
-            m_weightsRGB = m_voronoi->getRGBWeights();
+            else if(m_lightType.toStdString() == "Point" && m_numberOfOffsets >= ROTATION_TABLE_MINIMUM_OFFSETS)
+            {
+                //The weights of all the offsets are computed once (first offset that is not in the cache), then read in the table
+                if(!m_voronoi->hasRotationWeightTable(m_environmentMap, ROTATION_TABLE_IMAGES))
+                    m_voronoi->computeRotationWeightTable(m_environmentMap, ROTATION_TABLE_IMAGES);
 
-            delete[] varianceX;
-            delete[] varianceY;
+                m_voronoi->getRotationWeights(offset, m_weightsRGB);
+            }
+            else if(m_lightType.toStdString() == "Point")
+            {
+               m_voronoi->clearWeights(); //Reinitialise the weights
+               m_voronoi->computeVoronoiWeightsOR(m_environmentMap, offset);
+               m_weightsRGB = m_voronoi->getRGBWeights();
+            }
 
-        }
-        else if(m_lightType.toStdString() == "Point")
-        {
-           m_voronoi->clearWeights(); //Reinitialise the weights
-           m_voronoi->computeVoronoiWeightsOR(m_environmentMap, offset);
-           m_weightsRGB = m_voronoi->getRGBWeights();
-        }
 
+            //The weights are incomplete if the relighting has been cancelled during their computation
+            if(this->isCancelled())
+                return EXIT_FAILURE;
 
-        progressBarValue += 25/(m_numberOfOffsets);
-        this->updateProgressWindow(QString("Weights computed"), progressBarValue);
+            progressBarValue += 25/(m_numberOfOffsets);
+            this->updateProgressWindow(QString("Weights computed"), progressBarValue);
+
+            //Normalize the weights
+            normalizeWeightsRGB(m_weightsRGB);
+
+            //Calculate the result. The exposure and the gamma are applied when the result is saved.
+            if(this->computeFinalRelighting() == EXIT_FAILURE)
+            {
+                this->updateProgressWindow(QString("Relighting failed"), 100);
+                return EXIT_FAILURE;
+            }
 
-        //Normalize the weights
-        normalizeWeightsRGB(m_weightsRGB);
+            this->storeCachedResult(key);
+        }
 
-        //Calculate the result, change the background, the exposure and apply the gamma
-        this->computeFinalRelighting();
+        //Change the background
         this->rayTraceBackground(offset+M_PI);//Offset by Pi. Reason not found yet
-        this->changeExposure(m_exposure);
-        this->gammaCorrection(2.2);
 
         //Saves the weights
         this->saveVoronoiWeights(l);
@@ -162,7 +230,7 @@ void FreeFormLightStage::relighting()
         //All the values are scaled between 0 and 255 before raytracing the background
         ostringstream osstream;
         osstream << this->getFolderPath() << "/Results/free_form/" << m_object.toStdString() << "_" << m_lightType.toStdString() << "_" << m_environmentMapName.toStdString() << "_offset" << l << ".jpg";
-        this->saveResult(SAVE_8BITS, osstream.str());
+        this->saveResult(SAVE_8BITS, osstream.str(), m_exposure, 2.2);
 
         emit updateImage(QString(osstream.str().c_str()));
         osstream.str("");
@@ -171,7 +239,12 @@ void FreeFormLightStage::relighting()
         this->updateProgressWindow(QString("Result " + QString::number(l) + " generated"), progressBarValue);
     }
 
+    if(m_useResultCache)
+        this->updateProgressWindow(this->resultCacheStatistics(), 100);
+
     this->updateProgressWindow(QString("Done"), 100);
+
+    return EXIT_SUCCESS;
 }
 
 /**
@@ -182,16 +255,15 @@ void FreeFormLightStage::relighting()
   */
 bool FreeFormLightStage::loadReflectanceField()
 {
-    //Only allocate memory if it has not been already allocated
-    if(m_reflectanceField == NULL)
-        m_reflectanceField = new Mat[m_numberOfLightingConditions];
+    TraceScope traceScope("FreeFormLightStage::loadReflectanceField", "loading");
+    MemoryStage memoryStage("loadReflectanceField");
 
     string file("free_form/EggFF_");
     string extension(".png");
 
     ostringstream osstream;
+    vector<string> paths(m_numberOfLightingConditions);
 
-    //Load the images
     for(unsigned int i = 0 ; i<m_numberOfLightingConditions ; i++)
     {
        osstream << this->getFolderPath();
@@ -209,18 +281,26 @@ bool FreeFormLightStage::loadReflectanceField()
           osstream << "/images/" << file << "0" << i << extension;
        }
 
-       m_reflectanceField[i] = imread(osstream.str(), CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_COLOR);
+       paths[i] = osstream.str();
+       osstream.str("");
+    }
 
-       if(!m_reflectanceField[i].data)
-       {
-          cerr << "Couldn't open the file : " << osstream.str() << endl;
-          return EXIT_FAILURE;
-       }
+    //Identity of the reflectance field in the baked pack and in the cache of the results
+    m_sourceImagesSignature = this->sourceImagesSignature(paths, vector<float>());
 
-       m_reflectanceField[i].convertTo(m_reflectanceField[i], CV_32FC3, 1.0/255.0);
+    //The pack of the images is mapped instead of decoding the images when it has already been baked from the same images
+    //The images are modified after the loading (removeDarkRoom) : the pack holds floats in image major order
+    if(this->mapBakedReflectanceField(file, IMAGE_MAJOR, STORAGE_FLOAT32) == EXIT_SUCCESS)
+        return EXIT_SUCCESS;
 
-       osstream.str("");
-    }
+    //Load the images in parallel
+    ReflectanceFieldLoader loader(m_reflectanceField);
+    loader.setReadFlags(CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_COLOR);
+    loader.setScale(1.0/255.0);
+    loader.setProgress(this, 0, 25);
+
+    if(loader.load(paths) == EXIT_FAILURE)
+        return EXIT_FAILURE;
 
     //Load the mask
     //Only one object for Free form acquisition
@@ -236,6 +316,8 @@ bool FreeFormLightStage::loadReflectanceField()
 
     m_objectMask.convertTo(m_objectMask, CV_32FC3, 1.0/255.0);
 
+    this->bakeReflectanceField(file, IMAGE_MAJOR, STORAGE_FLOAT32);
+
     return EXIT_SUCCESS;
 }
 
@@ -245,6 +327,9 @@ bool FreeFormLightStage::loadReflectanceField()
  */
 void FreeFormLightStage::removeDarkRoom()
 {
+    TraceScope traceScope("FreeFormLightStage::removeDarkRoom", "loading");
+    MemoryStage memoryStage("removeDarkRoom");
+
     //Load the dark room picture
     Mat darkRoom = imread(this->getFolderPath() + "/images/free_form/darkRoom.png", CV_LOAD_IMAGE_COLOR);
 
@@ -260,18 +345,47 @@ void FreeFormLightStage::removeDarkRoom()
 
     for(unsigned int i = 0 ; i<m_numberOfLightingConditions ; i++)
     {
-        m_reflectanceField[i]-= darkRoom;
-        m_reflectanceField[i] = max(m_reflectanceField[i], 0.0); // clamp
+        Mat image = m_reflectanceField.image(i);
+
+        image -= darkRoom;
+        max(image, 0.0, image); // clamp
     }
 }
 
+/**
+ * Loads the environment map and identifies the light sources manually on the calling thread (thread of the graphical interface) if the identification is manual.
+ * relighting then uses these light sources.
+ * @brief identifyLightsBeforeStart
+ */
+void FreeFormLightStage::identifyLightsBeforeStart()
+{
+    m_lightsIdentified = false;
+
+    if(m_identificationMethod != "Manual")
+        return;
+
+    this->loadEnvironmentMap();
+    m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+
+    this->identifyLightsUser();
+    m_lightsIdentified = true;
+}
+
 /**
  * Method to manually select the incoming light directions in the environment map of the office.
  * @brief identifyLightsUser
- * @param INPUT : mouseParameters parameters that are sent to the callback function to manually select light sources.
  */
-void FreeFormLightStage::identifyLightsUser(MouseParameters& mouseParameters)
+void FreeFormLightStage::identifyLightsUser()
 {
+    //Mouse parameters used to identified the lights manually
+    MouseParameters mouseParameters;
+    mouseParameters.voronoi = m_voronoi;
+    mouseParameters.windowName = "Lighting condition";
+    mouseParameters.latLongWidth = m_environmentMapWidth;
+    mouseParameters.latLongHeight = m_environmentMapHeight;
+    mouseParameters.isPressed = false;
+    mouseParameters.numberOfLightSourcesAdded = 0;
+
     Mat lightingCondition;
     ostringstream osstream;
     int cellNumber = 0;
@@ -413,6 +527,17 @@ void FreeFormLightStage::setIdentificationMethod(QString& identificationMethod)
     m_identificationMethod = identificationMethod;
 }
 
+/**
+ * Sets the tolerance of the integration of the weights on the pyramids (see Relighting::setPyramidTolerance) and gives it to the Voronoi diagram.
+ * @brief setPyramidTolerance
+ * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong light source.
+ */
+void FreeFormLightStage::setPyramidTolerance(double tolerance)
+{
+    Relighting::setPyramidTolerance(tolerance);
+    m_voronoi->setPyramidTolerance(tolerance);
+}
+
 /**
  * Setter to change the value of the boolean that saves of the Voronoi diagram to a file.
  * @brief setSaveVoronoiDiagram
@@ -454,6 +579,7 @@ void FreeFormLightStage::setRelighting(QString &environmentMap, QString &lightTy
 void FreeFormLightStage::clearRelighting()
 {
     m_voronoi->clearVoronoi();
+    m_lightsIdentified = false;
     m_object = QString("");
     m_environmentMapName = QString("");
     m_lightType = QString("");
@@ -477,5 +603,4 @@ void FreeFormLightStage::updateProgressWindow(QString updateText, int progressBa
 {
     emit statusUpdate(updateText);
     emit updateProgressBar(progressBarValue);
-    qApp->processEvents(); //Refresh the main window to process the signals
 }
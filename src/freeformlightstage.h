@@ -85,8 +85,9 @@ class FreeFormLightStage : public Relighting
         /**
          * Computes the relighting of the object using the free form light stage method.
          * @brief relighting
+         * @return EXIT_SUCCESS, or EXIT_FAILURE if the environment map or the images could not be loaded, if the relighting failed or if it has been cancelled.
          */
-        void virtual relighting();
+        bool virtual relighting();
 
        /**
          * Virtual pure function.
@@ -105,9 +106,15 @@ class FreeFormLightStage : public Relighting
         /**
          * Method to manually select the incoming light directions in the environment map of the office.
          * @brief identifyLightsUser
-         * @param INPUT : mouseParameters parameters that are sent to the callback function to manually select light sources.
          */
-        void identifyLightsUser(MouseParameters& mouseParameters);
+        void identifyLightsUser();
+
+        /**
+         * Loads the environment map and identifies the light sources manually on the calling thread (thread of the graphical interface) if the identification is manual.
+         * relighting then uses these light sources.
+         * @brief identifyLightsBeforeStart
+         */
+        void virtual identifyLightsBeforeStart();
 
         /**
          * Saves the environment map with the voronoi tesselation displayed.
@@ -136,6 +143,13 @@ class FreeFormLightStage : public Relighting
          */
         void setIdentificationMethod(QString& identificationMethod);
 
+        /**
+         * Sets the tolerance of the integration of the weights on the pyramids (see Relighting::setPyramidTolerance) and gives it to the Voronoi diagram.
+         * @brief setPyramidTolerance
+         * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong light source.
+         */
+        void virtual setPyramidTolerance(double tolerance);
+
         /**
          * Setter to change the value of the boolean that saves of the Voronoi diagram to a file.
          * @brief setSaveVoronoiDiagram
@@ -197,6 +211,7 @@ class FreeFormLightStage : public Relighting
         Voronoi* m_voronoi; /*!< Object that performs the voronoi tesselation*/
         double m_exposure; /*!< Exposure of the final result*/
         QString m_identificationMethod; /*!< Method to select light sources*/
+        bool m_lightsIdentified; /*!< True if the light sources have been identified by identifyLightsBeforeStart for the next relighting*/
         bool m_saveVoronoi; /*!< Boolean to save the voronoi diagram or not*/
 };
 
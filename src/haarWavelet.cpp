@@ -0,0 +1,567 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file haarWavelet.cpp
+ * \brief Haar wavelet transforms of the environment maps and of the Voronoi cells, and nonlinear approximation of the environment maps.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The transform is the orthonormal nonstandard 2D Haar decomposition (2x2 blocks, then 1D steps once one dimension is 1), on images padded with zeros to powers of two.
+ * The coefficients are stored at the position of the in-place layout : index = row*paddedWidth + column, the last average is at index 0.
+ * The transform is orthonormal : the integral of an environment map over a cell is the dot product of their coefficients.
+ * Most of the energy of an environment map with a few bright regions is in a few coefficients : the weights are approximated with the largest coefficients only.
+ */
+
+#include "haarWavelet.h"
+
+using namespace std;
+using namespace cv;
+
+typedef vector<pair<int, double> > SparseVector; //(label, value) of the elements of a level, sorted by label within each element
+
+//Signs of a block : average then details. 2D blocks are a b / c d (horizontal, vertical and diagonal details), 1D blocks are a b
+static const double haarSigns2D[4][4] = {{1.0, 1.0, 1.0, 1.0}, {1.0, -1.0, 1.0, -1.0}, {1.0, 1.0, -1.0, -1.0}, {1.0, -1.0, -1.0, 1.0}};
+static const double haarSigns1D[2][2] = {{1.0, 1.0}, {1.0, -1.0}};
+
+/**
+ * Gives the inputs and the outputs of a block of one level of the transform.
+ * @brief haarBlock
+ * @param INPUT : width, height size of the current level (averages of the previous level).
+ * @param INPUT : bi, bj position of the block in the next level.
+ * @param INPUT : paddedWidth width of the transform.
+ * @param OUTPUT : inputs positions of the inputs in the current level (row*width + column).
+ * @param OUTPUT : outputs position of the average in the next level, then positions of the details in the transform.
+ * @param OUTPUT : scale normalisation of the block.
+ * @return the number of inputs (4 for a 2D block, 2 for a 1D block).
+ */
+static int haarBlock(int width, int height, int bi, int bj, int paddedWidth, int inputs[4], int outputs[4], double &scale)
+{
+    int nextWidth = (width > 1) ? width/2 : 1;
+    int nextHeight = (height > 1) ? height/2 : 1;
+
+    outputs[0] = bi*nextWidth + bj;
+
+    if(width > 1 && height > 1)
+    {
+        inputs[0] = 2*bi*width + 2*bj;
+        inputs[1] = 2*bi*width + 2*bj+1;
+        inputs[2] = (2*bi+1)*width + 2*bj;
+        inputs[3] = (2*bi+1)*width + 2*bj+1;
+
+        outputs[1] = bi*paddedWidth + bj+nextWidth;
+        outputs[2] = (bi+nextHeight)*paddedWidth + bj;
+        outputs[3] = (bi+nextHeight)*paddedWidth + bj+nextWidth;
+
+        scale = 0.5;
+        return 4;
+    }
+    else if(width > 1)
+    {
+        inputs[0] = 2*bj;
+        inputs[1] = 2*bj+1;
+        outputs[1] = bj+nextWidth;
+    }
+    else
+    {
+        inputs[0] = 2*bi;
+        inputs[1] = 2*bi+1;
+        outputs[1] = (bi+nextHeight)*paddedWidth;
+    }
+
+    scale = 1.0/sqrt(2.0);
+    return 2;
+}
+
+/**
+ * Sign of an input in an output of a block.
+ * @brief haarSign
+ * @param INPUT : numberOfInputs number of inputs of the block (4 or 2).
+ * @param INPUT : output output of the block (0 is the average).
+ * @param INPUT : input input of the block.
+ * @return +1 or -1.
+ */
+static double haarSign(int numberOfInputs, int output, int input)
+{
+    return (numberOfInputs == 4) ? haarSigns2D[output][input] : haarSigns1D[output][input];
+}
+
+/**
+ * Coefficient of an environment map candidate to the approximation.
+ */
+struct WaveletCandidate
+{
+    double energy; /*!< Energy of the coefficient (sum over the channels)*/
+    int index; /*!< Position of the coefficient in the transform*/
+    Vec3d value; /*!< RGB value of the coefficient*/
+};
+
+/**
+ * Orders the candidates by decreasing energy (the heap of the candidates gives the smallest energy first).
+ */
+struct GreaterEnergy
+{
+    bool operator()(const WaveletCandidate &a, const WaveletCandidate &b) const
+    {
+        return a.energy > b.energy;
+    }
+};
+
+/**
+ * Orders the candidates by position.
+ * @brief lessCandidateIndex
+ */
+static bool lessCandidateIndex(const WaveletCandidate &a, const WaveletCandidate &b)
+{
+    return a.index < b.index;
+}
+
+/**
+ * Adds a coefficient of an environment map to the candidates : only the numberOfKeptCoefficients largest coefficients are kept.
+ * @brief selectWaveletCoefficient
+ * @param OUTPUT : largest heap of the largest coefficients (smallest energy first, see GreaterEnergy).
+ * @param INPUT : numberOfKeptCoefficients maximum number of coefficients kept.
+ * @param INPUT : index position of the coefficient.
+ * @param INPUT : value RGB value of the coefficient.
+ * @param OUTPUT : totalEnergy energy of all the coefficients (updated).
+ */
+static void selectWaveletCoefficient(vector<WaveletCandidate> &largest, unsigned int numberOfKeptCoefficients, int index, const Vec3d &value, double &totalEnergy)
+{
+    WaveletCandidate candidate;
+    candidate.energy = value.dot(value);
+    candidate.index = index;
+    candidate.value = value;
+
+    totalEnergy += candidate.energy;
+
+    if(numberOfKeptCoefficients == 0)
+        return;
+
+    if(largest.size() < numberOfKeptCoefficients)
+    {
+        largest.push_back(candidate);
+        push_heap(largest.begin(), largest.end(), GreaterEnergy());
+    }
+    else if(candidate.energy > largest.front().energy)
+    {
+        pop_heap(largest.begin(), largest.end(), GreaterEnergy());
+        largest.back() = candidate;
+        push_heap(largest.begin(), largest.end(), GreaterEnergy());
+    }
+}
+
+/**
+ * Reads a pixel of the first level of the transform of an environment map : RGB value weighted by the solid angle, 0 in the padding and for NaN values.
+ * @brief weightedPixel
+ * @param INPUT : environmentMap environment map (CV_32FC3, BGR).
+ * @param INPUT : solidAngles solid angle of each row of the environment map.
+ * @param INPUT : position position of the pixel in the padded image (row*paddedWidth + column).
+ * @param INPUT : paddedWidth width of the padded image.
+ * @return the RGB value of the pixel.
+ */
+static Vec3d weightedPixel(const Mat &environmentMap, const vector<double> &solidAngles, int position, int paddedWidth)
+{
+    int i = position/paddedWidth;
+    int j = position%paddedWidth;
+
+    if(i >= environmentMap.rows || j >= environmentMap.cols)
+        return Vec3d(0.0, 0.0, 0.0);
+
+    //OpenCV uses BGR
+    const Vec3f &pixel = environmentMap.ptr<Vec3f>(i)[j];
+    Vec3d value(isnan(pixel[2]) ? 0.0 : pixel[2], isnan(pixel[1]) ? 0.0 : pixel[1], isnan(pixel[0]) ? 0.0 : pixel[0]);
+
+    return value*solidAngles[i];
+}
+
+/**
+ * Orders the values of the labels in a block by label.
+ * @brief lessLabel
+ */
+static bool lessLabel(const pair<int, Vec4d> &a, const pair<int, Vec4d> &b)
+{
+    return a.first < b.first;
+}
+
+/**
+ * Orders the coefficients of the cells by position, then by label.
+ * @brief lessWaveletCoefficient
+ */
+static bool lessWaveletCoefficient(const SparseWaveletCoefficient &a, const SparseWaveletCoefficient &b)
+{
+    return (a.index < b.index) || (a.index == b.index && a.label < b.label);
+}
+
+/**
+ * Appends a coefficient of a cell.
+ * @brief addWaveletCoefficient
+ * @param OUTPUT : coefficients coefficients of the cells.
+ * @param INPUT : index position of the coefficient.
+ * @param INPUT : label number of the cell.
+ * @param INPUT : value value of the coefficient.
+ */
+static void addWaveletCoefficient(vector<SparseWaveletCoefficient> &coefficients, int index, int label, double value)
+{
+    SparseWaveletCoefficient coefficient;
+    coefficient.index = index;
+    coefficient.label = label;
+    coefficient.value = value;
+
+    coefficients.push_back(coefficient);
+}
+
+/**
+ * Returns the smallest power of two greater than or equal to size.
+ * @brief waveletSize
+ * @param INPUT : size size of the image along one dimension.
+ * @return the size of the image padded for the transform.
+ */
+int waveletSize(int size)
+{
+    int paddedSize = 1;
+
+    while(paddedSize < size)
+        paddedSize *= 2;
+
+    return paddedSize;
+}
+
+/**
+ * Gives the support of the basis function of a coefficient : the function is constant on each rectangle and zero elsewhere.
+ * @brief waveletSupport
+ * @param INPUT : index position of the coefficient in the transform.
+ * @param INPUT : paddedWidth, paddedHeight size of the transform.
+ * @param OUTPUT : rectangles rectangles of the support (pixels of the padded image).
+ * @param OUTPUT : values value of the basis function on each rectangle.
+ * @return the number of rectangles (1 for the last average, 2 for a 1D detail, 4 for a 2D detail).
+ */
+int waveletSupport(int index, int paddedWidth, int paddedHeight, Rect rectangles[4], double values[4])
+{
+    int row = index/paddedWidth;
+    int column = index%paddedWidth;
+    int levelWidth = paddedWidth;
+    int levelHeight = paddedHeight;
+
+    //Level of the transform whose details contain the position (same layout as haarBlock)
+    while(levelWidth > 1 || levelHeight > 1)
+    {
+        int nextWidth = (levelWidth > 1) ? levelWidth/2 : 1;
+        int nextHeight = (levelHeight > 1) ? levelHeight/2 : 1;
+
+        if(row < levelHeight && column < levelWidth && (row >= nextHeight || column >= nextWidth))
+        {
+            //An input of the block is the normalised sum of blockWidth x blockHeight pixels
+            int blockWidth = paddedWidth/levelWidth;
+            int blockHeight = paddedHeight/levelHeight;
+            int bi = (row >= nextHeight) ? row-nextHeight : row;
+            int bj = (column >= nextWidth) ? column-nextWidth : column;
+            double inputScale = 1.0/sqrt((double) blockWidth*blockHeight);
+
+            if(levelWidth > 1 && levelHeight > 1)
+            {
+                int output = ((row >= nextHeight) ? 2 : 0) + ((column >= nextWidth) ? 1 : 0);
+
+                for(int t = 0 ; t<4 ; t++)
+                {
+                    rectangles[t] = Rect((2*bj + t%2)*blockWidth, (2*bi + t/2)*blockHeight, blockWidth, blockHeight);
+                    values[t] = haarSigns2D[output][t]*0.5*inputScale;
+                }
+
+                return 4;
+            }
+
+            for(int t = 0 ; t<2 ; t++)
+            {
+                if(levelWidth > 1)
+                    rectangles[t] = Rect((2*bj + t)*blockWidth, 0, blockWidth, blockHeight);
+                else
+                    rectangles[t] = Rect(0, (2*bi + t)*blockHeight, blockWidth, blockHeight);
+
+                values[t] = haarSigns1D[1][t]*inputScale/sqrt(2.0);
+            }
+
+            return 2;
+        }
+
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    //Last average : constant on the whole image
+    rectangles[0] = Rect(0, 0, paddedWidth, paddedHeight);
+    values[0] = 1.0/sqrt((double) paddedWidth*paddedHeight);
+
+    return 1;
+}
+
+/**
+ * Computes the transform of an environment map weighted by the solid angle (sin(theta), as computeVoronoiWeightsRGB).
+ * Only the numberOfCoefficients largest coefficients (by energy) are kept : they are selected while the transform is computed, which is never stored. NaN values of the environment map are ignored.
+ * @brief environmentMapWavelet
+ * @param INPUT : environmentMap is an OpenCV Mat of floats (CV_32FC3, BGR) containing the HDR values of the environment map.
+ * @param INPUT : numberOfCoefficients number of coefficients kept.
+ * @param OUTPUT : approximation coefficients kept (RGB order) and relative error of the approximation.
+ */
+void environmentMapWavelet(const Mat &environmentMap, unsigned int numberOfCoefficients, WaveletApproximation &approximation)
+{
+    int width = environmentMap.cols;
+    int height = environmentMap.rows;
+    int paddedWidth = waveletSize(width);
+    int paddedHeight = waveletSize(height);
+    int size = paddedWidth*paddedHeight;
+
+    vector<double> solidAngles(height);
+
+    for(int i = 0 ; i<height ; i++)
+        solidAngles[i] = sin((float) i*M_PI/height);
+
+    unsigned int numberOfKeptCoefficients = std::min(numberOfCoefficients, (unsigned int) size);
+
+    //Largest coefficients found so far
+    vector<WaveletCandidate> largest;
+    largest.reserve(numberOfKeptCoefficients);
+    double totalEnergy = 0.0;
+
+    //Averages of the current level : the first level is read from the environment map, the next ones are 4 (or 2) times smaller
+    vector<Vec3d> level;
+    bool firstLevel = true;
+    int levelWidth = paddedWidth;
+    int levelHeight = paddedHeight;
+
+    while(levelWidth > 1 || levelHeight > 1)
+    {
+        int nextWidth = (levelWidth > 1) ? levelWidth/2 : 1;
+        int nextHeight = (levelHeight > 1) ? levelHeight/2 : 1;
+        vector<Vec3d> next(nextWidth*nextHeight);
+
+        int inputs[4], outputs[4];
+        Vec3d inputValues[4];
+        double scale = 1.0;
+
+        for(int bi = 0 ; bi<nextHeight ; bi++)
+        {
+            for(int bj = 0 ; bj<nextWidth ; bj++)
+            {
+                int numberOfInputs = haarBlock(levelWidth, levelHeight, bi, bj, paddedWidth, inputs, outputs, scale);
+
+                for(int t = 0 ; t<numberOfInputs ; t++)
+                    inputValues[t] = firstLevel ? weightedPixel(environmentMap, solidAngles, inputs[t], paddedWidth) : level[inputs[t]];
+
+                for(int o = 0 ; o<numberOfInputs ; o++)
+                {
+                    Vec3d value(0.0, 0.0, 0.0);
+
+                    for(int t = 0 ; t<numberOfInputs ; t++)
+                        value += inputValues[t]*haarSign(numberOfInputs, o, t);
+
+                    if(o == 0)
+                        next[outputs[0]] = value*scale;
+                    else
+                        selectWaveletCoefficient(largest, numberOfKeptCoefficients, outputs[o], value*scale, totalEnergy);
+                }
+            }
+        }
+
+        level.swap(next);
+        firstLevel = false;
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    //Last average
+    selectWaveletCoefficient(largest, numberOfKeptCoefficients, 0, firstLevel ? weightedPixel(environmentMap, solidAngles, 0, paddedWidth) : level[0], totalEnergy);
+
+    sort(largest.begin(), largest.end(), lessCandidateIndex);
+
+    approximation.indices.resize(largest.size());
+    approximation.coefficients.resize(largest.size());
+
+    double keptEnergy = 0.0;
+
+    for(unsigned int k = 0 ; k<largest.size() ; k++)
+    {
+        approximation.indices[k] = largest[k].index;
+        approximation.coefficients[k] = largest[k].value;
+        keptEnergy += largest[k].energy;
+    }
+
+    //The transform is orthonormal : the energy of the coefficients dropped is the squared L2 error
+    approximation.relativeError = (totalEnergy > 0.0) ? sqrt(std::max(0.0, totalEnergy-keptEnergy)/totalEnergy) : 0.0;
+}
+
+/**
+ * Computes the transform of the indicator function of each label of a label map. The coefficients equal to zero are not stored.
+ * The indicator of a region is constant on most blocks : only the blocks crossed by the boundaries of the regions give coefficients.
+ * The values of the labels in each level are stored in a single buffer (the first level is read from the label map).
+ * @brief labelMapWavelet
+ * @param INPUT : labelMap label of each pixel (CV_32SC1). The pixels with a negative label do not belong to any region.
+ * @param OUTPUT : coefficients coefficients of all the labels sorted by index.
+ */
+void labelMapWavelet(const Mat &labelMap, vector<SparseWaveletCoefficient> &coefficients)
+{
+    int width = labelMap.cols;
+    int height = labelMap.rows;
+    int paddedWidth = waveletSize(width);
+    int paddedHeight = waveletSize(height);
+
+    coefficients.clear();
+
+    //Values of the labels of the current level : element e owns the values [levelOffsets[e] ; levelOffsets[e+1][ of level
+    SparseVector level, next;
+    vector<int> levelOffsets, nextOffsets;
+    bool firstLevel = true;
+    int levelWidth = paddedWidth;
+    int levelHeight = paddedHeight;
+
+    //Values of each label in the inputs of a block, sorted by label
+    vector<pair<int, Vec4d> > valuesOfLabel;
+
+    while(levelWidth > 1 || levelHeight > 1)
+    {
+        int nextWidth = (levelWidth > 1) ? levelWidth/2 : 1;
+        int nextHeight = (levelHeight > 1) ? levelHeight/2 : 1;
+
+        next.clear();
+        nextOffsets.assign(1, 0);
+
+        int inputs[4], outputs[4];
+        double scale = 1.0;
+
+        //Inputs of a block : ranges of level, or a single value for a labelled pixel of the first level
+        pair<int, double> pixels[4];
+        const pair<int, double>* inputBegin[4];
+        const pair<int, double>* inputEnd[4];
+
+        //The blocks are visited in the order of the averages of the next level (outputs[0] = bi*nextWidth + bj)
+        for(int bi = 0 ; bi<nextHeight ; bi++)
+        {
+            for(int bj = 0 ; bj<nextWidth ; bj++)
+            {
+                int numberOfInputs = haarBlock(levelWidth, levelHeight, bi, bj, paddedWidth, inputs, outputs, scale);
+
+                for(int t = 0 ; t<numberOfInputs ; t++)
+                {
+                    if(firstLevel)
+                    {
+                        int i = inputs[t]/paddedWidth;
+                        int j = inputs[t]%paddedWidth;
+                        int label = (i < height && j < width) ? labelMap.ptr<int>(i)[j] : -1;
+
+                        pixels[t] = make_pair(label, 1.0);
+                        inputBegin[t] = &pixels[t];
+                        inputEnd[t] = (label >= 0) ? &pixels[t]+1 : &pixels[t];
+                    }
+                    else
+                    {
+                        inputBegin[t] = level.empty() ? NULL : &level[0] + levelOffsets[inputs[t]];
+                        inputEnd[t] = level.empty() ? NULL : &level[0] + levelOffsets[inputs[t]+1];
+                    }
+                }
+
+                //Block inside a single cell : no detail
+                bool uniform = (inputEnd[0]-inputBegin[0] == 1);
+
+                for(int t = 1 ; t<numberOfInputs && uniform ; t++)
+                    uniform = (inputEnd[t]-inputBegin[t] == 1 && *inputBegin[t] == *inputBegin[0]);
+
+                if(uniform)
+                {
+                    next.push_back(make_pair(inputBegin[0]->first, inputBegin[0]->second*numberOfInputs*scale));
+                    nextOffsets.push_back(next.size());
+                    continue;
+                }
+
+                //Values of each label in the inputs of the block (a block only contains a few labels)
+                valuesOfLabel.clear();
+
+                for(int t = 0 ; t<numberOfInputs ; t++)
+                {
+                    for(const pair<int, double>* input = inputBegin[t] ; input != inputEnd[t] ; ++input)
+                    {
+                        unsigned int e = 0;
+
+                        while(e < valuesOfLabel.size() && valuesOfLabel[e].first != input->first)
+                            e++;
+
+                        if(e == valuesOfLabel.size())
+                            valuesOfLabel.push_back(make_pair(input->first, Vec4d(0.0, 0.0, 0.0, 0.0)));
+
+                        valuesOfLabel[e].second[t] += input->second;
+                    }
+                }
+
+                sort(valuesOfLabel.begin(), valuesOfLabel.end(), lessLabel);
+
+                for(unsigned int e = 0 ; e<valuesOfLabel.size() ; e++)
+                {
+                    for(int o = 0 ; o<numberOfInputs ; o++)
+                    {
+                        double value = 0.0;
+
+                        for(int t = 0 ; t<numberOfInputs ; t++)
+                            value += valuesOfLabel[e].second[t]*haarSign(numberOfInputs, o, t);
+
+                        value *= scale;
+
+                        if(fabs(value) < 1e-12)
+                            continue;
+
+                        if(o == 0)
+                            next.push_back(make_pair(valuesOfLabel[e].first, value));
+                        else
+                            addWaveletCoefficient(coefficients, outputs[o], valuesOfLabel[e].first, value);
+                    }
+                }
+
+                nextOffsets.push_back(next.size());
+            }
+        }
+
+        level.swap(next);
+        levelOffsets.swap(nextOffsets);
+        firstLevel = false;
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    //Last average (the label of the pixel if the label map is a single pixel)
+    if(firstLevel)
+    {
+        if(width > 0 && height > 0 && labelMap.ptr<int>(0)[0] >= 0)
+            addWaveletCoefficient(coefficients, 0, labelMap.ptr<int>(0)[0], 1.0);
+    }
+    else
+    {
+        for(int e = levelOffsets[0] ; e<levelOffsets[1] ; e++)
+            addWaveletCoefficient(coefficients, 0, level[e].first, level[e].second);
+    }
+
+    sort(coefficients.begin(), coefficients.end(), lessWaveletCoefficient);
+}
@@ -0,0 +1,116 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file haarWavelet.h
+ * \brief Haar wavelet transforms of the environment maps and of the Voronoi cells, and nonlinear approximation of the environment maps.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The transform is the orthonormal nonstandard 2D Haar decomposition (2x2 blocks, then 1D steps once one dimension is 1), on images padded with zeros to powers of two.
+ * The coefficients are stored at the position of the in-place layout : index = row*paddedWidth + column, the last average is at index 0.
+ * The transform is orthonormal : the integral of an environment map over a cell is the dot product of their coefficients.
+ * Most of the energy of an environment map with a few bright regions is in a few coefficients : the weights are approximated with the largest coefficients only.
+ * Each basis function is constant on at most 4 rectangles (see waveletSupport) : a rotation of the environment map is applied on the side of the cells.
+ */
+
+#ifndef HAARWAVELET_H
+#define HAARWAVELET_H
+
+#define _USE_MATH_DEFINES
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Coefficient of the transform of the indicator function of a Voronoi cell.
+ */
+struct SparseWaveletCoefficient
+{
+    int index; /*!< Position of the coefficient in the transform*/
+    int label; /*!< Number of the cell*/
+    double value; /*!< Value of the coefficient*/
+};
+
+/**
+ * Largest coefficients of the transform of an environment map (weighted by the solid angle).
+ */
+struct WaveletApproximation
+{
+    std::vector<int> indices; /*!< Positions of the coefficients kept (increasing order)*/
+    std::vector<cv::Vec3d> coefficients; /*!< RGB values of the coefficients kept*/
+    double relativeError; /*!< Relative L2 error of the approximation of the environment map weighted by the solid angle*/
+};
+
+/**
+ * Returns the smallest power of two greater than or equal to size.
+ * @brief waveletSize
+ * @param INPUT : size size of the image along one dimension.
+ * @return the size of the image padded for the transform.
+ */
+int waveletSize(int size);
+
+/**
+ * Gives the support of the basis function of a coefficient : the function is constant on each rectangle and zero elsewhere.
+ * @brief waveletSupport
+ * @param INPUT : index position of the coefficient in the transform.
+ * @param INPUT : paddedWidth, paddedHeight size of the transform.
+ * @param OUTPUT : rectangles rectangles of the support (pixels of the padded image).
+ * @param OUTPUT : values value of the basis function on each rectangle.
+ * @return the number of rectangles (1 for the last average, 2 for a 1D detail, 4 for a 2D detail).
+ */
+int waveletSupport(int index, int paddedWidth, int paddedHeight, cv::Rect rectangles[4], double values[4]);
+
+/**
+ * Computes the transform of an environment map weighted by the solid angle (sin(theta), as computeVoronoiWeightsRGB).
+ * Only the numberOfCoefficients largest coefficients (by energy) are kept : they are selected while the transform is computed, which is never stored. NaN values of the environment map are ignored.
+ * @brief environmentMapWavelet
+ * @param INPUT : environmentMap is an OpenCV Mat of floats (CV_32FC3, BGR) containing the HDR values of the environment map.
+ * @param INPUT : numberOfCoefficients number of coefficients kept.
+ * @param OUTPUT : approximation coefficients kept (RGB order) and relative error of the approximation.
+ */
+void environmentMapWavelet(const cv::Mat &environmentMap, unsigned int numberOfCoefficients, WaveletApproximation &approximation);
+
+/**
+ * Computes the transform of the indicator function of each label of a label map. The coefficients equal to zero are not stored.
+ * The indicator of a region is constant on most blocks : only the blocks crossed by the boundaries of the regions give coefficients.
+ * The values of the labels in each level are stored in a single buffer (the first level is read from the label map).
+ * @brief labelMapWavelet
+ * @param INPUT : labelMap label of each pixel (CV_32SC1). The pixels with a negative label do not belong to any region.
+ * @param OUTPUT : coefficients coefficients of all the labels sorted by index.
+ */
+void labelMapWavelet(const cv::Mat &labelMap, std::vector<SparseWaveletCoefficient> &coefficients);
+
+#endif // HAARWAVELET_H
@@ -50,6 +50,8 @@ using namespace cv;
  */
 void gammaCorrectionImage(const Mat &rgbImage, Mat &rgbImageWithGamma, double gamma)
 {
+    //Channels of the image, converted to floats and with the gamma
+    TrackedMemory channels("gammaCorrectionImage", matMemorySize(rgbImage) + 2*rgbImage.total()*3*sizeof(float));
     Mat channel[3],channel32F[3], channelWithGamma[3];
 
     split(rgbImage, channel);
@@ -101,6 +103,7 @@ void gammaCorrectionImage(float* image, unsigned int& width, unsigned int& heigh
  */
 void removeGammaCorrection(const Mat &rgbImage, Mat &rgbImageWithoutGamma, double gamma)
 {
+    TrackedMemory channels("removeGammaCorrection", matMemorySize(rgbImage) + 2*rgbImage.total()*3*sizeof(float));
     Mat channel[3], channel32F[3], channelWithoutGamma[3];
 
     split(rgbImage, channel);
@@ -339,11 +342,7 @@ void paintSamples(Mat &image, unsigned int& width, unsigned int& height, Mat &sa
 
     ostringstream osstream;
 
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
 
     osstream << "/envMapSamples.pfm";
 
@@ -403,11 +402,7 @@ void cropImages(int xStart, int yStart, int xEnd, int yEnd, int numberOfImages)
     {
         int imageNumber = k;
 
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
 
         if(k<10)
             osstream << "/images/office_room/Egg_bedroom45_000" << imageNumber << ".TIF";
@@ -438,11 +433,7 @@ void cropImages(int xStart, int yStart, int xEnd, int yEnd, int numberOfImages)
 
         int imageNumber = k;
 
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
 
         if(k<10)
         {
@@ -462,11 +453,7 @@ void cropImages(int xStart, int yStart, int xEnd, int yEnd, int numberOfImages)
         osstream.str("");
     }
 /*
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
 
     //Cropping the mask
     osstream << "/images/free_form/" << "EggFF_" << "mask" << ".png";
@@ -475,11 +462,7 @@ void cropImages(int xStart, int yStart, int xEnd, int yEnd, int numberOfImages)
     osstream.str("");
     result = Mat(mask, boundingBoxResult);
 
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
 
     osstream << "/images/Cropped/EggFF_maskCropped.png";
     imwrite(osstream.str(), result);
@@ -508,7 +491,7 @@ void cropMirrorBallToMatrix()
     for(int k = 0 ; k<143 ; k++)
     {
 
-         file << qApp->applicationDirPath().toStdString() << "/images/";
+         file << dataRootPath() << "/images/";
         imageN = k+416;
         file << "IMG_";
         if(imageN<10)
@@ -522,7 +505,7 @@ void cropMirrorBallToMatrix()
         image = imread(file.str(), CV_LOAD_IMAGE_COLOR);
         aux = image(Rect(1173,2389,915,915));
         file.str("");
-        file << qApp->applicationDirPath().toStdString() << "/cropped/" << k << ".jpg" ;
+        file << dataRootPath() << "/cropped/" << k << ".jpg" ;
         imwrite(file.str(), aux);
         file.str("");
     }
@@ -540,7 +523,7 @@ void cropMirrorBallToMatrix()
     {
         for(int j = 7 ; j<14 ; j++)
         {
-            file << qApp->applicationDirPath().toStdString() << "/cropped/";
+            file << dataRootPath() << "/cropped/";
             imageN = i*14+j;
 
             if(imageN<10)
@@ -560,6 +543,6 @@ void cropMirrorBallToMatrix()
             file.str("");
         }
     }
-     file << qApp->applicationDirPath().toStdString() << "/matrix4.jpg";
+     file << dataRootPath() << "/matrix4.jpg";
     imwrite(file.str(), matrix);
 }
@@ -54,6 +54,7 @@
 #include "mathsFunctions.h"
 #include "PFMReadWrite.h"
 #include "loadFiles.h"
+#include "memoryTracker.h"
 
 
 /**
@@ -46,9 +46,15 @@ using namespace cv;
  * Constructor of the LightStageRelighting class.
  * @brief LightStageRelighting
  */
-LightStageRelighting::LightStageRelighting(): Relighting(), m_voronoi(new Voronoi())
+LightStageRelighting::LightStageRelighting(): Relighting(), m_voronoi(new Voronoi()), m_lightDirectionsCartesian(std::vector<std::vector<float> >()),
+    m_batchRelighting(false), m_batchEnvironmentMaps(QStringList()), m_residentObject(QString()),
+    m_turntable(false), m_turntableVideo(QString()), m_turntableFramesPerSecond(30.0), m_turntableThresholds(std::vector<float>()), m_turntableAbsoluteValues(false),
+    m_sphericalHarmonicsBands(0), m_sphericalHarmonicsRotation(Matx33d::eye()), m_environmentMapsSH(std::map<std::string, EnvironmentMapSH>()), m_environmentMapsSHUses(0), m_environmentMapSH(Mat()),
+    m_waveletCoefficients(0), m_environmentMapsWavelet(std::map<std::string, EnvironmentMapWavelet>()),
+    m_environmentMapsWaveletUses(0), m_environmentMapWavelet(WaveletApproximation())
 {
-
+    //The computations of the weights stop when the relighting is cancelled
+    m_voronoi->setCancelToken(&m_cancelled);
 }
 
 /**
@@ -56,47 +62,110 @@ LightStageRelighting::LightStageRelighting(): Relighting(), m_voronoi(new Vorono
   */
 LightStageRelighting::~LightStageRelighting()
 {
+    this->stopWorkerThread();
     delete m_voronoi;
 }
 
 /**
  * Computes the relighting of the object using the light stage method.
  * @brief relighting
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the environment map or the images could not be loaded, if the relighting failed or if it has been cancelled.
  */
-void LightStageRelighting::relighting()
+bool LightStageRelighting::relighting()
 {
+    TraceScope traceScope("LightStageRelighting::relighting");
+
     //Prints in the progress window what relighting is happening
     this->updateProgressWindow(QString("Relighting the " + m_object + " in " +m_environmentMapName), 0);
 
+    //The frames of the turntable are computed in parallel from the full reflectance field in memory : they do not go through computeFinalRelighting
+    if(m_turntable && !m_batchRelighting
+       && (m_lowRankRank > 0 || m_outOfCore || m_sparseMode != SPARSE_DISABLED || m_incrementalRelighting || m_useResultCache))
+    {
+        cerr << "The turntable relighting is not available with the low rank, out-of-core, sparse or incremental relightings or with the cache of the results" << endl;
+        this->updateProgressWindow(QString("Turntable not available with the options of the reflectance field"), 100);
+        return EXIT_FAILURE;
+    }
+
     /*---Loads the EM---*/
     this->loadEnvironmentMap();
     m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
 
+    if(!m_environmentMap.data)
+    {
+        this->updateProgressWindow(QString("Environment map not loaded"), 100);
+        return EXIT_FAILURE;
+    }
+
     /*---Loads the reflectance field ---*/
-    //Load images in CV_8UC3
-    loadReflectanceField();
-    this->updateProgressWindow(QString("Images loaded"), 25);
+    //Load images and remove their gamma correction
+    if(this->loadReflectanceField() == EXIT_FAILURE)
+    {
+        this->updateProgressWindow(QString("Images not loaded"), 100);
+        return EXIT_FAILURE;
+    }
 
-    //The files provided have a gamma correction of GAMMA
-    //It is removed for the calculations
-    this->removeGammaReflectanceField(GAMMA);
-    this->updateProgressWindow(QString("Gamma correction removed"), 50);
+    this->updateTrackedMemory();
+
+    if(this->isCancelled())
+        return EXIT_FAILURE;
+
+    this->updateProgressWindow(QString("Images loaded"), 50);
 
     /*---Read the light directions ---*/
-    std::vector<std::vector<float> > lightDirectionsCartesian;
-    std::vector<Point2i> lightDirectionsLatLongMap;
-    readFile(this->getFolderPath() + "/light_directions.txt", lightDirectionsCartesian);
+    this->readLightDirections();
 
-    //The object is taken as a reference
-    //The directions given in the text file are from the light stage towards the object
-    //The directions used are from the object to the light stage
-    for(unsigned int n = 0 ; n< lightDirectionsCartesian.size() ; n++)
+    if(m_batchRelighting)
+    {
+        if(this->relightingBatch() == EXIT_FAILURE)
+            return EXIT_FAILURE;
+
+        this->updateProgressWindow(QString("Done"), 100);
+        return EXIT_SUCCESS;
+    }
+
+    if(m_turntable)
+    {
+        if(this->relightingTurntable() == EXIT_FAILURE)
+            return EXIT_FAILURE;
+
+        this->updateProgressWindow(QString("Done"), 100);
+        return EXIT_SUCCESS;
+    }
+
+    //The basis of the light stage is given by the light directions
+    ostringstream basis;
+    for(unsigned int n = 0 ; n<m_lightDirectionsCartesian.size() ; n++)
+    {
+        for(unsigned int c = 0 ; c<m_lightDirectionsCartesian[n].size() ; c++)
+        {
+            basis << m_lightDirectionsCartesian[n][c] << ",";
+        }
+    }
+
+    if(m_pyramidTolerance > 0.0)
+        basis << "pyramid" << m_pyramidTolerance << ";";
+
+    //The spherical harmonics give approximated weights : their results are not those of the exact Voronoi weights
+    if(m_sphericalHarmonicsBands > 0)
     {
-        lightDirectionsCartesian[n][0] *= -1;
-        lightDirectionsCartesian[n][1] *= -1;
-        lightDirectionsCartesian[n][2] *= -1;
+        basis << "sh" << m_sphericalHarmonicsBands;
+
+        for(int r = 0 ; r<3 ; r++)
+        {
+            for(int c = 0 ; c<3 ; c++)
+            {
+                basis << "," << m_sphericalHarmonicsRotation(r, c);
+            }
+        }
+
+        basis << ";";
     }
 
+    //Same for the largest wavelet coefficients
+    if(m_waveletCoefficients > 0)
+        basis << "wavelet" << m_waveletCoefficients << ";";
+
     //Loop to generate several results (rotate the environment map depending on the offset)
     int progressBarValue = 50;
 
@@ -104,66 +173,776 @@ void LightStageRelighting::relighting()
     for(unsigned int l = 0 ; l<m_numberOfOffsets ; l++)
     {
 
+        if(this->isCancelled())
+            return EXIT_FAILURE;
+
         offset = (float) 2.0*l*M_PI/m_numberOfOffsets;
 
-        //Convert the light direction from the cartesian coordinate system to the spherical coordinate system
-        //Output : points point2f that correspond to a pixel in the environment map
-        cartesianToLatLongVector2i(lightDirectionsCartesian, lightDirectionsLatLongMap,m_environmentMapWidth, m_environmentMapHeight);
+        //The weights and the linear combination are read from the cache of the results when they have already been computed
+        QByteArray key = this->resultCacheKey(offset, basis.str());
+        progressBarValue += 25/m_numberOfOffsets;
 
-        //Voronoi tesselation using the light directions and the environment map
-        //The object basis calculates the voronoi tesselation when the light directions are added as point light sources
-        m_voronoi->clearVoronoi();
-        m_voronoi->setVoronoi(lightDirectionsLatLongMap);
+        if(this->loadCachedResult(key) == EXIT_SUCCESS)
+        {
+            this->updateProgressWindow(QString("Result " + QString::number(l) + " read from the cache"), progressBarValue);
+        }
+        else
+        {
+            this->computeWeights(l, offset);
+
+            //The weights are incomplete if the relighting has been cancelled during their computation
+            if(this->isCancelled())
+                return EXIT_FAILURE;
+
+            this->updateProgressWindow(QString("Weights computed"), progressBarValue);
+
+            //Compute the result of the linear combination
+            if(this->computeFinalRelighting() == EXIT_FAILURE)
+            {
+                this->updateProgressWindow(QString("Relighting failed"), 100);
+                return EXIT_FAILURE;
+            }
+
+            this->storeCachedResult(key);
+        }
+
+        this->saveRelitResult(l, offset);
+
+        progressBarValue += 25/m_numberOfOffsets;
+        this->updateProgressWindow(QString("Result " + QString::number(l) + " generated"), progressBarValue);
+    }
+
+    if(m_useResultCache)
+        this->updateProgressWindow(this->resultCacheStatistics(), 100);
+
+    this->updateProgressWindow(QString("Done"), 100);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Computes the relighting of the object for several environment maps and all the offsets at once.
+ * The weights of every (environment map, offset) pair are computed first. The results are then computed by batches of BATCH_SIZE with a single pass over the reflectance field per batch.
+ * @brief relightingBatch
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if an environment map could not be loaded, if the relighting failed or if it has been cancelled.
+ */
+bool LightStageRelighting::relightingBatch()
+{
+    TraceScope traceScope("LightStageRelighting::relightingBatch");
+
+    QStringList environmentMaps = m_batchEnvironmentMaps;
+
+    if(environmentMaps.isEmpty())
+        environmentMaps.append(m_environmentMapName);
+
+    //Weights, environment map and offset number of each result of the batch
+    std::vector<std::vector<std::vector<float> > > weightsBatch;
+    std::vector<QString> environmentMapOfResult;
+    std::vector<unsigned int> offsetOfResult;
+
+    int progressBarValue = 50;
+    float offset = 0.0;
+
+    for(int e = 0 ; e<environmentMaps.size() ; e++)
+    {
+        m_environmentMapName = environmentMaps[e];
+        this->loadEnvironmentMap();
+        m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+
+        if(!m_environmentMap.data)
+        {
+            this->updateProgressWindow(QString("Environment map not loaded : " + m_environmentMapName), 100);
+            return EXIT_FAILURE;
+        }
+
+        for(unsigned int l = 0 ; l<m_numberOfOffsets ; l++)
+        {
+            if(this->isCancelled())
+                return EXIT_FAILURE;
+
+            offset = (float) 2.0*l*M_PI/m_numberOfOffsets;
+
+            this->computeWeights(l, offset);
+
+            weightsBatch.push_back(m_weightsRGB);
+            environmentMapOfResult.push_back(m_environmentMapName);
+            offsetOfResult.push_back(l);
+        }
+
+        progressBarValue = 50 + 25*(e+1)/environmentMaps.size();
+        this->updateProgressWindow(QString("Weights computed for " + m_environmentMapName), progressBarValue);
+    }
+
+    unsigned int numberOfResults = weightsBatch.size();
+
+    for(unsigned int start = 0 ; start<numberOfResults ; start += BATCH_SIZE)
+    {
+        if(this->isCancelled())
+            return EXIT_FAILURE;
+
+        unsigned int end = std::min(start+BATCH_SIZE, numberOfResults);
+
+        std::vector<std::vector<std::vector<float> > > weights(weightsBatch.begin()+start, weightsBatch.begin()+end);
+        std::vector<Mat> results;
+
+        if(this->computeFinalRelightingBatch(weights, results) == EXIT_FAILURE)
+        {
+            this->updateProgressWindow(QString("Relighting failed"), 100);
+            return EXIT_FAILURE;
+        }
+
+        for(unsigned int o = start ; o<end ; o++)
+        {
+            //The environment map is needed to raytrace the background
+            if(m_environmentMapName != environmentMapOfResult[o])
+            {
+                m_environmentMapName = environmentMapOfResult[o];
+                this->loadEnvironmentMap();
+            }
+
+            offset = (float) 2.0*offsetOfResult[o]*M_PI/m_numberOfOffsets;
+
+            m_relitResult = results[o-start];
+            this->saveRelitResult(offsetOfResult[o], offset);
+
+            progressBarValue = 75 + 25*(o+1)/numberOfResults;
+            this->updateProgressWindow(QString("Result " + QString::number(offsetOfResult[o]) + " generated for " + m_environmentMapName), progressBarValue);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Computes the frames of a turntable (all the offsets of the environment map) in parallel and writes them in order in a video or an image sequence.
+ * The Voronoi diagram, the reflectance field, the background table and the transfer function are prepared once and only read by the frames.
+ * @brief relightingTurntable
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the turntable could not be written or if it has been cancelled.
+ */
+bool LightStageRelighting::relightingTurntable()
+{
+    TraceScope traceScope("LightStageRelighting::relightingTurntable");
+
+    //The light sources do not move with the environment map : one Voronoi diagram (and label map) for all the frames
+    std::vector<Point2i> lightDirectionsLatLongMap;
+    cartesianToLatLongVector2i(m_lightDirectionsCartesian, lightDirectionsLatLongMap, m_environmentMapWidth, m_environmentMapHeight);
+
+    m_voronoi->clearVoronoi();
+    m_voronoi->setVoronoi(lightDirectionsLatLongMap);
+    m_voronoi->computeLabelMap();
+
+    //Point lights : the weights of all the frames are computed at once, each frame reads its column of the table
+    //With the spherical harmonics, each frame only rotates the coefficients of the environment map
+    if(m_lightType.toStdString() == "Point" && m_sphericalHarmonicsBands > 0)
+        this->prepareSphericalHarmonics();
+    else if(m_lightType.toStdString() == "Point" && m_waveletCoefficients > 0)
+        this->prepareWavelet();
+    else if(m_lightType.toStdString() == "Point")
+        m_voronoi->computeRotationWeightTable(m_environmentMap, ROTATION_TABLE_CELLS);
+
+    //The reflectance field is converted once, then only read by the frames
+    m_reflectanceField.setStorage(m_reflectanceFieldStorage);
+    m_reflectanceField.setLayout(m_reflectanceFieldLayout);
+
+    m_relitResult.create(m_reflectanceField.rows(), m_reflectanceField.cols(), CV_32FC3);
+    this->computeBackgroundTable();
+    m_turntableAbsoluteValues = this->outputThresholds(255, EXPOSURE, GAMMA, m_turntableThresholds);
+
+    //Output : video or one JPEG per offset (same names as saveRelitResult)
+    ostringstream osstream;
+    osstream << this->getFolderPath() << "/Results/light_stage/" << m_object.toStdString() << "_" << m_lightType.toStdString() << "_" << m_environmentMapName.toStdString();
+    string prefix = osstream.str();
+
+    TurntableWriter writer;
+    vector<string> framePaths;
+    bool opened = EXIT_FAILURE;
+
+    if(m_turntableVideo.isEmpty())
+    {
+        for(unsigned int l = 0 ; l<m_numberOfOffsets ; l++)
+        {
+            osstream.str("");
+            osstream << prefix << "_offset" << l << ".jpg";
+            framePaths.push_back(osstream.str());
+        }
+
+        opened = writer.openImageSequence(framePaths);
+    }
+    else
+    {
+        string videoPath = m_turntableVideo.toStdString();
+
+        if(QDir::isRelativePath(m_turntableVideo))
+            videoPath = this->getFolderPath() + "/Results/light_stage/" + videoPath;
+
+        opened = writer.openVideo(videoPath, m_numberOfOffsets, m_relitResult.size(), m_turntableFramesPerSecond);
+    }
+
+    if(opened == EXIT_FAILURE)
+        return EXIT_FAILURE;
+
+    //The frames are started in order. acquireFrame bounds the number of frames computed or waiting to be written
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+
+    for(unsigned int l = 0 ; l<m_numberOfOffsets ; l++)
+    {
+        if(this->isCancelled())
+        {
+            //The writer skips the frames that are not computed
+            writer.submit(l, Mat());
+            continue;
+        }
+
+        writer.acquireFrame();
+        pool.start(new RenderFrameTask(*this, writer, l));
+
+        this->updateProgressWindow(QString("Frame " + QString::number(l) + " started"), 50 + 50*l/m_numberOfOffsets);
+    }
+
+    pool.waitForDone();
+
+    if(writer.finish() == EXIT_FAILURE || this->isCancelled())
+        return EXIT_FAILURE;
+
+    cout << "Turntable : " << m_numberOfOffsets << " frames, at most " << writer.getMaximumBufferedFrames() << " frames in the reorder buffer" << endl;
+
+    if(!framePaths.empty())
+        emit updateImage(QString(framePaths.back().c_str()));
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Computes one frame of the turntable on the calling thread (weights, linear combination, background and output stage) and gives it to the writer.
+ * Called by the threads of the pool of relightingTurntable.
+ * @brief renderTurntableFrame
+ * @param INPUT : l number of the offset (frame).
+ * @param OUTPUT : writer writer of the turntable.
+ */
+void LightStageRelighting::renderTurntableFrame(unsigned int l, TurntableWriter &writer)
+{
+    TraceScope traceScope("LightStageRelighting::renderTurntableFrame");
+
+    if(this->isCancelled())
+    {
+        writer.submit(l, Mat());
+        return;
+    }
+
+    float offset = (float) 2.0*l*M_PI/m_numberOfOffsets;
+
+    std::vector<std::vector<float> > weightsRGB;
+
+    if(m_lightType.toStdString() == "Gaussian")
+    {
+        //The weights are accumulated in the Voronoi diagram : each frame has its own copy. The label map is shared (read only)
+        Voronoi voronoi(*m_voronoi);
+        voronoi.clearWeights();
+        voronoi.computeVoronoiWeightsGaussian(m_environmentMap, offset);
+        weightsRGB = voronoi.getRGBWeights();
+    }
+    else if(m_sphericalHarmonicsBands > 0)
+    {
+        //The projections on the spherical harmonics are only read
+        m_voronoi->getSHWeights(m_environmentMapSH, this->sphericalHarmonicsRotation(offset), weightsRGB);
+    }
+    else if(m_waveletCoefficients > 0)
+    {
+        //The approximation of the environment map and the cells are only read : each frame rotates the cells
+        m_voronoi->getWaveletWeights(m_environmentMapWavelet, offset, weightsRGB);
+    }
+    else
+    {
+        //The rotation weight table is only read
+        m_voronoi->getRotationWeights(offset, weightsRGB);
+    }
+
+    //The weights are incomplete if the relighting has been cancelled during their computation
+    if(this->isCancelled())
+    {
+        writer.submit(l, Mat());
+        return;
+    }
+
+    normalizeWeightsRGB(weightsRGB);
+
+    //The frames are computed in parallel : each kernel runs on the calling thread for the whole image
+    Mat result(m_reflectanceField.rows(), m_reflectanceField.cols(), CV_32FC3);
+    Mat frame(result.size(), CV_8UC3);
+    TrackedMemory frameMemory("LightStageRelighting::renderTurntableFrame", matMemorySize(result) + matMemorySize(frame));
+
+    WeightedSumKernel weightedSum(m_reflectanceField, weightsRGB, result);
+    weightedSum(Range(0, result.rows));
+
+    BackgroundKernel background(m_backgroundPixels, m_backgroundRows, m_backgroundPhi, m_environmentMap, offset, false, 1.0, result);
+    background(Range(0, m_backgroundPixels.size()));
+
+    OutputStageKernel outputStage(result, m_turntableThresholds, m_turntableAbsoluteValues, frame);
+    outputStage(Range(0, result.rows));
+
+    writer.submit(l, frame);
+}
+
+/**
+ * Reads the light stage directions from light_directions.txt. The directions are stored from the object towards the light sources.
+ * @brief readLightDirections
+ */
+void LightStageRelighting::readLightDirections()
+{
+    m_lightDirectionsCartesian.clear();
+    readFile(this->getFolderPath() + "/light_directions.txt", m_lightDirectionsCartesian);
+
+    //The object is taken as a reference
+    //The directions given in the text file are from the light stage towards the object
+    //The directions used are from the object to the light stage
+    for(unsigned int n = 0 ; n< m_lightDirectionsCartesian.size() ; n++)
+    {
+        m_lightDirectionsCartesian[n][0] *= -1;
+        m_lightDirectionsCartesian[n][1] *= -1;
+        m_lightDirectionsCartesian[n][2] *= -1;
+    }
+}
+
+/**
+ * Computes the normalised RGB weights of the light stage light sources for the current environment map rotated by offset. The result is stored in m_weightsRGB.
+ * @brief computeWeights
+ * @param INPUT : l number of the offset.
+ * @param INPUT : offset rotation of the environment map (phi angle).
+ */
+void LightStageRelighting::computeWeights(unsigned int l, float offset)
+{
+    TraceScope traceScope("LightStageRelighting::computeWeights");
+    MemoryStage memoryStage("computeWeights");
+
+    if(m_sphericalHarmonicsBands > 0 && m_lightType.toStdString() == "Point")
+    {
+        //The Voronoi diagram and its projection on the spherical harmonics are kept for all the offsets
+        this->prepareSphericalHarmonics();
+
+        this->saveLightStageDirection();
+        this->saveLightStageIntensities();
+        this->saveVoronoiTesselation(l);
+
+        m_voronoi->clearWeights();
+        m_voronoi->computeVoronoiWeightsSH(m_environmentMapSH, this->sphericalHarmonicsRotation(offset));
+
+        m_weightsRGB = m_voronoi->getRGBWeights();
+        normalizeWeightsRGB(m_weightsRGB);
+
+        this->saveVoronoiWeights(l);
+        return;
+    }
+
+    if(m_waveletCoefficients > 0 && m_lightType.toStdString() == "Point")
+    {
+        //The Voronoi diagram and the transform of its cells are kept for all the offsets
+        this->prepareWavelet();
 
-        //Many images are saved here to understand each step of the relighting
-        //Save the voronoi diagrams to files
         this->saveLightStageDirection();
         this->saveLightStageIntensities();
         this->saveVoronoiTesselation(l);
 
-        //Compute the weight of each voronoi cell (sum of the intensities taking into account the solid angle)
-        m_voronoi->computeVoronoiIntensity(m_environmentMap);
+        m_voronoi->clearWeights();
+        m_voronoi->computeVoronoiWeightsWavelet(m_environmentMapWavelet, offset);
+
+        m_weightsRGB = m_voronoi->getRGBWeights();
+        normalizeWeightsRGB(m_weightsRGB);
+
+        this->saveVoronoiWeights(l);
+        return;
+    }
 
-        //Compute the weight of each voronoi cell independently for each RGB channel (average of the color of the cell taking into account the solid angle)
-        if(m_lightType.toStdString() == "Gaussian")
+    if(m_pyramidTolerance > 0.0 && m_lightType.toStdString() == "Point")
+    {
+        //The Voronoi diagram, its label map and the pyramid of the label map are kept for all the offsets
+        if(!m_voronoi->hasLabelMap(m_environmentMapWidth, m_environmentMapHeight))
         {
-            m_voronoi->computeVoronoiWeightsGaussian(m_environmentMap, offset);
+            std::vector<Point2i> lightDirectionsLatLongMap;
+            cartesianToLatLongVector2i(m_lightDirectionsCartesian, lightDirectionsLatLongMap, m_environmentMapWidth, m_environmentMapHeight);
+
+            m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+            m_voronoi->clearVoronoi();
+            m_voronoi->setVoronoi(lightDirectionsLatLongMap);
+            m_voronoi->computeLabelMap();
         }
-        else if(m_lightType.toStdString() == "Point")
+
+        this->saveLightStageDirection();
+        this->saveLightStageIntensities();
+        this->saveVoronoiTesselation(l);
+
+        m_voronoi->clearWeights();
+        m_voronoi->computeVoronoiWeightsRGB(m_environmentMap, offset);
+
+        m_weightsRGB = m_voronoi->getRGBWeights();
+        normalizeWeightsRGB(m_weightsRGB);
+
+        this->saveVoronoiWeights(l);
+        return;
+    }
+
+    if(m_lightType.toStdString() == "Point" && m_numberOfOffsets >= ROTATION_TABLE_MINIMUM_OFFSETS)
+    {
+        //The Voronoi diagram is kept for all the offsets : the weights of all the offsets are computed once per environment map, then read in the table
+        if(!m_voronoi->hasLabelMap(m_environmentMapWidth, m_environmentMapHeight))
         {
-            m_voronoi->computeVoronoiWeightsRGB(m_environmentMap, offset);
+            std::vector<Point2i> lightDirectionsLatLongMap;
+            cartesianToLatLongVector2i(m_lightDirectionsCartesian, lightDirectionsLatLongMap, m_environmentMapWidth, m_environmentMapHeight);
+
+            m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+            m_voronoi->clearVoronoi();
+            m_voronoi->setVoronoi(lightDirectionsLatLongMap);
+            m_voronoi->computeLabelMap();
         }
 
-        //Normalise the weights for display purposes
+        if(!m_voronoi->hasRotationWeightTable(m_environmentMap, ROTATION_TABLE_CELLS))
+            m_voronoi->computeRotationWeightTable(m_environmentMap, ROTATION_TABLE_CELLS);
+
+        this->saveLightStageDirection();
+        this->saveLightStageIntensities();
+        this->saveVoronoiTesselation(l);
+
+        m_voronoi->clearWeights();
+        m_voronoi->computeVoronoiWeightsRotationTable(offset);
+
         m_weightsRGB = m_voronoi->getRGBWeights();
         normalizeWeightsRGB(m_weightsRGB);
 
-        //Save the weights diagram
         this->saveVoronoiWeights(l);
+        return;
+    }
 
-        progressBarValue += 25/m_numberOfOffsets;
-        this->updateProgressWindow(QString("Weights computed"), progressBarValue);
+    std::vector<Point2i> lightDirectionsLatLongMap;
 
-        //Compute the result of the linear combination
-        //Change the background, hange the exposure and apply gamma
-        this->computeFinalRelighting();
-        this->rayTraceBackground(offset);
-        this->changeExposure(EXPOSURE);
-        this->gammaCorrection(GAMMA);
+    //Convert the light direction from the cartesian coordinate system to the spherical coordinate system
+    //Output : points point2f that correspond to a pixel in the environment map
+    cartesianToLatLongVector2i(m_lightDirectionsCartesian, lightDirectionsLatLongMap,m_environmentMapWidth, m_environmentMapHeight);
 
-        //Save the final result
-        ostringstream osstream;
-        osstream << this->getFolderPath() << "/Results/light_stage/" << m_object.toStdString() << "_" << m_lightType.toStdString() << "_" << m_environmentMapName.toStdString() << "_offset" << l << ".jpg";
-        this->saveResult(SAVE_8BITS, osstream.str());
+    //Voronoi tesselation using the light directions and the environment map
+    //The object basis calculates the voronoi tesselation when the light directions are added as point light sources
+    m_voronoi->clearVoronoi();
+    m_voronoi->setVoronoi(lightDirectionsLatLongMap);
 
-        emit updateImage(QString(osstream.str().c_str()));
-        osstream.str("");
+    //Many images are saved here to understand each step of the relighting
+    //Save the voronoi diagrams to files
+    this->saveLightStageDirection();
+    this->saveLightStageIntensities();
+    this->saveVoronoiTesselation(l);
 
-        progressBarValue += 25/m_numberOfOffsets;
-        this->updateProgressWindow(QString("Result " + QString::number(l) + " generated"), progressBarValue);
+    //Compute the weight of each voronoi cell (sum of the intensities taking into account the solid angle)
+    m_voronoi->computeVoronoiIntensity(m_environmentMap);
+
+    //Compute the weight of each voronoi cell independently for each RGB channel (average of the color of the cell taking into account the solid angle)
+    if(m_lightType.toStdString() == "Gaussian")
+    {
+        m_voronoi->computeVoronoiWeightsGaussian(m_environmentMap, offset);
+    }
+    else if(m_lightType.toStdString() == "Point")
+    {
+        m_voronoi->computeVoronoiWeightsRGB(m_environmentMap, offset);
     }
 
-    this->updateProgressWindow(QString("Done"), 100);
+    //Normalise the weights for display purposes
+    m_weightsRGB = m_voronoi->getRGBWeights();
+    normalizeWeightsRGB(m_weightsRGB);
+
+    //Save the weights diagram
+    this->saveVoronoiWeights(l);
+}
+
+/**
+ * Prepares the spherical harmonics fast path : projects the Voronoi cells of the light directions (once for all the offsets) and the current environment map (once per environment map) on the spherical harmonics.
+ * The coefficients of at most SH_CACHE_MAXIMUM_MAPS environment maps are kept, and they are projected again when the file of the environment map has been modified.
+ * @brief prepareSphericalHarmonics
+ */
+void LightStageRelighting::prepareSphericalHarmonics()
+{
+    TraceScope traceScope("LightStageRelighting::prepareSphericalHarmonics");
+
+    int bands = m_sphericalHarmonicsBands;
+
+    //The projection of the cells only depends on the light directions and on the size of the environment map
+    if(!m_voronoi->hasLabelMap(m_environmentMapWidth, m_environmentMapHeight) || !m_voronoi->hasSHBasis(bands))
+    {
+        std::vector<Point2i> lightDirectionsLatLongMap;
+        cartesianToLatLongVector2i(m_lightDirectionsCartesian, lightDirectionsLatLongMap, m_environmentMapWidth, m_environmentMapHeight);
+
+        m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+        m_voronoi->clearVoronoi();
+        m_voronoi->setVoronoi(lightDirectionsLatLongMap);
+        m_voronoi->computeSHBasis(bands);
+    }
+
+    ostringstream key;
+    key << m_environmentMapName.toStdString() << "_" << m_environmentMapWidth << "x" << m_environmentMapHeight << "_" << bands;
+
+    //A file modified since the projection invalidates the coefficients
+    qint64 lastModified = this->environmentMapLastModified();
+
+    std::map<std::string, EnvironmentMapSH>::iterator environmentMapSH = m_environmentMapsSH.find(key.str());
+
+    if(environmentMapSH != m_environmentMapsSH.end() && environmentMapSH->second.lastModified != lastModified)
+    {
+        m_environmentMapsSH.erase(environmentMapSH);
+        environmentMapSH = m_environmentMapsSH.end();
+    }
+
+    if(environmentMapSH == m_environmentMapsSH.end())
+    {
+        //The least recently used environment map is removed to make room for the new one
+        while(m_environmentMapsSH.size() >= SH_CACHE_MAXIMUM_MAPS)
+        {
+            std::map<std::string, EnvironmentMapSH>::iterator leastRecentlyUsed = m_environmentMapsSH.begin();
+
+            for(std::map<std::string, EnvironmentMapSH>::iterator it = m_environmentMapsSH.begin() ; it != m_environmentMapsSH.end() ; ++it)
+            {
+                if(it->second.lastUse < leastRecentlyUsed->second.lastUse)
+                    leastRecentlyUsed = it;
+            }
+
+            m_environmentMapsSH.erase(leastRecentlyUsed);
+        }
+
+        EnvironmentMapSH entry;
+        projectEnvironmentMapSH(m_environmentMap, bands, entry.coefficients);
+        entry.lastModified = lastModified;
+        entry.lastUse = 0;
+
+        environmentMapSH = m_environmentMapsSH.insert(std::make_pair(key.str(), entry)).first;
+    }
+
+    environmentMapSH->second.lastUse = ++m_environmentMapsSHUses;
+    m_environmentMapSH = environmentMapSH->second.coefficients;
+}
+
+/**
+ * Returns the rotation of the spherical harmonics coefficients of the environment map for an offset : the environment map is read in the direction rotation*Ry(offset)*w (see setSphericalHarmonics).
+ * @brief sphericalHarmonicsRotation
+ * @param INPUT : offset rotation of the environment map (phi angle).
+ * @return the rotation matrix of the coefficients (see rotationMatrixSH).
+ */
+Mat LightStageRelighting::sphericalHarmonicsRotation(float offset) const
+{
+    Mat rotationSH;
+    rotationMatrixSH(m_sphericalHarmonicsBands, m_sphericalHarmonicsRotation*rotationY(offset), rotationSH);
+
+    return rotationSH;
+}
+
+/**
+ * Prepares the Haar wavelet path : computes the wavelet transform of the Voronoi cells of the light directions (once for all the offsets and environment maps)
+ * and the approximation of the current environment map (once per environment map, the offsets rotate the cells). The approximation is stored in m_environmentMapWavelet.
+ * The approximations of at most WAVELET_CACHE_MAXIMUM_MAPS environment maps are kept, and they are computed again when the file of the environment map has been modified.
+ * The relative error is printed on the error output when the approximation of another environment map is used.
+ * @brief prepareWavelet
+ */
+void LightStageRelighting::prepareWavelet()
+{
+    TraceScope traceScope("LightStageRelighting::prepareWavelet");
+
+    //The transform of the cells only depends on the light directions and on the size of the environment map
+    if(!m_voronoi->hasLabelMap(m_environmentMapWidth, m_environmentMapHeight) || !m_voronoi->hasWaveletBasis())
+    {
+        std::vector<Point2i> lightDirectionsLatLongMap;
+        cartesianToLatLongVector2i(m_lightDirectionsCartesian, lightDirectionsLatLongMap, m_environmentMapWidth, m_environmentMapHeight);
+
+        m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+        m_voronoi->clearVoronoi();
+        m_voronoi->setVoronoi(lightDirectionsLatLongMap);
+        m_voronoi->computeWaveletBasis();
+    }
+
+    ostringstream key;
+    key << m_environmentMapName.toStdString() << "_" << m_environmentMapWidth << "x" << m_environmentMapHeight << "_" << m_waveletCoefficients;
+
+    //A file modified since the transform invalidates the approximation
+    qint64 lastModified = this->environmentMapLastModified();
+
+    std::map<std::string, EnvironmentMapWavelet>::iterator cachedWavelet = m_environmentMapsWavelet.find(key.str());
+
+    if(cachedWavelet != m_environmentMapsWavelet.end() && cachedWavelet->second.lastModified != lastModified)
+    {
+        m_environmentMapsWavelet.erase(cachedWavelet);
+        cachedWavelet = m_environmentMapsWavelet.end();
+    }
+
+    if(cachedWavelet == m_environmentMapsWavelet.end())
+    {
+        //The least recently used environment map is removed to make room for the new one
+        while(m_environmentMapsWavelet.size() >= WAVELET_CACHE_MAXIMUM_MAPS)
+        {
+            std::map<std::string, EnvironmentMapWavelet>::iterator leastRecentlyUsed = m_environmentMapsWavelet.begin();
+
+            for(std::map<std::string, EnvironmentMapWavelet>::iterator it = m_environmentMapsWavelet.begin() ; it != m_environmentMapsWavelet.end() ; ++it)
+            {
+                if(it->second.lastUse < leastRecentlyUsed->second.lastUse)
+                    leastRecentlyUsed = it;
+            }
+
+            m_environmentMapsWavelet.erase(leastRecentlyUsed);
+        }
+
+        EnvironmentMapWavelet entry;
+        environmentMapWavelet(m_environmentMap, m_waveletCoefficients, entry.approximation);
+        entry.lastModified = lastModified;
+        entry.lastUse = 0;
+
+        cachedWavelet = m_environmentMapsWavelet.insert(std::make_pair(key.str(), entry)).first;
+    }
+
+    //The error is reported when a new approximation or the one of another environment map is used (same error for all the offsets : the rotations of the cells are exact)
+    if(cachedWavelet->second.lastUse != m_environmentMapsWaveletUses || m_environmentMapsWaveletUses == 0)
+    {
+        cachedWavelet->second.lastUse = ++m_environmentMapsWaveletUses;
+        m_environmentMapWavelet = cachedWavelet->second.approximation;
+
+        cerr << "Wavelet approximation of " << m_environmentMapName.toStdString() << " : " << m_environmentMapWavelet.indices.size()
+             << " coefficients, relative error " << m_environmentMapWavelet.relativeError << endl;
+    }
+}
+
+/**
+ * Returns the modification date of the file of the current environment map (invalidates the coefficients kept by the fast paths).
+ * @brief environmentMapLastModified
+ * @return the date in ms since epoch, or -1 if the file does not exist.
+ */
+qint64 LightStageRelighting::environmentMapLastModified()
+{
+    QFileInfo environmentMapFile(QString::fromStdString(this->getFolderPath() + "/environment_maps/") + m_environmentMapName + ".pfm");
+
+    return environmentMapFile.exists() ? environmentMapFile.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+/**
+ * Raytraces the background, changes the exposure, applies the gamma to m_relitResult and saves it.
+ * @brief saveRelitResult
+ * @param INPUT : l number of the offset.
+ * @param INPUT : offset rotation of the environment map (phi angle).
+ */
+void LightStageRelighting::saveRelitResult(unsigned int l, float offset)
+{
+    TraceScope traceScope("LightStageRelighting::saveRelitResult");
+
+    //Change the background
+    this->rayTraceBackground(offset);
+
+    //Save the final result. The exposure and the gamma are applied when the result is saved.
+    ostringstream osstream;
+    osstream << this->getFolderPath() << "/Results/light_stage/" << m_object.toStdString() << "_" << m_lightType.toStdString() << "_" << m_environmentMapName.toStdString() << "_offset" << l << ".jpg";
+    this->saveResult(SAVE_8BITS, osstream.str(), EXPOSURE, GAMMA);
+
+    emit updateImage(QString(osstream.str().c_str()));
+    osstream.str("");
+}
+
+/**
+ * Relights an object under one rotation of an environment map with the data kept in memory by the previous calls.
+ * The reflectance field, the light directions and the label map of the Voronoi diagram are only computed when the object (or the size of the environment map) changes :
+ * the other calls only compute the weights and the linear combination.
+ * @brief relight
+ * @param INPUT : object name of the object.
+ * @param INPUT : environmentMap name of the environment map.
+ * @param INPUT : offset rotation of the environment map (phi angle).
+ * @param INPUT : lightType type of light sources used (Point or Gaussian).
+ * @param INPUT : exposure exposure of the result in stops.
+ * @param OUTPUT : result linear relit image (CV_32FC3, BGR) with the background.
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+bool LightStageRelighting::relight(const QString &object, const QString &environmentMap, float offset, const QString &lightType, double exposure, Mat &result)
+{
+    if(lightType != "Point" && lightType != "Gaussian")
+    {
+        cerr << "Unknown light type : " << lightType.toStdString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    if(object != m_residentObject)
+    {
+        m_object = object;
+
+        if(this->loadReflectanceField() == EXIT_FAILURE)
+            return EXIT_FAILURE;
+
+        this->readLightDirections();
+
+        //The label map is computed again with the light directions of the object
+        m_voronoi->clearVoronoi();
+        m_residentObject = object;
+    }
+
+    m_environmentMapName = environmentMap;
+    m_lightType = lightType;
+    this->loadEnvironmentMap();
+
+    if(!m_environmentMap.data)
+        return EXIT_FAILURE;
+
+    //The Voronoi diagram only depends on the light directions and on the size of the environment map
+    if(!m_voronoi->hasLabelMap(m_environmentMapWidth, m_environmentMapHeight))
+    {
+        std::vector<Point2i> lightDirectionsLatLongMap;
+        cartesianToLatLongVector2i(m_lightDirectionsCartesian, lightDirectionsLatLongMap, m_environmentMapWidth, m_environmentMapHeight);
+
+        m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+        m_voronoi->clearVoronoi();
+        m_voronoi->setVoronoi(lightDirectionsLatLongMap);
+        m_voronoi->computeLabelMap();
+    }
+
+    m_voronoi->clearWeights();
+
+    if(m_lightType == "Gaussian")
+    {
+        m_voronoi->computeVoronoiWeightsGaussian(m_environmentMap, offset);
+    }
+    else if(m_sphericalHarmonicsBands > 0)
+    {
+        this->prepareSphericalHarmonics();
+        m_voronoi->clearWeights();
+        m_voronoi->computeVoronoiWeightsSH(m_environmentMapSH, this->sphericalHarmonicsRotation(offset));
+    }
+    else if(m_waveletCoefficients > 0)
+    {
+        this->prepareWavelet();
+        m_voronoi->clearWeights();
+        m_voronoi->computeVoronoiWeightsWavelet(m_environmentMapWavelet, offset);
+    }
+    else
+    {
+        m_voronoi->computeVoronoiWeightsRGB(m_environmentMap, offset);
+    }
+
+    m_weightsRGB = m_voronoi->getRGBWeights();
+    normalizeWeightsRGB(m_weightsRGB);
+
+    if(this->computeFinalRelighting() == EXIT_FAILURE)
+        return EXIT_FAILURE;
+
+    this->rayTraceBackground(offset);
+
+    m_relitResult.convertTo(result, CV_32FC3, pow(2.0, exposure));
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Sets the tolerance of the integration of the weights on the pyramids (see Relighting::setPyramidTolerance) and gives it to the Voronoi diagram.
+ * @brief setPyramidTolerance
+ * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong light source.
+ */
+void LightStageRelighting::setPyramidTolerance(double tolerance)
+{
+    Relighting::setPyramidTolerance(tolerance);
+    m_voronoi->setPyramidTolerance(tolerance);
+}
+
+/**
+ * Returns the size in bytes of the data kept in memory between two relightings (reflectance field, mask, environment maps and label map of the Voronoi diagram).
+ * @brief residentMemory
+ */
+size_t LightStageRelighting::residentMemory()
+{
+    return Relighting::residentMemory() + m_voronoi->labelMapMemorySize();
 }
 
 /**
@@ -171,13 +950,15 @@ void LightStageRelighting::relighting()
  */
 bool LightStageRelighting::loadReflectanceField()
 {
-    //Only allocate memory if it has not been already allocated
-    if(m_reflectanceField == NULL)
-        m_reflectanceField = new Mat[m_numberOfLightingConditions];
+    TraceScope traceScope("LightStageRelighting::loadReflectanceField", "loading");
+    MemoryStage memoryStage("loadReflectanceField");
 
     string file;
     string extension;
 
+    //The reflectance field kept in memory by relight is replaced
+    m_residentObject = QString();
+
     if(m_object == "Plant")
     {
         file = string("light_stage/plant_left_");
@@ -195,6 +976,7 @@ bool LightStageRelighting::loadReflectanceField()
     }
 
     ostringstream osstream;
+    vector<string> paths(m_numberOfLightingConditions);
 
     for(unsigned int i = 0 ; i<m_numberOfLightingConditions ; i++)
     {
@@ -214,17 +996,53 @@ bool LightStageRelighting::loadReflectanceField()
           osstream << "/images/" << file << "0" << i << extension;
        }
 
-       m_reflectanceField[i] = imread(osstream.str(), CV_LOAD_IMAGE_COLOR);
+       paths[i] = osstream.str();
+       osstream.str("");
+    }
 
-       if(!m_reflectanceField[i].data)
-       {
-          cerr << "Couldn't open the file : " << osstream.str() << endl;
-          return EXIT_FAILURE;
-       }
+    //Identity of the reflectance field in the baked pack and in the cache of the results
+    m_sourceImagesSignature = this->sourceImagesSignature(paths, vector<float>());
 
+    //The pack of the images is mapped instead of decoding the images when it has already been baked from the same images
+    //It is baked with the layout and storage of the relighting : the mapped values are used without being converted
+    if(this->mapBakedReflectanceField(file, m_reflectanceFieldLayout, m_reflectanceFieldStorage) == EXIT_SUCCESS)
+        return EXIT_SUCCESS;
 
-       m_reflectanceField[i].convertTo(m_reflectanceField[i], CV_32FC3, 1.0/255.0);
-       osstream.str("");
+    //The files provided have a gamma correction of GAMMA
+    //It is removed while the 8 bits values are converted to floats : only 256 values are possible
+    vector<float> gammaTable(256);
+    for(int k = 0 ; k<256 ; k++)
+    {
+        gammaTable[k] = (float) pow(k/255.0, GAMMA);
+    }
+
+    if(m_outOfCore)
+    {
+        //The first image gives the size of the reflectance field
+        Mat image = imread(paths[0], CV_LOAD_IMAGE_COLOR);
+
+        if(!image.data)
+        {
+           cerr << "Couldn't open the file : " << paths[0] << endl;
+           return EXIT_FAILURE;
+        }
+
+        //The images are streamed to a tiled file : only one tile of the reflectance field is in memory during the relighting
+        m_reflectanceField.release();
+
+        if(this->prepareTiledReflectanceField(paths, gammaTable, image.rows, image.cols) == EXIT_FAILURE)
+            return EXIT_FAILURE;
+    }
+    else
+    {
+        //Decodes the images in parallel, each one directly in its slot
+        ReflectanceFieldLoader loader(m_reflectanceField);
+        loader.setReadFlags(CV_LOAD_IMAGE_COLOR);
+        loader.setLookUpTable(gammaTable);
+        loader.setProgress(this, 0, 50);
+
+        if(loader.load(paths) == EXIT_FAILURE)
+            return EXIT_FAILURE;
     }
 
     //Load the mask
@@ -240,6 +1058,8 @@ bool LightStageRelighting::loadReflectanceField()
 
     m_objectMask.convertTo(m_objectMask, CV_32FC3, 1.0/255.0);
 
+    this->bakeReflectanceField(file, m_reflectanceFieldLayout, m_reflectanceFieldStorage);
+
     return EXIT_SUCCESS;
 }
 
@@ -265,6 +1085,63 @@ void LightStageRelighting::setRelighting(QString &object, QString &environmentMa
 
 }
 
+/**
+ * Enables or disables the batch relighting (all the offsets of all the environment maps are relit with a single pass over the reflectance field per batch).
+ * @brief setBatchRelighting
+ * @param INPUT : batchRelighting true to enable the batch relighting.
+ * @param INPUT : environmentMaps names of the environment maps of the batch. If empty, only the environment map of the relighting is used.
+ */
+void LightStageRelighting::setBatchRelighting(bool batchRelighting, const QStringList &environmentMaps)
+{
+    m_batchRelighting = batchRelighting;
+    m_batchEnvironmentMaps = environmentMaps;
+}
+
+/**
+ * Enables or disables the turntable relighting (the offsets are computed in parallel and written in order, see relightingTurntable).
+ * The turntable relighting needs the full reflectance field in memory : it is refused with the low rank, out-of-core, sparse or incremental relightings or with the cache of the results.
+ * @brief setTurntable
+ * @param INPUT : turntable true to enable the turntable relighting.
+ * @param INPUT : videoFile path of the video (relative paths are in Results/light_stage). If empty, the frames are saved as an image sequence.
+ * @param INPUT : framesPerSecond frame rate of the video.
+ */
+void LightStageRelighting::setTurntable(bool turntable, const QString &videoFile, double framesPerSecond)
+{
+    m_turntable = turntable;
+    m_turntableVideo = videoFile;
+    m_turntableFramesPerSecond = framesPerSecond;
+}
+
+/**
+ * Enables or disables the spherical harmonics fast path for the point light sources : the weights are computed from the first bands of the environment map
+ * (low frequency approximation for diffuse objects and previews) instead of integrating the environment map over each Voronoi cell.
+ * @brief setSphericalHarmonics
+ * @param INPUT : bands number of bands of the spherical harmonics (at most SH_MAXIMUM_BANDS). 0 disables the fast path.
+ * @param INPUT : angleX, angleY, angleZ Euler angles in radians of a 3D rotation of the environment map applied before the offsets (see eulerRotation).
+ */
+void LightStageRelighting::setSphericalHarmonics(unsigned int bands, double angleX, double angleY, double angleZ)
+{
+    if(bands > SH_MAXIMUM_BANDS)
+    {
+        cerr << "At most " << SH_MAXIMUM_BANDS << " bands of spherical harmonics are supported" << endl;
+        bands = SH_MAXIMUM_BANDS;
+    }
+
+    m_sphericalHarmonicsBands = bands;
+    m_sphericalHarmonicsRotation = eulerRotation(angleX, angleY, angleZ);
+}
+
+/**
+ * Enables or disables the Haar wavelet path for the point light sources : the weights are computed from the largest wavelet coefficients of the environment map
+ * (sparse dot product with the transform of each cell) instead of integrating all the pixels of the environment map. Not used when the spherical harmonics are enabled.
+ * @brief setWaveletApproximation
+ * @param INPUT : numberOfCoefficients number of coefficients kept. 0 disables the wavelet path.
+ */
+void LightStageRelighting::setWaveletApproximation(unsigned int numberOfCoefficients)
+{
+    m_waveletCoefficients = numberOfCoefficients;
+}
+
 /**
  * Restart the relighting by reinitialising all the variables.
  * @brief clearRelighting
@@ -277,6 +1154,14 @@ void LightStageRelighting::clearRelighting()
     m_lightType = QString("");
     m_numberOfOffsets = 0;
     m_numberOfLightingConditions = 1;
+    m_batchRelighting = false;
+    m_batchEnvironmentMaps = QStringList();
+    m_residentObject = QString();
+    m_turntable = false;
+    m_turntableVideo = QString();
+    m_sphericalHarmonicsBands = 0;
+    m_sphericalHarmonicsRotation = Matx33d::eye();
+    m_waveletCoefficients = 0;
 
     //Environment Map parameters
     m_environmentMapWidth = 1024;
@@ -403,5 +1288,25 @@ void LightStageRelighting::updateProgressWindow(QString updateText, int progress
 {
     emit statusUpdate(updateText);
     emit updateProgressBar(progressBarValue);
-    qApp->processEvents(); //Refresh the main window to process the signals
+}
+
+/**
+ * Constructor of the RenderFrameTask class.
+ * @brief RenderFrameTask
+ * @param INPUT : relighting relighting that owns the data of the turntable.
+ * @param INPUT : writer writer of the turntable.
+ * @param INPUT : l number of the offset (frame).
+ */
+RenderFrameTask::RenderFrameTask(LightStageRelighting &relighting, TurntableWriter &writer, unsigned int l): QRunnable(), m_relighting(relighting), m_writer(writer), m_frame(l)
+{
+
+}
+
+/**
+ * Computes the frame.
+ * @brief run
+ */
+void RenderFrameTask::run()
+{
+    m_relighting.renderTurntableFrame(m_frame, m_writer);
 }
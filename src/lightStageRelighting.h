@@ -43,6 +43,9 @@
 #define _USE_MATH_DEFINES
 #define GAMMA 2.2
 #define EXPOSURE 1.2
+#define BATCH_SIZE 32u //Maximum number of results computed by a single pass over the reflectance field
+#define SH_CACHE_MAXIMUM_MAPS 16u //Maximum number of environment maps whose spherical harmonics coefficients are kept
+#define WAVELET_CACHE_MAXIMUM_MAPS 16u //Maximum number of environment maps whose wavelet approximations are kept
 
 #include "loadFiles.h"
 #include "mathsFunctions.h"
@@ -52,6 +55,9 @@
 #include "LightingBasis.h"
 #include "optimisation.h"
 #include "relighting.h"
+#include "turntableWriter.h"
+#include "sphericalHarmonics.h"
+#include "haarWavelet.h"
 
 
 #include <iostream>
@@ -59,6 +65,7 @@
 #include <sstream>
 #include <vector>
 #include <cmath>
+#include <map>
 
 #include <opencv2/core/core.hpp>
 #include <opencv/highgui.h>
@@ -66,7 +73,30 @@
 
 #include <QApplication>
 #include <QObject>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QString>
+#include <QStringList>
+
+/**
+ * Spherical harmonics coefficients of an environment map kept by the fast path.
+ */
+struct EnvironmentMapSH
+{
+    cv::Mat coefficients; /*!< Spherical harmonics coefficients of the environment map (see projectEnvironmentMapSH)*/
+    qint64 lastModified; /*!< Modification date of the file of the environment map when it was projected (ms since epoch, -1 if unknown)*/
+    unsigned long long lastUse; /*!< Number of the last use of the coefficients (the least recently used entry is removed first)*/
+};
+
+/**
+ * Wavelet approximation of an environment map kept by the wavelet path.
+ */
+struct EnvironmentMapWavelet
+{
+    WaveletApproximation approximation; /*!< Largest wavelet coefficients of the environment map (see environmentMapWavelet)*/
+    qint64 lastModified; /*!< Modification date of the file of the environment map when it was transformed (ms since epoch, -1 if unknown)*/
+    unsigned long long lastUse; /*!< Number of the last use of the approximation (the least recently used entry is removed first)*/
+};
 
 class LightStageRelighting : public Relighting
 {
@@ -88,8 +118,115 @@ class LightStageRelighting : public Relighting
         /**
          * Computes the relighting of the object using the light stage method.
          * @brief relighting
+         * @return EXIT_SUCCESS, or EXIT_FAILURE if the environment map or the images could not be loaded, if the relighting failed or if it has been cancelled.
+         */
+        bool virtual relighting();
+
+        /**
+         * Computes the relighting of the object for several environment maps and all the offsets at once.
+         * The weights of every (environment map, offset) pair are computed first. The results are then computed by batches of BATCH_SIZE with a single pass over the reflectance field per batch.
+         * @brief relightingBatch
+         * @return EXIT_SUCCESS, or EXIT_FAILURE if an environment map could not be loaded, if the relighting failed or if it has been cancelled.
+         */
+        bool relightingBatch();
+
+        /**
+         * Computes the frames of a turntable (all the offsets of the environment map) in parallel and writes them in order in a video or an image sequence.
+         * The Voronoi diagram, the reflectance field, the background table and the transfer function are prepared once and only read by the frames.
+         * @brief relightingTurntable
+         * @return EXIT_SUCCESS, or EXIT_FAILURE if the turntable could not be written or if it has been cancelled.
+         */
+        bool relightingTurntable();
+
+        /**
+         * Computes one frame of the turntable on the calling thread (weights, linear combination, background and output stage) and gives it to the writer.
+         * Called by the threads of the pool of relightingTurntable.
+         * @brief renderTurntableFrame
+         * @param INPUT : l number of the offset (frame).
+         * @param OUTPUT : writer writer of the turntable.
          */
-        void virtual relighting();
+        void renderTurntableFrame(unsigned int l, TurntableWriter &writer);
+
+        /**
+         * Reads the light stage directions from light_directions.txt. The directions are stored from the object towards the light sources.
+         * @brief readLightDirections
+         */
+        void readLightDirections();
+
+        /**
+         * Computes the normalised RGB weights of the light stage light sources for the current environment map rotated by offset. The result is stored in m_weightsRGB.
+         * @brief computeWeights
+         * @param INPUT : l number of the offset.
+         * @param INPUT : offset rotation of the environment map (phi angle).
+         */
+        void computeWeights(unsigned int l, float offset);
+
+        /**
+         * Prepares the spherical harmonics fast path : projects the Voronoi cells of the light directions (once for all the offsets) and the current environment map (once per environment map) on the spherical harmonics.
+         * The coefficients of at most SH_CACHE_MAXIMUM_MAPS environment maps are kept, and they are projected again when the file of the environment map has been modified.
+         * @brief prepareSphericalHarmonics
+         */
+        void prepareSphericalHarmonics();
+
+        /**
+         * Returns the rotation of the spherical harmonics coefficients of the environment map for an offset : the environment map is read in the direction rotation*Ry(offset)*w (see setSphericalHarmonics).
+         * @brief sphericalHarmonicsRotation
+         * @param INPUT : offset rotation of the environment map (phi angle).
+         * @return the rotation matrix of the coefficients (see rotationMatrixSH).
+         */
+        cv::Mat sphericalHarmonicsRotation(float offset) const;
+
+        /**
+         * Prepares the Haar wavelet path : computes the wavelet transform of the Voronoi cells of the light directions (once for all the offsets and environment maps)
+         * and the approximation of the current environment map (once per environment map, the offsets rotate the cells). The approximation is stored in m_environmentMapWavelet.
+         * The approximations of at most WAVELET_CACHE_MAXIMUM_MAPS environment maps are kept, and they are computed again when the file of the environment map has been modified.
+         * The relative error is printed on the error output when the approximation of another environment map is used.
+         * @brief prepareWavelet
+         */
+        void prepareWavelet();
+
+        /**
+         * Returns the modification date of the file of the current environment map (invalidates the coefficients kept by the fast paths).
+         * @brief environmentMapLastModified
+         * @return the date in ms since epoch, or -1 if the file does not exist.
+         */
+        qint64 environmentMapLastModified();
+
+        /**
+         * Raytraces the background, changes the exposure, applies the gamma to m_relitResult and saves it.
+         * @brief saveRelitResult
+         * @param INPUT : l number of the offset.
+         * @param INPUT : offset rotation of the environment map (phi angle).
+         */
+        void saveRelitResult(unsigned int l, float offset);
+
+        /**
+         * Relights an object under one rotation of an environment map with the data kept in memory by the previous calls.
+         * The reflectance field, the light directions and the label map of the Voronoi diagram are only computed when the object (or the size of the environment map) changes :
+         * the other calls only compute the weights and the linear combination.
+         * @brief relight
+         * @param INPUT : object name of the object.
+         * @param INPUT : environmentMap name of the environment map.
+         * @param INPUT : offset rotation of the environment map (phi angle).
+         * @param INPUT : lightType type of light sources used (Point or Gaussian).
+         * @param INPUT : exposure exposure of the result in stops.
+         * @param OUTPUT : result linear relit image (CV_32FC3, BGR) with the background.
+         * @return EXIT_SUCCESS or EXIT_FAILURE.
+         */
+        bool relight(const QString &object, const QString &environmentMap, float offset, const QString &lightType, double exposure, cv::Mat &result);
+
+        /**
+         * Sets the tolerance of the integration of the weights on the pyramids (see Relighting::setPyramidTolerance) and gives it to the Voronoi diagram.
+         * @brief setPyramidTolerance
+         * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong light source.
+         */
+        void virtual setPyramidTolerance(double tolerance);
+
+        /**
+         * Returns the size in bytes of the data kept in memory between two relightings (reflectance field, mask, environment maps and label map of the Voronoi diagram).
+         * @brief residentMemory
+         */
+        size_t virtual residentMemory();
 
         /**
          * Virtual pure function.
@@ -111,6 +248,41 @@ class LightStageRelighting : public Relighting
         void setRelighting(QString &object, QString &environmentMap, QString &lightType, unsigned int numberOfLightingConditions,
                            unsigned int numberOfOffsets);
 
+        /**
+         * Enables or disables the batch relighting (all the offsets of all the environment maps are relit with a single pass over the reflectance field per batch).
+         * @brief setBatchRelighting
+         * @param INPUT : batchRelighting true to enable the batch relighting.
+         * @param INPUT : environmentMaps names of the environment maps of the batch. If empty, only the environment map of the relighting is used.
+         */
+        void setBatchRelighting(bool batchRelighting, const QStringList &environmentMaps = QStringList());
+
+        /**
+         * Enables or disables the turntable relighting (the offsets are computed in parallel and written in order, see relightingTurntable).
+         * The turntable relighting needs the full reflectance field in memory : it is refused with the low rank, out-of-core, sparse or incremental relightings or with the cache of the results.
+         * @brief setTurntable
+         * @param INPUT : turntable true to enable the turntable relighting.
+         * @param INPUT : videoFile path of the video (relative paths are in Results/light_stage). If empty, the frames are saved as an image sequence.
+         * @param INPUT : framesPerSecond frame rate of the video.
+         */
+        void setTurntable(bool turntable, const QString &videoFile = QString(), double framesPerSecond = 30.0);
+
+        /**
+         * Enables or disables the spherical harmonics fast path for the point light sources : the weights are computed from the first bands of the environment map
+         * (low frequency approximation for diffuse objects and previews) instead of integrating the environment map over each Voronoi cell.
+         * @brief setSphericalHarmonics
+         * @param INPUT : bands number of bands of the spherical harmonics (at most SH_MAXIMUM_BANDS). 0 disables the fast path.
+         * @param INPUT : angleX, angleY, angleZ Euler angles in radians of a 3D rotation of the environment map applied before the offsets (see eulerRotation).
+         */
+        void setSphericalHarmonics(unsigned int bands, double angleX = 0.0, double angleY = 0.0, double angleZ = 0.0);
+
+        /**
+         * Enables or disables the Haar wavelet path for the point light sources : the weights are computed from the largest wavelet coefficients of the environment map
+         * (the environment map is transformed once, each offset rotates the cells) instead of integrating all the pixels of the environment map. Not used when the spherical harmonics are enabled.
+         * @brief setWaveletApproximation
+         * @param INPUT : numberOfCoefficients number of coefficients kept. 0 disables the wavelet path.
+         */
+        void setWaveletApproximation(unsigned int numberOfCoefficients);
+
         /**
          * Restart the relighting by reinitialising all the variables.
          * @brief clearRelighting
@@ -176,7 +348,53 @@ class LightStageRelighting : public Relighting
 
     private:
         Voronoi* m_voronoi;/*!< Object that performs the voronoi tesselation*/
+        std::vector<std::vector<float> > m_lightDirectionsCartesian; /*!< Directions of the light sources (from the object towards the light stage)*/
+        bool m_batchRelighting; /*!< Relight all the offsets (and environment maps) with a single pass over the reflectance field per batch*/
+        QStringList m_batchEnvironmentMaps; /*!< Environment maps used in the batch relighting*/
+        QString m_residentObject; /*!< Object whose reflectance field and light directions are in memory for relight (empty if none)*/
+        bool m_turntable; /*!< Compute the offsets in parallel and write them in order (turntable)*/
+        QString m_turntableVideo; /*!< Video of the turntable (image sequence if empty)*/
+        double m_turntableFramesPerSecond; /*!< Frame rate of the video of the turntable*/
+        std::vector<float> m_turntableThresholds; /*!< Transfer function of the frames of the turntable (see outputThresholds)*/
+        bool m_turntableAbsoluteValues; /*!< True if the negative values of the frames are converted as their absolute value (see outputThresholds)*/
+        unsigned int m_sphericalHarmonicsBands; /*!< Number of bands of the spherical harmonics fast path (0 if disabled)*/
+        cv::Matx33d m_sphericalHarmonicsRotation; /*!< 3D rotation of the environment map applied before the offsets*/
+        std::map<std::string, EnvironmentMapSH> m_environmentMapsSH; /*!< Spherical harmonics coefficients of the environment maps already projected (key : name, size and bands, at most SH_CACHE_MAXIMUM_MAPS entries)*/
+        unsigned long long m_environmentMapsSHUses; /*!< Number of uses of m_environmentMapsSH (date of the entries)*/
+        cv::Mat m_environmentMapSH; /*!< Spherical harmonics coefficients of the current environment map*/
+        unsigned int m_waveletCoefficients; /*!< Number of wavelet coefficients of the environment map kept by the wavelet path (0 if disabled)*/
+        std::map<std::string, EnvironmentMapWavelet> m_environmentMapsWavelet; /*!< Wavelet approximations already computed (key : name, size and number of coefficients, at most WAVELET_CACHE_MAXIMUM_MAPS entries)*/
+        unsigned long long m_environmentMapsWaveletUses; /*!< Number of uses of m_environmentMapsWavelet (date of the entries)*/
+        WaveletApproximation m_environmentMapWavelet; /*!< Wavelet approximation of the current environment map*/
+
+};
+
+/**
+ * Task of the thread pool that computes one frame of a turntable.
+ */
+class RenderFrameTask : public QRunnable
+{
+    public:
+
+        /**
+         * Constructor of the RenderFrameTask class.
+         * @brief RenderFrameTask
+         * @param INPUT : relighting relighting that owns the data of the turntable.
+         * @param INPUT : writer writer of the turntable.
+         * @param INPUT : l number of the offset (frame).
+         */
+        RenderFrameTask(LightStageRelighting &relighting, TurntableWriter &writer, unsigned int l);
 
+        /**
+         * Computes the frame.
+         * @brief run
+         */
+        virtual void run();
+
+    private:
+        LightStageRelighting &m_relighting; /*!< Relighting that owns the data of the turntable*/
+        TurntableWriter &m_writer; /*!< Writer of the turntable*/
+        unsigned int m_frame; /*!< Number of the offset*/
 };
 
 
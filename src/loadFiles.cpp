@@ -43,6 +43,9 @@
 using namespace std;
 using namespace cv;
 
+//Folder of the data set with setDataRootPath (empty : folder of the application)
+static string dataRoot;
+
 /**
 * This function loads the pictures corresponding to the reflectance field of an object.
 * @param listOfImages is an array of OpenCV Mat object. Each element of the array is a picture of the reflectance field.
@@ -101,11 +104,7 @@ int loadImages(Mat listOfImages[], unsigned int numberOfImages, string object)
 
     for(unsigned int i = 0 ; i<numberOfImages ; i++)
     {
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
 
        if(i<10)
        {
@@ -199,3 +198,28 @@ void readFile(const string& fileName, vector<vector<float> > &components)
         }
 }
 
+/**
+* Sets the folder that contains the data of the framework (images, environment maps, light intensities...).
+* By default the data is in the folder of the application.
+* @param INPUT : path path of the folder. An empty path restores the default folder.
+*/
+void setDataRootPath(const string &path)
+{
+    dataRoot = path;
+}
+
+/**
+* Returns the folder that contains the data of the framework : the path set with setDataRootPath or the folder of the application.
+* @return the path of the folder.
+*/
+string dataRootPath()
+{
+    if(!dataRoot.empty())
+        return dataRoot;
+
+    #if defined(__APPLE__) && defined(__MACH__)
+        return QCoreApplication::applicationDirPath().toStdString() + "/../../..";
+    #else
+        return QCoreApplication::applicationDirPath().toStdString();
+    #endif
+}
@@ -51,6 +51,8 @@
 #include <opencv2/core/core.hpp>
 #include <opencv/highgui.h>
 
+#include <QCoreApplication>
+
 /**
 * This function loads the pictures corresponding to the reflectance field of an object.
 * @param listOfImages is an array of OpenCV Mat object. Each element of the array is a picture of the reflectance field.
@@ -70,4 +72,17 @@ int loadImages(cv::Mat listOfImages[], unsigned int numberOfImages, std::string
 */
 void readFile(const std::string& fileName, std::vector<std::vector<float> > &components);
 
+/**
+* Sets the folder that contains the data of the framework (images, environment maps, light intensities...).
+* By default the data is in the folder of the application.
+* @param INPUT : path path of the folder. An empty path restores the default folder.
+*/
+void setDataRootPath(const std::string &path);
+
+/**
+* Returns the folder that contains the data of the framework : the path set with setDataRootPath or the folder of the application.
+* @return the path of the folder.
+*/
+std::string dataRootPath();
+
 #endif // LOADFILES_H_INCLUDED
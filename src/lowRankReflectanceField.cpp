@@ -0,0 +1,417 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file lowRankReflectanceField.cpp
+ * \brief Low rank approximation of a reflectance field.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The reflectance field is cut in tiles of LOW_RANK_TILE_ROWS rows. The images of each tile are approximated with a PCA (OpenCV) :
+ * image i ~ mean + sum over j of coefficients(i,j)*basis(j).
+ * The relighting is computed in the compressed domain : the weights are projected on the coefficients and only the rank basis images are combined.
+ */
+
+#include "lowRankReflectanceField.h"
+#include "relightingKernels.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Default constructor of the LowRankReflectanceField class. Creates an empty low rank reflectance field.
+ * @brief LowRankReflectanceField
+ */
+LowRankReflectanceField::LowRankReflectanceField(): m_means(std::vector<Mat>()), m_basis(std::vector<Mat>()), m_coefficients(std::vector<Mat>()),
+    m_tileSquaredErrors(std::vector<double>()), m_tileSquaredNorms(std::vector<double>()),
+    m_rank(0), m_numberOfImages(0), m_rows(0), m_cols(0), m_reconstructionError(0.0), m_sourceSignature(std::string())
+{
+
+}
+
+/**
+ * Destructor of the LowRankReflectanceField class.
+ */
+LowRankReflectanceField::~LowRankReflectanceField()
+{
+
+}
+
+/**
+ * Computes the low rank approximation of a reflectance field (one PCA per tile, tiles are processed in parallel).
+ * The reconstruction error is computed and printed.
+ * @brief compute
+ * @param INPUT : reflectanceField reflectance field to approximate.
+ * @param INPUT : rank number of basis images kept in each tile.
+ */
+void LowRankReflectanceField::compute(const ReflectanceField &reflectanceField, unsigned int rank)
+{
+    m_rank = rank;
+    m_numberOfImages = reflectanceField.getNumberOfImages();
+    m_rows = reflectanceField.rows();
+    m_cols = reflectanceField.cols();
+
+    unsigned int numberOfTiles = (m_rows+LOW_RANK_TILE_ROWS-1)/LOW_RANK_TILE_ROWS;
+
+    m_means.assign(numberOfTiles, Mat());
+    m_basis.assign(numberOfTiles, Mat());
+    m_coefficients.assign(numberOfTiles, Mat());
+    m_tileSquaredErrors.assign(numberOfTiles, 0.0);
+    m_tileSquaredNorms.assign(numberOfTiles, 0.0);
+
+    //Each thread computes the PCA of a set of tiles
+    LowRankFactorizationKernel factorization(reflectanceField, *this);
+    parallel_for_(Range(0, numberOfTiles), factorization);
+
+    double squaredError = 0.0, squaredNorm = 0.0;
+
+    for(unsigned int t = 0 ; t<numberOfTiles ; ++t)
+    {
+        squaredError += m_tileSquaredErrors[t];
+        squaredNorm += m_tileSquaredNorms[t];
+    }
+
+    m_reconstructionError = (squaredNorm > 0.0) ? sqrt(squaredError/squaredNorm) : 0.0;
+
+    cout << "Low rank reflectance field : rank " << m_rank << " - " << memorySize()/(1024*1024) << " MB" << endl;
+    cout << "Reconstruction error : relative " << m_reconstructionError
+         << " - RMS " << sqrt(squaredError/(3.0*m_numberOfImages*m_rows*m_cols)) << endl;
+}
+
+/**
+ * Computes the PCA of tile t of the reflectance field. The tiles must have been allocated by compute.
+ * @brief computeTile
+ * @param INPUT : t number of the tile.
+ * @param INPUT : reflectanceField reflectance field to approximate.
+ */
+void LowRankReflectanceField::computeTile(unsigned int t, const ReflectanceField &reflectanceField)
+{
+    int firstRow = t*LOW_RANK_TILE_ROWS;
+    int lastRow = min(m_rows, firstRow+LOW_RANK_TILE_ROWS);
+
+    //Each row of the data matrix is the tile of one image
+    Mat data(m_numberOfImages, 3*(lastRow-firstRow)*m_cols, CV_32F);
+
+    for(unsigned int i = 0 ; i<m_numberOfImages ; ++i)
+    {
+        Mat tile = reflectanceField.image(i).rowRange(firstRow, lastRow);
+        Mat dataRow = data.row(i);
+
+        tile.reshape(1, 1).copyTo(dataRow);
+    }
+
+    //The images are the samples, the pixels are the variables
+    PCA pca(data, Mat(), CV_PCA_DATA_AS_ROW, m_rank);
+
+    m_means[t] = pca.mean.clone();
+    m_basis[t] = pca.eigenvectors.clone();
+    m_coefficients[t] = pca.project(data);
+
+    double error = norm(data, pca.backProject(m_coefficients[t]), NORM_L2);
+    double dataNorm = norm(data, NORM_L2);
+
+    m_tileSquaredErrors[t] = error*error;
+    m_tileSquaredNorms[t] = dataNorm*dataNorm;
+}
+
+/**
+ * Computes the relit tile t in the compressed domain : result = sum(w)*mean + sum over j of (sum over i of w_i*coefficients(i,j))*basis(j).
+ * @brief relightTile
+ * @param INPUT : t number of the tile.
+ * @param INPUT : weightsBGR weights of the images in BGR order. weightsBGR[3*i+c] is the weight of channel c of image i.
+ * @param OUTPUT : result CV_32FC3 continuous image that has already been allocated with the size of the reflectance field.
+ */
+void LowRankReflectanceField::relightTile(unsigned int t, const float* weightsBGR, Mat &result) const
+{
+    const Mat &coefficients = m_coefficients[t];
+    int rank = coefficients.cols;
+
+    //Projection of the weights in the compressed domain. tileWeights[0..2] : weights of the mean, tileWeights[3*(j+1)+c] : weight of basis image j
+    vector<float> tileWeights(3*(rank+1), 0.0f);
+
+    for(unsigned int i = 0 ; i<m_numberOfImages ; ++i)
+    {
+        const float* coefficientsImage = coefficients.ptr<float>(i);
+
+        for(int c = 0 ; c<3 ; ++c)
+        {
+            float weight = weightsBGR[3*i+c];
+            tileWeights[c] += weight;
+
+            for(int j = 0 ; j<rank ; ++j)
+            {
+                tileWeights[3*(j+1)+c] += weight*coefficientsImage[j];
+            }
+        }
+    }
+
+    //The tile is made of full rows : it is contiguous in the result
+    int numberOfPixels = m_means[t].cols/3;
+    float* dst = result.ptr<float>(t*LOW_RANK_TILE_ROWS);
+
+    memset(dst, 0, 3*numberOfPixels*sizeof(float));
+    weightedSumRow(m_means[t].ptr<float>(), &tileWeights[0], dst, numberOfPixels);
+
+    for(int j = 0 ; j<rank ; ++j)
+    {
+        weightedSumRow(m_basis[t].ptr<float>(j), &tileWeights[3*(j+1)], dst, numberOfPixels);
+    }
+}
+
+/**
+ * Saves the low rank reflectance field in a binary file.
+ * @brief save
+ * @param INPUT : filePath path of the file.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be written.
+ */
+bool LowRankReflectanceField::save(const string &filePath) const
+{
+    ofstream file(filePath.c_str(), ios::out | ios::trunc | ios::binary);
+
+    if(!file)
+    {
+        cerr << "Could not write the file : " << filePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    unsigned int header[5] = {m_numberOfImages, m_rank, (unsigned int) m_rows, (unsigned int) m_cols, LOW_RANK_TILE_ROWS};
+
+    //The signature is padded with zeros
+    string signature(m_sourceSignature);
+    signature.resize(SOURCE_SIGNATURE_SIZE, '\0');
+
+    file.write("LRR2", 4*sizeof(char));
+    file.write((char*) header, 5*sizeof(unsigned int));
+    file.write(signature.data(), SOURCE_SIGNATURE_SIZE*sizeof(char));
+    file.write((char*) &m_reconstructionError, sizeof(double));
+
+    for(unsigned int t = 0 ; t<m_means.size() ; ++t)
+    {
+        int rank = m_basis[t].rows;
+
+        file.write((char*) &rank, sizeof(int));
+        file.write((char*) m_means[t].ptr<float>(), m_means[t].total()*sizeof(float));
+        file.write((char*) m_basis[t].ptr<float>(), m_basis[t].total()*sizeof(float));
+        file.write((char*) m_coefficients[t].ptr<float>(), m_coefficients[t].total()*sizeof(float));
+    }
+
+    return file.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Loads a low rank reflectance field saved with save.
+ * @brief load
+ * @param INPUT : filePath path of the file.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be read.
+ */
+bool LowRankReflectanceField::load(const string &filePath)
+{
+    ifstream file(filePath.c_str(), ios::in | ios::binary);
+
+    if(!file)
+        return EXIT_FAILURE;
+
+    char type[4];
+    unsigned int header[5];
+    char signature[SOURCE_SIGNATURE_SIZE];
+
+    file.read(type, 4*sizeof(char));
+    file.read((char*) header, 5*sizeof(unsigned int));
+    file.read(signature, SOURCE_SIGNATURE_SIZE*sizeof(char));
+
+    //Files without signature (LRRF) are computed again
+    if(!file || strncmp(type, "LRR2", 4) != 0 || header[4] != LOW_RANK_TILE_ROWS)
+    {
+        cerr << "Invalid low rank reflectance field : " << filePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    m_numberOfImages = header[0];
+    m_rank = header[1];
+    m_rows = header[2];
+    m_cols = header[3];
+    m_sourceSignature = string(signature, SOURCE_SIGNATURE_SIZE);
+    file.read((char*) &m_reconstructionError, sizeof(double));
+
+    unsigned int numberOfTiles = (m_rows+LOW_RANK_TILE_ROWS-1)/LOW_RANK_TILE_ROWS;
+
+    m_means.assign(numberOfTiles, Mat());
+    m_basis.assign(numberOfTiles, Mat());
+    m_coefficients.assign(numberOfTiles, Mat());
+    m_tileSquaredErrors.assign(numberOfTiles, 0.0);
+    m_tileSquaredNorms.assign(numberOfTiles, 0.0);
+
+    for(unsigned int t = 0 ; t<numberOfTiles && file ; ++t)
+    {
+        int rank = 0;
+        int numberOfValues = 3*(min(m_rows, (int) (t+1)*LOW_RANK_TILE_ROWS) - (int) t*LOW_RANK_TILE_ROWS)*m_cols;
+
+        file.read((char*) &rank, sizeof(int));
+
+        if(rank < 0 || rank > (int) m_rank)
+            break;
+
+        m_means[t].create(1, numberOfValues, CV_32F);
+        m_basis[t].create(rank, numberOfValues, CV_32F);
+        m_coefficients[t].create(m_numberOfImages, rank, CV_32F);
+
+        file.read((char*) m_means[t].ptr<float>(), m_means[t].total()*sizeof(float));
+        file.read((char*) m_basis[t].ptr<float>(), m_basis[t].total()*sizeof(float));
+        file.read((char*) m_coefficients[t].ptr<float>(), m_coefficients[t].total()*sizeof(float));
+    }
+
+    if(!file || m_coefficients.empty() || m_coefficients.back().rows != (int) m_numberOfImages)
+    {
+        cerr << "Could not read the low rank reflectance field : " << filePath << endl;
+        this->release();
+        return EXIT_FAILURE;
+    }
+
+    cout << "Low rank reflectance field loaded : rank " << m_rank << " - relative reconstruction error " << m_reconstructionError << endl;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Releases the memory of the low rank reflectance field.
+ * @brief release
+ */
+void LowRankReflectanceField::release()
+{
+    m_means.clear();
+    m_basis.clear();
+    m_coefficients.clear();
+    m_tileSquaredErrors.clear();
+    m_tileSquaredNorms.clear();
+    m_rank = 0;
+    m_numberOfImages = 0;
+    m_rows = 0;
+    m_cols = 0;
+    m_reconstructionError = 0.0;
+    m_sourceSignature = string();
+}
+
+/**
+ * Returns true if the low rank reflectance field has not been computed or loaded.
+ * @brief empty
+ */
+bool LowRankReflectanceField::empty() const
+{
+    return m_means.empty();
+}
+
+/**
+ * Getter that returns the rank of the approximation.
+ * @brief getRank
+ */
+unsigned int LowRankReflectanceField::getRank() const
+{
+    return m_rank;
+}
+
+/**
+ * Getter that returns the number of images of the approximated reflectance field.
+ * @brief getNumberOfImages
+ */
+unsigned int LowRankReflectanceField::getNumberOfImages() const
+{
+    return m_numberOfImages;
+}
+
+/**
+ * Getter that returns the number of tiles.
+ * @brief getNumberOfTiles
+ */
+unsigned int LowRankReflectanceField::getNumberOfTiles() const
+{
+    return m_means.size();
+}
+
+/**
+ * Getter that returns the height of the images.
+ * @brief rows
+ */
+int LowRankReflectanceField::rows() const
+{
+    return m_rows;
+}
+
+/**
+ * Getter that returns the width of the images.
+ * @brief cols
+ */
+int LowRankReflectanceField::cols() const
+{
+    return m_cols;
+}
+
+/**
+ * Getter that returns the relative reconstruction error ||RF - approximation|| / ||RF|| (Frobenius norms).
+ * @brief getReconstructionError
+ */
+double LowRankReflectanceField::getReconstructionError() const
+{
+    return m_reconstructionError;
+}
+
+/**
+ * Sets the signature of the reflectance field that has been approximated (see Relighting::reflectanceFieldSignature). It is saved in the file.
+ * @brief setSourceSignature
+ * @param INPUT : signature SOURCE_SIGNATURE_SIZE bytes.
+ */
+void LowRankReflectanceField::setSourceSignature(const string &signature)
+{
+    m_sourceSignature = signature;
+}
+
+/**
+ * Getter that returns the signature of the reflectance field that has been approximated (empty if unknown).
+ * @brief getSourceSignature
+ */
+const string &LowRankReflectanceField::getSourceSignature() const
+{
+    return m_sourceSignature;
+}
+
+/**
+ * Returns the size in bytes of the low rank reflectance field.
+ * @brief memorySize
+ */
+size_t LowRankReflectanceField::memorySize() const
+{
+    size_t size = 0;
+
+    for(unsigned int t = 0 ; t<m_means.size() ; ++t)
+    {
+        size += (m_means[t].total() + m_basis[t].total() + m_coefficients[t].total())*sizeof(float);
+    }
+
+    return size;
+}
@@ -0,0 +1,197 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file lowRankReflectanceField.h
+ * \brief Low rank approximation of a reflectance field.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The reflectance field is cut in tiles of LOW_RANK_TILE_ROWS rows. The images of each tile are approximated with a PCA (OpenCV) :
+ * image i ~ mean + sum over j of coefficients(i,j)*basis(j).
+ * The relighting is computed in the compressed domain : the weights are projected on the coefficients and only the rank basis images are combined.
+ */
+
+#ifndef LOWRANKREFLECTANCEFIELD_H
+#define LOWRANKREFLECTANCEFIELD_H
+
+#define LOW_RANK_TILE_ROWS 16
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "reflectanceField.h"
+
+class LowRankReflectanceField
+{
+    public:
+
+        /**
+         * Default constructor of the LowRankReflectanceField class. Creates an empty low rank reflectance field.
+         * @brief LowRankReflectanceField
+         */
+        LowRankReflectanceField();
+
+        /**
+         * Destructor of the LowRankReflectanceField class.
+         */
+        ~LowRankReflectanceField();
+
+        /**
+         * Computes the low rank approximation of a reflectance field (one PCA per tile, tiles are processed in parallel).
+         * The reconstruction error is computed and printed.
+         * @brief compute
+         * @param INPUT : reflectanceField reflectance field to approximate.
+         * @param INPUT : rank number of basis images kept in each tile.
+         */
+        void compute(const ReflectanceField &reflectanceField, unsigned int rank);
+
+        /**
+         * Computes the PCA of tile t of the reflectance field. The tiles must have been allocated by compute.
+         * @brief computeTile
+         * @param INPUT : t number of the tile.
+         * @param INPUT : reflectanceField reflectance field to approximate.
+         */
+        void computeTile(unsigned int t, const ReflectanceField &reflectanceField);
+
+        /**
+         * Computes the relit tile t in the compressed domain : result = sum(w)*mean + sum over j of (sum over i of w_i*coefficients(i,j))*basis(j).
+         * @brief relightTile
+         * @param INPUT : t number of the tile.
+         * @param INPUT : weightsBGR weights of the images in BGR order. weightsBGR[3*i+c] is the weight of channel c of image i.
+         * @param OUTPUT : result CV_32FC3 continuous image that has already been allocated with the size of the reflectance field.
+         */
+        void relightTile(unsigned int t, const float* weightsBGR, cv::Mat &result) const;
+
+        /**
+         * Sets the signature of the reflectance field that has been approximated (see Relighting::reflectanceFieldSignature). It is saved in the file.
+         * @brief setSourceSignature
+         * @param INPUT : signature SOURCE_SIGNATURE_SIZE bytes.
+         */
+        void setSourceSignature(const std::string &signature);
+
+        /**
+         * Getter that returns the signature of the reflectance field that has been approximated (empty if unknown).
+         * @brief getSourceSignature
+         */
+        const std::string &getSourceSignature() const;
+
+        /**
+         * Saves the low rank reflectance field in a binary file.
+         * @brief save
+         * @param INPUT : filePath path of the file.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be written.
+         */
+        bool save(const std::string &filePath) const;
+
+        /**
+         * Loads a low rank reflectance field saved with save.
+         * @brief load
+         * @param INPUT : filePath path of the file.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be read.
+         */
+        bool load(const std::string &filePath);
+
+        /**
+         * Releases the memory of the low rank reflectance field.
+         * @brief release
+         */
+        void release();
+
+        /**
+         * Returns true if the low rank reflectance field has not been computed or loaded.
+         * @brief empty
+         */
+        bool empty() const;
+
+        /**
+         * Getter that returns the rank of the approximation.
+         * @brief getRank
+         */
+        unsigned int getRank() const;
+
+        /**
+         * Getter that returns the number of images of the approximated reflectance field.
+         * @brief getNumberOfImages
+         */
+        unsigned int getNumberOfImages() const;
+
+        /**
+         * Getter that returns the number of tiles.
+         * @brief getNumberOfTiles
+         */
+        unsigned int getNumberOfTiles() const;
+
+        /**
+         * Getter that returns the height of the images.
+         * @brief rows
+         */
+        int rows() const;
+
+        /**
+         * Getter that returns the width of the images.
+         * @brief cols
+         */
+        int cols() const;
+
+        /**
+         * Getter that returns the relative reconstruction error ||RF - approximation|| / ||RF|| (Frobenius norms).
+         * @brief getReconstructionError
+         */
+        double getReconstructionError() const;
+
+        /**
+         * Returns the size in bytes of the low rank reflectance field.
+         * @brief memorySize
+         */
+        size_t memorySize() const;
+
+    private:
+        std::vector<cv::Mat> m_means; /*!< m_means[t] is the 1 x (3*pixels of tile t) mean image of tile t (CV_32F)*/
+        std::vector<cv::Mat> m_basis; /*!< m_basis[t] is the rank x (3*pixels of tile t) matrix of the basis images of tile t (CV_32F)*/
+        std::vector<cv::Mat> m_coefficients; /*!< m_coefficients[t] is the numberOfImages x rank matrix of the coordinates of each image in the basis of tile t (CV_32F)*/
+        std::vector<double> m_tileSquaredErrors; /*!< Squared reconstruction error of each tile*/
+        std::vector<double> m_tileSquaredNorms; /*!< Squared norm of each tile*/
+        unsigned int m_rank; /*!< Rank of the approximation*/
+        unsigned int m_numberOfImages; /*!< Number of images (lighting conditions)*/
+        int m_rows; /*!< Height of the images*/
+        int m_cols; /*!< Width of the images*/
+        double m_reconstructionError; /*!< Relative reconstruction error*/
+        std::string m_sourceSignature; /*!< Signature of the reflectance field that has been approximated*/
+};
+
+#endif // LOWRANKREFLECTANCEFIELD_H
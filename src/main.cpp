@@ -35,20 +35,79 @@
  * \date May, 23rd, 2014
  *
  * The program relights an object using an environment map and the reflectance field of the object, captured with a light stage, a free-form acquisition or a regular room. It uses OpenCV library version 2.4.2.
+ * With --batch jobs.ini the relightings described in the job file are run without the graphical interface (see batchRelighting.h).
+ * With --server name a resident relighting server answers the requests received on the local socket name (see relightingServer.h).
+ * With --trace file.json the duration of each stage of the relightings is written in file.json when the program ends (Chrome trace event format, see trace.h).
  */
 
 #include <iostream>
+#include <string>
 
 #include <QApplication>
+#include <QCoreApplication>
 #include "mainWindow.h"
+#include "batchRelighting.h"
+#include "relightingServer.h"
+#include "trace.h"
 
 int main (int argc, char* argv[])
 {
+    //Headless modes : IBR_Framework --batch jobs.ini [--data-root folder] or IBR_Framework --server name [--data-root folder]
+    QString jobFile;
+    QString serverName;
+    QString dataRoot;
+    QString traceFile;
 
-    QApplication app(argc, argv);
-    MainWindow window(750,600);
+    for(int i = 1 ; i<argc-1 ; i++)
+    {
+        if(std::string(argv[i]) == "--batch")
+            jobFile = QString::fromLocal8Bit(argv[i+1]);
+        else if(std::string(argv[i]) == "--server")
+            serverName = QString::fromLocal8Bit(argv[i+1]);
+        else if(std::string(argv[i]) == "--data-root")
+            dataRoot = QString::fromLocal8Bit(argv[i+1]);
+        else if(std::string(argv[i]) == "--trace")
+            traceFile = QString::fromLocal8Bit(argv[i+1]);
+    }
 
-    window.show();
-    return app.exec();
-}
+    if(!traceFile.isEmpty())
+        startTracing(traceFile.toLocal8Bit().constData());
+
+    int returnCode = EXIT_SUCCESS;
+
+    if(!jobFile.isEmpty())
+    {
+        //No graphical interface and no event loop : the jobs are run one after the other
+        QCoreApplication app(argc, argv);
+        BatchRelighting batchRelighting;
+
+        returnCode = batchRelighting.run(jobFile, dataRoot);
+    }
+    else if(!serverName.isEmpty())
+    {
+        //The server answers the requests in the event loop until a shutdown request, SIGINT or SIGTERM
+        QCoreApplication app(argc, argv);
+        RelightingServer server;
+
+        if(server.listen(serverName, dataRoot) == EXIT_FAILURE)
+            returnCode = EXIT_FAILURE;
+        else
+            returnCode = app.exec();
+    }
+    else
+    {
+        QApplication app(argc, argv);
+        MainWindow window(750,600);
 
+        if(!dataRoot.isEmpty())
+            setDataRootPath(dataRoot.toStdString());
+
+        window.show();
+        returnCode = app.exec();
+    }
+
+    if(isTracing())
+        stopTracing();
+
+    return returnCode;
+}
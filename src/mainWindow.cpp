@@ -195,7 +195,9 @@ MainWindow::~MainWindow()
     delete m_lightStageTab;
     delete m_tabs;
 
+    //Stops the worker threads of the relightings
     delete m_LSRelighting;
+    delete m_FFRelighting;
     delete m_ORRelighting;
 }
 
@@ -400,6 +402,15 @@ void MainWindow::buildWindow()
     QObject::connect(m_ORRelighting, SIGNAL(updateProgressBar(int)), m_progressWindow, SLOT(setValueProgressBar(int)));
     QObject::connect(m_ORRelighting, SIGNAL(updateImage(QString)), m_progressWindow, SLOT(updateImage(QString)));
 
+    //The relightings run on their worker thread : the cancel token is set directly from the GUI thread
+    QObject::connect(m_progressWindow, SIGNAL(cancelRequested()), m_LSRelighting, SLOT(cancelRelighting()), Qt::DirectConnection);
+    QObject::connect(m_progressWindow, SIGNAL(cancelRequested()), m_FFRelighting, SLOT(cancelRelighting()), Qt::DirectConnection);
+    QObject::connect(m_progressWindow, SIGNAL(cancelRequested()), m_ORRelighting, SLOT(cancelRelighting()), Qt::DirectConnection);
+
+    QObject::connect(m_LSRelighting, SIGNAL(relightingFinished()), this, SLOT(relightingFinished()));
+    QObject::connect(m_FFRelighting, SIGNAL(relightingFinished()), this, SLOT(relightingFinished()));
+    QObject::connect(m_ORRelighting, SIGNAL(relightingFinished()), this, SLOT(relightingFinished()));
+
     //If the number of lighting conditions changes then the range in which the number corresponding to the picture of the dark room changes tooS
     QObject::connect(m_numberOfLightingConditionsOR, SIGNAL(valueChanged(int)), this, SLOT(changeRangeIndirectLightPicture(int)));
 }
@@ -444,8 +455,8 @@ void MainWindow::startLightStageRelighting()
 
     m_progressWindow->clear();
     m_progressWindow->open();
-    qApp->processEvents(); //Refresh the main window
-    m_LSRelighting->relighting();
+    this->setStartButtonsEnabled(false);
+    m_LSRelighting->startRelighting();
 }
 
 /**
@@ -478,8 +489,8 @@ void MainWindow::startFreeFormRelighting()
     m_FFRelighting->setRelighting(environmentMap, lightType, numberOfLightingConditions, numberOfOffsets, exposure, identificationMethod, save);
     m_progressWindow->clear();
     m_progressWindow->open();
-    qApp->processEvents(); //Refresh the main window
-    m_FFRelighting->relighting();
+    this->setStartButtonsEnabled(false);
+    m_FFRelighting->startRelighting();
 }
 
 /**
@@ -561,7 +572,29 @@ void MainWindow::startOfficeRoomRelighting()
 
 
     m_ORRelighting->setRelighting(object, environmentMap, lightType, numberOfLightingConditions, numberOfOffsets, identificationMethod, masksType, optimisationMethod, numberOfSamples, indirectLightPicture, computeMasks,exposure);
-    m_ORRelighting->relighting();
+    this->setStartButtonsEnabled(false);
+    m_ORRelighting->startRelighting();
+}
+
+/**
+ * Qt slot called when a relighting running on its worker thread ends or is cancelled. Enables the start buttons again.
+ * @brief relightingFinished
+ */
+void MainWindow::relightingFinished()
+{
+    this->setStartButtonsEnabled(true);
+}
+
+/**
+ * Enables or disables the start buttons of the three tabs. Only one relighting runs at a time.
+ * @brief setStartButtonsEnabled
+ * @param enabled INPUT : true to enable the buttons, false to disable them.
+ */
+void MainWindow::setStartButtonsEnabled(bool enabled)
+{
+    m_startButtonLS->setEnabled(enabled);
+    m_startButtonFF->setEnabled(enabled);
+    m_startButtonOR->setEnabled(enabled);
 }
 
 /**
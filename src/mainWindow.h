@@ -133,7 +133,20 @@ class MainWindow : public QWidget
          */
         void changeRangeIndirectLightPicture(int indirectLightPicture);
 
+        /**
+         * Qt slot called when a relighting running on its worker thread ends or is cancelled. Enables the start buttons again.
+         * @brief relightingFinished
+         */
+        void relightingFinished();
+
     private:
+        /**
+         * Enables or disables the start buttons of the three tabs. Only one relighting runs at a time.
+         * @brief setStartButtonsEnabled
+         * @param enabled INPUT : true to enable the buttons, false to disable them.
+         */
+        void setStartButtonsEnabled(bool enabled);
+
 
         QTabWidget* m_tabs; /*!< The main widget containing the three tabs*/
         QWidget* m_officeRoomTab; /*!< The widget containing the office room tab*/
@@ -357,3 +357,79 @@ void compute2DDistributionFunction(const Mat &image, unsigned int& width, unsign
 
 }
 
+/**
+ * Converts a 32 bits float to a 16 bits IEEE half float (round to nearest even). Values too large for a half float become infinity.
+ * @brief floatToHalf
+ * @param INPUT : value is the float to convert.
+ * @return the bits of the half float.
+ */
+unsigned short floatToHalf(float value)
+{
+    union { unsigned int u; float f; } bits, infinity, halfMax, denormalMagic;
+
+    infinity.u = 255u << 23;
+    halfMax.u = (127u + 16u) << 23;
+    denormalMagic.u = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    bits.f = value;
+    unsigned int sign = bits.u & 0x80000000u;
+    bits.u ^= sign;
+
+    unsigned short half = 0;
+
+    if(bits.u >= halfMax.u)
+    {
+        //Infinity or NaN
+        half = (bits.u > infinity.u) ? 0x7e00 : 0x7c00;
+    }
+    else if(bits.u < (113u << 23))
+    {
+        //Denormalized half : the addition aligns the mantissa and rounds it
+        bits.f += denormalMagic.f;
+        half = (unsigned short) (bits.u - denormalMagic.u);
+    }
+    else
+    {
+        //Normalized half : rebias the exponent and round the mantissa to nearest even
+        unsigned int oddMantissa = (bits.u >> 13) & 1u;
+        bits.u -= 112u << 23;
+        bits.u += 0xfffu + oddMantissa;
+        half = (unsigned short) (bits.u >> 13);
+    }
+
+    return half | (unsigned short) (sign >> 16);
+}
+
+/**
+ * Converts a 16 bits IEEE half float to a 32 bits float.
+ * @brief halfToFloat
+ * @param INPUT : half contains the bits of the half float.
+ * @return the value of the half float as a 32 bits float.
+ */
+float halfToFloat(unsigned short half)
+{
+    union { unsigned int u; float f; } bits, magic;
+
+    const unsigned int shiftedExponent = 0x7c00u << 13;
+    magic.u = 113u << 23;
+
+    bits.u = (half & 0x7fffu) << 13;
+    unsigned int exponent = shiftedExponent & bits.u;
+    bits.u += (127u - 15u) << 23;
+
+    if(exponent == shiftedExponent)
+    {
+        //Infinity or NaN
+        bits.u += (128u - 16u) << 23;
+    }
+    else if(exponent == 0)
+    {
+        //Zero or denormalized half
+        bits.u += 1u << 23;
+        bits.f -= magic.f;
+    }
+
+    bits.u |= (half & 0x8000u) << 16;
+
+    return bits.f;
+}
@@ -169,4 +169,20 @@ void reorientateRectangle(cv::Point2i& startingPoint, cv::Point2i& endingPoint,
  */
 void compute2DDistributionFunction(const cv::Mat &image, unsigned int& width, unsigned int& height, float* pdf, float* cdf);
 
+/**
+ * Converts a 32 bits float to a 16 bits IEEE half float (round to nearest even). Values too large for a half float become infinity.
+ * @brief floatToHalf
+ * @param INPUT : value is the float to convert.
+ * @return the bits of the half float.
+ */
+unsigned short floatToHalf(float value);
+
+/**
+ * Converts a 16 bits IEEE half float to a 32 bits float.
+ * @brief halfToFloat
+ * @param INPUT : half contains the bits of the half float.
+ * @return the value of the half float as a 32 bits float.
+ */
+float halfToFloat(unsigned short half);
+
 #endif // MATHSFUNCTIONS_H_INCLUDED
@@ -0,0 +1,262 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file memoryTracker.cpp
+ * \brief Accounting of the memory used by the large image buffers, per owner and per stage of the relighting.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The buffers are declared by their owner : setTrackedMemory gives the size of a buffer kept by an object (reflectance field, environment maps...)
+ * and a TrackedMemory declares a temporary buffer for its lifetime (channels of split/merge, projection matrix...).
+ * A MemoryStage records the peak of the tracked memory while the stage is running.
+ * The numbers are given by memoryReport and printed by memorySummary.
+ */
+
+#include "memoryTracker.h"
+
+using namespace std;
+
+static QMutex memoryMutex;
+static MemoryUsage totalMemory = {0, 0};
+static std::map<std::string, MemoryUsage> ownersMemory;
+static std::map<std::string, MemoryUsage> stagesMemory;
+static std::map<std::string, int> runningStages; /*!< Number of running stages of each name*/
+
+/**
+ * Updates the peaks of the total and of the running stages. The mutex must be locked.
+ * @brief updatePeaks
+ */
+static void updatePeaks()
+{
+    totalMemory.peak = std::max(totalMemory.peak, totalMemory.current);
+
+    for(std::map<std::string, int>::const_iterator it = runningStages.begin() ; it != runningStages.end() ; it++)
+    {
+        MemoryUsage &stage = stagesMemory[it->first];
+        stage.current = totalMemory.current;
+        stage.peak = std::max(stage.peak, totalMemory.current);
+    }
+}
+
+/**
+ * Adds or removes bytes from the memory of an owner. The mutex must be locked.
+ * @brief changeTrackedMemory
+ */
+static void changeTrackedMemory(const std::string &owner, size_t addedBytes, size_t removedBytes)
+{
+    std::map<std::string, MemoryUsage>::iterator it = ownersMemory.find(owner);
+
+    if(it == ownersMemory.end())
+    {
+        MemoryUsage usage = {0, 0};
+        it = ownersMemory.insert(std::make_pair(owner, usage)).first;
+    }
+
+    //An owner never goes below 0 even if it removes more than it added
+    removedBytes = std::min(removedBytes, it->second.current + addedBytes);
+
+    it->second.current = it->second.current + addedBytes - removedBytes;
+    it->second.peak = std::max(it->second.peak, it->second.current);
+
+    totalMemory.current = totalMemory.current + addedBytes - removedBytes;
+    updatePeaks();
+}
+
+/**
+ * Returns the size in megabytes written with one decimal.
+ * @brief megabytes
+ */
+static std::string megabytes(size_t bytes)
+{
+    ostringstream text;
+    text << fixed << setprecision(1) << bytes/(1024.0*1024.0) << " MB";
+    return text.str();
+}
+
+/**
+ * Writes the memory of the owners or of the stages sorted by decreasing peak.
+ * @brief writeUsages
+ */
+static void writeUsages(ostringstream &text, const std::map<std::string, MemoryUsage> &usages)
+{
+    std::multimap<size_t, std::string, std::greater<size_t> > sortedByPeak;
+
+    for(std::map<std::string, MemoryUsage>::const_iterator it = usages.begin() ; it != usages.end() ; it++)
+    {
+        sortedByPeak.insert(std::make_pair(it->second.peak, it->first));
+    }
+
+    for(std::multimap<size_t, std::string, std::greater<size_t> >::const_iterator it = sortedByPeak.begin() ; it != sortedByPeak.end() ; it++)
+    {
+        const MemoryUsage &usage = usages.find(it->second)->second;
+        text << "  " << it->second << " : peak " << megabytes(usage.peak) << ", current " << megabytes(usage.current) << endl;
+    }
+}
+
+/**
+ * Sets the size of the buffers kept by an owner (replaces the previous size). Set 0 when the buffers are released.
+ * @brief setTrackedMemory
+ * @param INPUT : owner name of the owner (e.g. "Buddha/reflectanceField").
+ * @param INPUT : bytes size of the buffers in bytes.
+ */
+void setTrackedMemory(const std::string &owner, size_t bytes)
+{
+    QMutexLocker locker(&memoryMutex);
+
+    std::map<std::string, MemoryUsage>::const_iterator it = ownersMemory.find(owner);
+    size_t previousBytes = it == ownersMemory.end() ? 0 : it->second.current;
+
+    changeTrackedMemory(owner, bytes, previousBytes);
+}
+
+/**
+ * Returns the number of bytes used by the data of an image (without the header).
+ * @brief matMemorySize
+ * @param INPUT : image image.
+ */
+size_t matMemorySize(const cv::Mat &image)
+{
+    return image.total()*image.elemSize();
+}
+
+/**
+ * Returns the memory tracked for all the owners, each owner and each stage.
+ * @brief memoryReport
+ */
+MemoryReport memoryReport()
+{
+    QMutexLocker locker(&memoryMutex);
+
+    MemoryReport report;
+    report.total = totalMemory;
+    report.owners = ownersMemory;
+    report.stages = stagesMemory;
+
+    return report;
+}
+
+/**
+ * Returns a text summary of the memory report : total, then the owners and the stages sorted by decreasing peak.
+ * @brief memorySummary
+ */
+std::string memorySummary()
+{
+    MemoryReport report = memoryReport();
+    ostringstream text;
+
+    text << "Tracked memory : peak " << megabytes(report.total.peak) << ", current " << megabytes(report.total.current) << endl;
+    text << "Owners :" << endl;
+    writeUsages(text, report.owners);
+    text << "Stages :" << endl;
+    writeUsages(text, report.stages);
+
+    return text.str();
+}
+
+/**
+ * Sets every peak to its current size, so that the peaks of the next job can be measured. Owners and stages whose current size is 0 are removed.
+ * @brief resetMemoryPeaks
+ */
+void resetMemoryPeaks()
+{
+    QMutexLocker locker(&memoryMutex);
+
+    totalMemory.peak = totalMemory.current;
+
+    for(std::map<std::string, MemoryUsage>::iterator it = ownersMemory.begin() ; it != ownersMemory.end() ; )
+    {
+        it->second.peak = it->second.current;
+
+        if(it->second.current == 0)
+            ownersMemory.erase(it++);
+        else
+            it++;
+    }
+
+    //The stages that are not running are forgotten
+    for(std::map<std::string, MemoryUsage>::iterator it = stagesMemory.begin() ; it != stagesMemory.end() ; )
+    {
+        it->second.peak = it->second.current;
+
+        if(runningStages.find(it->first) == runningStages.end())
+            stagesMemory.erase(it++);
+        else
+            it++;
+    }
+}
+
+/**
+ * Adds a temporary buffer to the memory of an owner until the destruction of the object.
+ * @brief TrackedMemory
+ * @param INPUT : owner name of the owner (e.g. "Relighting::gammaCorrection").
+ * @param INPUT : bytes size of the buffer in bytes.
+ */
+TrackedMemory::TrackedMemory(const std::string &owner, size_t bytes): m_owner(owner), m_bytes(bytes)
+{
+    QMutexLocker locker(&memoryMutex);
+    changeTrackedMemory(m_owner, m_bytes, 0);
+}
+
+/**
+ * Removes the buffer from the memory of its owner.
+ * @brief ~TrackedMemory
+ */
+TrackedMemory::~TrackedMemory()
+{
+    QMutexLocker locker(&memoryMutex);
+    changeTrackedMemory(m_owner, 0, m_bytes);
+}
+
+/**
+ * Starts a stage. The peak of the stage is updated each time the tracked memory changes until the destruction of the object.
+ * Stages of the same name can run at the same time (several jobs) : the stage runs until the last one ends.
+ * @brief MemoryStage
+ * @param INPUT : name name of the stage (e.g. "loadReflectanceField").
+ */
+MemoryStage::MemoryStage(const std::string &name): m_name(name)
+{
+    QMutexLocker locker(&memoryMutex);
+
+    runningStages[m_name]++;
+    updatePeaks();
+}
+
+/**
+ * Ends the stage.
+ * @brief ~MemoryStage
+ */
+MemoryStage::~MemoryStage()
+{
+    QMutexLocker locker(&memoryMutex);
+
+    if(--runningStages[m_name] <= 0)
+        runningStages.erase(m_name);
+}
@@ -0,0 +1,165 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file memoryTracker.h
+ * \brief Accounting of the memory used by the large image buffers, per owner and per stage of the relighting.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The buffers are declared by their owner : setTrackedMemory gives the size of a buffer kept by an object (reflectance field, environment maps...)
+ * and a TrackedMemory declares a temporary buffer for its lifetime (channels of split/merge, projection matrix...).
+ * A MemoryStage records the peak of the tracked memory while the stage is running.
+ * The numbers are given by memoryReport and printed by memorySummary.
+ */
+
+#ifndef MEMORYTRACKER_H
+#define MEMORYTRACKER_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+#include <QMutex>
+#include <QMutexLocker>
+
+/**
+ * Current and peak sizes in bytes.
+ */
+struct MemoryUsage
+{
+    size_t current; /*!< Size in bytes now*/
+    size_t peak; /*!< Maximum size in bytes since the last resetMemoryPeaks*/
+};
+
+/**
+ * Tracked memory of the whole program, of each owner and of each stage.
+ * For a stage the current size is the size when the stage last ended (or now if the stage is running) and the peak is the maximum reached while it was running.
+ */
+struct MemoryReport
+{
+    MemoryUsage total; /*!< Memory tracked for all the owners*/
+    std::map<std::string, MemoryUsage> owners; /*!< Memory of each owner*/
+    std::map<std::string, MemoryUsage> stages; /*!< Memory of each stage*/
+};
+
+/**
+ * Sets the size of the buffers kept by an owner (replaces the previous size). Set 0 when the buffers are released.
+ * @brief setTrackedMemory
+ * @param INPUT : owner name of the owner (e.g. "Buddha/reflectanceField").
+ * @param INPUT : bytes size of the buffers in bytes.
+ */
+void setTrackedMemory(const std::string &owner, size_t bytes);
+
+/**
+ * Returns the number of bytes used by the data of an image (without the header).
+ * @brief matMemorySize
+ * @param INPUT : image image.
+ */
+size_t matMemorySize(const cv::Mat &image);
+
+/**
+ * Returns the memory tracked for all the owners, each owner and each stage.
+ * @brief memoryReport
+ */
+MemoryReport memoryReport();
+
+/**
+ * Returns a text summary of the memory report : total, then the owners and the stages sorted by decreasing peak.
+ * @brief memorySummary
+ */
+std::string memorySummary();
+
+/**
+ * Sets every peak to its current size, so that the peaks of the next job can be measured. Owners and stages whose current size is 0 are removed.
+ * @brief resetMemoryPeaks
+ */
+void resetMemoryPeaks();
+
+class TrackedMemory
+{
+    public:
+
+        /**
+         * Adds a temporary buffer to the memory of an owner until the destruction of the object.
+         * @brief TrackedMemory
+         * @param INPUT : owner name of the owner (e.g. "Relighting::gammaCorrection").
+         * @param INPUT : bytes size of the buffer in bytes.
+         */
+        TrackedMemory(const std::string &owner, size_t bytes);
+
+        /**
+         * Removes the buffer from the memory of its owner.
+         * @brief ~TrackedMemory
+         */
+        ~TrackedMemory();
+
+    private:
+        //The buffer would be removed twice
+        TrackedMemory(const TrackedMemory &);
+        TrackedMemory& operator=(const TrackedMemory &);
+
+        std::string m_owner; /*!< Name of the owner*/
+        size_t m_bytes; /*!< Size of the buffer in bytes*/
+};
+
+class MemoryStage
+{
+    public:
+
+        /**
+         * Starts a stage. The peak of the stage is updated each time the tracked memory changes until the destruction of the object.
+         * Stages of the same name can run at the same time (several jobs) : the stage runs until the last one ends.
+         * @brief MemoryStage
+         * @param INPUT : name name of the stage (e.g. "loadReflectanceField").
+         */
+        MemoryStage(const std::string &name);
+
+        /**
+         * Ends the stage.
+         * @brief ~MemoryStage
+         */
+        ~MemoryStage();
+
+    private:
+        MemoryStage(const MemoryStage &);
+        MemoryStage& operator=(const MemoryStage &);
+
+        std::string m_name; /*!< Name of the stage*/
+};
+
+#endif // MEMORYTRACKER_H
@@ -47,9 +47,11 @@ using namespace cv;
  * @brief LightStageRelighting
  */
 OfficeRoomRelighting::OfficeRoomRelighting(): Relighting(), m_voronoi(new Voronoi()), m_roomType(string()), m_indirectLightPicture(4),
-    m_identificationMethod(QString("Median Energy")), m_optimisationMethod(QString("Disabled")), m_numberOfSamplesInverseCDF(0), m_exposure(0)
+    m_identificationMethod(QString("Median Energy")), m_lightsIdentified(false), m_optimisationMethod(QString("Disabled")), m_numberOfSamplesInverseCDF(0), m_exposure(0),
+    m_maskPyramids(QMap<QString, LabelMapPyramid>()), m_environmentMapPyramid(EnvironmentMapPyramid())
 {
-
+    //The computations of the weights stop when the relighting is cancelled
+    m_voronoi->setCancelToken(&m_cancelled);
 }
 
 /**
@@ -57,22 +59,43 @@ OfficeRoomRelighting::OfficeRoomRelighting(): Relighting(), m_voronoi(new Vorono
   */
 OfficeRoomRelighting::~OfficeRoomRelighting()
 {
+    this->stopWorkerThread();
     delete m_voronoi;
 }
 
 /**
  * Computes the relighting of the object using the office room method.
  * @brief relighting
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the environment map or the images could not be loaded, if the relighting failed or if it has been cancelled.
  */
-void OfficeRoomRelighting::relighting()
+bool OfficeRoomRelighting::relighting()
 {
+    TraceScope traceScope("OfficeRoomRelighting::relighting");
+
     //Sets the room and mask types
     this->setMaskAndRoomTypes();
 
+    //The light sources identified before the start are only used by this relighting
+    bool lightsIdentified = m_lightsIdentified;
+    m_lightsIdentified = false;
+
     /*---Loads the EM---*/
     this->updateProgressWindow(QString("Relighting the " + m_object + " in " + m_environmentMapName), 0);
-    this->loadEnvironmentMap();
-    m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+
+    //The images are scaled and subtracted in memory (prepareReflectanceField) : they cannot be read from a tiled file
+    if(m_outOfCore)
+    {
+        cerr << "The out-of-core relighting is only available for the light stage" << endl;
+        this->updateProgressWindow(QString("Out-of-core relighting not available for the office room"), 100);
+        return EXIT_FAILURE;
+    }
+
+    //Already loaded if the light sources have been identified before the start (the size of the environment map clears the Voronoi diagram)
+    if(!lightsIdentified)
+    {
+        this->loadEnvironmentMap();
+        m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+    }
 
     //Remove indirect light and overlaps between the lights
     if(m_computeBasisMasks)
@@ -89,8 +112,18 @@ void OfficeRoomRelighting::relighting()
         prepareMasks();
     }
 
+    if(!m_environmentMap.data)
+    {
+        this->updateProgressWindow(QString("Environment map not loaded"), 100);
+        return EXIT_FAILURE;
+    }
+
     //Load the reflectance field
-    this->loadReflectanceField();
+    if(this->loadReflectanceField() == EXIT_FAILURE)
+    {
+        this->updateProgressWindow(QString("Images not loaded"), 100);
+        return EXIT_FAILURE;
+    }
 
     if(m_roomType == "bedroom" || m_roomType == "bedroom45")
     {
@@ -101,20 +134,18 @@ void OfficeRoomRelighting::relighting()
         this->prepareReflectanceField_office();
     }
 
-    this->updateProgressWindow(QString("Images loaded"), 25);
+    this->updateTrackedMemory();
 
-    //Mouse parameters used to identified the lights manually
-    MouseParameters mouseParameters;
-    mouseParameters.voronoi = m_voronoi;
-    mouseParameters.windowName = "Lighting condition";
-    mouseParameters.latLongWidth = m_environmentMapWidth;
-    mouseParameters.latLongHeight = m_environmentMapHeight;
-    mouseParameters.isPressed = false;
-    mouseParameters.numberOfLightSourcesAdded = 0;
+    if(this->isCancelled())
+        return EXIT_FAILURE;
+
+    this->updateProgressWindow(QString("Images loaded"), 25);
 
     if(m_identificationMethod == "Manual") //Lights are identified manually
     {
-        this->identifyLightsUser(mouseParameters);      
+        if(!lightsIdentified)
+            this->identifyLightsUser();
+
         this->updateProgressWindow(QString("Voronoi diagram generated"), 50);
     }
     else if(m_identificationMethod == "Inverse CDF")//Lights are identified automatically
@@ -136,76 +167,134 @@ void OfficeRoomRelighting::relighting()
         startingPointArray[n] = 1.0;
     }
 
+    //Parameters of the result in the cache of the results
+    ostringstream parameters;
+    parameters << m_roomType << ";" << m_indirectLightPicture << ";" << m_identificationMethod.toStdString() << ";" << m_masksType.toStdString() << ";"
+               << m_optimisationMethod.toStdString() << ";" << m_numberOfSamplesInverseCDF << ";" << m_computeBasisMasks << ";";
+
+    if(m_pyramidTolerance > 0.0)
+        parameters << "pyramid" << m_pyramidTolerance << ";";
+
+    m_voronoi->writeBasis(parameters);
+
     //Offsets
     int progressBarValue = 50;
     float offset = 0.0;
     for(unsigned int l = 0 ; l<m_numberOfOffsets ; l++)
     {
+        if(this->isCancelled())
+        {
+            delete[] startingPointArray;
+            return EXIT_FAILURE;
+        }
+
         offset = (float) 2.0*l*M_PI/m_numberOfOffsets;
 
-        //Compute the weights of the voronoi diagram
-        if(m_lightType.toStdString() == "Gaussian")
+        //The weights (optimisation included) and the linear combination are read from the cache of the results when they have already been computed
+        QByteArray key = this->resultCacheKey(offset, parameters.str());
+
+        if(this->loadCachedResult(key) == EXIT_SUCCESS)
         {
-            m_voronoi->clearWeights(); //Reinitialise the weights
-            //m_voronoi->computeVoronoiWeightsGaussianOR(environmentMapHDR, offset);
-            m_weightsRGB = m_voronoi->getRGBWeights();
+            progressBarValue += 25/(m_numberOfOffsets);
+            this->updateProgressWindow(QString("Result " + QString::number(l) + " read from the cache"), progressBarValue);
         }
-        else if(m_lightType.toStdString() == "Point")
+        else
         {
-            if(m_identificationMethod == "Masks")//If the masks are used, the voronoi diagram is not needed
-            {
-                m_weightsRGB = this->computeWeightsMasks(m_environmentMap, offset);
-            }
-            else
+            //Compute the weights of the voronoi diagram
+            if(m_lightType.toStdString() == "Gaussian")
             {
                 m_voronoi->clearWeights(); //Reinitialise the weights
-                m_voronoi->computeVoronoiWeightsOR(m_environmentMap, offset);
+                //m_voronoi->computeVoronoiWeightsGaussianOR(environmentMapHDR, offset);
                 m_weightsRGB = m_voronoi->getRGBWeights();
             }
-        }
+            else if(m_lightType.toStdString() == "Point")
+            {
+                if(m_identificationMethod == "Masks")//If the masks are used, the voronoi diagram is not needed
+                {
+                    m_weightsRGB = this->computeWeightsMasks(m_environmentMap, offset);
+                }
+                else if(m_numberOfOffsets >= ROTATION_TABLE_MINIMUM_OFFSETS)
+                {
+                    //The weights of all the offsets are computed once (first offset that is not in the cache), then read in the table
+                    if(!m_voronoi->hasRotationWeightTable(m_environmentMap, ROTATION_TABLE_IMAGES))
+                        m_voronoi->computeRotationWeightTable(m_environmentMap, ROTATION_TABLE_IMAGES);
 
-        progressBarValue += 25/(m_numberOfOffsets);
-        this->updateProgressWindow(QString("Weights computed"), progressBarValue);
+                    m_voronoi->getRotationWeights(offset, m_weightsRGB);
+                }
+                else
+                {
+                    m_voronoi->clearWeights(); //Reinitialise the weights
+                    m_voronoi->computeVoronoiWeightsOR(m_environmentMap, offset);
+                    m_weightsRGB = m_voronoi->getRGBWeights();
+                }
+            }
 
-        //Optimisation process
-        if(m_optimisationMethod == "Original Space")
-        {
-            this->updateProgressWindow(QString("Starting optimisation in original space"), progressBarValue);
+            //The weights are incomplete if the relighting has been cancelled during their computation
+            if(this->isCancelled())
+            {
+                delete[] startingPointArray;
+                return EXIT_FAILURE;
+            }
 
-            bool weightsExist = this->weightsTableOptimisation(l); //l = offset number
+            progressBarValue += 25/(m_numberOfOffsets);
+            this->updateProgressWindow(QString("Weights computed"), progressBarValue);
+
+            //Optimisation process
+            if(m_optimisationMethod == "Original Space")
+            {
+                this->updateProgressWindow(QString("Starting optimisation in original space"), progressBarValue);
+
+                bool weightsExist = this->weightsTableOptimisation(l); //l = offset number
+
+                if(!weightsExist)
+                {
+                    Optimisation optimisation(m_environmentMapName.toStdString(), m_environmentMapWidth, m_environmentMapHeight, m_numberOfComponents,
+                                         m_numberOfLightingConditions, m_indirectLightPicture, offset, m_roomType, m_masksType.toStdString(),m_weightsRGB);
+                    optimisation.setPyramidTolerance(m_pyramidTolerance);
+                    optimisation.environmentMapOptimisation(startingPointArray);
+                    m_weightsRGB = optimisation.getRGBWeights();
+                }
 
-            if(!weightsExist)
+                this->updateProgressWindow(QString("Optimisation done"), progressBarValue);
+            }
+            else if(m_optimisationMethod == "PCA Space")
             {
+                this->updateProgressWindow(QString("Starting optimisation in PCA space"), progressBarValue);
+
                 Optimisation optimisation(m_environmentMapName.toStdString(), m_environmentMapWidth, m_environmentMapHeight, m_numberOfComponents,
-                                     m_numberOfLightingConditions, m_indirectLightPicture, offset, m_roomType, m_masksType.toStdString(),m_weightsRGB);
-                optimisation.environmentMapOptimisation(startingPointArray);
+                                          m_numberOfLightingConditions, m_indirectLightPicture, offset, m_roomType, m_masksType.toStdString(), m_weightsRGB);
+                optimisation.environmentMapPCAOptimisation(startingPointArray);
                 m_weightsRGB = optimisation.getRGBWeights();
+
+                this->updateProgressWindow(QString("Optimisation done"), progressBarValue);
             }
 
-            this->updateProgressWindow(QString("Optimisation done"), progressBarValue);
-        }
-        else if(m_optimisationMethod == "PCA Space")
-        {
-            this->updateProgressWindow(QString("Starting optimisation in PCA space"), progressBarValue);
+            //The optimisation can be long : check the cancel token before computing the result
+            if(this->isCancelled())
+            {
+                delete[] startingPointArray;
+                return EXIT_FAILURE;
+            }
 
-            Optimisation optimisation(m_environmentMapName.toStdString(), m_environmentMapWidth, m_environmentMapHeight, m_numberOfComponents,
-                                      m_numberOfLightingConditions, m_indirectLightPicture, offset, m_roomType, m_masksType.toStdString(), m_weightsRGB);
-            optimisation.environmentMapPCAOptimisation(startingPointArray);
-            m_weightsRGB = optimisation.getRGBWeights();
+            //Normalize the weights
+            normalizeWeightsRGB(m_weightsRGB);
 
-            this->updateProgressWindow(QString("Optimisation done"), progressBarValue);
-        }
+            //Calculate the result
+            if(this->computeFinalRelighting() == EXIT_FAILURE)
+            {
+                this->updateProgressWindow(QString("Relighting failed"), 100);
+                delete[] startingPointArray;
+                return EXIT_FAILURE;
+            }
 
-        //Normalize the weights
-        normalizeWeightsRGB(m_weightsRGB);
+            this->storeCachedResult(key);
+        }
 
         if(m_identificationMethod == "Manual")
         {
            this->saveVoronoiWeights(l);
         }
 
-        //Calculate the result
-        this->computeFinalRelighting();
         this->changeExposure(m_exposure);
         this->rayTraceBackground(offset+M_PI, true, 2.2); //Apply gamma only on background as HDR is used
 
@@ -223,9 +312,14 @@ void OfficeRoomRelighting::relighting()
         osstream.str("");
     }
 
+    if(m_useResultCache)
+        this->updateProgressWindow(this->resultCacheStatistics(), 100);
+
     this->updateProgressWindow(QString("Done"), 100);
 
     delete[] startingPointArray;
+
+    return EXIT_SUCCESS;
 }
 
 /**
@@ -236,9 +330,8 @@ void OfficeRoomRelighting::relighting()
  */
 bool OfficeRoomRelighting::loadReflectanceField()
 {
-    //Only allocate memory if it has not been already allocated
-    if(m_reflectanceField == NULL)
-        m_reflectanceField = new Mat[m_numberOfLightingConditions];
+    TraceScope traceScope("OfficeRoomRelighting::loadReflectanceField", "loading");
+    MemoryStage memoryStage("loadReflectanceField");
 
     string file;
     string extension;
@@ -291,8 +384,8 @@ bool OfficeRoomRelighting::loadReflectanceField()
     }
 
     ostringstream osstream;
+    vector<string> paths(m_numberOfLightingConditions);
 
-    //Load the files
     for(unsigned int i = 0 ; i<m_numberOfLightingConditions ; i++)
     {
        osstream << this->getFolderPath();
@@ -310,34 +403,27 @@ bool OfficeRoomRelighting::loadReflectanceField()
           osstream << "/images/" << file << "0" << i << extension;
        }
 
-       if(extension == ".pfm")
-       {
-           m_reflectanceField[i] = loadPFM(osstream.str());
-
-           if(!m_reflectanceField[i].data)
-           {
-              cerr << "Couldn't open the file : " << osstream.str() << endl;
-              return EXIT_FAILURE;
-           }
+       paths[i] = osstream.str();
+       osstream.str("");
+    }
 
-           m_reflectanceField[i].convertTo(m_reflectanceField[i], CV_32FC3, 1.0/65535.0);
-       }
-       else
-       {
-           //For 16 bits TIF HDR images, use CV_LOAD_IMAGE_ANYDEPTH to load the image correctly (with values between 0 and 65535)
-           m_reflectanceField[i] = imread(osstream.str(), CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_COLOR);
+    //Identity of the reflectance field in the baked pack and in the cache of the results
+    m_sourceImagesSignature = this->sourceImagesSignature(paths, vector<float>());
 
-           if(!m_reflectanceField[i].data)
-           {
-              cerr << "Couldn't open the file : " << osstream.str() << endl;
-              return EXIT_FAILURE;
-           }
+    //The pack of the images is mapped instead of decoding the images when it has already been baked from the same images
+    //The images are modified after the loading (prepareReflectanceField) : the pack holds floats in image major order
+    if(this->mapBakedReflectanceField(file, IMAGE_MAJOR, STORAGE_FLOAT32) == EXIT_SUCCESS)
+        return EXIT_SUCCESS;
 
-           m_reflectanceField[i].convertTo(m_reflectanceField[i], CV_32FC3, 1.0/65535.0);
-       }
+    //Load the files in parallel
+    //For 16 bits TIF HDR images, CV_LOAD_IMAGE_ANYDEPTH loads the image correctly (with values between 0 and 65535)
+    ReflectanceFieldLoader loader(m_reflectanceField);
+    loader.setReadFlags(CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_COLOR);
+    loader.setScale(1.0/65535.0);
+    loader.setProgress(this, 0, 25);
 
-       osstream.str("");
-    }
+    if(loader.load(paths) == EXIT_FAILURE)
+        return EXIT_FAILURE;
 
     //Load the mask
     osstream << this->getFolderPath() << "/images/office_room/" << m_object.toStdString() << "_mask.png";
@@ -352,6 +438,8 @@ bool OfficeRoomRelighting::loadReflectanceField()
 
      m_objectMask.convertTo(m_objectMask, CV_32FC3, 1.0/255.0);
 
+    this->bakeReflectanceField(file, IMAGE_MAJOR, STORAGE_FLOAT32);
+
     return EXIT_SUCCESS;
 }
 
@@ -364,6 +452,8 @@ bool OfficeRoomRelighting::loadReflectanceField()
  */
 bool OfficeRoomRelighting::weightsTableOptimisation(int offset)
 {
+    TraceScope traceScope("OfficeRoomRelighting::weightsTableOptimisation", "optimisation");
+
     bool found = false;
     float *scalingFactors = new float[m_numberOfLightingConditions];
 
@@ -600,6 +690,8 @@ void OfficeRoomRelighting::saveVoronoiWeights(int offset)
  */
 void OfficeRoomRelighting::identifyLightsAutomatically()
 {
+    TraceScope traceScope("OfficeRoomRelighting::identifyLightsAutomatically", "voronoi");
+
     ostringstream osstream;
     int cellNumber = 0;
     int numberOfClusters = 1;
@@ -736,6 +828,8 @@ void OfficeRoomRelighting::identifyLightsAutomatically()
  */
 void OfficeRoomRelighting::identifyMedianEnergy()
 {
+    TraceScope traceScope("OfficeRoomRelighting::identifyMedianEnergy", "voronoi");
+
     ostringstream osstream;
     Mat lightingCondition;
 
@@ -814,13 +908,42 @@ void OfficeRoomRelighting::identifyMedianEnergy()
     m_voronoi->setCellNumberPerPicture(cellNumberPerPicture);
 }
 
+/**
+ * Loads the environment map and identifies the light sources manually on the calling thread (thread of the graphical interface) if the identification is manual.
+ * relighting then uses these light sources.
+ * @brief identifyLightsBeforeStart
+ */
+void OfficeRoomRelighting::identifyLightsBeforeStart()
+{
+    m_lightsIdentified = false;
+
+    if(m_identificationMethod != "Manual")
+        return;
+
+    //The lighting conditions displayed depend on the room
+    this->setMaskAndRoomTypes();
+    this->loadEnvironmentMap();
+    m_voronoi->setEnvironmentMapSize(m_environmentMapWidth, m_environmentMapHeight);
+
+    this->identifyLightsUser();
+    m_lightsIdentified = true;
+}
+
 /**
  * Method to manually select the incoming light directions in the environment map of the office.
  * @brief identifyLightsUser
- * @param INPUT : mouseParameters parameters that are sent to the callback function to manually select light sources.
  */
-void OfficeRoomRelighting::identifyLightsUser(MouseParameters& mouseParameters)
+void OfficeRoomRelighting::identifyLightsUser()
 {
+    //Mouse parameters used to identified the lights manually
+    MouseParameters mouseParameters;
+    mouseParameters.voronoi = m_voronoi;
+    mouseParameters.windowName = "Lighting condition";
+    mouseParameters.latLongWidth = m_environmentMapWidth;
+    mouseParameters.latLongHeight = m_environmentMapHeight;
+    mouseParameters.isPressed = false;
+    mouseParameters.numberOfLightSourcesAdded = 0;
+
 
     Mat lightingCondition;
     ostringstream osstream;
@@ -880,6 +1003,8 @@ void OfficeRoomRelighting::identifyLightsUser(MouseParameters& mouseParameters)
  */
 void OfficeRoomRelighting::prepareBasis_office()
 {
+    TraceScope traceScope("OfficeRoomRelighting::prepareBasis_office");
+
     ostringstream osstream, osstream2;
     Mat lightingCondition;
 
@@ -998,6 +1123,8 @@ void OfficeRoomRelighting::prepareBasis_office()
  */
 void OfficeRoomRelighting::prepareBasis_bedroom()
 {
+    TraceScope traceScope("OfficeRoomRelighting::prepareBasis_bedroom");
+
     ostringstream osstream;
     Mat *lightingConditions = new Mat[m_numberOfLightingConditions];
     Mat darkRoom;
@@ -1090,6 +1217,7 @@ void OfficeRoomRelighting::prepareBasis_bedroom()
  */
 void OfficeRoomRelighting::prepareMasks()
 {
+    TraceScope traceScope("OfficeRoomRelighting::prepareMasks");
 
     ostringstream osstream;
     Mat residualMask, residualMaskNot;
@@ -1157,6 +1285,9 @@ void OfficeRoomRelighting::prepareMasks()
  */
 void OfficeRoomRelighting::prepareReflectanceField_office()
 {
+    TraceScope traceScope("OfficeRoomRelighting::prepareReflectanceField_office", "loading");
+    MemoryStage memoryStage("prepareReflectanceField");
+
     //Set the global scaling factors for the chosen object
     float* globalScalingFactor = new float[m_numberOfLightingConditions];
 
@@ -1195,9 +1326,12 @@ void OfficeRoomRelighting::prepareReflectanceField_office()
     //Multiply each picture of the reflectance field by its scaling factor
     for(unsigned int i = 0 ; i<m_numberOfLightingConditions ; i++)
     {
-       m_reflectanceField[i] *= globalScalingFactor[i];
+       Mat image = m_reflectanceField.image(i);
+       image *= globalScalingFactor[i];
     }
 
+    //The channels and the scaled channels of one picture are held at the same time
+    TrackedMemory channels("OfficeRoomRelighting::prepareReflectanceField", 2*m_reflectanceField.rows()*m_reflectanceField.cols()*3*sizeof(float));
     Mat channel[3], channel32F[3];
 
     //Apply house light scaling factors to pictures
@@ -1210,7 +1344,8 @@ void OfficeRoomRelighting::prepareReflectanceField_office()
 
     for(int i = 5 ; i<=6 ; i++)
     {
-        split(m_reflectanceField[i], channel);
+        Mat image = m_reflectanceField.image(i);
+        split(image, channel);
 
         channel[0].convertTo(channel32F[0], CV_32F);
         channel[1].convertTo(channel32F[1], CV_32F);
@@ -1225,38 +1360,29 @@ void OfficeRoomRelighting::prepareReflectanceField_office()
         channel32F[1].convertTo(channel32F[1], CV_32F);
         channel32F[2].convertTo(channel32F[2], CV_32F);
 
-        merge(channel32F,3,m_reflectanceField[i]);
+        merge(channel32F,3,image);
    }
 
+   Mat indirectLight = m_reflectanceField.image(4);
+
    for(unsigned int i = 0 ; i<m_numberOfLightingConditions ; i++)
    {
        if(i != m_indirectLightPicture)
-           m_reflectanceField[i]-= m_reflectanceField[4];
+       {
+           Mat image = m_reflectanceField.image(i);
+           image -= indirectLight;
+       }
    }
 
-   m_reflectanceField[0]-= m_reflectanceField[1];
-   m_reflectanceField[2]-= m_reflectanceField[3];
+   Mat image0 = m_reflectanceField.image(0), image2 = m_reflectanceField.image(2);
+   image0 -= m_reflectanceField.image(1);
+   image2 -= m_reflectanceField.image(3);
 
    //Set negative values to 0.0
    for(unsigned int k = 0 ; k<m_numberOfLightingConditions ; k++)
    {
-       int width = m_reflectanceField[k].cols;
-       int height = m_reflectanceField[k].rows;
-
-       for(int i = 0 ; i<height ; i++)
-       {
-           for(int j = 0 ; j<width ; j++)
-           {
-               if(m_reflectanceField[k].at<Vec3f>(i,j).val[0]<0)
-                   m_reflectanceField[k].at<Vec3f>(i,j).val[0] = 0.0;
-
-               if(m_reflectanceField[k].at<Vec3f>(i,j).val[1]<0)
-                   m_reflectanceField[k].at<Vec3f>(i,j).val[1] = 0.0;
-
-               if(m_reflectanceField[k].at<Vec3f>(i,j).val[2]<0)
-                   m_reflectanceField[k].at<Vec3f>(i,j).val[2] = 0.0;
-           }
-       }
+       Mat image = m_reflectanceField.image(k);
+       max(image, 0.0, image);
    }
 
    delete[] globalScalingFactor;
@@ -1268,10 +1394,16 @@ void OfficeRoomRelighting::prepareReflectanceField_office()
  */
 void OfficeRoomRelighting::prepareReflectanceField_bedroom()
 {
+    TraceScope traceScope("OfficeRoomRelighting::prepareReflectanceField_bedroom", "loading");
+    MemoryStage memoryStage("prepareReflectanceField");
+
    //The indirect light picture has been stored with +3 stops
+   Mat indirectLight = m_reflectanceField.image(m_indirectLightPicture);
+
    if(m_object != "Bird_bedroom")
-      m_reflectanceField[m_indirectLightPicture] *= pow(2.0,-3.0);
+      indirectLight *= pow(2.0,-3.0);
 
+   TrackedMemory channels("OfficeRoomRelighting::prepareReflectanceField", 2*m_reflectanceField.rows()*m_reflectanceField.cols()*3*sizeof(float));
    Mat channel[3], channel32F[3];
 
    //Apply scaling factor for house lights (picture 11 reflectance field)
@@ -1281,7 +1413,8 @@ void OfficeRoomRelighting::prepareReflectanceField_bedroom()
    scalingFactorLightHouseRGB[1] = 0.7448/0.7153;
    scalingFactorLightHouseRGB[2] = 0.6739/0.5513;
 
-   split(m_reflectanceField[11], channel);
+   Mat houseLights = m_reflectanceField.image(11);
+   split(houseLights, channel);
 
    channel[0].convertTo(channel32F[0], CV_32F);
    channel[1].convertTo(channel32F[1], CV_32F);
@@ -1296,40 +1429,31 @@ void OfficeRoomRelighting::prepareReflectanceField_bedroom()
    channel32F[1].convertTo(channel32F[1], CV_32F);
    channel32F[2].convertTo(channel32F[2], CV_32F);
 
-   merge(channel32F,3,m_reflectanceField[11]);
+   merge(channel32F,3,houseLights);
 
    for(unsigned int i = 0 ; i<m_numberOfLightingConditions ; i++)
    {
         if(i != m_indirectLightPicture)
-            m_reflectanceField[i]-= m_reflectanceField[m_indirectLightPicture];
+        {
+            Mat image = m_reflectanceField.image(i);
+            image -= indirectLight;
+        }
    }
 
    for(unsigned int i = 1 ; i<m_numberOfLightingConditions-1 ; i+=2)
    {
         if(i != m_indirectLightPicture)
-            m_reflectanceField[i] -= m_reflectanceField[i+1];
+        {
+            Mat image = m_reflectanceField.image(i);
+            image -= m_reflectanceField.image(i+1);
+        }
    }
 
     //Set negative values to 0.0
     for(unsigned int k = 0 ; k<m_numberOfLightingConditions ; k++)
     {
-        int width = m_reflectanceField[k].cols;
-        int height = m_reflectanceField[k].rows;
-
-        for(int i = 0 ; i<height ; i++)
-        {
-            for(int j = 0 ; j<width ; j++)
-            {
-                if(m_reflectanceField[k].at<Vec3f>(i,j).val[0]<0)
-                    m_reflectanceField[k].at<Vec3f>(i,j).val[0] = 0.0;
-
-                if(m_reflectanceField[k].at<Vec3f>(i,j).val[1]<0)
-                    m_reflectanceField[k].at<Vec3f>(i,j).val[1] = 0.0;
-
-                if(m_reflectanceField[k].at<Vec3f>(i,j).val[2]<0)
-                    m_reflectanceField[k].at<Vec3f>(i,j).val[2] = 0.0;
-            }
-        }
+        Mat image = m_reflectanceField.image(k);
+        max(image, 0.0, image);
     }
 }
 
@@ -1338,7 +1462,7 @@ void OfficeRoomRelighting::prepareReflectanceField_bedroom()
  * @brief normalizeEnergyBasis
  * @param reflectanceField
  */
-void OfficeRoomRelighting::normalizeEnergyBasis(Mat reflectanceField[])
+void OfficeRoomRelighting::normalizeEnergyBasis(ReflectanceField &reflectanceField)
 {
     Mat currentMask;
     Mat currentLightingCondition;
@@ -1381,7 +1505,10 @@ void OfficeRoomRelighting::normalizeEnergyBasis(Mat reflectanceField[])
     for(unsigned int i = 0 ; i<m_numberOfLightingConditions ; ++i)
     {
         if(i != m_indirectLightPicture)
-           reflectanceField[i] *= 1.0/energy[i];
+        {
+           Mat image = reflectanceField.image(i);
+           image *= 1.0/energy[i];
+        }
     }
 
     delete[] energy;
@@ -1396,6 +1523,9 @@ void OfficeRoomRelighting::normalizeEnergyBasis(Mat reflectanceField[])
  */
 std::vector<std::vector<float> > OfficeRoomRelighting::computeWeightsMasks(Mat &environmentMap, const float offset)
 {
+    TraceScope traceScope("OfficeRoomRelighting::computeWeightsMasks");
+    MemoryStage memoryStage("computeWeights");
+
     float R = 0.0, G = 0.0, B = 0.0;
     float RMask = 0.0, GMask = 0.0, BMask = 0.0;
     std::vector<std::vector<float> > rgbWeights;
@@ -1413,6 +1543,10 @@ std::vector<std::vector<float> > OfficeRoomRelighting::computeWeightsMasks(Mat &
 
     for(unsigned int k = 0 ; k<m_numberOfLightingConditions ; k++)
     {
+        //Each mask is a pass over the environment map : the weights are left incomplete if the relighting is cancelled
+        if(this->isCancelled())
+            return rgbWeights;
+
         //Load the correct mask : residual mask for the dark room (indirect light only)
         osstream << this->getFolderPath();
 
@@ -1430,6 +1564,42 @@ std::vector<std::vector<float> > OfficeRoomRelighting::computeWeightsMasks(Mat &
             osstream << "/lighting_conditions/office_room/" << m_roomType << "/" << m_masksType.toStdString() << "/residualMask.png";
             currentMask = imread(osstream.str(), CV_LOAD_IMAGE_COLOR);
         }
+
+        if(m_pyramidTolerance > 0.0)
+        {
+            //The pyramid of a mask is computed the first time the mask is read
+            QString maskPath = QString::fromStdString(osstream.str());
+
+            if(!m_maskPyramids.contains(maskPath))
+            {
+                Mat labelMap;
+                maskToLabelMap(currentMask, labelMap);
+                m_maskPyramids[maskPath].build(labelMap);
+            }
+
+            const LabelMapPyramid &maskPyramid = m_maskPyramids[maskPath];
+            unsigned int level = maskPyramid.selectLevel(m_pyramidTolerance, jOffset, maskPyramid.getNumberOfLevels()-1);
+
+            if(level > 0)
+            {
+                if(!m_environmentMapPyramid.isBuiltFrom(environmentMap))
+                    m_environmentMapPyramid.build(environmentMap);
+
+                if(level < m_environmentMapPyramid.getNumberOfLevels() && m_environmentMapPyramid.getSums(level).size() == maskPyramid.getLabels(level).size())
+                {
+                    std::vector<PyramidIntegral> integrals;
+                    integrateLabels(m_environmentMapPyramid, maskPyramid, level, jOffset, 1, integrals);
+
+                    rgbWeights[k][0] += integrals[0].sum[0];
+                    rgbWeights[k][1] += integrals[0].sum[1];
+                    rgbWeights[k][2] += integrals[0].sum[2];
+
+                    osstream.str("");
+                    continue;
+                }
+            }
+        }
+
         currentMask.convertTo(currentMask, CV_32FC3); //Convert the matrix to CV_32FC3 to be able to read the values
         osstream.str("");
 
@@ -1540,6 +1710,17 @@ void OfficeRoomRelighting::setExposure(double exposure)
     m_exposure = exposure;
 }
 
+/**
+ * Sets the tolerance of the integration of the weights on the pyramids (see Relighting::setPyramidTolerance) and gives it to the Voronoi diagram (the masks and the optimisation read m_pyramidTolerance).
+ * @brief setPyramidTolerance
+ * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong light source.
+ */
+void OfficeRoomRelighting::setPyramidTolerance(double tolerance)
+{
+    Relighting::setPyramidTolerance(tolerance);
+    m_voronoi->setPyramidTolerance(tolerance);
+}
+
 /**
  * Setter to change the optimisation method for the environment map.
  * @brief setOptimisationMethod
@@ -1601,6 +1782,7 @@ void OfficeRoomRelighting::setRelighting(QString &object, QString &environmentMa
 void OfficeRoomRelighting::clearRelighting()
 {
     m_voronoi->clearVoronoi();
+    m_lightsIdentified = false;
     m_object = QString("");
     m_environmentMapName = QString("");
     m_lightType = QString("");
@@ -1619,6 +1801,8 @@ void OfficeRoomRelighting::clearRelighting()
     m_masksType = QString("");
     m_optimisationMethod = QString("");
     m_numberOfSamplesInverseCDF = 0;
+    m_maskPyramids.clear();
+    m_environmentMapPyramid.clear();
 
 }
 
@@ -1632,5 +1816,4 @@ void OfficeRoomRelighting::updateProgressWindow(QString updateText, int progress
 {
     emit statusUpdate(updateText);
     emit updateProgressBar(progressBarValue);
-    qApp->processEvents(); //Refresh the main window to process the signals
 }
@@ -66,6 +66,7 @@
 #include <QApplication>
 #include <QObject>
 #include <QString>
+#include <QMap>
 
 class OfficeRoomRelighting : public Relighting
 {
@@ -86,8 +87,9 @@ class OfficeRoomRelighting : public Relighting
         /**
          * Computes the relighting of the object using the office room method.
          * @brief relighting
+         * @return EXIT_SUCCESS, or EXIT_FAILURE if the environment map or the images could not be loaded, if the relighting failed or if it has been cancelled.
          */
-        void virtual relighting();
+        bool virtual relighting();
 
         /**
          * Virtual pure function.
@@ -122,9 +124,15 @@ class OfficeRoomRelighting : public Relighting
         /**
          * Method to manually select the incoming light directions in the environment map of the office.
          * @brief identifyLightsUser
-         * @param INPUT : mouseParameters parameters that are sent to the callback function to manually select light sources.
          */
-        void identifyLightsUser(MouseParameters& mouseParameters);
+        void identifyLightsUser();
+
+        /**
+         * Loads the environment map and identifies the light sources manually on the calling thread (thread of the graphical interface) if the identification is manual.
+         * relighting then uses these light sources.
+         * @brief identifyLightsBeforeStart
+         */
+        void virtual identifyLightsBeforeStart();
 
         /**
          * Method that chooses the centroid of the energy as the incoming light direction for each lighting condition.
@@ -167,7 +175,7 @@ class OfficeRoomRelighting : public Relighting
          * @brief normalizeEnergyBasis
          * @param reflectanceField
          */
-        void normalizeEnergyBasis(cv::Mat reflectanceField[]);
+        void normalizeEnergyBasis(ReflectanceField &reflectanceField);
 
         /**
          * Method to compute the weights using the masks.
@@ -212,6 +220,13 @@ class OfficeRoomRelighting : public Relighting
          */
         void setExposure(double exposure);
 
+        /**
+         * Sets the tolerance of the integration of the weights on the pyramids (see Relighting::setPyramidTolerance) and gives it to the Voronoi diagram (the masks and the optimisation read m_pyramidTolerance).
+         * @brief setPyramidTolerance
+         * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong light source.
+         */
+        void virtual setPyramidTolerance(double tolerance);
+
         /**
          * Setter to change the optimisation method for the environment map.
          * @brief setOptimisationMethod
@@ -289,11 +304,14 @@ class OfficeRoomRelighting : public Relighting
         std::string m_roomType;
         unsigned int m_indirectLightPicture; /*!< Number of the picture of the dark room*/
         QString m_identificationMethod; /*!< Method to select light sources*/ //Manual, Median Energy, Inverse CDF, Masks
+        bool m_lightsIdentified; /*!< True if the light sources have been identified by identifyLightsBeforeStart for the next relighting*/
         QString m_masksType; /*!< Type of masks used : adapted to high or low frequency lighting*/
         QString m_optimisationMethod; /*!< Optimisation method*/
         unsigned int m_numberOfSamplesInverseCDF; /*!< Number of samples used in the environment map sampling (see identifyLightsAutomatically)*/
         bool m_computeBasisMasks;
         double m_exposure; /*!< Exposure of the final result*/
+        QMap<QString, LabelMapPyramid> m_maskPyramids; /*!< Pyramids of the masks already read by computeWeightsMasks, by file name*/
+        EnvironmentMapPyramid m_environmentMapPyramid; /*!< Pyramid of the environment map used by computeWeightsMasks*/
 
 };
 
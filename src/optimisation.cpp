@@ -56,6 +56,8 @@ static string roomTypeGlobal;
 static std::vector<std::vector<float> > rgbWeightsGlobal;
 static PCA pcaProjectionMatrix; //PCA of the projection matrix
 static Mat envMapPCASpace;
+static double pyramidToleranceGlobal;
+static std::vector<Vec3d> maskMomentsGlobal; //Number of pixels, sum of the intensities and sum of the squared intensities of each mask (empty if not computed)
 
 /**
  * Default constructor to initialise
@@ -63,7 +65,7 @@ static Mat envMapPCASpace;
  */
 Optimisation::Optimisation(): m_environmentMapName(string("")), m_environmentMapWidth(1024), m_environmentMapHeight(512), m_numberOfComponents(3),
     m_numberOflightingConditions(0), m_indirectLightPicture(0),
-    m_offset(0.0), m_rgbWeights(std::vector<std::vector<float> >())
+    m_offset(0.0), m_rgbWeights(std::vector<std::vector<float> >()), m_pyramidTolerance(0.0)
 {
     this->setGlobalVariables();
 }
@@ -90,7 +92,7 @@ Optimisation::Optimisation(string environmentMapName,
     m_environmentMapName(environmentMapName),
     m_environmentMapWidth(environmentMapWidth), m_environmentMapHeight(environmentMapHeight), m_numberOfComponents(numberOfComponents),
     m_numberOflightingConditions(numberOfLightingConditions), m_indirectLightPicture(indirectLightPicture),
-    m_offset(offset), m_roomType(roomType), m_masksType(masksType), m_rgbWeights(rgbWeights)
+    m_offset(offset), m_roomType(roomType), m_masksType(masksType), m_rgbWeights(rgbWeights), m_pyramidTolerance(0.0)
 {
     this->setGlobalVariables();
 }
@@ -102,6 +104,9 @@ Optimisation::Optimisation(string environmentMapName,
  */
 void Optimisation::environmentMapOptimisation(double startingPointArray[])
 {
+    TraceScope traceScope("Optimisation::environmentMapOptimisation", "optimisation");
+    MemoryStage memoryStage("optimisation");
+
     column_vector startingPoint(m_numberOflightingConditions);
 
     for(unsigned int i = 0 ; i<m_numberOflightingConditions ; i++)
@@ -110,6 +115,10 @@ void Optimisation::environmentMapOptimisation(double startingPointArray[])
 
     }
 
+    //The sums over the masks do not depend on the variables : they are computed once instead of at each evaluation of the function
+    if(m_pyramidTolerance > 0.0)
+        this->computeMaskMoments();
+
     cout << "Starting optimisation" << endl;
     cout << "starting point \n" << startingPoint << endl;
     find_min_box_constrained(lbfgs_search_strategy(10),
@@ -139,6 +148,9 @@ void Optimisation::environmentMapOptimisation(double startingPointArray[])
  */
 void Optimisation::environmentMapPCAOptimisation(double startingPointArray[])
 {
+    TraceScope traceScope("Optimisation::environmentMapPCAOptimisation", "optimisation");
+    MemoryStage memoryStage("optimisation");
+
     this->computePCAMatrix();
 
     column_vector startingPoint(m_numberOflightingConditions);
@@ -179,11 +191,14 @@ void Optimisation::environmentMapPCAOptimisation(double startingPointArray[])
  */
 void Optimisation::computePCAMatrix()
 {
+    TraceScope traceScope("Optimisation::computePCAMatrix", "optimisation");
+
     ostringstream osstream;
 
     //Variables are along the columns
     Rect boundingBox(0,0,numberOflightingConditionsGlobal,environmentMapHeightGlobal*environmentMapWidthGlobal);
     Mat projectionMatrix(boundingBox.size(),CV_32F);
+    TrackedMemory projectionMatrixMemory("Optimisation::computePCAMatrix", matMemorySize(projectionMatrix));
     Mat currentMask;
 
     float weightR = 0.0, weightG = 0.0, weightB = 0.0;
@@ -195,11 +210,7 @@ void Optimisation::computePCAMatrix()
     {
 
         //Load the correct mask : residual mask for the dark room (indirect light only)
-        #if defined(__APPLE__) && defined(__MACH__)
-            osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-        #else
-            osstream << qApp->applicationDirPath().toStdString();
-        #endif
+        osstream << dataRootPath();
 
         if(k != indirectLightPictureGlobal)
         {
@@ -261,16 +272,13 @@ void Optimisation::computePCAMatrix()
     envMapPCASpace = Mat(boundingBox.size(), CV_32F);
     float R = 0.0, G = 0.0, B = 0.0;
 
-    #if defined(__APPLE__) && defined(__MACH__)
-        osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-    #else
-        osstream << qApp->applicationDirPath().toStdString();
-    #endif
+    osstream << dataRootPath();
 
     osstream << "/environment_maps/" <<environmentMapNameGlobal << ".pfm";
 
 
     Mat environmentMap = loadPFM(osstream.str());
+    TrackedMemory environmentMapMemory("Optimisation::computePCAMatrix", matMemorySize(environmentMap) + matMemorySize(environmentMapIntensity));
     osstream.str("");
 
     // Fills
@@ -318,6 +326,111 @@ void Optimisation::setGlobalVariables()
     rgbWeightsGlobal = m_rgbWeights;
     roomTypeGlobal = m_roomType;
     masksTypeGlobal = m_masksType;
+    pyramidToleranceGlobal = m_pyramidTolerance;
+    maskMomentsGlobal = std::vector<Vec3d>();
+}
+
+/**
+ * Sets the tolerance of the pyramids of the environment map and of the masks (see environmentMapPyramid.h). When it is positive, the sums of the environment map over each mask
+ * (number of pixels, intensity and squared intensity) are computed once by environmentMapOptimisation : the function to optimise does not read the images any more.
+ * The sums are integrated at the coarsest level of the pyramids whose fraction of the solid angle given to a wrong mask is below the tolerance (full resolution otherwise).
+ * @brief setPyramidTolerance
+ * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong mask (0 : disabled).
+ */
+void Optimisation::setPyramidTolerance(double tolerance)
+{
+    m_pyramidTolerance = tolerance;
+    pyramidToleranceGlobal = tolerance;
+    maskMomentsGlobal = std::vector<Vec3d>();
+}
+
+/**
+ * Method that computes the number of pixels, the sum of the intensities and the sum of the squared intensities of the rotated environment map over each mask.
+ * @brief computeMaskMoments
+ */
+void Optimisation::computeMaskMoments()
+{
+    TraceScope traceScope("Optimisation::computeMaskMoments", "optimisation");
+
+    ostringstream osstream;
+    osstream << dataRootPath();
+    osstream << "/environment_maps/" <<environmentMapNameGlobal << ".pfm";
+
+    Mat environmentMap = loadPFM(osstream.str());
+    TrackedMemory environmentMapMemory("computeMaskMoments", matMemorySize(environmentMap));
+    osstream.str("");
+
+    int width = environmentMap.cols;
+    int height = environmentMap.rows;
+    int jOffset = floor(offsetGlobal*environmentMapWidthGlobal/(2.0*M_PI));
+
+    EnvironmentMapPyramid environmentMapPyramid;
+    environmentMapPyramid.build(environmentMap);
+
+    maskMomentsGlobal.assign(numberOflightingConditionsGlobal, Vec3d(0.0, 0.0, 0.0));
+
+    for(unsigned int k = 0 ; k<numberOflightingConditionsGlobal ; k++)
+    {
+        //Load the correct mask : residual mask for the dark room (indirect light only)
+        osstream << dataRootPath();
+        if(k != indirectLightPictureGlobal)
+        {
+            //Type of mask
+            if(k<10)
+                osstream << "/lighting_conditions/office_room/" << roomTypeGlobal << "/" << masksTypeGlobal << "/condition_mask0" << k << ".png";
+            else
+                osstream << "/lighting_conditions/office_room/" << roomTypeGlobal << "/" << masksTypeGlobal << "/condition_mask" << k << ".png";
+        }
+        else
+        {
+            osstream << "/lighting_conditions/office_room/" << roomTypeGlobal << "/" << masksTypeGlobal << "/residualMask.png";
+        }
+
+        Mat labelMap;
+        maskToLabelMap(imread(osstream.str(), CV_LOAD_IMAGE_COLOR), labelMap);
+        osstream.str("");
+
+        if(labelMap.cols != environmentMap.cols || labelMap.rows != environmentMap.rows)
+        {
+            cerr << "The mask " << k << " does not have the size of the environment map" << endl;
+            continue;
+        }
+
+        LabelMapPyramid maskPyramid;
+        maskPyramid.build(labelMap);
+
+        unsigned int level = maskPyramid.selectLevel(pyramidToleranceGlobal, jOffset, environmentMapPyramid.getNumberOfLevels()-1);
+
+        if(level > 0)
+        {
+            std::vector<PyramidIntegral> integrals;
+            integrateLabels(environmentMapPyramid, maskPyramid, level, jOffset, 1, integrals);
+
+            maskMomentsGlobal[k] = Vec3d(integrals[0].count, (integrals[0].sum[0]+integrals[0].sum[1]+integrals[0].sum[2])/3.0, integrals[0].squaredIntensity);
+            continue;
+        }
+
+        //Full resolution
+        for(int i = 0 ; i<height ; i++)
+        {
+            double solidAngle = sin((float) M_PI*i/height);
+
+            for(int j = 0 ; j<width ; j++)
+            {
+                if(labelMap.at<int>(i,j) != 0)
+                    continue;
+
+                int jModulus = (((j+jOffset) % width) + width) % width;
+                const Vec3f &pixel = environmentMap.at<Vec3f>(i,jModulus);
+
+                if(isnan(pixel[0]) && isnan(pixel[1]) && isnan(pixel[2])) //Values in the environment map could be NaN.
+                    continue;
+
+                double intensity = solidAngle*((isnan(pixel[0]) ? 0.0 : pixel[0]) + (isnan(pixel[1]) ? 0.0 : pixel[1]) + (isnan(pixel[2]) ? 0.0 : pixel[2]))/3.0;
+                maskMomentsGlobal[k] += Vec3d(1.0, intensity, intensity*intensity);
+            }
+        }
+    }
 }
 
 /**
@@ -399,6 +512,8 @@ std::vector<std::vector<float> > Optimisation::getRGBWeights()
  */
 double functionToOptimise(const column_vector &variablesVector)
 {
+    TraceScope traceScope("functionToOptimise", "optimisation");
+
     float R = 0.0, G = 0.0, B = 0.0, intensityEnvMap = 0.0;
     float RMask = 0.0, GMask = 0.0, BMask = 0.0;
     float intensityWeights = 0.0;
@@ -409,15 +524,30 @@ double functionToOptimise(const column_vector &variablesVector)
     double* variables = new double[numberOfVariables];
     double result = 0.0;
 
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    if(!maskMomentsGlobal.empty())
+    {
+        //Sum over the pixels p of mask k of (x*w-I(p))^2 = N*x^2*w^2 - 2*x*w*sum(I) + sum(I^2)
+        for(unsigned int k = 0 ; k<numberOfVariables && k<maskMomentsGlobal.size() ; k++)
+        {
+            double x = variablesVector(k);
+            intensityWeights = (rgbWeightsGlobal[k][0]+rgbWeightsGlobal[k][1]+rgbWeightsGlobal[k][2])/3.0;
+
+            result += maskMomentsGlobal[k][0]*x*x*intensityWeights*intensityWeights - 2.0*x*intensityWeights*maskMomentsGlobal[k][1] + maskMomentsGlobal[k][2];
+        }
+
+        delete[] variables;
+
+        //The rounding errors can make the sum slightly negative
+        return sqrt(std::max(result, 0.0));
+    }
+
+    osstream << dataRootPath();
        osstream << "/environment_maps/" <<environmentMapNameGlobal << ".pfm";
 
 
+    //The environment map is read again at each evaluation of the function
     Mat environmentMap = loadPFM(osstream.str());
+    TrackedMemory environmentMapMemory("functionToOptimise", matMemorySize(environmentMap));
     osstream.str("");
 
 
@@ -432,11 +562,7 @@ double functionToOptimise(const column_vector &variablesVector)
     {
 
         //Load the correct mask : residual mask for the dark room (indirect light only)
-        #if defined(__APPLE__) && defined(__MACH__)
-            osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-        #else
-            osstream << qApp->applicationDirPath().toStdString();
-        #endif
+        osstream << dataRootPath();
         if(k != indirectLightPictureGlobal)
         {
             //Type of mask
@@ -502,6 +628,8 @@ double functionToOptimise(const column_vector &variablesVector)
  */
 double functionToOptimisePCASpace(const column_vector &variablesVector)
 {
+    TraceScope traceScope("functionToOptimisePCASpace", "optimisation");
+
     float RMask = 0.0, GMask = 0.0, BMask = 0.0;
     float intensityWeights = 0.0;
     Mat currentMask;
@@ -523,11 +651,7 @@ double functionToOptimisePCASpace(const column_vector &variablesVector)
     {
 
         //Load the correct mask : residual mask for the dark room (indirect light only)
-        #if defined(__APPLE__) && defined(__MACH__)
-            osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-        #else
-            osstream << qApp->applicationDirPath().toStdString();
-        #endif
+        osstream << dataRootPath();
 
         if(k != indirectLightPictureGlobal)
         {
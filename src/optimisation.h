@@ -59,6 +59,10 @@
 #include <QApplication>
 
 #include "PFMReadWrite.h"
+#include "loadFiles.h"
+#include "trace.h"
+#include "memoryTracker.h"
+#include "environmentMapPyramid.h"
 
 //Column Vector used with dlib library
 typedef dlib::matrix<double,0,1> column_vector;
@@ -113,6 +117,21 @@ class Optimisation
          */
         void computePCAMatrix();
 
+        /**
+         * Sets the tolerance of the pyramids of the environment map and of the masks (see environmentMapPyramid.h). When it is positive, the sums of the environment map over each mask
+         * (number of pixels, intensity and squared intensity) are computed once by environmentMapOptimisation : the function to optimise does not read the images any more.
+         * The sums are integrated at the coarsest level of the pyramids whose fraction of the solid angle given to a wrong mask is below the tolerance (full resolution otherwise).
+         * @brief setPyramidTolerance
+         * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong mask (0 : disabled).
+         */
+        void setPyramidTolerance(double tolerance);
+
+        /**
+         * Method that computes the number of pixels, the sum of the intensities and the sum of the squared intensities of the rotated environment map over each mask.
+         * @brief computeMaskMoments
+         */
+        void computeMaskMoments();
+
         /**
          * Method that sets the global variables required for the function to optimise.
          * @brief setGlobalVariables
@@ -179,6 +198,7 @@ class Optimisation
         std::string m_roomType; /*!< Type of room used : office or bedroom*/
         std::string m_masksType; /*!< Type of mask used : adapted to high or low frequency lighting*/
         std::vector<std::vector<float> > m_rgbWeights; /*!< RGB weights of each lighting condition*/
+        double m_pyramidTolerance; /*!< Tolerance of the pyramids of the environment map and of the masks (0 : disabled)*/
 
 
 };
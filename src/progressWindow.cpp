@@ -47,7 +47,8 @@
 ProgressWindow::ProgressWindow(QWidget *parent) :
     QDialog(parent),
     m_gridLayout(new QGridLayout()), m_progressBar(new QProgressBar(this)), m_scrollBar(new QScrollBar()),
-    m_textArea(new QPlainTextEdit()), m_imageResult(new QLabel()), m_closeButton(new QPushButton("Close"))
+    m_textArea(new QPlainTextEdit()), m_imageResult(new QLabel()), m_closeButton(new QPushButton("Close")),
+    m_cancelButton(new QPushButton("Cancel"))
 {
     buildWindow();
 }
@@ -63,6 +64,7 @@ ProgressWindow::~ProgressWindow()
     delete m_textArea;
     delete m_imageResult;
     delete m_closeButton;
+    delete m_cancelButton;
     delete m_gridLayout;
 
 }
@@ -83,6 +85,7 @@ void ProgressWindow::buildWindow()
     m_gridLayout->addWidget(m_imageResult, 0,0,2,1);
     m_gridLayout->addWidget(m_progressBar, 0,1);
     m_gridLayout->addWidget(m_textArea,1,1);
+    m_gridLayout->addWidget(m_cancelButton, 2,0);
     m_gridLayout->addWidget(m_closeButton, 2,1);
 
     m_progressBar->setMinimum(0);
@@ -91,6 +94,7 @@ void ProgressWindow::buildWindow()
     this->setLayout(m_gridLayout);
 
     QObject::connect(m_closeButton, SIGNAL(clicked()), this, SLOT(close()));
+    QObject::connect(m_cancelButton, SIGNAL(clicked()), this, SIGNAL(cancelRequested()));
 }
 
 /**
@@ -75,7 +75,12 @@ class ProgressWindow : public QDialog
         void buildWindow();
     
     signals:
-    
+        /**
+         * Qt signal emitted when the cancel button is clicked.
+         * @brief cancelRequested
+         */
+        void cancelRequested();
+
     public slots:
         /**
          * Qt slot that adds text to the text area.
@@ -123,6 +128,7 @@ class ProgressWindow : public QDialog
         QPlainTextEdit* m_textArea; /*!< Text area in which the text is displayed*/
         QLabel* m_imageResult; /*!< QLabel that displays an image*/
         QPushButton* m_closeButton; /*!< Button to close the window*/
+        QPushButton* m_cancelButton; /*!< Button to cancel the running relighting*/
 };
 
 #endif // PROGRESSWINDOW_H
@@ -0,0 +1,707 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file reflectanceField.cpp
+ * \brief Container that stores all the images of a reflectance field in a single allocation.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The images of the reflectance field are stored in one OpenCV matrix. Two layouts are available :
+ * IMAGE_MAJOR stores the images one after the other (each image is contiguous),
+ * PIXEL_MAJOR stores all the lighting conditions of a pixel one after the other (the relit value of a pixel is a contiguous dot product).
+ */
+
+#include "reflectanceField.h"
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Converts stored values to floats.
+ * @brief dequantizeValues
+ * @param INPUT : data stored values.
+ * @param INPUT : storage type of the stored values.
+ * @param INPUT : numberOfValues number of values to convert.
+ * @param OUTPUT : values the converted values.
+ */
+static void dequantizeValues(const uchar* data, reflectanceFieldStorage storage, int numberOfValues, float* values)
+{
+    int k = 0;
+
+    if(storage == STORAGE_UINT8)
+    {
+#if CV_SSE2
+        __m128i zero = _mm_setzero_si128();
+
+        for( ; k<=numberOfValues-16 ; k += 16)
+        {
+            __m128i bytes = _mm_loadu_si128((const __m128i*) (data+k));
+            __m128i low = _mm_unpacklo_epi8(bytes, zero);
+            __m128i high = _mm_unpackhi_epi8(bytes, zero);
+
+            _mm_storeu_ps(values+k, _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)));
+            _mm_storeu_ps(values+k+4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)));
+            _mm_storeu_ps(values+k+8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)));
+            _mm_storeu_ps(values+k+12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)));
+        }
+#endif
+        for( ; k<numberOfValues ; ++k)
+        {
+            values[k] = data[k];
+        }
+    }
+    else if(storage == STORAGE_FLOAT16)
+    {
+        const unsigned short* halfs = (const unsigned short*) data;
+
+#if defined(__F16C__)
+        for( ; k<=numberOfValues-4 ; k += 4)
+        {
+            _mm_storeu_ps(values+k, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*) (halfs+k))));
+        }
+#endif
+        for( ; k<numberOfValues ; ++k)
+        {
+            values[k] = halfToFloat(halfs[k]);
+        }
+    }
+    else
+    {
+        memcpy(values, data, numberOfValues*sizeof(float));
+    }
+}
+
+/**
+ * Default constructor of the ReflectanceField class. Creates an empty reflectance field.
+ * @brief ReflectanceField
+ */
+ReflectanceField::ReflectanceField(): m_data(Mat()), m_layout(IMAGE_MAJOR), m_storage(STORAGE_FLOAT32), m_scales(std::vector<float>()),
+    m_quantizationErrors(std::vector<float>()), m_maxValues(std::vector<float>()), m_numberOfImages(0), m_rows(0), m_cols(0), m_version(0), m_memoryOwner(std::string())
+{
+
+}
+
+/**
+ * Destructor of the ReflectanceField class.
+ */
+ReflectanceField::~ReflectanceField()
+{
+    if(!m_memoryOwner.empty())
+        setTrackedMemory(m_memoryOwner, 0);
+}
+
+/**
+ * Allocates the reflectance field with 32 bits floats storage. The memory is only reallocated if the size, the number of images, the layout or the storage changes.
+ * @brief create
+ * @param INPUT : numberOfImages number of images (lighting conditions) in the reflectance field.
+ * @param INPUT : rows height of the images.
+ * @param INPUT : cols width of the images.
+ * @param INPUT : layout layout of the data in memory.
+ */
+void ReflectanceField::create(unsigned int numberOfImages, int rows, int cols, reflectanceFieldLayout layout)
+{
+    m_numberOfImages = numberOfImages;
+    m_rows = rows;
+    m_cols = cols;
+    m_layout = layout;
+    m_storage = STORAGE_FLOAT32;
+    m_scales.assign(m_numberOfImages, 1.0f);
+    m_quantizationErrors.assign(m_numberOfImages, 0.0f);
+    m_maxValues.clear();
+    m_version++;
+
+    //External memory (attach) is never written by create
+    if(m_data.data && !m_data.refcount)
+        m_data.release();
+
+    //One allocation for all the images. Mat::create does nothing if the size and type did not change
+    if(m_layout == IMAGE_MAJOR)
+    {
+        m_data.create(m_numberOfImages, m_rows*m_cols, CV_32FC3);
+    }
+    else
+    {
+        m_data.create(m_rows*m_cols, m_numberOfImages, CV_32FC3);
+    }
+
+    this->updateTrackedMemory();
+}
+
+/**
+ * Uses values stored in external memory (e.g. a mapped file) as the reflectance field. The values are not copied.
+ * The memory must remain valid until the reflectance field is released or created again.
+ * @brief attach
+ * @param INPUT : data values of the reflectance field (matrix of the layout with the type of the storage, without padding).
+ * @param INPUT : numberOfImages number of images (lighting conditions) in the reflectance field.
+ * @param INPUT : rows height of the images.
+ * @param INPUT : cols width of the images.
+ * @param INPUT : layout layout of the data in memory.
+ * @param INPUT : storage type of the values.
+ * @param INPUT : scales scale factor of each image (STORAGE_UINT8).
+ * @param INPUT : quantizationErrors quantization error of each image.
+ */
+void ReflectanceField::attach(uchar* data, unsigned int numberOfImages, int rows, int cols, reflectanceFieldLayout layout, reflectanceFieldStorage storage,
+                              const vector<float> &scales, const vector<float> &quantizationErrors)
+{
+    m_numberOfImages = numberOfImages;
+    m_rows = rows;
+    m_cols = cols;
+    m_layout = layout;
+    m_storage = storage;
+    m_scales = scales;
+    m_quantizationErrors = quantizationErrors;
+    m_maxValues.clear();
+    m_version++;
+
+    //Header on the external memory : OpenCV does not own (nor free) the values
+    if(m_layout == IMAGE_MAJOR)
+    {
+        m_data = Mat(m_numberOfImages, m_rows*m_cols, storageType(m_storage), data);
+    }
+    else
+    {
+        m_data = Mat(m_rows*m_cols, m_numberOfImages, storageType(m_storage), data);
+    }
+
+    this->updateTrackedMemory();
+}
+
+/**
+ * Releases the memory of the reflectance field.
+ * @brief release
+ */
+void ReflectanceField::release()
+{
+    m_data.release();
+    m_storage = STORAGE_FLOAT32;
+    m_scales.clear();
+    m_quantizationErrors.clear();
+    m_maxValues.clear();
+    m_version++;
+    m_numberOfImages = 0;
+    m_rows = 0;
+    m_cols = 0;
+
+    this->updateTrackedMemory();
+}
+
+/**
+ * Returns true if the reflectance field has not been allocated.
+ * @brief empty
+ */
+bool ReflectanceField::empty() const
+{
+    return m_data.empty();
+}
+
+/**
+ * Returns image i of the reflectance field as a CV_32FC3 image.
+ * With the IMAGE_MAJOR layout and 32 bits floats storage the returned matrix is a header on the data of the reflectance field : modifying it modifies the reflectance field.
+ * Otherwise the returned matrix is a copy.
+ * @brief image
+ * @param INPUT : i number of the image.
+ * @return the image i.
+ */
+Mat ReflectanceField::image(unsigned int i) const
+{
+    if(m_layout == IMAGE_MAJOR && m_storage == STORAGE_FLOAT32)
+    {
+        return m_data.row(i).reshape(3, m_rows);
+    }
+    else
+    {
+        //The image is strided or quantized : it has to be copied
+        Mat result(m_rows, m_cols, CV_32FC3);
+        loadImage(m_data, m_storage, i, result.ptr<float>());
+
+        return result;
+    }
+}
+
+/**
+ * Copies an image in the slot i of the reflectance field. The image is converted to floats and multiplied by scale.
+ * @brief setImage
+ * @param INPUT : i number of the image.
+ * @param INPUT : image 3 channels image with the size of the reflectance field.
+ * @param INPUT : scale scale factor applied during the conversion to floats.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the image does not have the correct size.
+ */
+bool ReflectanceField::setImage(unsigned int i, const Mat &image, double scale)
+{
+    if(this->decodeImage(i, image, scale) == EXIT_FAILURE)
+        return EXIT_FAILURE;
+
+    m_maxValues.clear();
+    m_version++;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Converts an image to floats multiplied by scale in the slot i of the reflectance field.
+ * Unlike setImage, the cached maxima and the version are not updated so that different images can be decoded concurrently.
+ * @brief decodeImage
+ * @param INPUT : i number of the image.
+ * @param INPUT : image 3 channels image with the size of the reflectance field.
+ * @param INPUT : scale scale factor applied during the conversion to floats.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the image does not have the correct size.
+ */
+bool ReflectanceField::decodeImage(unsigned int i, const Mat &image, double scale)
+{
+    if(i >= m_numberOfImages || image.rows != m_rows || image.cols != m_cols || image.channels() != 3)
+    {
+        cerr << "Image " << i << " does not match the size of the reflectance field" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if(m_layout == IMAGE_MAJOR && m_storage == STORAGE_FLOAT32)
+    {
+        //The header has the correct size and type : the image is converted directly in the reflectance field
+        Mat destination = this->image(i);
+        image.convertTo(destination, CV_32F, scale);
+    }
+    else
+    {
+        Mat image32F;
+        image.convertTo(image32F, CV_32F, scale);
+
+        storeImage(m_data, m_storage, i, image32F.ptr<float>());
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Decodes an 8 bits image in the slot i of the reflectance field through a look-up table : value = lut[byte].
+ * Unlike setImage, the cached maxima and the version are not updated so that different images can be decoded concurrently.
+ * @brief decodeImage
+ * @param INPUT : i number of the image.
+ * @param INPUT : image CV_8UC3 image with the size of the reflectance field.
+ * @param INPUT : lut 256 values of the look-up table.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the image does not have the correct size or type.
+ */
+bool ReflectanceField::decodeImage(unsigned int i, const Mat &image, const vector<float> &lut)
+{
+    if(i >= m_numberOfImages || image.rows != m_rows || image.cols != m_cols || image.type() != CV_8UC3 || lut.size() != 256)
+    {
+        cerr << "Image " << i << " does not match the size of the reflectance field" << endl;
+        return EXIT_FAILURE;
+    }
+
+    int valuesPerRow = 3*m_cols;
+    const float* table = &lut[0];
+
+    //The image is decoded directly in the reflectance field when the values are stored as floats
+    //Otherwise it is decoded in a temporary buffer and quantized
+    Mat image32F;
+    if(m_layout == IMAGE_MAJOR && m_storage == STORAGE_FLOAT32)
+        image32F = this->image(i);
+    else
+        image32F.create(m_rows, m_cols, CV_32FC3);
+
+    for(int r = 0 ; r<m_rows ; ++r)
+    {
+        const uchar* src = image.ptr<uchar>(r);
+        float* dst = image32F.ptr<float>(r);
+
+        for(int k = 0 ; k<valuesPerRow ; ++k)
+        {
+            dst[k] = table[src[k]];
+        }
+    }
+
+    if(m_layout != IMAGE_MAJOR || m_storage != STORAGE_FLOAT32)
+        storeImage(m_data, m_storage, i, image32F.ptr<float>());
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Changes the layout of the reflectance field in memory (transposition of the data).
+ * @brief setLayout
+ * @param INPUT : layout new layout.
+ */
+void ReflectanceField::setLayout(reflectanceFieldLayout layout)
+{
+    if(layout == m_layout)
+        return;
+
+    if(!m_data.empty())
+    {
+        //The values are held twice during the transposition
+        Mat transposed;
+        TrackedMemory transposition(m_memoryOwner.empty() ? "ReflectanceField::setLayout" : m_memoryOwner + "/setLayout", memorySize());
+
+        transpose(m_data, transposed);
+        m_data = transposed;
+    }
+
+    this->updateTrackedMemory();
+
+    m_layout = layout;
+}
+
+/**
+ * Changes the type used to store the values of the reflectance field.
+ * The maximum and RMS quantization errors compared to the previous storage are computed and printed.
+ * @brief setStorage
+ * @param INPUT : storage new storage.
+ */
+void ReflectanceField::setStorage(reflectanceFieldStorage storage)
+{
+    if(storage == m_storage)
+        return;
+
+    if(m_data.empty())
+    {
+        m_storage = storage;
+        return;
+    }
+
+    Mat data(m_data.rows, m_data.cols, storageType(storage));
+    vector<float> values(3*m_rows*m_cols);
+    TrackedMemory conversion(m_memoryOwner.empty() ? "ReflectanceField::setStorage" : m_memoryOwner + "/setStorage", matMemorySize(data));
+    vector<float> previousErrors(m_quantizationErrors);
+
+    double squaredError = 0.0;
+    float maxError = 0.0;
+
+    for(unsigned int i = 0 ; i<m_numberOfImages ; ++i)
+    {
+        loadImage(m_data, m_storage, i, &values[0]);
+        squaredError += storeImage(data, storage, i, &values[0]);
+        maxError = max(maxError, m_quantizationErrors[i]);
+
+        //The errors of successive conversions add up
+        m_quantizationErrors[i] += previousErrors[i];
+    }
+
+    size_t previousSize = memorySize();
+
+    m_data = data;
+    m_storage = storage;
+    m_maxValues.clear();
+    m_version++;
+
+    this->updateTrackedMemory();
+
+    cerr << "Reflectance field storage : " << previousSize/(1024*1024) << " MB -> " << memorySize()/(1024*1024) << " MB" << endl;
+    cerr << "Quantization error : max " << maxError << " - RMS " << sqrt(squaredError/values.size()/m_numberOfImages) << endl;
+}
+
+/**
+ * Converts stored values to floats (the scale factor of STORAGE_UINT8 is not applied).
+ * @brief dequantize
+ * @param INPUT : data pointer returned by imageRow or pixel.
+ * @param INPUT : numberOfValues number of values to convert.
+ * @param OUTPUT : values the converted values.
+ */
+void ReflectanceField::dequantize(const uchar* data, int numberOfValues, float* values) const
+{
+    dequantizeValues(data, m_storage, numberOfValues, values);
+}
+
+/**
+ * Returns a pointer on pixel c of row r of image i (the row contains 3*cols values in BGR order). Only valid with the IMAGE_MAJOR layout.
+ * @brief imageRow
+ */
+const uchar* ReflectanceField::imageRow(unsigned int i, int r, int c) const
+{
+    return m_data.ptr(i) + (r*m_cols+c)*m_data.elemSize();
+}
+
+/**
+ * Returns a pointer on the lighting conditions of pixel (r,c) (3*numberOfImages values in BGR order). Only valid with the PIXEL_MAJOR layout.
+ * @brief pixel
+ */
+const uchar* ReflectanceField::pixel(int r, int c) const
+{
+    return m_data.ptr(r*m_cols+c);
+}
+
+/**
+ * Getter that returns the layout of the reflectance field.
+ * @brief getLayout
+ */
+reflectanceFieldLayout ReflectanceField::getLayout() const
+{
+    return m_layout;
+}
+
+/**
+ * Getter that returns the storage of the reflectance field.
+ * @brief getStorage
+ */
+reflectanceFieldStorage ReflectanceField::getStorage() const
+{
+    return m_storage;
+}
+
+/**
+ * Getter that returns the factor that converts the stored values of image i to radiance (1.0 except for STORAGE_UINT8).
+ * @brief getScale
+ */
+float ReflectanceField::getScale(unsigned int i) const
+{
+    return m_scales[i];
+}
+
+/**
+ * Returns the maximum absolute value of channel c (BGR order) of image i. The maxima are computed the first time they are requested after the reflectance field is modified by create, setImage or setStorage.
+ * @brief maxValue
+ * @param INPUT : i number of the image.
+ * @param INPUT : c channel (0 : blue, 1 : green, 2 : red).
+ */
+float ReflectanceField::maxValue(unsigned int i, int c) const
+{
+    if(m_maxValues.empty())
+    {
+        m_maxValues.assign(3*m_numberOfImages, 0.0f);
+
+        for(unsigned int k = 0 ; k<m_numberOfImages ; ++k)
+        {
+            Mat currentImage = this->image(k);
+            const float* values = currentImage.ptr<float>();
+
+            for(int v = 0 ; v<3*m_rows*m_cols ; ++v)
+            {
+                m_maxValues[3*k+v%3] = max(m_maxValues[3*k+v%3], (float) fabs(values[v]));
+            }
+        }
+    }
+
+    return m_maxValues[3*i+c];
+}
+
+/**
+ * Getter that returns the maximum absolute quantization error of image i compared to 32 bits floats.
+ * @brief getQuantizationError
+ */
+float ReflectanceField::getQuantizationError(unsigned int i) const
+{
+    return m_quantizationErrors[i];
+}
+
+/**
+ * Getter that returns the number of images of the reflectance field.
+ * @brief getNumberOfImages
+ */
+unsigned int ReflectanceField::getNumberOfImages() const
+{
+    return m_numberOfImages;
+}
+
+/**
+ * Getter that returns the height of the images.
+ * @brief rows
+ */
+int ReflectanceField::rows() const
+{
+    return m_rows;
+}
+
+/**
+ * Getter that returns the width of the images.
+ * @brief cols
+ */
+int ReflectanceField::cols() const
+{
+    return m_cols;
+}
+
+/**
+ * Getter that returns a counter incremented each time the values of the reflectance field are replaced by create, setImage, setStorage or release.
+ * @brief getVersion
+ */
+unsigned int ReflectanceField::getVersion() const
+{
+    return m_version;
+}
+
+/**
+ * Returns the size in bytes of the reflectance field.
+ * @brief memorySize
+ */
+size_t ReflectanceField::memorySize() const
+{
+    return m_data.total()*m_data.elemSize();
+}
+
+/**
+ * Getter that returns the matrix of the values of the reflectance field (layout and type of the storage).
+ * @brief getData
+ */
+const Mat &ReflectanceField::getData() const
+{
+    return m_data;
+}
+
+/**
+ * Sets the owner under which the memory of the reflectance field is tracked (see memoryTracker.h). The memory is not tracked without an owner.
+ * The values in external memory (attach) are not counted : they belong to the mapped file.
+ * @brief setMemoryOwner
+ * @param INPUT : owner name of the owner (e.g. "Plant/reflectanceField"), empty to stop tracking.
+ */
+void ReflectanceField::setMemoryOwner(const std::string &owner)
+{
+    if(owner == m_memoryOwner)
+        return;
+
+    if(!m_memoryOwner.empty())
+        setTrackedMemory(m_memoryOwner, 0);
+
+    m_memoryOwner = owner;
+    this->updateTrackedMemory();
+}
+
+/**
+ * Gives the current size of the values to the memory tracker.
+ * @brief updateTrackedMemory
+ */
+void ReflectanceField::updateTrackedMemory()
+{
+    if(m_memoryOwner.empty())
+        return;
+
+    //A matrix without reference counter is a header on external memory
+    setTrackedMemory(m_memoryOwner, m_data.refcount ? memorySize() : 0);
+}
+
+/**
+ * Returns the OpenCV type of the elements of a storage.
+ * @brief storageType
+ * @param INPUT : storage type used to store the values.
+ * @return CV_32FC3, CV_16UC3 or CV_8UC3.
+ */
+int ReflectanceField::storageType(reflectanceFieldStorage storage)
+{
+    if(storage == STORAGE_FLOAT16)
+        return CV_16UC3;
+    else if(storage == STORAGE_UINT8)
+        return CV_8UC3;
+
+    return CV_32FC3;
+}
+
+/**
+ * Reads image i of data (stored with storage) as floats, scale factor included.
+ * @brief loadImage
+ */
+void ReflectanceField::loadImage(const Mat &data, reflectanceFieldStorage storage, unsigned int i, float* values) const
+{
+    int numberOfPixels = m_rows*m_cols;
+
+    if(m_layout == IMAGE_MAJOR)
+    {
+        dequantizeValues(data.ptr(i), storage, 3*numberOfPixels, values);
+    }
+    else
+    {
+        //The lighting condition i of each pixel is strided
+        for(int p = 0 ; p<numberOfPixels ; ++p)
+        {
+            dequantizeValues(data.ptr(p) + i*data.elemSize(), storage, 3, values+3*p);
+        }
+    }
+
+    if(m_scales[i] != 1.0f)
+    {
+        for(int k = 0 ; k<3*numberOfPixels ; ++k)
+        {
+            values[k] *= m_scales[i];
+        }
+    }
+}
+
+/**
+ * Writes the float values of image i in data (stored with storage). Computes the scale factor and the quantization error of the image.
+ * @brief storeImage
+ * @return the sum of the squared quantization errors of the image.
+ */
+double ReflectanceField::storeImage(Mat &data, reflectanceFieldStorage storage, unsigned int i, const float* values)
+{
+    int numberOfValues = 3*m_rows*m_cols;
+    float scale = 1.0f;
+
+    //8 bits integers : the range of the image is mapped to [0:255]
+    if(storage == STORAGE_UINT8)
+    {
+        float maxValue = 0.0f;
+
+        for(int k = 0 ; k<numberOfValues ; ++k)
+        {
+            maxValue = max(maxValue, values[k]);
+        }
+
+        if(maxValue > 0.0f)
+            scale = maxValue/255.0f;
+    }
+
+    double squaredError = 0.0;
+    float maxError = 0.0f;
+
+    for(int k = 0 ; k<numberOfValues ; ++k)
+    {
+        int p = k/3, c = k%3;
+        uchar* destination = (m_layout == IMAGE_MAJOR) ? data.ptr(i) + p*data.elemSize() : data.ptr(p) + i*data.elemSize();
+        float storedValue = values[k];
+
+        if(storage == STORAGE_UINT8)
+        {
+            uchar quantizedValue = saturate_cast<uchar>(values[k]/scale);
+            destination[c] = quantizedValue;
+            storedValue = quantizedValue*scale;
+        }
+        else if(storage == STORAGE_FLOAT16)
+        {
+            unsigned short halfValue = floatToHalf(values[k]);
+            ((unsigned short*) destination)[c] = halfValue;
+            storedValue = halfToFloat(halfValue);
+        }
+        else
+        {
+            ((float*) destination)[c] = values[k];
+        }
+
+        float error = fabs(storedValue - values[k]);
+        squaredError += error*error;
+        maxError = max(maxError, error);
+    }
+
+    m_scales[i] = scale;
+    m_quantizationErrors[i] = maxError;
+
+    return squaredError;
+}
@@ -0,0 +1,316 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file reflectanceField.h
+ * \brief Container that stores all the images of a reflectance field in a single allocation.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The images of the reflectance field are stored in one OpenCV matrix. Two layouts are available :
+ * IMAGE_MAJOR stores the images one after the other (each image is contiguous),
+ * PIXEL_MAJOR stores all the lighting conditions of a pixel one after the other (the relit value of a pixel is a contiguous dot product).
+ *
+ * The values can be stored as 32 bits floats, 16 bits half floats or 8 bits integers with one scale factor per image.
+ * The reflectance field is always loaded and prepared as 32 bits floats, the compact storages are applied before the relighting.
+ */
+
+#ifndef REFLECTANCEFIELD_H
+#define REFLECTANCEFIELD_H
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "mathsFunctions.h"
+#include "memoryTracker.h"
+
+#define SOURCE_SIGNATURE_SIZE 20 //Size in bytes of the signature (SHA-1) of the source of a reflectance field saved on disk
+
+enum reflectanceFieldLayout{ IMAGE_MAJOR, PIXEL_MAJOR};
+enum reflectanceFieldStorage{ STORAGE_FLOAT32, STORAGE_FLOAT16, STORAGE_UINT8};
+
+class ReflectanceField
+{
+    public:
+
+        /**
+         * Default constructor of the ReflectanceField class. Creates an empty reflectance field.
+         * @brief ReflectanceField
+         */
+        ReflectanceField();
+
+        /**
+         * Destructor of the ReflectanceField class.
+         */
+        ~ReflectanceField();
+
+        /**
+         * Allocates the reflectance field with 32 bits floats storage. The memory is only reallocated if the size, the number of images, the layout or the storage changes
+         * or if the values are in external memory (attach).
+         * @brief create
+         * @param INPUT : numberOfImages number of images (lighting conditions) in the reflectance field.
+         * @param INPUT : rows height of the images.
+         * @param INPUT : cols width of the images.
+         * @param INPUT : layout layout of the data in memory.
+         */
+        void create(unsigned int numberOfImages, int rows, int cols, reflectanceFieldLayout layout = IMAGE_MAJOR);
+
+        /**
+         * Releases the memory of the reflectance field.
+         * @brief release
+         */
+        void release();
+
+        /**
+         * Uses values stored in external memory (e.g. a mapped file) as the reflectance field. The values are not copied.
+         * The memory must remain valid until the reflectance field is released or created again.
+         * @brief attach
+         * @param INPUT : data values of the reflectance field (matrix of the layout with the type of the storage, without padding).
+         * @param INPUT : numberOfImages number of images (lighting conditions) in the reflectance field.
+         * @param INPUT : rows height of the images.
+         * @param INPUT : cols width of the images.
+         * @param INPUT : layout layout of the data in memory.
+         * @param INPUT : storage type of the values.
+         * @param INPUT : scales scale factor of each image (STORAGE_UINT8).
+         * @param INPUT : quantizationErrors quantization error of each image.
+         */
+        void attach(uchar* data, unsigned int numberOfImages, int rows, int cols, reflectanceFieldLayout layout, reflectanceFieldStorage storage,
+                    const std::vector<float> &scales, const std::vector<float> &quantizationErrors);
+
+        /**
+         * Returns true if the reflectance field has not been allocated.
+         * @brief empty
+         */
+        bool empty() const;
+
+        /**
+         * Returns image i of the reflectance field as a CV_32FC3 image.
+         * With the IMAGE_MAJOR layout and 32 bits floats storage the returned matrix is a header on the data of the reflectance field : modifying it modifies the reflectance field.
+         * Otherwise the returned matrix is a copy.
+         * @brief image
+         * @param INPUT : i number of the image.
+         * @return the image i.
+         */
+        cv::Mat image(unsigned int i) const;
+
+        /**
+         * Copies an image in the slot i of the reflectance field. The image is converted to floats and multiplied by scale.
+         * @brief setImage
+         * @param INPUT : i number of the image.
+         * @param INPUT : image 3 channels image with the size of the reflectance field.
+         * @param INPUT : scale scale factor applied during the conversion to floats.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the image does not have the correct size.
+         */
+        bool setImage(unsigned int i, const cv::Mat &image, double scale = 1.0);
+
+        /**
+         * Decodes an 8 bits image in the slot i of the reflectance field through a look-up table : value = lut[byte].
+         * Used to remove the gamma of 8 bits images in the same pass as the conversion to floats.
+         * Unlike setImage, the cached maxima and the version are not updated so that different images can be decoded concurrently.
+         * It must only be used to fill a reflectance field that has just been created.
+         * @brief decodeImage
+         * @param INPUT : i number of the image.
+         * @param INPUT : image CV_8UC3 image with the size of the reflectance field.
+         * @param INPUT : lut 256 values of the look-up table.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the image does not have the correct size or type.
+         */
+        bool decodeImage(unsigned int i, const cv::Mat &image, const std::vector<float> &lut);
+
+        /**
+         * Converts an image to floats multiplied by scale in the slot i of the reflectance field.
+         * Unlike setImage, the cached maxima and the version are not updated so that different images can be decoded concurrently.
+         * It must only be used to fill a reflectance field that has just been created.
+         * @brief decodeImage
+         * @param INPUT : i number of the image.
+         * @param INPUT : image 3 channels image with the size of the reflectance field.
+         * @param INPUT : scale scale factor applied during the conversion to floats.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the image does not have the correct size.
+         */
+        bool decodeImage(unsigned int i, const cv::Mat &image, double scale);
+
+        /**
+         * Changes the layout of the reflectance field in memory (transposition of the data).
+         * @brief setLayout
+         * @param INPUT : layout new layout.
+         */
+        void setLayout(reflectanceFieldLayout layout);
+
+        /**
+         * Changes the type used to store the values of the reflectance field.
+         * The maximum and RMS quantization errors compared to the previous storage are computed and printed.
+         * @brief setStorage
+         * @param INPUT : storage new storage.
+         */
+        void setStorage(reflectanceFieldStorage storage);
+
+        /**
+         * Converts stored values to floats (the scale factor of STORAGE_UINT8 is not applied).
+         * @brief dequantize
+         * @param INPUT : data pointer returned by imageRow or pixel.
+         * @param INPUT : numberOfValues number of values to convert.
+         * @param OUTPUT : values the converted values.
+         */
+        void dequantize(const uchar* data, int numberOfValues, float* values) const;
+
+        /**
+         * Returns a pointer on pixel c of row r of image i (the row contains 3*cols values in BGR order). Only valid with the IMAGE_MAJOR layout.
+         * @brief imageRow
+         */
+        const uchar* imageRow(unsigned int i, int r, int c = 0) const;
+
+        /**
+         * Returns a pointer on the lighting conditions of pixel (r,c) (3*numberOfImages values in BGR order). Only valid with the PIXEL_MAJOR layout.
+         * @brief pixel
+         */
+        const uchar* pixel(int r, int c) const;
+
+        /**
+         * Getter that returns the layout of the reflectance field.
+         * @brief getLayout
+         */
+        reflectanceFieldLayout getLayout() const;
+
+        /**
+         * Getter that returns the storage of the reflectance field.
+         * @brief getStorage
+         */
+        reflectanceFieldStorage getStorage() const;
+
+        /**
+         * Getter that returns the factor that converts the stored values of image i to radiance (1.0 except for STORAGE_UINT8).
+         * @brief getScale
+         */
+        float getScale(unsigned int i) const;
+
+        /**
+         * Returns the maximum absolute value of channel c (BGR order) of image i. The maxima are computed the first time they are requested after the reflectance field is modified by create, setImage or setStorage.
+         * @brief maxValue
+         * @param INPUT : i number of the image.
+         * @param INPUT : c channel (0 : blue, 1 : green, 2 : red).
+         */
+        float maxValue(unsigned int i, int c) const;
+
+        /**
+         * Getter that returns the maximum absolute quantization error of image i compared to 32 bits floats.
+         * @brief getQuantizationError
+         */
+        float getQuantizationError(unsigned int i) const;
+
+        /**
+         * Getter that returns the number of images of the reflectance field.
+         * @brief getNumberOfImages
+         */
+        unsigned int getNumberOfImages() const;
+
+        /**
+         * Getter that returns the height of the images.
+         * @brief rows
+         */
+        int rows() const;
+
+        /**
+         * Getter that returns the width of the images.
+         * @brief cols
+         */
+        int cols() const;
+
+        /**
+         * Getter that returns a counter incremented each time the values of the reflectance field are replaced by create, setImage, setStorage or release.
+         * @brief getVersion
+         */
+        unsigned int getVersion() const;
+
+        /**
+         * Returns the size in bytes of the reflectance field.
+         * @brief memorySize
+         */
+        size_t memorySize() const;
+
+        /**
+         * Getter that returns the matrix of the values of the reflectance field (layout and type of the storage).
+         * @brief getData
+         */
+        const cv::Mat &getData() const;
+
+        /**
+         * Sets the owner under which the memory of the reflectance field is tracked (see memoryTracker.h). The memory is not tracked without an owner.
+         * The values in external memory (attach) are not counted : they belong to the mapped file.
+         * @brief setMemoryOwner
+         * @param INPUT : owner name of the owner (e.g. "Plant/reflectanceField"), empty to stop tracking.
+         */
+        void setMemoryOwner(const std::string &owner);
+
+        /**
+         * Returns the OpenCV type of the elements of a storage.
+         * @brief storageType
+         * @param INPUT : storage type used to store the values.
+         * @return CV_32FC3, CV_16UC3 or CV_8UC3.
+         */
+        static int storageType(reflectanceFieldStorage storage);
+
+    private:
+        /**
+         * Reads image i of data (stored with storage) as floats, scale factor included.
+         * @brief loadImage
+         */
+        void loadImage(const cv::Mat &data, reflectanceFieldStorage storage, unsigned int i, float* values) const;
+
+        /**
+         * Writes the float values of image i in data (stored with storage). Computes the scale factor and the quantization error of the image.
+         * @brief storeImage
+         * @return the sum of the squared quantization errors of the image.
+         */
+        double storeImage(cv::Mat &data, reflectanceFieldStorage storage, unsigned int i, const float* values);
+
+        /**
+         * Gives the current size of the values to the memory tracker.
+         * @brief updateTrackedMemory
+         */
+        void updateTrackedMemory();
+
+        cv::Mat m_data; /*!< IMAGE_MAJOR : numberOfImages x (rows*cols) matrix. PIXEL_MAJOR : (rows*cols) x numberOfImages matrix. Elements are CV_32FC3, CV_16UC3 (half floats) or CV_8UC3*/
+        reflectanceFieldLayout m_layout; /*!< Layout of the data in memory*/
+        reflectanceFieldStorage m_storage; /*!< Type of the stored values*/
+        std::vector<float> m_scales; /*!< Scale factor of each image (STORAGE_UINT8)*/
+        std::vector<float> m_quantizationErrors; /*!< Maximum absolute quantization error of each image*/
+        mutable std::vector<float> m_maxValues; /*!< Cache of the maximum absolute value of each channel of each image. m_maxValues[3*i+c], empty if not computed*/
+        unsigned int m_numberOfImages; /*!< Number of images (lighting conditions)*/
+        int m_rows; /*!< Height of the images*/
+        int m_cols; /*!< Width of the images*/
+        unsigned int m_version; /*!< Counter of the modifications of the values*/
+        std::string m_memoryOwner; /*!< Owner of the memory in the memory tracker (not tracked if empty)*/
+};
+
+#endif // REFLECTANCEFIELD_H
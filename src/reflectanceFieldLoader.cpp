@@ -0,0 +1,293 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file reflectanceFieldLoader.cpp
+ * \brief Loads the images of a reflectance field in parallel.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The images are read and converted to floats by a thread pool, each image directly in its slot of the reflectance field.
+ * The number of images being decoded at the same time is bounded by a semaphore.
+ */
+
+#include "reflectanceFieldLoader.h"
+#include "relighting.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Constructor of the ReflectanceFieldLoader class.
+ * @brief ReflectanceFieldLoader
+ * @param OUTPUT : reflectanceField reflectance field filled by the loader.
+ * @param INPUT : maxImagesInFlight maximum number of images decoded at the same time (0 : twice the number of cores).
+ */
+ReflectanceFieldLoader::ReflectanceFieldLoader(ReflectanceField &reflectanceField, int maxImagesInFlight):
+    m_reflectanceField(reflectanceField), m_paths(vector<string>()), m_failures(vector<unsigned char>()),
+    m_imagesInFlight(maxImagesInFlight > 0 ? maxImagesInFlight : 2*QThread::idealThreadCount()),
+    m_readFlags(CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_COLOR), m_scale(1.0), m_lut(vector<float>()),
+    m_relighting(NULL), m_progressBegin(0), m_progressEnd(0), m_imagesDone(0), m_progressReported(0)
+{
+
+}
+
+/**
+ * Destructor of the ReflectanceFieldLoader class.
+ */
+ReflectanceFieldLoader::~ReflectanceFieldLoader()
+{
+
+}
+
+/**
+ * Sets the flags given to imread (PFM files are read with loadPFM).
+ * @brief setReadFlags
+ * @param INPUT : readFlags flags of imread (default CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_COLOR).
+ */
+void ReflectanceFieldLoader::setReadFlags(int readFlags)
+{
+    m_readFlags = readFlags;
+}
+
+/**
+ * Sets the scale factor applied during the conversion to floats. Not used if a look-up table is set.
+ * @brief setScale
+ * @param INPUT : scale scale factor.
+ */
+void ReflectanceFieldLoader::setScale(double scale)
+{
+    m_scale = scale;
+}
+
+/**
+ * Sets a look-up table used to convert 8 bits images to floats (e.g. gamma removal). An empty table disables the look-up table.
+ * @brief setLookUpTable
+ * @param INPUT : lut 256 values of the look-up table.
+ */
+void ReflectanceFieldLoader::setLookUpTable(const vector<float> &lut)
+{
+    m_lut = lut;
+}
+
+/**
+ * Sets the relighting whose progress window is updated as the images are decoded. NULL disables the progress.
+ * The progress bar goes from progressBegin (no image decoded) to progressEnd (all the images decoded).
+ * @brief setProgress
+ * @param INPUT : relighting relighting that owns the progress window.
+ * @param INPUT : progressBegin value of the progress bar before the loading.
+ * @param INPUT : progressEnd value of the progress bar after the loading.
+ */
+void ReflectanceFieldLoader::setProgress(Relighting *relighting, int progressBegin, int progressEnd)
+{
+    m_relighting = relighting;
+    m_progressBegin = progressBegin;
+    m_progressEnd = progressEnd;
+}
+
+/**
+ * Creates the reflectance field with the size of the first image that can be read and loads all the images in parallel.
+ * @brief load
+ * @param INPUT : paths paths of the images. paths[i] is loaded in the slot i of the reflectance field.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if at least one image could not be loaded (the files are printed).
+ */
+bool ReflectanceFieldLoader::load(const vector<string> &paths)
+{
+    TraceScope traceScope("ReflectanceFieldLoader::load", "loading");
+
+    m_paths = paths;
+    m_failures.assign(m_paths.size(), 0);
+    m_imagesDone.store(0);
+    m_progressReported.store(m_progressBegin);
+
+    if(m_paths.empty())
+        return EXIT_FAILURE;
+
+    //The first image that can be read gives the size of the reflectance field
+    //The images before it are failures : they are reported with the others at the end
+    Mat image;
+    unsigned int first = 0;
+
+    for( ; first<m_paths.size() ; first++)
+    {
+        image = this->readImage(m_paths[first]);
+
+        if(image.data)
+            break;
+
+        m_failures[first] = 1;
+        this->imageDone();
+    }
+
+    if(!image.data)
+    {
+        cerr << "None of the " << m_paths.size() << " images could be opened, the first one is : " << m_paths[0] << endl;
+        return EXIT_FAILURE;
+    }
+
+    //All the images are stored in one allocation
+    m_reflectanceField.create(m_paths.size(), image.rows, image.cols);
+
+    if(this->convertImage(first, image) == EXIT_FAILURE)
+        m_failures[first] = 1;
+
+    image.release();
+    this->imageDone();
+
+    //The calling thread waits for a free place in the queue before starting the next image
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+
+    for(unsigned int i = first+1 ; i<m_paths.size() ; i++)
+    {
+        m_imagesInFlight.acquire();
+        pool.start(new DecodeImageTask(*this, i));
+    }
+
+    pool.waitForDone();
+
+    bool success = EXIT_SUCCESS;
+
+    for(unsigned int i = 0 ; i<m_paths.size() ; i++)
+    {
+        if(m_failures[i])
+        {
+            cerr << "Couldn't open the file : " << m_paths[i] << endl;
+            success = EXIT_FAILURE;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Reads and converts image i in its slot, then frees a place in the queue. Called by the threads of the pool.
+ * @brief decodeImage
+ * @param INPUT : i number of the image.
+ */
+void ReflectanceFieldLoader::decodeImage(unsigned int i)
+{
+    TraceScope traceScope("ReflectanceFieldLoader::decodeImage", "loading");
+
+    Mat image = this->readImage(m_paths[i]);
+
+    if(!image.data || this->convertImage(i, image) == EXIT_FAILURE)
+        m_failures[i] = 1;
+
+    //The decoded image is freed before the place is given to the next image
+    image.release();
+    m_imagesInFlight.release();
+
+    this->imageDone();
+}
+
+/**
+ * Getter that returns the paths of the images that could not be loaded by the last call to load.
+ * @brief getFailures
+ */
+vector<string> ReflectanceFieldLoader::getFailures() const
+{
+    vector<string> failures;
+
+    for(unsigned int i = 0 ; i<m_failures.size() ; i++)
+    {
+        if(m_failures[i])
+            failures.push_back(m_paths[i]);
+    }
+
+    return failures;
+}
+
+/**
+ * Reads an image (imread or loadPFM depending on the extension).
+ * @brief readImage
+ */
+Mat ReflectanceFieldLoader::readImage(const string &path) const
+{
+    if(path.size() > 4 && path.compare(path.size()-4, 4, ".pfm") == 0)
+        return loadPFM(path);
+
+    return imread(path, m_readFlags);
+}
+
+/**
+ * Converts an image to floats in slot i of the reflectance field.
+ * @brief convertImage
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the image does not have the size or the type of the reflectance field.
+ */
+bool ReflectanceFieldLoader::convertImage(unsigned int i, const Mat &image)
+{
+    if(!m_lut.empty())
+        return m_reflectanceField.decodeImage(i, image, m_lut);
+
+    return m_reflectanceField.decodeImage(i, image, m_scale);
+}
+
+/**
+ * Counts one more image decoded (or failed) and updates the progress window when the value of the progress bar changes.
+ * Called by the threads of the pool.
+ * @brief imageDone
+ */
+void ReflectanceFieldLoader::imageDone()
+{
+    int imagesDone = m_imagesDone.fetchAndAddOrdered(1) + 1;
+
+    if(m_relighting == NULL)
+        return;
+
+    int progress = m_progressBegin + (m_progressEnd - m_progressBegin)*imagesDone/(int) m_paths.size();
+    int reported = m_progressReported.load();
+
+    //One update per value of the progress bar : only the thread that changes the value reports it
+    if(progress > reported && m_progressReported.testAndSetOrdered(reported, progress))
+    {
+        m_relighting->updateProgressWindow(QString("Images loaded : " + QString::number(imagesDone) + "/" + QString::number(m_paths.size())), progress);
+    }
+}
+
+/**
+ * Constructor of the DecodeImageTask class.
+ * @brief DecodeImageTask
+ * @param INPUT : loader loader that owns the images.
+ * @param INPUT : i number of the image.
+ */
+DecodeImageTask::DecodeImageTask(ReflectanceFieldLoader &loader, unsigned int i): QRunnable(), m_loader(loader), m_image(i)
+{
+
+}
+
+/**
+ * Loads the image.
+ * @brief run
+ */
+void DecodeImageTask::run()
+{
+    m_loader.decodeImage(m_image);
+}
@@ -0,0 +1,197 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file reflectanceFieldLoader.h
+ * \brief Loads the images of a reflectance field in parallel.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The images are read and converted to floats by a thread pool (QThreadPool), each image directly in its slot of the reflectance field.
+ * The number of images being decoded at the same time is bounded by a semaphore so that the memory used by the decoded images stays bounded.
+ * A file that cannot be read does not stop the loading of the other files : all the failures are reported at the end.
+ * The progress of the loading is reported in the progress window of the relighting as the images are decoded.
+ */
+
+#ifndef REFLECTANCEFIELDLOADER_H
+#define REFLECTANCEFIELDLOADER_H
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv/highgui.h>
+
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QString>
+#include <QThread>
+#include <QThreadPool>
+
+#include "reflectanceField.h"
+#include "PFMReadWrite.h"
+#include "trace.h"
+
+//The relighting includes the loader : it is only declared here
+class Relighting;
+
+class ReflectanceFieldLoader
+{
+    public:
+
+        /**
+         * Constructor of the ReflectanceFieldLoader class.
+         * @brief ReflectanceFieldLoader
+         * @param OUTPUT : reflectanceField reflectance field filled by the loader.
+         * @param INPUT : maxImagesInFlight maximum number of images decoded at the same time (0 : twice the number of cores).
+         */
+        ReflectanceFieldLoader(ReflectanceField &reflectanceField, int maxImagesInFlight = 0);
+
+        /**
+         * Destructor of the ReflectanceFieldLoader class.
+         */
+        ~ReflectanceFieldLoader();
+
+        /**
+         * Sets the flags given to imread (PFM files are read with loadPFM).
+         * @brief setReadFlags
+         * @param INPUT : readFlags flags of imread (default CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_COLOR).
+         */
+        void setReadFlags(int readFlags);
+
+        /**
+         * Sets the scale factor applied during the conversion to floats. Not used if a look-up table is set.
+         * @brief setScale
+         * @param INPUT : scale scale factor.
+         */
+        void setScale(double scale);
+
+        /**
+         * Sets a look-up table used to convert 8 bits images to floats (e.g. gamma removal). An empty table disables the look-up table.
+         * @brief setLookUpTable
+         * @param INPUT : lut 256 values of the look-up table.
+         */
+        void setLookUpTable(const std::vector<float> &lut);
+
+        /**
+         * Sets the relighting whose progress window is updated as the images are decoded. NULL disables the progress.
+         * The progress bar goes from progressBegin (no image decoded) to progressEnd (all the images decoded).
+         * @brief setProgress
+         * @param INPUT : relighting relighting that owns the progress window.
+         * @param INPUT : progressBegin value of the progress bar before the loading.
+         * @param INPUT : progressEnd value of the progress bar after the loading.
+         */
+        void setProgress(Relighting *relighting, int progressBegin, int progressEnd);
+
+        /**
+         * Creates the reflectance field with the size of the first image that can be read and loads all the images in parallel.
+         * @brief load
+         * @param INPUT : paths paths of the images. paths[i] is loaded in the slot i of the reflectance field.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if at least one image could not be loaded (the files are printed).
+         */
+        bool load(const std::vector<std::string> &paths);
+
+        /**
+         * Reads and converts image i in its slot, then frees a place in the queue. Called by the threads of the pool.
+         * @brief decodeImage
+         * @param INPUT : i number of the image.
+         */
+        void decodeImage(unsigned int i);
+
+        /**
+         * Getter that returns the paths of the images that could not be loaded by the last call to load.
+         * @brief getFailures
+         */
+        std::vector<std::string> getFailures() const;
+
+    private:
+        /**
+         * Reads an image (imread or loadPFM depending on the extension).
+         * @brief readImage
+         */
+        cv::Mat readImage(const std::string &path) const;
+
+        /**
+         * Converts an image to floats in slot i of the reflectance field.
+         * @brief convertImage
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the image does not have the size or the type of the reflectance field.
+         */
+        bool convertImage(unsigned int i, const cv::Mat &image);
+
+        /**
+         * Counts one more image decoded (or failed) and updates the progress window when the value of the progress bar changes.
+         * Called by the threads of the pool.
+         * @brief imageDone
+         */
+        void imageDone();
+
+        ReflectanceField &m_reflectanceField; /*!< Reflectance field filled by the loader*/
+        std::vector<std::string> m_paths; /*!< Paths of the images*/
+        std::vector<unsigned char> m_failures; /*!< m_failures[i] is 1 if image i could not be loaded. Each thread only writes its own images*/
+        QSemaphore m_imagesInFlight; /*!< Free places in the queue of images being decoded*/
+        int m_readFlags; /*!< Flags of imread*/
+        double m_scale; /*!< Scale factor of the conversion to floats*/
+        std::vector<float> m_lut; /*!< Look-up table of the 8 bits values (empty if not used)*/
+        Relighting *m_relighting; /*!< Relighting whose progress window is updated (NULL if not used)*/
+        int m_progressBegin; /*!< Value of the progress bar before the loading*/
+        int m_progressEnd; /*!< Value of the progress bar after the loading*/
+        QAtomicInt m_imagesDone; /*!< Number of images decoded or failed*/
+        QAtomicInt m_progressReported; /*!< Last value of the progress bar sent to the progress window*/
+};
+
+/**
+ * Task of the thread pool that loads one image of the reflectance field.
+ */
+class DecodeImageTask : public QRunnable
+{
+    public:
+        /**
+         * Constructor of the DecodeImageTask class.
+         * @brief DecodeImageTask
+         * @param INPUT : loader loader that owns the images.
+         * @param INPUT : i number of the image.
+         */
+        DecodeImageTask(ReflectanceFieldLoader &loader, unsigned int i);
+
+        /**
+         * Loads the image.
+         * @brief run
+         */
+        virtual void run();
+
+    private:
+        ReflectanceFieldLoader &m_loader; /*!< Loader that owns the images*/
+        unsigned int m_image; /*!< Number of the image*/
+};
+
+#endif // REFLECTANCEFIELDLOADER_H
@@ -0,0 +1,280 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file reflectanceFieldPack.cpp
+ * \brief Baked reflectance field : a file that is mapped in memory instead of decoding the images.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * A pack contains the linear values of a reflectance field and the mask of the object.
+ * It is written once (bake) then mapped in memory (map) with a private mapping : the reflectance field is a header on the mapped file.
+ */
+
+#include "reflectanceFieldPack.h"
+
+using namespace std;
+using namespace cv;
+
+//Number of unsigned int in the header
+#define PACK_HEADER_SIZE 9
+
+/**
+ * Returns the smallest multiple of alignment greater or equal to offset.
+ * @brief alignOffset
+ */
+static unsigned long long alignOffset(unsigned long long offset, unsigned long long alignment)
+{
+    return (offset + alignment - 1)/alignment*alignment;
+}
+
+/**
+ * Default constructor of the ReflectanceFieldPack class. No file is mapped.
+ * @brief ReflectanceFieldPack
+ */
+ReflectanceFieldPack::ReflectanceFieldPack(): m_file(), m_mapping(NULL), m_sourceSignature()
+{
+
+}
+
+/**
+ * Destructor of the ReflectanceFieldPack class. Unmaps the file.
+ */
+ReflectanceFieldPack::~ReflectanceFieldPack()
+{
+    this->unmap();
+}
+
+/**
+ * Writes a reflectance field and the mask of the object in a pack file.
+ * @brief bake
+ * @param INPUT : filePath path of the file.
+ * @param INPUT : reflectanceField reflectance field (any layout and storage).
+ * @param INPUT : mask mask of the object.
+ * @param INPUT : sourceSignature signature of the images the reflectance field has been loaded from (see Relighting::sourceImagesSignature).
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be written.
+ */
+bool ReflectanceFieldPack::bake(const string &filePath, const ReflectanceField &reflectanceField, const Mat &mask, const string &sourceSignature)
+{
+    const Mat &data = reflectanceField.getData();
+
+    if(data.empty() || !data.isContinuous())
+    {
+        cerr << "No reflectance field to bake" << endl;
+        return EXIT_FAILURE;
+    }
+
+    Mat maskContinuous = mask.isContinuous() ? mask : mask.clone();
+    unsigned int numberOfImages = reflectanceField.getNumberOfImages();
+
+    unsigned int header[PACK_HEADER_SIZE] = {PACK_VERSION, numberOfImages, (unsigned int) reflectanceField.rows(), (unsigned int) reflectanceField.cols(),
+                                             (unsigned int) reflectanceField.getLayout(), (unsigned int) reflectanceField.getStorage(),
+                                             (unsigned int) maskContinuous.rows, (unsigned int) maskContinuous.cols, (unsigned int) maskContinuous.type()};
+
+    string signature = sourceSignature;
+    signature.resize(SOURCE_SIGNATURE_SIZE, '\0');
+
+    vector<float> scales(numberOfImages);
+    vector<float> quantizationErrors(numberOfImages);
+
+    for(unsigned int i = 0 ; i<numberOfImages ; ++i)
+    {
+        scales[i] = reflectanceField.getScale(i);
+        quantizationErrors[i] = reflectanceField.getQuantizationError(i);
+    }
+
+    unsigned long long dataSize = data.total()*data.elemSize();
+    unsigned long long headerEnd = 4*sizeof(char) + PACK_HEADER_SIZE*sizeof(unsigned int) + SOURCE_SIGNATURE_SIZE*sizeof(char)
+                                   + 2*sizeof(unsigned long long) + 2*numberOfImages*sizeof(float);
+
+    //The values start on a page : they are aligned in the mapped memory
+    unsigned long long offsets[2];
+    offsets[0] = alignOffset(headerEnd, PACK_ALIGNMENT);
+    offsets[1] = alignOffset(offsets[0] + dataSize, 64);
+
+    ofstream file(filePath.c_str(), ios::out | ios::trunc | ios::binary);
+
+    if(!file)
+    {
+        cerr << "Could not write the file : " << filePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    //Written as an invalid pack until the end : an interrupted bake is never mapped
+    file.write("RFPW", 4*sizeof(char));
+    file.write((char*) header, PACK_HEADER_SIZE*sizeof(unsigned int));
+    file.write(signature.data(), SOURCE_SIGNATURE_SIZE*sizeof(char));
+    file.write((char*) offsets, 2*sizeof(unsigned long long));
+    file.write((char*) &scales[0], numberOfImages*sizeof(float));
+    file.write((char*) &quantizationErrors[0], numberOfImages*sizeof(float));
+
+    vector<char> padding(PACK_ALIGNMENT, 0);
+    file.write(&padding[0], offsets[0] - headerEnd);
+    file.write((const char*) data.data, dataSize);
+    file.write(&padding[0], offsets[1] - offsets[0] - dataSize);
+
+    if(!maskContinuous.empty())
+        file.write((const char*) maskContinuous.data, maskContinuous.total()*maskContinuous.elemSize());
+
+    file.seekp(0);
+    file.write("RFPK", 4*sizeof(char));
+
+    if(!file)
+    {
+        cerr << "Could not write the file : " << filePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    cout << "Reflectance field baked : " << filePath << " (" << (offsets[1]+maskContinuous.total()*maskContinuous.elemSize())/(1024*1024) << " MB)" << endl;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Maps a pack file in memory. The reflectance field uses the mapped values (no copy), the mask is copied.
+ * The previous mapping is released : the reflectance field attached to it must not be used anymore.
+ * @brief map
+ * @param INPUT : filePath path of the file.
+ * @param OUTPUT : reflectanceField reflectance field attached to the mapped values.
+ * @param OUTPUT : mask mask of the object.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the file does not exist or is not a valid pack.
+ */
+bool ReflectanceFieldPack::map(const string &filePath, ReflectanceField &reflectanceField, Mat &mask)
+{
+    this->unmap();
+
+    m_file.setFileName(QString::fromStdString(filePath));
+
+    if(!m_file.open(QIODevice::ReadOnly))
+        return EXIT_FAILURE;
+
+    qint64 fileSize = m_file.size();
+
+    //Private mapping : the pages are shared with the page cache until they are modified
+    m_mapping = m_file.map(0, fileSize, QFileDevice::MapPrivateOption);
+
+    if(m_mapping == NULL)
+    {
+        cerr << "Could not map the file : " << filePath << endl;
+        this->unmap();
+        return EXIT_FAILURE;
+    }
+
+    unsigned long long signatureOffset = 4*sizeof(char) + PACK_HEADER_SIZE*sizeof(unsigned int);
+    unsigned long long headerEnd = signatureOffset + SOURCE_SIGNATURE_SIZE*sizeof(char) + 2*sizeof(unsigned long long);
+
+    unsigned int header[PACK_HEADER_SIZE];
+    unsigned long long offsets[2];
+
+    if((unsigned long long) fileSize >= headerEnd)
+    {
+        memcpy(header, m_mapping + 4, PACK_HEADER_SIZE*sizeof(unsigned int));
+        memcpy(offsets, m_mapping + signatureOffset + SOURCE_SIGNATURE_SIZE*sizeof(char), 2*sizeof(unsigned long long));
+    }
+
+    if((unsigned long long) fileSize < headerEnd || strncmp((const char*) m_mapping, "RFPK", 4) != 0 || header[0] != PACK_VERSION
+       || header[4] > PIXEL_MAJOR || header[5] > STORAGE_UINT8)
+    {
+        cerr << "Invalid reflectance field pack : " << filePath << endl;
+        this->unmap();
+        return EXIT_FAILURE;
+    }
+
+    unsigned int numberOfImages = header[1];
+    int rows = header[2];
+    int cols = header[3];
+    reflectanceFieldLayout layout = (reflectanceFieldLayout) header[4];
+    reflectanceFieldStorage storage = (reflectanceFieldStorage) header[5];
+    int maskRows = header[6];
+    int maskCols = header[7];
+    int maskType = header[8];
+
+    unsigned long long dataSize = (unsigned long long) numberOfImages*rows*cols*CV_ELEM_SIZE(ReflectanceField::storageType(storage));
+    unsigned long long maskSize = (unsigned long long) maskRows*maskCols*CV_ELEM_SIZE(maskType);
+
+    if(headerEnd + 2*numberOfImages*sizeof(float) > offsets[0] || offsets[0] + dataSize > offsets[1] || offsets[1] + maskSize > (unsigned long long) fileSize)
+    {
+        cerr << "Truncated reflectance field pack : " << filePath << endl;
+        this->unmap();
+        return EXIT_FAILURE;
+    }
+
+    m_sourceSignature = string((const char*) m_mapping + signatureOffset, SOURCE_SIGNATURE_SIZE);
+
+    vector<float> scales(numberOfImages);
+    vector<float> quantizationErrors(numberOfImages);
+
+    memcpy(&scales[0], m_mapping + headerEnd, numberOfImages*sizeof(float));
+    memcpy(&quantizationErrors[0], m_mapping + headerEnd + numberOfImages*sizeof(float), numberOfImages*sizeof(float));
+
+    reflectanceField.attach(m_mapping + offsets[0], numberOfImages, rows, cols, layout, storage, scales, quantizationErrors);
+
+    //The mask is small : it is copied so that it does not depend on the mapping
+    if(maskSize > 0)
+        mask = Mat(maskRows, maskCols, maskType, m_mapping + offsets[1]).clone();
+    else
+        mask.release();
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Unmaps the file.
+ * @brief unmap
+ */
+void ReflectanceFieldPack::unmap()
+{
+    if(m_mapping != NULL)
+        m_file.unmap(m_mapping);
+
+    if(m_file.isOpen())
+        m_file.close();
+
+    m_mapping = NULL;
+    m_sourceSignature.clear();
+}
+
+/**
+ * Returns true if no file is mapped.
+ * @brief empty
+ */
+bool ReflectanceFieldPack::empty() const
+{
+    return m_mapping == NULL;
+}
+
+/**
+ * Returns the signature of the images the mapped reflectance field has been loaded from.
+ * @brief getSourceSignature
+ */
+const string &ReflectanceFieldPack::getSourceSignature() const
+{
+    return m_sourceSignature;
+}
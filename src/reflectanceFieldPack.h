@@ -0,0 +1,125 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file reflectanceFieldPack.h
+ * \brief Baked reflectance field : a file that is mapped in memory instead of decoding the images.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * A pack contains the linear values of a reflectance field (as they are after loadReflectanceField) and the mask of the object.
+ * It is written once (bake) then mapped in memory (map) : the reflectance field is a header on the mapped file, the pages are read on first access.
+ * The mapping is private (copy on write) : the reflectance field can be modified in memory without modifying the file.
+ * File format : "RFPK", header (unsigned int) : version, numberOfImages, rows, cols, layout, storage, mask rows, mask cols, mask type,
+ * signature of the source images (SOURCE_SIGNATURE_SIZE bytes), offsets of the values and of the mask (64 bits), scales and quantization errors (floats), values (aligned on PACK_ALIGNMENT bytes), mask.
+ */
+
+#ifndef REFLECTANCEFIELDPACK_H
+#define REFLECTANCEFIELDPACK_H
+
+#define PACK_VERSION 2
+#define PACK_ALIGNMENT 4096
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <QFile>
+#include <QString>
+
+#include "reflectanceField.h"
+
+class ReflectanceFieldPack
+{
+    public:
+
+        /**
+         * Default constructor of the ReflectanceFieldPack class. No file is mapped.
+         * @brief ReflectanceFieldPack
+         */
+        ReflectanceFieldPack();
+
+        /**
+         * Destructor of the ReflectanceFieldPack class. Unmaps the file.
+         */
+        ~ReflectanceFieldPack();
+
+        /**
+         * Writes a reflectance field and the mask of the object in a pack file.
+         * @brief bake
+         * @param INPUT : filePath path of the file.
+         * @param INPUT : reflectanceField reflectance field (any layout and storage).
+         * @param INPUT : mask mask of the object.
+         * @param INPUT : sourceSignature signature of the images the reflectance field has been loaded from (see Relighting::sourceImagesSignature).
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be written.
+         */
+        static bool bake(const std::string &filePath, const ReflectanceField &reflectanceField, const cv::Mat &mask, const std::string &sourceSignature);
+
+        /**
+         * Maps a pack file in memory. The reflectance field uses the mapped values (no copy), the mask is copied.
+         * The previous mapping is released : the reflectance field attached to it must not be used anymore.
+         * @brief map
+         * @param INPUT : filePath path of the file.
+         * @param OUTPUT : reflectanceField reflectance field attached to the mapped values.
+         * @param OUTPUT : mask mask of the object.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the file does not exist or is not a valid pack.
+         */
+        bool map(const std::string &filePath, ReflectanceField &reflectanceField, cv::Mat &mask);
+
+        /**
+         * Unmaps the file.
+         * @brief unmap
+         */
+        void unmap();
+
+        /**
+         * Returns true if no file is mapped.
+         * @brief empty
+         */
+        bool empty() const;
+
+        /**
+         * Returns the signature of the images the mapped reflectance field has been loaded from.
+         * @brief getSourceSignature
+         */
+        const std::string &getSourceSignature() const;
+
+    private:
+        QFile m_file; /*!< Mapped file*/
+        uchar* m_mapping; /*!< Address of the mapped file*/
+        std::string m_sourceSignature; /*!< Signature of the images written in the mapped file (SOURCE_SIGNATURE_SIZE bytes)*/
+};
+
+#endif // REFLECTANCEFIELDPACK_H
@@ -46,8 +46,17 @@ using namespace cv;
  * Main constructor of the Relighting class.
  * @brief Relighting
  */
-Relighting::Relighting(): m_object(QString()), m_environmentMapName(QString()), m_lightType(QString()),
-    m_numberOfOffsets(1), m_reflectanceField(NULL), m_numberOfLightingConditions(1),  m_objectMask(Mat()),
+Relighting::Relighting(): m_workerThread(NULL), m_running(0), m_cancelled(0), m_object(QString()), m_environmentMapName(QString()), m_lightType(QString()),
+    m_numberOfOffsets(1), m_reflectanceField(), m_reflectanceFieldLayout(IMAGE_MAJOR),
+    m_reflectanceFieldStorage(STORAGE_FLOAT32), m_lowRankReflectanceField(), m_lowRankRank(0),
+    m_sparseMode(SPARSE_DISABLED), m_sparseParameter(1.0), m_sparseReported(false),
+    m_tiledReflectanceField(), m_outOfCore(false), m_outOfCoreMemoryBudget(512*1024*1024),
+    m_reflectanceFieldPack(), m_bakedReflectanceField(false), m_sourceImagesSignature(),
+    m_residentEnvironmentMaps(false), m_environmentMapCache(QMap<QString, ResidentEnvironmentMap>()), m_environmentMapCacheUses(0),
+    m_useResultCache(false), m_resultCache(), m_environmentMapHash(QByteArray()), m_pyramidTolerance(0.0), m_incrementalRelighting(false), m_incrementalMaxChangedFraction(0.25),
+    m_accumulatedResult(Mat()), m_accumulatedWeights(std::vector<std::vector<float> >()), m_accumulatedVersion(0), m_incrementalUpdates(0), m_accumulatedChangedFraction(0.0), m_memoryOwner(std::string()),
+    m_backgroundPixels(std::vector<int>()), m_backgroundRows(std::vector<int>()), m_backgroundPhi(std::vector<float>()),
+    m_backgroundTableSize(Size()), m_backgroundTableMask(Mat()), m_backgroundTableEnvironmentMapHeight(0), m_numberOfLightingConditions(1),  m_objectMask(Mat()),
     m_environmentMap(Mat()), m_environmentMapWidth(1024), m_environmentMapHeight(512), m_numberOfComponents(3),
     m_weightsRGB(std::vector<std::vector<float> >()), m_relitResult(Mat())
 {
@@ -59,7 +68,110 @@ Relighting::Relighting(): m_object(QString()), m_environmentMapName(QString()),
   */
 Relighting::~Relighting()
 {
-    delete[] m_reflectanceField;
+    this->stopWorkerThread();
+    this->releaseTrackedMemory();
+}
+
+/**
+ * Starts the relighting on the worker thread of the object and returns immediately.
+ * The object is moved to its worker thread the first time : the signals reach the graphical interface as queued signals.
+ * relightingFinished is emitted when the relighting ends or is cancelled. Does nothing if a relighting is already running.
+ * @brief startRelighting
+ */
+void Relighting::startRelighting()
+{
+    if(m_running.fetchAndStoreOrdered(1) == 1)
+        return;
+
+    m_cancelled.store(0);
+
+    //The windows of OpenCV must be used on the thread of the graphical interface
+    this->identifyLightsBeforeStart();
+
+    if(m_workerThread == NULL)
+    {
+        m_workerThread = new QThread();
+        this->moveToThread(m_workerThread);
+        m_workerThread->start();
+    }
+
+    QMetaObject::invokeMethod(this, "runRelighting", Qt::QueuedConnection);
+}
+
+/**
+ * Steps of the relighting that need the graphical interface (manual identification of the light sources).
+ * Called by startRelighting on the calling thread before the relighting is given to the worker thread. Does nothing by default.
+ * @brief identifyLightsBeforeStart
+ */
+void Relighting::identifyLightsBeforeStart()
+{
+
+}
+
+/**
+ * Returns true if a relighting started with startRelighting is running.
+ * @brief isRunning
+ */
+bool Relighting::isRunning() const
+{
+    return m_running.load() == 1;
+}
+
+/**
+ * Qt slot that asks the running relighting to stop. The relighting stops at the next check (between the offsets and in the rows of the computations of the weights).
+ * Can be called from any thread (connect it with Qt::DirectConnection).
+ * @brief cancelRelighting
+ */
+void Relighting::cancelRelighting()
+{
+    m_cancelled.store(1);
+}
+
+/**
+ * Qt slot that runs the relighting on the worker thread (invoked by startRelighting) and emits relightingFinished.
+ * @brief runRelighting
+ */
+void Relighting::runRelighting()
+{
+    resetMemoryPeaks();
+
+    this->relighting();
+
+    cout << memorySummary();
+
+    m_running.store(0);
+    emit relightingFinished();
+}
+
+/**
+ * Returns true if the relighting has been cancelled. Prints the cancellation the first time it is noticed.
+ * @brief isCancelled
+ */
+bool Relighting::isCancelled()
+{
+    //The token is set back to 2 once the cancellation has been reported
+    if(m_cancelled.testAndSetOrdered(1, 2))
+        this->updateProgressWindow(QString("Relighting cancelled"), 100);
+
+    return m_cancelled.load() != 0;
+}
+
+/**
+ * Cancels the running relighting, waits for it and stops the worker thread.
+ * Called by the destructors of the derived classes before they release their members.
+ * @brief stopWorkerThread
+ */
+void Relighting::stopWorkerThread()
+{
+    if(m_workerThread == NULL)
+        return;
+
+    m_cancelled.store(1);
+    m_workerThread->quit();
+    m_workerThread->wait();
+
+    delete m_workerThread;
+    m_workerThread = NULL;
 }
 
 /**
@@ -68,6 +180,9 @@ Relighting::~Relighting()
  */
 void Relighting::loadEnvironmentMap()
 {
+    TraceScope traceScope("Relighting::loadEnvironmentMap");
+    MemoryStage memoryStage("loadEnvironmentMap");
+
     if(m_environmentMapName == "Grace Cathedral")
     {
         m_environmentMapName = "grace_latlong";
@@ -89,41 +204,190 @@ void Relighting::loadEnvironmentMap()
        m_environmentMapName = "pisa_courtyard";
     }
 
-    m_environmentMap = loadPFM(this->getFolderPath() + "/environment_maps/" + m_environmentMapName.toStdString() + ".pfm");
+    m_environmentMapHash.clear();
 
-    if(!m_environmentMap.data)
+    if(m_residentEnvironmentMaps && m_environmentMapCache.contains(m_environmentMapName))
     {
-        cerr << "Could not load : " << this->getFolderPath() + "/environment_maps/" + m_environmentMapName.toStdString() + ".pfm" << endl;
+        ResidentEnvironmentMap &residentEnvironmentMap = m_environmentMapCache[m_environmentMapName];
+        residentEnvironmentMap.lastUse = ++m_environmentMapCacheUses;
+        m_environmentMap = residentEnvironmentMap.environmentMap;
+    }
+    else
+    {
+        m_environmentMap = loadPFM(this->getFolderPath() + "/environment_maps/" + m_environmentMapName.toStdString() + ".pfm");
+
+        if(!m_environmentMap.data)
+        {
+            cerr << "Could not load : " << this->getFolderPath() + "/environment_maps/" + m_environmentMapName.toStdString() + ".pfm" << endl;
+        }
+        else if(m_residentEnvironmentMaps)
+        {
+            //The least recently used environment map is removed to make room for the new one
+            while((unsigned int) m_environmentMapCache.size() >= RESIDENT_ENVIRONMENT_MAPS_MAXIMUM)
+            {
+                QMap<QString, ResidentEnvironmentMap>::iterator leastRecentlyUsed = m_environmentMapCache.begin();
+
+                for(QMap<QString, ResidentEnvironmentMap>::iterator it = m_environmentMapCache.begin() ; it != m_environmentMapCache.end() ; ++it)
+                {
+                    if(it.value().lastUse < leastRecentlyUsed.value().lastUse)
+                        leastRecentlyUsed = it;
+                }
+
+                m_environmentMapCache.erase(leastRecentlyUsed);
+            }
+
+            ResidentEnvironmentMap residentEnvironmentMap;
+            residentEnvironmentMap.environmentMap = m_environmentMap;
+            residentEnvironmentMap.lastUse = ++m_environmentMapCacheUses;
+
+            m_environmentMapCache.insert(m_environmentMapName, residentEnvironmentMap);
+        }
     }
 
     m_environmentMapWidth = m_environmentMap.cols;
     m_environmentMapHeight = m_environmentMap.rows;
     m_numberOfComponents = 3;
+
+    this->updateTrackedMemory();
 }
 
 /**
  * Function to compute the final relighting (linear combination) from the reflectance field and the RGB weights.
+ * The linear combination is computed in a single pass over the reflectance field using all the cores.
  * @brief computeFinalRelighting
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the reflectance field is not available or could not be read.
  */
-void Relighting::computeFinalRelighting()
+bool Relighting::computeFinalRelighting()
 {
-    m_relitResult = Mat::zeros(m_reflectanceField[0].rows, m_reflectanceField[0].cols, CV_32FC3);
+    TraceScope traceScope("Relighting::computeFinalRelighting");
+    MemoryStage memoryStage("computeFinalRelighting");
 
-    Mat channel[3];
-    Mat currentImage;
+    if(m_outOfCore)
+    {
+        if(m_tiledReflectanceField.empty())
+        {
+            cerr << "The out-of-core reflectance field has not been loaded" << endl;
+            return EXIT_FAILURE;
+        }
 
-    for(unsigned int i = 0 ; i<m_numberOfLightingConditions ; ++i)
+        //The tiles are streamed from the disk one after the other
+        return m_tiledReflectanceField.relight(m_weightsRGB, m_relitResult);
+    }
+
+    if(m_lowRankRank > 0)
     {
-        split(m_reflectanceField[i], channel);
+        if(this->prepareLowRankReflectanceField() == EXIT_FAILURE)
+            return EXIT_FAILURE;
+
+        m_relitResult.create(m_lowRankReflectanceField.rows(), m_lowRankReflectanceField.cols(), CV_32FC3);
+
+        //Linear combination of the basis images of each tile
+        LowRankWeightedSumKernel lowRankWeightedSum(m_lowRankReflectanceField, m_weightsRGB, m_relitResult);
+        parallel_for_(Range(0, m_lowRankReflectanceField.getNumberOfTiles()), lowRankWeightedSum);
+
+        return EXIT_SUCCESS;
+    }
+
+    //The error bound is reported once, when the reflectance field is converted to a new storage
+    bool storageChanged = (m_reflectanceField.getStorage() != m_reflectanceFieldStorage);
+
+    m_reflectanceField.setStorage(m_reflectanceFieldStorage);
+    m_reflectanceField.setLayout(m_reflectanceFieldLayout);
+
+    if(m_incrementalRelighting && m_sparseMode == SPARSE_DISABLED)
+    {
+        this->computeIncrementalRelighting();
+    }
+    else
+    {
+        m_relitResult.create(m_reflectanceField.rows(), m_reflectanceField.cols(), CV_32FC3);
+
+        if(m_sparseMode != SPARSE_DISABLED)
+        {
+            //Sparse relighting : only the significant images are accumulated (the result is black if none is significant)
+            std::vector<unsigned int> images;
+            this->selectSignificantImages(images);
+
+            WeightedSumKernel weightedSum(m_reflectanceField, m_weightsRGB, m_relitResult, images);
+            parallel_for_(Range(0, m_relitResult.rows), weightedSum, numberOfRowTiles(m_relitResult.rows));
+        }
+        else
+        {
+            //Fused multiply-accumulate of the images, split in tiles of rows across the cores
+            WeightedSumKernel weightedSum(m_reflectanceField, m_weightsRGB, m_relitResult);
+            parallel_for_(Range(0, m_relitResult.rows), weightedSum, numberOfRowTiles(m_relitResult.rows));
+        }
+    }
+
+    this->updateTrackedMemory();
+
+    if(storageChanged && m_reflectanceFieldStorage != STORAGE_FLOAT32)
+    {
+        cerr << "Relighting error due to the storage of the reflectance field : at most " << this->storageErrorBound() << endl;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Function to compute several relightings at once from the reflectance field (one per set of RGB weights).
+ * The reflectance field is read from memory once for the whole batch instead of once per relighting.
+ * @brief computeFinalRelightingBatch
+ * @param INPUT : weightsBatch weightsBatch[o] contains the RGB weights (same format as m_weightsRGB) of relighting o.
+ * @param OUTPUT : results results[o] is the relit result (CV_32FC3) computed with weightsBatch[o].
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the reflectance field is not available or could not be read.
+ */
+bool Relighting::computeFinalRelightingBatch(const std::vector<std::vector<std::vector<float> > > &weightsBatch, std::vector<Mat> &results)
+{
+    TraceScope traceScope("Relighting::computeFinalRelightingBatch");
+    MemoryStage memoryStage("computeFinalRelighting");
+
+    if(m_outOfCore)
+    {
+        if(m_tiledReflectanceField.empty())
+        {
+            cerr << "The out-of-core reflectance field has not been loaded" << endl;
+            return EXIT_FAILURE;
+        }
+
+        //Each tile is read once for the whole batch
+        return m_tiledReflectanceField.relightBatch(weightsBatch, results);
+    }
+
+    if(m_lowRankRank > 0)
+    {
+        if(this->prepareLowRankReflectanceField() == EXIT_FAILURE)
+            return EXIT_FAILURE;
+
+        //In the compressed domain the cost of a relighting is already small : the outputs are computed one after the other
+        results.resize(weightsBatch.size());
+        for(unsigned int o = 0 ; o<weightsBatch.size() ; ++o)
+        {
+            results[o].create(m_lowRankReflectanceField.rows(), m_lowRankReflectanceField.cols(), CV_32FC3);
+
+            LowRankWeightedSumKernel lowRankWeightedSum(m_lowRankReflectanceField, weightsBatch[o], results[o]);
+            parallel_for_(Range(0, m_lowRankReflectanceField.getNumberOfTiles()), lowRankWeightedSum);
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    m_reflectanceField.setStorage(m_reflectanceFieldStorage);
+    m_reflectanceField.setLayout(m_reflectanceFieldLayout);
 
-        //OpenCV uses images in BGR format
-        channel[0] *= m_weightsRGB[i][2];
-        channel[1] *= m_weightsRGB[i][1];
-        channel[2] *= m_weightsRGB[i][0];
+    int rows = m_reflectanceField.rows();
+    int cols = m_reflectanceField.cols();
 
-        merge(channel,3, currentImage);
-        m_relitResult += currentImage;
+    results.resize(weightsBatch.size());
+    for(unsigned int o = 0 ; o<weightsBatch.size() ; ++o)
+    {
+        results[o].create(rows, cols, CV_32FC3);
     }
+
+    BatchWeightedSumKernel batchWeightedSum(m_reflectanceField, weightsBatch, results);
+    parallel_for_(Range(0, rows), batchWeightedSum, numberOfRowTiles(rows));
+
+    return EXIT_SUCCESS;
 }
 
 /**
@@ -135,26 +399,43 @@ void Relighting::computeFinalRelighting()
  */
 void Relighting::rayTraceBackground(const float offset, bool applyGamma, double gamma)
 {
-    ostringstream osstream;
-    Mat environmentMap;
+    TraceScope traceScope("Relighting::rayTraceBackground");
+    MemoryStage memoryStage("rayTraceBackground");
 
-//Load the environment map
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
-    osstream << "/environment_maps/" << m_environmentMapName.toStdString() << ".pfm";
+    if(!m_environmentMap.data)
+    {
+        cerr << "The environment map has not been loaded" << endl;
+        return;
+    }
 
-    environmentMap = loadPFM(osstream.str());
-    osstream.str("");
+    //The table only depends on the size of the result, the mask and the height of the environment map
+    if(m_backgroundTableSize != m_relitResult.size() || m_backgroundTableMask.data != m_objectMask.data
+       || m_backgroundTableEnvironmentMapHeight != m_environmentMapHeight)
+    {
+        this->computeBackgroundTable();
+    }
+
+    //Gather of the environment map for the background pixels, split across the cores
+    BackgroundKernel background(m_backgroundPixels, m_backgroundRows, m_backgroundPhi, m_environmentMap, offset, applyGamma, gamma, m_relitResult);
+    parallel_for_(Range(0, m_backgroundPixels.size()), background);
+}
 
+/**
+ * Precomputes the background pixels of the relit result and the latitude longitude coordinates of their directions (without offset).
+ * @brief computeBackgroundTable
+ */
+void Relighting::computeBackgroundTable()
+{
     //Information about the image
     int width = m_relitResult.cols;
     int height = m_relitResult.rows;
     float halfHeight = height/2;
     float halfWidth = width/2;
 
+    m_backgroundPixels.clear();
+    m_backgroundRows.clear();
+    m_backgroundPhi.clear();
+
     for(int i = 0 ; i<height ; i++)
     {
         for(int j = 0 ; j<width; j++)
@@ -179,27 +460,17 @@ void Relighting::rayTraceBackground(const float offset, bool applyGamma, double
                 float theta = 0.0, phi = 0.0;
                 cartesianToSpherical(x,y,z,r,theta,phi);
 
-                phi += offset;
-                phi = moduloRealNumber(phi, 2.0*M_PI);
-
-                //Convert the spherical coordinates to latitude longitude map
-                int I = floor(m_environmentMapHeight*theta/M_PI);
-                int J = floor(m_environmentMapWidth*phi/(2.0*M_PI));
-
-                //Results are between 0 and 255 for 8 bits images
-                m_relitResult.at<Vec3f>(i,j).val[0] = environmentMap.at<Vec3f>(I,J).val[0];
-                m_relitResult.at<Vec3f>(i,j).val[1] = environmentMap.at<Vec3f>(I,J).val[1];
-                m_relitResult.at<Vec3f>(i,j).val[2] = environmentMap.at<Vec3f>(I,J).val[2];
-
-                if(applyGamma)
-                {
-                    m_relitResult.at<Vec3f>(i,j).val[0] = pow(m_relitResult.at<Vec3f>(i,j).val[0], 1.0/gamma);
-                    m_relitResult.at<Vec3f>(i,j).val[1] = pow(m_relitResult.at<Vec3f>(i,j).val[1], 1.0/gamma);
-                    m_relitResult.at<Vec3f>(i,j).val[2] = pow(m_relitResult.at<Vec3f>(i,j).val[2], 1.0/gamma);
-                }
+                //Convert theta to the row of the latitude longitude map. Phi depends on the offset.
+                m_backgroundPixels.push_back(i*width+j);
+                m_backgroundRows.push_back(min((int) floor(m_environmentMapHeight*theta/M_PI), (int) m_environmentMapHeight-1));
+                m_backgroundPhi.push_back(phi);
              }
         }
     }
+
+    m_backgroundTableSize = m_relitResult.size();
+    m_backgroundTableMask = m_objectMask;
+    m_backgroundTableEnvironmentMapHeight = m_environmentMapHeight;
 }
 
 /**
@@ -209,7 +480,11 @@ void Relighting::rayTraceBackground(const float offset, bool applyGamma, double
  */
 void Relighting::gammaCorrection(double gamma)
 {
+    TraceScope traceScope("Relighting::gammaCorrection");
+    MemoryStage memoryStage("gammaCorrection");
 
+    //The channels and the channels with the gamma are held at the same time
+    TrackedMemory channels("Relighting::gammaCorrection", 2*m_relitResult.total()*3*sizeof(float));
     Mat channel[3], channelWithGamma[3];
 
     split(m_relitResult, channel);
@@ -231,11 +506,15 @@ void Relighting::gammaCorrection(double gamma)
  */
 void Relighting::removeGammaReflectanceField(double gamma)
 {
-    Mat channel[3], channelWithoutGamma[3];
+    MemoryStage memoryStage("removeGammaReflectanceField");
+
+    //Channels, channels without gamma and merged image of one picture
+    TrackedMemory channels("Relighting::removeGammaReflectanceField", 3*m_reflectanceField.rows()*m_reflectanceField.cols()*3*sizeof(float));
+    Mat image, channel[3], channelWithoutGamma[3];
 
     for(unsigned int k = 0 ; k<m_numberOfLightingConditions ; ++k)
     {
-        split(m_reflectanceField[k], channel);
+        split(m_reflectanceField.image(k), channel);
 
         channel[0].convertTo(channel[0], CV_32F);
         channel[1].convertTo(channel[1], CV_32F);
@@ -245,7 +524,8 @@ void Relighting::removeGammaReflectanceField(double gamma)
         pow(channel[1], gamma, channelWithoutGamma[1]);
         pow(channel[2], gamma, channelWithoutGamma[2]);
 
-        merge(channelWithoutGamma, 3, m_reflectanceField[k]);
+        merge(channelWithoutGamma, 3, image);
+        m_reflectanceField.setImage(k, image);
     }
 
 }
@@ -262,22 +542,31 @@ void Relighting::changeExposure(double exposure)
 
 /**
  * Save the relit result in the correct format.
+ * The exposure, the gamma correction, the clamp and the quantization are applied in a single multithreaded pass. The relit result is not modified.
+ * As with cv::pow, the gamma correction uses the absolute value of the negative values (non integer power) : they are not clamped to 0.
  * @brief saveResult
+ * @param INPUT : fileType SAVE_8BITS or SAVE_16BITS.
+ * @param INPUT : filePath path of the file.
+ * @param INPUT : exposure exposure in stops applied to the relit result (the values are multiplied by 2^exposure).
+ * @param INPUT : gamma gamma correction applied after the exposure.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the file type is unknown.
  */
-bool Relighting::saveResult(saveFileType fileType, string filePath)
+bool Relighting::saveResult(saveFileType fileType, string filePath, double exposure, double gamma)
 {
+    TraceScope traceScope("Relighting::saveResult");
+    MemoryStage memoryStage("saveResult");
+
+    int maxValue = 0;
 
     if(fileType == SAVE_8BITS)
     {
-        m_relitResult *= 255.0;
-        m_relitResult.convertTo(m_relitResult, CV_8UC3);
-        imwrite(filePath, m_relitResult);
+        maxValue = 255;
+        m_outputImage.create(m_relitResult.size(), CV_8UC3);
     }
     else if(fileType == SAVE_16BITS)
     {
-        m_relitResult *= 65535.0;
-        m_relitResult.convertTo(m_relitResult, CV_16UC3);
-        imwrite(filePath, m_relitResult);
+        maxValue = 65535;
+        m_outputImage.create(m_relitResult.size(), CV_16UC3);
     }
     else
     {
@@ -285,10 +574,44 @@ bool Relighting::saveResult(saveFileType fileType, string filePath)
         return EXIT_FAILURE;
     }
 
+    std::vector<float> thresholds;
+    bool absoluteValues = this->outputThresholds(maxValue, exposure, gamma, thresholds);
+
+    OutputStageKernel outputStage(m_relitResult, thresholds, absoluteValues, m_outputImage);
+    parallel_for_(Range(0, m_relitResult.rows), outputStage, numberOfRowTiles(m_relitResult.rows));
+
+    imwrite(filePath, m_outputImage);
 
     return EXIT_SUCCESS;
 }
 
+/**
+ * Tabulates the transfer function of the saved images (exposure, gamma and quantization) for the OutputStageKernel.
+ * @brief outputThresholds
+ * @param INPUT : maxValue maximum output value (255 or 65535).
+ * @param INPUT : exposure exposure in stops.
+ * @param INPUT : gamma gamma correction applied after the exposure.
+ * @param OUTPUT : thresholds linear values where the output value changes (maxValue values).
+ * @return true if the negative values are converted as their absolute value (gamma correction with a non integer power, as cv::pow), false if they are clamped to 0.
+ */
+bool Relighting::outputThresholds(int maxValue, double exposure, double gamma, std::vector<float> &thresholds) const
+{
+    //The output value q is obtained for linear values in [thresholds[q-1] ; thresholds[q]]
+    //round(maxValue*(2^exposure*v)^(1/gamma)) = q  <=>  v >= ((q-0.5)/maxValue)^gamma/2^exposure
+    thresholds.resize(maxValue);
+    double exposureScale = pow(2.0, exposure);
+
+    for(int q = 1 ; q<=maxValue ; ++q)
+    {
+        thresholds[q-1] = pow((q-0.5)/maxValue, gamma)/exposureScale;
+    }
+
+    //cv::pow used |v| for a non integer power : the former gamma correction mapped -v and v to the same output
+    double power = 1.0/gamma;
+
+    return power != floor(power);
+}
+
 /**
  * Display the final relighting.
  * @brief displayRelighting
@@ -349,18 +672,728 @@ void Relighting::setNumberOfLightingConditions(unsigned int numberOfLightingCond
     m_numberOfLightingConditions = numberOfLightingConditions;
 }
 
+/**
+ * Methods that sets the layout of the reflectance field in memory used for the linear combination.
+ * The reflectance field is loaded and prepared image by image and transposed to this layout before the first relighting.
+ * @brief setReflectanceFieldLayout
+ * @param INPUT : layout IMAGE_MAJOR (default) or PIXEL_MAJOR.
+ */
+void Relighting::setReflectanceFieldLayout(reflectanceFieldLayout layout)
+{
+    m_reflectanceFieldLayout = layout;
+}
+
+/**
+ * Methods that sets the type used to store the reflectance field in memory.
+ * STORAGE_FLOAT16 halves and STORAGE_UINT8 quarters the memory used by the reflectance field. The values are dequantized during the linear combination.
+ * @brief setReflectanceFieldStorage
+ * @param INPUT : storage STORAGE_FLOAT32 (default), STORAGE_FLOAT16 or STORAGE_UINT8.
+ */
+void Relighting::setReflectanceFieldStorage(reflectanceFieldStorage storage)
+{
+    m_reflectanceFieldStorage = storage;
+}
+
+/**
+ * Upper bound of the difference between the relit result computed with the stored reflectance field and with 32 bits floats, for the current weights.
+ * @brief storageErrorBound
+ * @return the maximum absolute error over the three channels.
+ */
+float Relighting::storageErrorBound()
+{
+    float bound[3] = {0.0, 0.0, 0.0};
+
+    //|sum w_i (I_i - Q_i)| <= sum |w_i| max|I_i - Q_i|
+    for(unsigned int i = 0 ; i<m_weightsRGB.size() && i<m_reflectanceField.getNumberOfImages() ; ++i)
+    {
+        for(int c = 0 ; c<3 ; ++c)
+        {
+            bound[c] += fabs(m_weightsRGB[i][c])*m_reflectanceField.getQuantizationError(i);
+        }
+    }
+
+    return max(bound[0], max(bound[1], bound[2]));
+}
+
+/**
+ * Methods that enables the relighting in the compressed domain of a low rank approximation of the reflectance field.
+ * The approximation is computed (or loaded from the folder low_rank) before the first relighting, then the full reflectance field is released.
+ * @brief setLowRankRelighting
+ * @param INPUT : rank number of basis images kept in each tile. 0 disables the low rank relighting.
+ */
+void Relighting::setLowRankRelighting(unsigned int rank)
+{
+    m_lowRankRank = rank;
+}
+
+/**
+ * Methods that enables the sparse relighting : only the lighting conditions with a significant contribution are used in the linear combination.
+ * The contribution of a lighting condition is its weight multiplied by the maximum value of its image.
+ * @brief setSparseRelighting
+ * @param INPUT : mode SPARSE_DISABLED, SPARSE_ENERGY (the most significant conditions are kept until parameter (in [0:1]) of the total contribution is reached)
+ * or SPARSE_TOP_K (the parameter most significant conditions are kept).
+ * @param INPUT : parameter fraction of the total contribution (SPARSE_ENERGY) or number of lighting conditions (SPARSE_TOP_K).
+ */
+void Relighting::setSparseRelighting(sparseRelightingMode mode, double parameter)
+{
+    if(mode != m_sparseMode || parameter != m_sparseParameter)
+        m_sparseReported = false;
+
+    m_sparseMode = mode;
+    m_sparseParameter = parameter;
+}
+
+/**
+ * Methods that enables the incremental relighting : the last linear combination and its weights are kept
+ * and only the images whose weights changed are added (with the difference of the weights) to the last result.
+ * The linear combination is recomputed from scratch if too many weights changed or if the reflectance field changed.
+ * The rounding errors of the updates add up : it is also recomputed after INCREMENTAL_MAXIMUM_UPDATES updates, or when the changed fractions
+ * of the updates since the last recomputation add up to INCREMENTAL_MAXIMUM_ACCUMULATED_FRACTION.
+ * @brief setIncrementalRelighting
+ * @param INPUT : incrementalRelighting true to enable the incremental relighting.
+ * @param INPUT : maxChangedFraction maximum fraction of the lighting conditions whose weights changed for an incremental update.
+ */
+void Relighting::setIncrementalRelighting(bool incrementalRelighting, double maxChangedFraction)
+{
+    m_incrementalRelighting = incrementalRelighting;
+    m_incrementalMaxChangedFraction = maxChangedFraction;
+
+    if(!m_incrementalRelighting)
+    {
+        m_accumulatedResult.release();
+        m_accumulatedWeights.clear();
+    }
+}
+
+/**
+ * Methods that enables the out-of-core relighting for reflectance fields larger than the memory.
+ * The images are written once in a tiled file (folder out_of_core) while they are loaded, and the relighting reads one tile at a time.
+ * Only the light stage relighting reads a tiled file : the free form and office room relightings modify their images after the loading and fail if this mode is enabled.
+ * One row of all the images must fit in the memory budget.
+ * @brief setOutOfCoreRelighting
+ * @param INPUT : outOfCore true to enable the out-of-core relighting.
+ * @param INPUT : memoryBudget maximum size in bytes of the part of the reflectance field in memory (one tile).
+ */
+void Relighting::setOutOfCoreRelighting(bool outOfCore, size_t memoryBudget)
+{
+    m_outOfCore = outOfCore;
+    m_outOfCoreMemoryBudget = memoryBudget;
+
+    if(!m_outOfCore)
+        m_tiledReflectanceField.close();
+}
+
+/**
+ * Methods that enables the baked reflectance fields : the first loading writes the linear reflectance field and the mask in a pack file (folder baked),
+ * the next loadings map the pack in memory instead of decoding the images.
+ * @brief setBakedReflectanceField
+ * @param INPUT : bakedReflectanceField true to enable the baked reflectance fields.
+ */
+void Relighting::setBakedReflectanceField(bool bakedReflectanceField)
+{
+    m_bakedReflectanceField = bakedReflectanceField;
+}
+
+/**
+ * Methods that keeps the environment maps that have been loaded in memory : loading them again does not read the file.
+ * At most RESIDENT_ENVIRONMENT_MAPS_MAXIMUM environment maps are kept : the least recently used one is removed first.
+ * @brief setResidentEnvironmentMaps
+ * @param INPUT : residentEnvironmentMaps true to keep the environment maps in memory.
+ */
+void Relighting::setResidentEnvironmentMaps(bool residentEnvironmentMaps)
+{
+    m_residentEnvironmentMaps = residentEnvironmentMaps;
+
+    if(!m_residentEnvironmentMaps)
+        m_environmentMapCache.clear();
+}
+
+/**
+ * Returns the size in bytes of the data kept in memory between two relightings (reflectance field, mask and environment maps).
+ * @brief residentMemory
+ */
+size_t Relighting::residentMemory()
+{
+    return m_reflectanceField.memorySize() + matMemorySize(m_objectMask) + this->environmentMapsMemorySize();
+}
+
+/**
+ * Returns the size in bytes of the environment maps in memory (current environment map and environment maps kept in memory).
+ * @brief environmentMapsMemorySize
+ */
+size_t Relighting::environmentMapsMemorySize() const
+{
+    size_t memory = 0;
+
+    for(QMap<QString, ResidentEnvironmentMap>::const_iterator it = m_environmentMapCache.constBegin() ; it != m_environmentMapCache.constEnd() ; ++it)
+    {
+        memory += matMemorySize(it.value().environmentMap);
+    }
+
+    //The current environment map is not in the cache if the environment maps are not resident
+    if(!m_environmentMapCache.contains(m_environmentMapName))
+        memory += matMemorySize(m_environmentMap);
+
+    return memory;
+}
+
+/**
+ * Gives the sizes of the buffers of the relighting (reflectance field, environment maps, mask and results) to the memory tracker, under the name of the object.
+ * @brief updateTrackedMemory
+ */
+void Relighting::updateTrackedMemory()
+{
+    std::string owner = m_object.isEmpty() ? std::string("Relighting") : m_object.toStdString();
+
+    //The buffers of the previous object are not counted twice
+    if(owner != m_memoryOwner)
+        this->releaseTrackedMemory();
+
+    m_memoryOwner = owner;
+
+    //The reflectance field updates its size each time it is allocated
+    m_reflectanceField.setMemoryOwner(owner + "/reflectanceField");
+    setTrackedMemory(owner + "/environmentMaps", this->environmentMapsMemorySize());
+    setTrackedMemory(owner + "/objectMask", matMemorySize(m_objectMask));
+    setTrackedMemory(owner + "/relitResult", matMemorySize(m_relitResult) + matMemorySize(m_accumulatedResult));
+}
+
+/**
+ * Sets the sizes of the buffers of the relighting to 0 in the memory tracker.
+ * @brief releaseTrackedMemory
+ */
+void Relighting::releaseTrackedMemory()
+{
+    if(m_memoryOwner.empty())
+        return;
+
+    m_reflectanceField.setMemoryOwner(std::string());
+    setTrackedMemory(m_memoryOwner + "/environmentMaps", 0);
+    setTrackedMemory(m_memoryOwner + "/objectMask", 0);
+    setTrackedMemory(m_memoryOwner + "/relitResult", 0);
+
+    m_memoryOwner.clear();
+}
+
+/**
+ * Methods that enables the cache of the results (folder result_cache) : the weights and the linear relit result of each offset are stored on disk,
+ * under a hash of the object, of the content of the environment map, of the basis and of the parameters. An offset found in the cache is not computed again.
+ * @brief setResultCache
+ * @param INPUT : resultCache true to enable the cache of the results.
+ * @param INPUT : maximumSize maximum size in bytes of the cache. The least recently used results are removed above this size.
+ */
+void Relighting::setResultCache(bool resultCache, size_t maximumSize)
+{
+    m_useResultCache = resultCache;
+    m_resultCache.setMaximumSize(maximumSize);
+}
+
+/**
+ * Methods that sets the tolerance of the integration of the weights on the pyramids of the environment map and of the label maps (see environmentMapPyramid.h) :
+ * maximum fraction of the solid angle given to a wrong light source. 0 (default) computes the weights at full resolution.
+ * @brief setPyramidTolerance
+ * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong light source.
+ */
+void Relighting::setPyramidTolerance(double tolerance)
+{
+    m_pyramidTolerance = tolerance;
+}
+
+/**
+ * Returns the cache of the results (number of hits and misses, size).
+ * @brief getResultCache
+ */
+const ResultCache &Relighting::getResultCache() const
+{
+    return m_resultCache;
+}
+
+/**
+ * Returns the key of the result of an offset in the cache of the results, or an empty key if the cache is disabled.
+ * The key is a hash of the reflectance field (data folder, object, signature of the images, number of lighting conditions, storage, low rank and sparse parameters), of the content of the environment map,
+ * of the light type, of the offset and of the parameters of the method (basis, identification...).
+ * @brief resultCacheKey
+ * @param INPUT : offset rotation of the environment map (phi angle).
+ * @param INPUT : parameters basis and parameters specific to the method.
+ */
+QByteArray Relighting::resultCacheKey(float offset, const string &parameters)
+{
+    if(!m_useResultCache || !m_environmentMap.data)
+        return QByteArray();
+
+    //The environment map is hashed once per loading
+    if(m_environmentMapHash.isEmpty())
+    {
+        Mat environmentMap = m_environmentMap.isContinuous() ? m_environmentMap : m_environmentMap.clone();
+        int size[3] = {environmentMap.rows, environmentMap.cols, environmentMap.type()};
+
+        QCryptographicHash environmentMapHash(QCryptographicHash::Sha1);
+        environmentMapHash.addData((const char*) size, 3*sizeof(int));
+        environmentMapHash.addData((const char*) environmentMap.data, environmentMap.total()*environmentMap.elemSize());
+        m_environmentMapHash = environmentMapHash.result();
+    }
+
+    ostringstream inputs;
+    inputs << this->getFolderPath() << ";" << this->metaObject()->className() << ";" << m_object.toStdString() << ";" << m_numberOfLightingConditions << ";"
+           << m_reflectanceFieldStorage << ";" << m_lowRankRank << ";" << m_sparseMode << ";" << m_sparseParameter << ";"
+           << m_lightType.toStdString() << ";" << setprecision(9) << offset << ";" << parameters;
+
+    //The signature of the images : the results computed from images that have been modified are not reused
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(m_environmentMapHash);
+    hash.addData(m_sourceImagesSignature.data(), m_sourceImagesSignature.size());
+    hash.addData(inputs.str().c_str(), inputs.str().size());
+
+    return hash.result();
+}
+
+/**
+ * Reads m_weightsRGB and m_relitResult from the cache of the results.
+ * @brief loadCachedResult
+ * @param INPUT : key key of the result (empty if the cache is disabled).
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the result is not in the cache.
+ */
+bool Relighting::loadCachedResult(const QByteArray &key)
+{
+    TraceScope traceScope("Relighting::loadCachedResult", "cache");
+
+    if(key.isEmpty())
+        return EXIT_FAILURE;
+
+    m_resultCache.setFolder(this->getFolderPath() + "/result_cache");
+
+    std::vector<std::vector<float> > weights;
+    Mat result;
+
+    if(m_resultCache.load(key, weights, result) == EXIT_FAILURE)
+        return EXIT_FAILURE;
+
+    m_weightsRGB = weights;
+    m_relitResult = result;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Writes m_weightsRGB and m_relitResult (linear combination, before the background and the exposure) in the cache of the results.
+ * @brief storeCachedResult
+ * @param INPUT : key key of the result (empty if the cache is disabled).
+ */
+void Relighting::storeCachedResult(const QByteArray &key)
+{
+    TraceScope traceScope("Relighting::storeCachedResult", "cache");
+
+    if(key.isEmpty())
+        return;
+
+    m_resultCache.setFolder(this->getFolderPath() + "/result_cache");
+    m_resultCache.store(key, m_weightsRGB, m_relitResult);
+}
+
+/**
+ * Returns the number of hits and misses of the cache of the results as a text for the progress window.
+ * @brief resultCacheStatistics
+ */
+QString Relighting::resultCacheStatistics()
+{
+    return QString("Result cache : %1 hits, %2 misses, %3 MB").arg(m_resultCache.getHits()).arg(m_resultCache.getMisses())
+            .arg((qulonglong) (m_resultCache.getSize()/(1024*1024)));
+}
+
+/**
+ * Updates the last linear combination with the images whose weights changed, or recomputes it, and copies it in the relit result.
+ * Each update adds the rounding errors of delta_w*image to the result : the linear combination is recomputed from scratch after INCREMENTAL_MAXIMUM_UPDATES updates
+ * or when the changed fractions of the updates add up to INCREMENTAL_MAXIMUM_ACCUMULATED_FRACTION (the updates then cost as much as a recomputation).
+ * @brief computeIncrementalRelighting
+ */
+void Relighting::computeIncrementalRelighting()
+{
+    TraceScope traceScope("Relighting::computeIncrementalRelighting");
+
+    int rows = m_reflectanceField.rows();
+    int cols = m_reflectanceField.cols();
+    unsigned int numberOfImages = min((unsigned int) m_weightsRGB.size(), m_reflectanceField.getNumberOfImages());
+
+    //The last result can only be updated if it has been computed with the same reflectance field
+    bool canUpdate = !m_accumulatedResult.empty() && m_accumulatedResult.rows == rows && m_accumulatedResult.cols == cols
+                     && m_accumulatedVersion == m_reflectanceField.getVersion() && m_accumulatedWeights.size() == m_weightsRGB.size();
+
+    std::vector<unsigned int> changedImages;
+    std::vector<std::vector<float> > deltaWeights(m_weightsRGB.size(), std::vector<float>(3, 0.0f));
+
+    for(unsigned int i = 0 ; i<numberOfImages && canUpdate ; ++i)
+    {
+        bool changed = false;
+
+        for(int c = 0 ; c<3 ; ++c)
+        {
+            deltaWeights[i][c] = m_weightsRGB[i][c] - m_accumulatedWeights[i][c];
+            changed = changed || (deltaWeights[i][c] != 0.0f);
+        }
+
+        if(changed)
+            changedImages.push_back(i);
+    }
+
+    double changedFraction = numberOfImages > 0 ? (double) changedImages.size()/numberOfImages : 0.0;
+
+    //The updates drift from the exact linear combination : it is recomputed periodically
+    bool drifted = m_incrementalUpdates >= INCREMENTAL_MAXIMUM_UPDATES
+                   || m_accumulatedChangedFraction + changedFraction > INCREMENTAL_MAXIMUM_ACCUMULATED_FRACTION;
+
+    if(canUpdate && !drifted && changedFraction <= m_incrementalMaxChangedFraction)
+    {
+        //Add delta_w*image for the images whose weights changed
+        if(!changedImages.empty())
+        {
+            WeightedSumKernel deltaWeightedSum(m_reflectanceField, deltaWeights, m_accumulatedResult, changedImages, true);
+            parallel_for_(Range(0, rows), deltaWeightedSum, numberOfRowTiles(rows));
+
+            m_incrementalUpdates++;
+            m_accumulatedChangedFraction += changedFraction;
+        }
+    }
+    else
+    {
+        m_accumulatedResult.create(rows, cols, CV_32FC3);
+
+        WeightedSumKernel weightedSum(m_reflectanceField, m_weightsRGB, m_accumulatedResult);
+        parallel_for_(Range(0, rows), weightedSum, numberOfRowTiles(rows));
+
+        m_incrementalUpdates = 0;
+        m_accumulatedChangedFraction = 0.0;
+    }
+
+    m_accumulatedWeights = m_weightsRGB;
+    m_accumulatedVersion = m_reflectanceField.getVersion();
+
+    //The relit result is modified afterwards (background, exposure, gamma)
+    m_accumulatedResult.copyTo(m_relitResult);
+}
+
+/**
+ * Selects the lighting conditions used by the sparse relighting for the current weights and prints the bound on the dropped radiance.
+ * @brief selectSignificantImages
+ * @param OUTPUT : images numbers of the selected images in increasing order.
+ * @return an upper bound of the radiance dropped in any pixel and channel of the relit result.
+ */
+float Relighting::selectSignificantImages(std::vector<unsigned int> &images)
+{
+    unsigned int numberOfImages = min((unsigned int) m_weightsRGB.size(), m_reflectanceField.getNumberOfImages());
+
+    //Contribution of each image : |w_R|*max(R) + |w_G|*max(G) + |w_B|*max(B) (the images are in BGR format)
+    std::vector<std::pair<float, unsigned int> > contributions(numberOfImages);
+    double totalContribution = 0.0;
+
+    for(unsigned int i = 0 ; i<numberOfImages ; ++i)
+    {
+        float contribution = 0.0;
+
+        for(int c = 0 ; c<3 ; ++c)
+        {
+            contribution += fabs(m_weightsRGB[i][c])*m_reflectanceField.maxValue(i, 2-c);
+        }
+
+        contributions[i] = make_pair(contribution, i);
+        totalContribution += contribution;
+    }
+
+    sort(contributions.begin(), contributions.end(), greater<std::pair<float, unsigned int> >());
+
+    unsigned int numberOfImagesKept = numberOfImages;
+
+    if(m_sparseMode == SPARSE_TOP_K)
+    {
+        numberOfImagesKept = min(numberOfImages, (unsigned int) max(m_sparseParameter, 0.0));
+    }
+    else if(m_sparseMode == SPARSE_ENERGY)
+    {
+        double cumulativeContribution = 0.0;
+        numberOfImagesKept = 0;
+
+        while(numberOfImagesKept<numberOfImages && cumulativeContribution<m_sparseParameter*totalContribution)
+        {
+            cumulativeContribution += contributions[numberOfImagesKept].first;
+            numberOfImagesKept++;
+        }
+    }
+
+    //The images are accumulated in memory order
+    images.resize(numberOfImagesKept);
+
+    for(unsigned int k = 0 ; k<numberOfImagesKept ; ++k)
+    {
+        images[k] = contributions[k].second;
+    }
+
+    sort(images.begin(), images.end());
+
+    //|sum over the dropped images of w_i*I_i| <= sum over the dropped images of |w_i|*max(I_i) for each channel
+    float droppedRadiance[3] = {0.0, 0.0, 0.0};
+    double droppedContribution = 0.0;
+
+    for(unsigned int k = numberOfImagesKept ; k<numberOfImages ; ++k)
+    {
+        unsigned int i = contributions[k].second;
+
+        for(int c = 0 ; c<3 ; ++c)
+        {
+            droppedRadiance[c] += fabs(m_weightsRGB[i][c])*m_reflectanceField.maxValue(i, 2-c);
+        }
+
+        droppedContribution += contributions[k].first;
+    }
+
+    float droppedRadianceBound = max(droppedRadiance[0], max(droppedRadiance[1], droppedRadiance[2]));
+
+    //The selection is reported once after the parameters of the sparse relighting change
+    if(!m_sparseReported)
+    {
+        cerr << "Sparse relighting : " << numberOfImagesKept << "/" << numberOfImages << " lighting conditions - dropped radiance at most " << droppedRadianceBound;
+
+        if(totalContribution > 0.0)
+            cerr << " (" << 100.0*droppedContribution/totalContribution << "% of the total contribution)";
+
+        cerr << endl;
+        m_sparseReported = true;
+    }
+
+    return droppedRadianceBound;
+}
+
+/**
+ * Computes or loads the low rank approximation of the reflectance field that has just been loaded, then releases the reflectance field.
+ * @brief prepareLowRankReflectanceField
+ * @return EXIT_SUCCESS or EXIT_FAILURE if there is no reflectance field to approximate.
+ */
+bool Relighting::prepareLowRankReflectanceField()
+{
+    TraceScope traceScope("Relighting::prepareLowRankReflectanceField");
+
+    //The reflectance field is released once approximated : it is only present after a new loading
+    if(m_reflectanceField.empty())
+    {
+        if(m_lowRankReflectanceField.empty() || m_lowRankReflectanceField.getRank() != m_lowRankRank)
+        {
+            cerr << "No reflectance field to compute the low rank approximation of rank " << m_lowRankRank << endl;
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    //The approximation is saved once computed. Delete the file to compute it again.
+    QDir().mkpath(QString::fromStdString(this->getFolderPath() + "/low_rank"));
+
+    ostringstream filePath;
+    filePath << this->getFolderPath() << "/low_rank/" << m_object.toStdString() << "_" << m_numberOfLightingConditions << "_rank" << m_lowRankRank << ".lrrf";
+
+    //The file is only reused if it has been computed from the same images
+    string signature = this->reflectanceFieldSignature();
+
+    if(m_lowRankReflectanceField.load(filePath.str()) == EXIT_FAILURE
+       || m_lowRankReflectanceField.getSourceSignature() != signature
+       || m_lowRankReflectanceField.getNumberOfImages() != m_reflectanceField.getNumberOfImages()
+       || m_lowRankReflectanceField.rows() != m_reflectanceField.rows() || m_lowRankReflectanceField.cols() != m_reflectanceField.cols())
+    {
+        m_lowRankReflectanceField.compute(m_reflectanceField, m_lowRankRank);
+        m_lowRankReflectanceField.setSourceSignature(signature);
+        m_lowRankReflectanceField.save(filePath.str());
+    }
+
+    m_reflectanceField.release();
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Returns the SHA-1 of the size, of the storage and of the values of the reflectance field that has just been loaded.
+ * The files computed from the reflectance field (low rank approximation) are only reused if they have the same signature.
+ * @brief reflectanceFieldSignature
+ * @return SOURCE_SIGNATURE_SIZE bytes.
+ */
+string Relighting::reflectanceFieldSignature()
+{
+    const Mat &data = m_reflectanceField.getData();
+    int size[5] = {(int) m_reflectanceField.getNumberOfImages(), m_reflectanceField.rows(), m_reflectanceField.cols(),
+                   (int) m_reflectanceField.getStorage(), (int) m_reflectanceField.getLayout()};
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData((const char*) size, 5*sizeof(int));
+
+    for(int r = 0 ; r<data.rows ; r++)
+    {
+        hash.addData((const char*) data.ptr(r), data.cols*data.elemSize());
+    }
+
+    QByteArray signature = hash.result();
+
+    return string(signature.constData(), signature.size());
+}
+
+/**
+ * Returns the SHA-1 of the paths, sizes and modification dates of the images of a reflectance field and of the look-up table used to decode them.
+ * The files written from the images (out-of-core tiles) are only reused if they have the same signature.
+ * @brief sourceImagesSignature
+ * @param INPUT : paths paths of the images of the reflectance field.
+ * @param INPUT : lut look-up table from the 8 bits values to floats.
+ * @return SOURCE_SIGNATURE_SIZE bytes.
+ */
+string Relighting::sourceImagesSignature(const vector<string> &paths, const vector<float> &lut)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    for(unsigned int i = 0 ; i<paths.size() ; i++)
+    {
+        QFileInfo fileInfo(QString::fromStdString(paths[i]));
+        qint64 sizeAndDate[2] = {fileInfo.size(), fileInfo.lastModified().toMSecsSinceEpoch()};
+
+        hash.addData(paths[i].c_str(), paths[i].size());
+        hash.addData((const char*) sizeAndDate, 2*sizeof(qint64));
+    }
+
+    if(!lut.empty())
+        hash.addData((const char*) &lut[0], lut.size()*sizeof(float));
+
+    QByteArray signature = hash.result();
+
+    return string(signature.constData(), signature.size());
+}
+
+/**
+ * Maps the pack of the reflectance field and its mask if the baked reflectance fields are enabled (not used by the out-of-core relighting).
+ * The pack is rejected if it has been baked from other images (m_sourceImagesSignature).
+ * @brief mapBakedReflectanceField
+ * @param INPUT : name name of the images of the reflectance field (e.g. light_stage/plant_left_).
+ * @param INPUT : layout layout of the values in the pack.
+ * @param INPUT : storage storage of the values in the pack.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the pack is disabled, does not exist or does not match the images or the number of lighting conditions.
+ */
+bool Relighting::mapBakedReflectanceField(const string &name, reflectanceFieldLayout layout, reflectanceFieldStorage storage)
+{
+    if(!m_bakedReflectanceField || m_outOfCore)
+        return EXIT_FAILURE;
+
+    string filePath = this->bakedReflectanceFieldPath(name, layout, storage);
+
+    if(m_reflectanceFieldPack.map(filePath, m_reflectanceField, m_objectMask) == EXIT_FAILURE
+       || m_reflectanceFieldPack.getSourceSignature() != m_sourceImagesSignature
+       || m_reflectanceField.getLayout() != layout || m_reflectanceField.getStorage() != storage
+       || m_reflectanceField.getNumberOfImages() != m_numberOfLightingConditions || !m_objectMask.data)
+    {
+        //The reflectance field may still refer to the previous mapping
+        m_reflectanceField.release();
+        m_reflectanceFieldPack.unmap();
+        return EXIT_FAILURE;
+    }
+
+    cout << "Reflectance field mapped : " << filePath << endl;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Writes the pack of the reflectance field that has just been loaded and its mask if the baked reflectance fields are enabled.
+ * The reflectance field is first converted to the layout and storage of the pack : a mapped pack is then used by the relighting without being copied.
+ * @brief bakeReflectanceField
+ * @param INPUT : name name of the images of the reflectance field (e.g. light_stage/plant_left_).
+ * @param INPUT : layout layout of the values in the pack.
+ * @param INPUT : storage storage of the values in the pack.
+ */
+void Relighting::bakeReflectanceField(const string &name, reflectanceFieldLayout layout, reflectanceFieldStorage storage)
+{
+    if(!m_bakedReflectanceField || m_reflectanceField.empty())
+        return;
+
+    m_reflectanceField.setStorage(storage);
+    m_reflectanceField.setLayout(layout);
+
+    string filePath = this->bakedReflectanceFieldPath(name, layout, storage);
+    QDir().mkpath(QString::fromStdString(filePath.substr(0, filePath.find_last_of('/'))));
+
+    ReflectanceFieldPack::bake(filePath, m_reflectanceField, m_objectMask, m_sourceImagesSignature);
+}
+
+/**
+ * Returns the path of the pack of a reflectance field. Each layout and storage has its own pack.
+ * @brief bakedReflectanceFieldPath
+ * @param INPUT : name name of the images of the reflectance field (e.g. light_stage/plant_left_).
+ * @param INPUT : layout layout of the values in the pack.
+ * @param INPUT : storage storage of the values in the pack.
+ */
+string Relighting::bakedReflectanceFieldPath(const string &name, reflectanceFieldLayout layout, reflectanceFieldStorage storage)
+{
+    ostringstream filePath;
+    filePath << this->getFolderPath() << "/baked/" << name << m_numberOfLightingConditions << "_" << layout << "_" << storage << ".rfpk";
+
+    return filePath.str();
+}
+
+/**
+ * Opens the tiled file of the reflectance field, or creates it from 8 bits images decoded through a look-up table (one image in memory at a time).
+ * The file is created again if it does not match the images (size, modification date, look-up table) or the memory budget.
+ * @brief prepareTiledReflectanceField
+ * @param INPUT : paths paths of the images of the reflectance field.
+ * @param INPUT : lut 256 values of the look-up table from the 8 bits values to floats.
+ * @param INPUT : rows height of the images.
+ * @param INPUT : cols width of the images.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if an image or the file could not be read or written.
+ */
+bool Relighting::prepareTiledReflectanceField(const vector<string> &paths, const vector<float> &lut, int rows, int cols)
+{
+    //The file is written once. Delete it to write it again.
+    QDir().mkpath(QString::fromStdString(this->getFolderPath() + "/out_of_core"));
+
+    ostringstream filePath;
+    filePath << this->getFolderPath() << "/out_of_core/" << m_object.toStdString() << "_" << paths.size() << ".trf";
+
+    //The file is only reused if it has been written from the same images
+    string signature = this->sourceImagesSignature(paths, lut);
+
+    if(m_tiledReflectanceField.open(filePath.str()) == EXIT_SUCCESS
+       && m_tiledReflectanceField.getSourceSignature() == signature
+       && m_tiledReflectanceField.getNumberOfImages() == paths.size()
+       && m_tiledReflectanceField.rows() == rows && m_tiledReflectanceField.cols() == cols
+       && m_tiledReflectanceField.tileMemorySize() <= m_outOfCoreMemoryBudget)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    if(m_tiledReflectanceField.create(filePath.str(), paths.size(), rows, cols, m_outOfCoreMemoryBudget, signature) == EXIT_FAILURE)
+        return EXIT_FAILURE;
+
+    Mat lutMat(lut);
+    Mat image32F;
+
+    for(unsigned int i = 0 ; i<paths.size() ; i++)
+    {
+        Mat image = imread(paths[i], CV_LOAD_IMAGE_COLOR);
+
+        if(!image.data)
+        {
+            cerr << "Couldn't open the file : " << paths[i] << endl;
+            m_tiledReflectanceField.close();
+            return EXIT_FAILURE;
+        }
+
+        //Decoding to floats and writing in the tiles
+        LUT(image, lutMat, image32F);
+
+        if(m_tiledReflectanceField.writeImage(i, image32F) == EXIT_FAILURE)
+        {
+            m_tiledReflectanceField.close();
+            return EXIT_FAILURE;
+        }
+    }
+
+    return m_tiledReflectanceField.finish();
+}
+
 /**
  * Method that returns the path where the folders are depending on the OS.
  * @brief updateProgressWindow
  */
 std::string Relighting::getFolderPath()
 {
-    string path;
-    #if defined(__APPLE__) && defined(__MACH__)
-        path += qApp->applicationDirPath().toStdString() + "/../../..";
-    #else
-        path += qApp->applicationDirPath().toStdString();
-    #endif
-
-    return path;
+    return dataRootPath();
 }
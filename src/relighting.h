@@ -40,6 +40,10 @@
 #ifndef RELIGHTING_H
 #define RELIGHTING_H
 
+#define RESIDENT_ENVIRONMENT_MAPS_MAXIMUM 16u //Maximum number of environment maps kept in memory when the environment maps are resident
+#define INCREMENTAL_MAXIMUM_UPDATES 32u //Number of incremental updates after which the linear combination is recomputed from scratch
+#define INCREMENTAL_MAXIMUM_ACCUMULATED_FRACTION 1.0 //Sum of the changed fractions of the incremental updates after which the linear combination is recomputed from scratch
+
 #include "loadFiles.h"
 #include "mathsFunctions.h"
 #include "voronoi.h"
@@ -47,21 +51,52 @@
 #include "imageProcessing.h"
 #include "LightingBasis.h"
 #include "optimisation.h"
+#include "relightingKernels.h"
+#include "reflectanceField.h"
+#include "lowRankReflectanceField.h"
+#include "tiledReflectanceField.h"
+#include "reflectanceFieldPack.h"
+#include "reflectanceFieldLoader.h"
+#include "resultCache.h"
+#include "trace.h"
+#include "memoryTracker.h"
 
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <vector>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
 
 #include <opencv2/core/core.hpp>
 #include <opencv/highgui.h>
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include <QApplication>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMap>
+#include <QMetaObject>
 #include <QObject>
+#include <QThread>
 #include <QString>
 
 enum saveFileType{ SAVE_8BITS, SAVE_16BITS};
+enum sparseRelightingMode{ SPARSE_DISABLED, SPARSE_ENERGY, SPARSE_TOP_K};
+
+/**
+ * Environment map kept in memory when the environment maps are resident.
+ */
+struct ResidentEnvironmentMap
+{
+    cv::Mat environmentMap; /*!< HDR values of the environment map*/
+    unsigned long long lastUse; /*!< Number of the last use of the environment map (the least recently used entry is removed first)*/
+};
 
 class Relighting: public QObject
 {
@@ -83,8 +118,23 @@ class Relighting: public QObject
         /**
          * Virtual pure method to compute the relighting given an object and an environment.
          * @brief relighting
+         * @return EXIT_SUCCESS, or EXIT_FAILURE if the environment map or the images could not be loaded, if the relighting failed or if it has been cancelled.
+         */
+        bool virtual relighting() = 0;
+
+        /**
+         * Starts the relighting on the worker thread of the object and returns immediately.
+         * The object is moved to its worker thread the first time : the signals reach the graphical interface as queued signals.
+         * relightingFinished is emitted when the relighting ends or is cancelled. Does nothing if a relighting is already running.
+         * @brief startRelighting
          */
-        void virtual relighting() = 0;
+        void startRelighting();
+
+        /**
+         * Returns true if a relighting started with startRelighting is running.
+         * @brief isRunning
+         */
+        bool isRunning() const;
 
         /**
          * Sets the correct environment map name and loads the HDR image.
@@ -94,13 +144,26 @@ class Relighting: public QObject
 
         /**
          * Function to compute the final relighting (linear combination) from the reflectance field and the RGB weights.
+         * The linear combination is computed in a single pass over the reflectance field using all the cores.
          * @brief computeFinalRelighting
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the reflectance field is not available or could not be read.
+         */
+        bool computeFinalRelighting();
+
+        /**
+         * Function to compute several relightings at once from the reflectance field (one per set of RGB weights).
+         * The reflectance field is read from memory once for the whole batch instead of once per relighting.
+         * @brief computeFinalRelightingBatch
+         * @param INPUT : weightsBatch weightsBatch[o] contains the RGB weights (same format as m_weightsRGB) of relighting o.
+         * @param OUTPUT : results results[o] is the relit result (CV_32FC3) computed with weightsBatch[o].
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the reflectance field is not available or could not be read.
          */
-        void computeFinalRelighting();
+        bool computeFinalRelightingBatch(const std::vector<std::vector<std::vector<float> > > &weightsBatch, std::vector<cv::Mat> &results);
 
         /**
          * Function to raytrace the background in the final relit result
          * Applies gamma to background independently if bool parameter is set to true.
+         * The directions of the background pixels are precomputed once per size of result and mask : each offset is a gather in the environment map.
          * @brief rayTraceBackground
          * @param offset
          * @param applyGamma
@@ -135,9 +198,16 @@ class Relighting: public QObject
 
         /**
          * Save the relit result in the correct format.
+         * The exposure, the gamma correction, the clamp and the quantization are applied in a single multithreaded pass. The relit result is not modified.
+         * As with cv::pow, the gamma correction uses the absolute value of the negative values (non integer power) : they are not clamped to 0.
          * @brief saveResult
+         * @param INPUT : fileType SAVE_8BITS or SAVE_16BITS.
+         * @param INPUT : filePath path of the file.
+         * @param INPUT : exposure exposure in stops applied to the relit result (the values are multiplied by 2^exposure).
+         * @param INPUT : gamma gamma correction applied after the exposure.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the file type is unknown.
          */
-        bool saveResult(saveFileType fileType, std::string filePath);
+        bool saveResult(saveFileType fileType, std::string filePath, double exposure = 0.0, double gamma = 1.0);
 
         /**
          * Display the final relighting.
@@ -180,12 +250,129 @@ class Relighting: public QObject
          */
         void setNumberOfLightingConditions(unsigned int numberOfLightingConditions);
 
+        /**
+         * Methods that sets the layout of the reflectance field in memory used for the linear combination.
+         * The reflectance field is loaded and prepared image by image and transposed to this layout before the first relighting.
+         * @brief setReflectanceFieldLayout
+         * @param INPUT : layout IMAGE_MAJOR (default) or PIXEL_MAJOR.
+         */
+        void setReflectanceFieldLayout(reflectanceFieldLayout layout);
+
+        /**
+         * Methods that sets the type used to store the reflectance field in memory.
+         * STORAGE_FLOAT16 halves and STORAGE_UINT8 quarters the memory used by the reflectance field. The values are dequantized during the linear combination.
+         * @brief setReflectanceFieldStorage
+         * @param INPUT : storage STORAGE_FLOAT32 (default), STORAGE_FLOAT16 or STORAGE_UINT8.
+         */
+        void setReflectanceFieldStorage(reflectanceFieldStorage storage);
+
+        /**
+         * Upper bound of the difference between the relit result computed with the stored reflectance field and with 32 bits floats, for the current weights.
+         * @brief storageErrorBound
+         * @return the maximum absolute error over the three channels.
+         */
+        float storageErrorBound();
+
+        /**
+         * Methods that enables the relighting in the compressed domain of a low rank approximation of the reflectance field.
+         * The approximation is computed (or loaded from the folder low_rank) before the first relighting, then the full reflectance field is released.
+         * @brief setLowRankRelighting
+         * @param INPUT : rank number of basis images kept in each tile. 0 disables the low rank relighting.
+         */
+        void setLowRankRelighting(unsigned int rank);
+
+        /**
+         * Methods that enables the sparse relighting : only the lighting conditions with a significant contribution are used in the linear combination.
+         * The contribution of a lighting condition is its weight multiplied by the maximum value of its image.
+         * @brief setSparseRelighting
+         * @param INPUT : mode SPARSE_DISABLED, SPARSE_ENERGY (the most significant conditions are kept until parameter (in [0:1]) of the total contribution is reached)
+         * or SPARSE_TOP_K (the parameter most significant conditions are kept).
+         * @param INPUT : parameter fraction of the total contribution (SPARSE_ENERGY) or number of lighting conditions (SPARSE_TOP_K).
+         */
+        void setSparseRelighting(sparseRelightingMode mode, double parameter);
+
+        /**
+         * Methods that enables the incremental relighting : the last linear combination and its weights are kept
+         * and only the images whose weights changed are added (with the difference of the weights) to the last result.
+         * The linear combination is recomputed from scratch if too many weights changed or if the reflectance field changed.
+         * The rounding errors of the updates add up : it is also recomputed after INCREMENTAL_MAXIMUM_UPDATES updates, or when the changed fractions
+         * of the updates since the last recomputation add up to INCREMENTAL_MAXIMUM_ACCUMULATED_FRACTION.
+         * @brief setIncrementalRelighting
+         * @param INPUT : incrementalRelighting true to enable the incremental relighting.
+         * @param INPUT : maxChangedFraction maximum fraction of the lighting conditions whose weights changed for an incremental update.
+         */
+        void setIncrementalRelighting(bool incrementalRelighting, double maxChangedFraction = 0.25);
+
+        /**
+         * Methods that enables the out-of-core relighting for reflectance fields larger than the memory.
+         * The images are written once in a tiled file (folder out_of_core) while they are loaded, and the relighting reads one tile at a time.
+         * The low rank, sparse and incremental relightings are not used in this mode. Only the light stage relighting reads a tiled file :
+         * the free form and office room relightings modify their images after the loading and fail if this mode is enabled.
+         * One row of all the images must fit in the memory budget.
+         * @brief setOutOfCoreRelighting
+         * @param INPUT : outOfCore true to enable the out-of-core relighting.
+         * @param INPUT : memoryBudget maximum size in bytes of the part of the reflectance field in memory (one tile).
+         */
+        void setOutOfCoreRelighting(bool outOfCore, size_t memoryBudget = 512*1024*1024);
+
+        /**
+         * Methods that enables the baked reflectance fields : the first loading writes the linear reflectance field and the mask in a pack file (folder baked),
+         * the next loadings map the pack in memory instead of decoding the images. Delete the pack to bake it again.
+         * @brief setBakedReflectanceField
+         * @param INPUT : bakedReflectanceField true to enable the baked reflectance fields.
+         */
+        void setBakedReflectanceField(bool bakedReflectanceField);
+
+        /**
+         * Methods that keeps the environment maps that have been loaded in memory : loading them again does not read the file.
+         * At most RESIDENT_ENVIRONMENT_MAPS_MAXIMUM environment maps are kept : the least recently used one is removed first.
+         * @brief setResidentEnvironmentMaps
+         * @param INPUT : residentEnvironmentMaps true to keep the environment maps in memory.
+         */
+        void setResidentEnvironmentMaps(bool residentEnvironmentMaps);
+
+        /**
+         * Returns the size in bytes of the data kept in memory between two relightings (reflectance field, mask and environment maps).
+         * @brief residentMemory
+         */
+        size_t virtual residentMemory();
+
+        /**
+         * Methods that enables the cache of the results (folder result_cache) : the weights and the linear relit result of each offset are stored on disk,
+         * under a hash of the object, of the content of the environment map, of the basis and of the parameters. An offset found in the cache is not computed again.
+         * @brief setResultCache
+         * @param INPUT : resultCache true to enable the cache of the results.
+         * @param INPUT : maximumSize maximum size in bytes of the cache. The least recently used results are removed above this size.
+         */
+        void setResultCache(bool resultCache, size_t maximumSize = 1024*1024*1024);
+
+        /**
+         * Methods that sets the tolerance of the integration of the weights on the pyramids of the environment map and of the label maps (see environmentMapPyramid.h) :
+         * maximum fraction of the solid angle given to a wrong light source. 0 (default) computes the weights at full resolution.
+         * @brief setPyramidTolerance
+         * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong light source.
+         */
+        void virtual setPyramidTolerance(double tolerance);
+
+        /**
+         * Returns the cache of the results (number of hits and misses, size).
+         * @brief getResultCache
+         */
+        const ResultCache &getResultCache() const;
+
         /**
          * Restart the relighting by reinitialising all the variables.
          * @brief clearRelighting
          */
         void virtual clearRelighting() = 0;
 
+        /**
+         * Steps of the relighting that need the graphical interface (manual identification of the light sources).
+         * Called by startRelighting on the calling thread before the relighting is given to the worker thread. Does nothing by default.
+         * @brief identifyLightsBeforeStart
+         */
+        void virtual identifyLightsBeforeStart();
+
         /**
          * Virtual method to update the progress window.
          * @brief updateProgressWindow
@@ -198,14 +385,239 @@ class Relighting: public QObject
          */
         std::string getFolderPath();
 
+    public slots:
+
+        /**
+         * Qt slot that asks the running relighting to stop. The relighting stops at the next check (between the offsets and in the rows of the computations of the weights).
+         * Can be called from any thread (connect it with Qt::DirectConnection).
+         * @brief cancelRelighting
+         */
+        void cancelRelighting();
+
+        /**
+         * Qt slot that runs the relighting on the worker thread (invoked by startRelighting) and emits relightingFinished.
+         * @brief runRelighting
+         */
+        void runRelighting();
+
+    signals:
+
+        /**
+         * Qt signal emitted on the worker thread when a relighting started with startRelighting ends or is cancelled.
+         * @brief relightingFinished
+         */
+        void relightingFinished();
+
     protected:
+        /**
+         * Returns true if the relighting has been cancelled. Prints the cancellation the first time it is noticed.
+         * @brief isCancelled
+         */
+        bool isCancelled();
+
+        /**
+         * Cancels the running relighting, waits for it and stops the worker thread.
+         * Called by the destructors of the derived classes before they release their members.
+         * @brief stopWorkerThread
+         */
+        void stopWorkerThread();
+
+        /**
+         * Computes or loads the low rank approximation of the reflectance field that has just been loaded, then releases the reflectance field.
+         * @brief prepareLowRankReflectanceField
+         * @return EXIT_SUCCESS or EXIT_FAILURE if there is no reflectance field to approximate.
+         */
+        bool prepareLowRankReflectanceField();
+
+        /**
+         * Returns the SHA-1 of the size, of the storage and of the values of the reflectance field that has just been loaded.
+         * The files computed from the reflectance field (low rank approximation) are only reused if they have the same signature.
+         * @brief reflectanceFieldSignature
+         * @return SOURCE_SIGNATURE_SIZE bytes.
+         */
+        std::string reflectanceFieldSignature();
+
+        /**
+         * Returns the SHA-1 of the paths, sizes and modification dates of the images of a reflectance field and of the look-up table used to decode them.
+         * The files written from the images (out-of-core tiles) are only reused if they have the same signature.
+         * @brief sourceImagesSignature
+         * @param INPUT : paths paths of the images of the reflectance field.
+         * @param INPUT : lut look-up table from the 8 bits values to floats.
+         * @return SOURCE_SIGNATURE_SIZE bytes.
+         */
+        std::string sourceImagesSignature(const std::vector<std::string> &paths, const std::vector<float> &lut);
+
+        /**
+         * Maps the pack of the reflectance field and its mask if the baked reflectance fields are enabled (not used by the out-of-core relighting).
+         * The pack is rejected if it has been baked from other images (m_sourceImagesSignature).
+         * @brief mapBakedReflectanceField
+         * @param INPUT : name name of the images of the reflectance field (e.g. light_stage/plant_left_).
+         * @param INPUT : layout layout of the values in the pack.
+         * @param INPUT : storage storage of the values in the pack.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the pack is disabled, does not exist or does not match the images or the number of lighting conditions.
+         */
+        bool mapBakedReflectanceField(const std::string &name, reflectanceFieldLayout layout, reflectanceFieldStorage storage);
+
+        /**
+         * Writes the pack of the reflectance field that has just been loaded and its mask if the baked reflectance fields are enabled.
+         * The reflectance field is first converted to the layout and storage of the pack : a mapped pack is then used by the relighting without being copied.
+         * @brief bakeReflectanceField
+         * @param INPUT : name name of the images of the reflectance field (e.g. light_stage/plant_left_).
+         * @param INPUT : layout layout of the values in the pack.
+         * @param INPUT : storage storage of the values in the pack.
+         */
+        void bakeReflectanceField(const std::string &name, reflectanceFieldLayout layout, reflectanceFieldStorage storage);
+
+        /**
+         * Returns the path of the pack of a reflectance field. Each layout and storage has its own pack.
+         * @brief bakedReflectanceFieldPath
+         * @param INPUT : name name of the images of the reflectance field (e.g. light_stage/plant_left_).
+         * @param INPUT : layout layout of the values in the pack.
+         * @param INPUT : storage storage of the values in the pack.
+         */
+        std::string bakedReflectanceFieldPath(const std::string &name, reflectanceFieldLayout layout, reflectanceFieldStorage storage);
+
+        /**
+         * Opens the tiled file of the reflectance field, or creates it from 8 bits images decoded through a look-up table (one image in memory at a time).
+         * The file is created again if it does not match the images (size, modification date, look-up table) or the memory budget.
+         * @brief prepareTiledReflectanceField
+         * @param INPUT : paths paths of the images of the reflectance field.
+         * @param INPUT : lut 256 values of the look-up table from the 8 bits values to floats.
+         * @param INPUT : rows height of the images.
+         * @param INPUT : cols width of the images.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if an image or the file could not be read or written.
+         */
+        bool prepareTiledReflectanceField(const std::vector<std::string> &paths, const std::vector<float> &lut, int rows, int cols);
+
+        /**
+         * Selects the lighting conditions used by the sparse relighting for the current weights and prints the bound on the dropped radiance.
+         * @brief selectSignificantImages
+         * @param OUTPUT : images numbers of the selected images in increasing order.
+         * @return an upper bound of the radiance dropped in any pixel and channel of the relit result.
+         */
+        float selectSignificantImages(std::vector<unsigned int> &images);
+
+        /**
+         * Updates the last linear combination with the images whose weights changed, or recomputes it, and copies it in the relit result.
+         * Each update adds the rounding errors of delta_w*image to the result : the linear combination is recomputed from scratch after INCREMENTAL_MAXIMUM_UPDATES updates
+         * or when the changed fractions of the updates add up to INCREMENTAL_MAXIMUM_ACCUMULATED_FRACTION (the updates then cost as much as a recomputation).
+         * @brief computeIncrementalRelighting
+         */
+        void computeIncrementalRelighting();
+
+        /**
+         * Precomputes the background pixels of the relit result and the latitude longitude coordinates of their directions (without offset).
+         * @brief computeBackgroundTable
+         */
+        void computeBackgroundTable();
+
+        /**
+         * Tabulates the transfer function of the saved images (exposure, gamma and quantization) for the OutputStageKernel.
+         * @brief outputThresholds
+         * @param INPUT : maxValue maximum output value (255 or 65535).
+         * @param INPUT : exposure exposure in stops.
+         * @param INPUT : gamma gamma correction applied after the exposure.
+         * @param OUTPUT : thresholds linear values where the output value changes (maxValue values).
+         * @return true if the negative values are converted as their absolute value (gamma correction with a non integer power, as cv::pow), false if they are clamped to 0.
+         */
+        bool outputThresholds(int maxValue, double exposure, double gamma, std::vector<float> &thresholds) const;
+
+        /**
+         * Returns the key of the result of an offset in the cache of the results, or an empty key if the cache is disabled.
+         * The key is a hash of the reflectance field (data folder, object, number of lighting conditions, storage, low rank and sparse parameters), of the content of the environment map,
+         * of the light type, of the offset and of the parameters of the method (basis, identification...).
+         * @brief resultCacheKey
+         * @param INPUT : offset rotation of the environment map (phi angle).
+         * @param INPUT : parameters basis and parameters specific to the method.
+         */
+        QByteArray resultCacheKey(float offset, const std::string &parameters);
+
+        /**
+         * Reads m_weightsRGB and m_relitResult from the cache of the results.
+         * @brief loadCachedResult
+         * @param INPUT : key key of the result (empty if the cache is disabled).
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the result is not in the cache.
+         */
+        bool loadCachedResult(const QByteArray &key);
+
+        /**
+         * Writes m_weightsRGB and m_relitResult (linear combination, before the background and the exposure) in the cache of the results.
+         * @brief storeCachedResult
+         * @param INPUT : key key of the result (empty if the cache is disabled).
+         */
+        void storeCachedResult(const QByteArray &key);
+
+        /**
+         * Returns the number of hits and misses of the cache of the results as a text for the progress window.
+         * @brief resultCacheStatistics
+         */
+        QString resultCacheStatistics();
+
+        /**
+         * Gives the sizes of the buffers of the relighting (reflectance field, environment maps, mask and results) to the memory tracker, under the name of the object.
+         * @brief updateTrackedMemory
+         */
+        void updateTrackedMemory();
+
+        /**
+         * Sets the sizes of the buffers of the relighting to 0 in the memory tracker.
+         * @brief releaseTrackedMemory
+         */
+        void releaseTrackedMemory();
+
+        /**
+         * Returns the size in bytes of the environment maps in memory (current environment map and environment maps kept in memory).
+         * @brief environmentMapsMemorySize
+         */
+        size_t environmentMapsMemorySize() const;
+
+        QThread* m_workerThread; /*!< Thread on which the relightings started with startRelighting are computed (created the first time)*/
+        QAtomicInt m_running; /*!< 1 while a relighting started with startRelighting is running*/
+        QAtomicInt m_cancelled; /*!< Cancel token set by cancelRelighting and checked by the loops of the relighting*/
+
         QString m_object; /*!< Name of the object used for the relighting*/
         QString m_environmentMapName; /*!< Name of the environment map*/
         QString m_lightType; /*!< Name of the type of lights used*/
         unsigned int m_numberOfOffsets; /*!< Number of rotations of the environment map*/
 
         //Reflectance field parameters
-        cv::Mat* m_reflectanceField; /*!< Reflectance field*/
+        ReflectanceField m_reflectanceField; /*!< Reflectance field*/
+        reflectanceFieldLayout m_reflectanceFieldLayout; /*!< Layout of the reflectance field used for the linear combination*/
+        reflectanceFieldStorage m_reflectanceFieldStorage; /*!< Type used to store the reflectance field during the linear combination*/
+        LowRankReflectanceField m_lowRankReflectanceField; /*!< Low rank approximation of the reflectance field*/
+        unsigned int m_lowRankRank; /*!< Rank of the low rank relighting (0 if disabled)*/
+        sparseRelightingMode m_sparseMode; /*!< Selection of the lighting conditions in the sparse relighting*/
+        double m_sparseParameter; /*!< Fraction of the contribution or number of lighting conditions kept in the sparse relighting*/
+        bool m_sparseReported; /*!< True if the selection of the sparse relighting has been reported since its parameters changed*/
+        TiledReflectanceField m_tiledReflectanceField; /*!< Reflectance field on disk used by the out-of-core relighting*/
+        bool m_outOfCore; /*!< True if the out-of-core relighting is enabled*/
+        size_t m_outOfCoreMemoryBudget; /*!< Maximum size in bytes of a tile of the out-of-core reflectance field*/
+        ReflectanceFieldPack m_reflectanceFieldPack; /*!< Mapped pack used by the reflectance field when it is baked*/
+        bool m_bakedReflectanceField; /*!< True if the reflectance fields are baked in pack files*/
+        std::string m_sourceImagesSignature; /*!< Signature of the images of the reflectance field (see sourceImagesSignature), set by loadReflectanceField*/
+        bool m_residentEnvironmentMaps; /*!< True if the environment maps that have been loaded are kept in memory*/
+        QMap<QString, ResidentEnvironmentMap> m_environmentMapCache; /*!< Environment maps kept in memory, by file name (at most RESIDENT_ENVIRONMENT_MAPS_MAXIMUM entries)*/
+        unsigned long long m_environmentMapCacheUses; /*!< Number of uses of m_environmentMapCache (date of the entries)*/
+        bool m_useResultCache; /*!< True if the cache of the results is enabled*/
+        ResultCache m_resultCache; /*!< Cache of the weights and linear relit results*/
+        QByteArray m_environmentMapHash; /*!< Hash of the content of the environment map (computed when a key is needed)*/
+        double m_pyramidTolerance; /*!< Tolerance of the integration of the weights on the pyramids (0 : full resolution)*/
+        bool m_incrementalRelighting; /*!< True if the incremental relighting is enabled*/
+        double m_incrementalMaxChangedFraction; /*!< Maximum fraction of changed weights for an incremental update*/
+        cv::Mat m_accumulatedResult; /*!< Last linear combination (before background, exposure and gamma)*/
+        std::vector<std::vector<float> > m_accumulatedWeights; /*!< Weights of the last linear combination*/
+        unsigned int m_accumulatedVersion; /*!< Version of the reflectance field used for the last linear combination*/
+        unsigned int m_incrementalUpdates; /*!< Number of incremental updates since the last linear combination computed from scratch*/
+        double m_accumulatedChangedFraction; /*!< Sum of the changed fractions of the incremental updates since the last linear combination computed from scratch*/
+        std::string m_memoryOwner; /*!< Name under which the buffers are tracked by the memory tracker (empty if not tracked yet)*/
+
+        //Background ray tracing table
+        std::vector<int> m_backgroundPixels; /*!< Index (row*width+column) of each background pixel in the relit result*/
+        std::vector<int> m_backgroundRows; /*!< Row of the environment map seen by each background pixel (theta)*/
+        std::vector<float> m_backgroundPhi; /*!< Azimuthal angle phi (without offset) of the direction of each background pixel*/
+        cv::Size m_backgroundTableSize; /*!< Size of the relit result used to compute the table*/
+        cv::Mat m_backgroundTableMask; /*!< Mask used to compute the table (shares the data of the mask)*/
+        unsigned int m_backgroundTableEnvironmentMapHeight; /*!< Height of the environment map used to compute the table*/
         unsigned int m_numberOfLightingConditions; /*!< Number of lighting conditions*/
         cv::Mat m_objectMask; /*!< Mask of the object (to raytrace background)*/
 
@@ -218,6 +630,7 @@ class Relighting: public QObject
         //Result
         std::vector<std::vector<float> > m_weightsRGB;
         cv::Mat m_relitResult;
+        cv::Mat m_outputImage; /*!< Quantized image saved by saveResult*/
 };
 
 #endif // RELIGHTING_H
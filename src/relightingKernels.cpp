@@ -0,0 +1,557 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file relightingKernels.cpp
+ * \brief Multithreaded kernels used in the hot loops of the relighting.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The kernels are OpenCV ParallelLoopBody objects. They are executed with cv::parallel_for_ and each thread processes a tile of rows of the final result.
+ */
+
+#include "relightingKernels.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Constructor of the WeightedSumKernel class. All the images are used in the linear combination.
+ * @brief WeightedSumKernel
+ * @param INPUT : reflectanceField reflectance field (any layout).
+ * @param INPUT : weightsRGB weights of each image. weightsRGB[i] contains the R, G and B weights of image i.
+ * @param OUTPUT : result CV_32FC3 image that has already been allocated with the size of the reflectance field.
+ */
+WeightedSumKernel::WeightedSumKernel(const ReflectanceField &reflectanceField, const vector<vector<float> > &weightsRGB, Mat &result):
+    m_reflectanceField(reflectanceField), m_numberOfImages(reflectanceField.getNumberOfImages()), m_images(vector<unsigned int>()), m_allImages(true),
+    m_accumulate(false), m_weightsBGR(), m_result(result)
+{
+    m_images.resize(m_numberOfImages);
+
+    for(unsigned int i = 0 ; i<m_numberOfImages ; ++i)
+    {
+        m_images[i] = i;
+    }
+
+    this->setWeights(weightsRGB);
+}
+
+/**
+ * Constructor of the WeightedSumKernel class. Only a subset of the images is used in the linear combination.
+ * @brief WeightedSumKernel
+ * @param INPUT : reflectanceField reflectance field (any layout).
+ * @param INPUT : weightsRGB weights of each image. weightsRGB[i] contains the R, G and B weights of image i.
+ * @param OUTPUT : result CV_32FC3 image that has already been allocated with the size of the reflectance field.
+ * @param INPUT : images numbers of the images used in the linear combination. The linear combination is 0 if it is empty.
+ * @param INPUT : accumulate if true the linear combination is added to the values already in result.
+ */
+WeightedSumKernel::WeightedSumKernel(const ReflectanceField &reflectanceField, const vector<vector<float> > &weightsRGB, Mat &result,
+                                     const vector<unsigned int> &images, bool accumulate):
+    m_reflectanceField(reflectanceField), m_numberOfImages(reflectanceField.getNumberOfImages()), m_images(images), m_allImages(false),
+    m_accumulate(accumulate), m_weightsBGR(), m_result(result)
+{
+    this->setWeights(weightsRGB);
+}
+
+/**
+ * Stores the weights of the images used in the linear combination in BGR order and multiplied by the scale factors of the images.
+ * @brief setWeights
+ * @param INPUT : weightsRGB weights of each image.
+ */
+void WeightedSumKernel::setWeights(const vector<vector<float> > &weightsRGB)
+{
+    m_weightsBGR.assign(3*m_images.size(), 0.0f);
+
+    //OpenCV uses images in BGR format
+    //The scale factor of the quantized images is applied to the weights
+    for(unsigned int k = 0 ; k<m_images.size() ; ++k)
+    {
+        unsigned int i = m_images[k];
+        float scale = m_reflectanceField.getScale(i);
+
+        m_weightsBGR[3*k] = scale*weightsRGB[i][2];
+        m_weightsBGR[3*k+1] = scale*weightsRGB[i][1];
+        m_weightsBGR[3*k+2] = scale*weightsRGB[i][0];
+    }
+}
+
+/**
+ * Computes the linear combination for the rows in the range.
+ * @brief operator ()
+ * @param INPUT : rows range of rows of the result computed by the calling thread.
+ */
+void WeightedSumKernel::operator()(const Range &rows) const
+{
+    int width = m_result.cols;
+    bool pixelMajor = (m_reflectanceField.getLayout() == PIXEL_MAJOR);
+
+    //Dequantized values of a pixel (PIXEL_MAJOR) or of a row of an image (IMAGE_MAJOR)
+    vector<float> buffer(pixelMajor ? 3*m_numberOfImages : 3*width);
+
+    for(int r = rows.start ; r<rows.end ; ++r)
+    {
+        float* dst = (float*) m_result.ptr<float>(r);
+
+        if(pixelMajor)
+        {
+            //All the lighting conditions of a pixel are contiguous
+            for(int c = 0 ; c<width ; ++c)
+            {
+                const float* pixel = floatValues(m_reflectanceField, m_reflectanceField.pixel(r, c), 3*m_numberOfImages, &buffer[0]);
+                float relitPixel[3] = {0.0f, 0.0f, 0.0f};
+
+                if(m_allImages)
+                {
+                    dotProductBGR(pixel, &m_weightsBGR[0], m_numberOfImages, relitPixel);
+                }
+                else
+                {
+                    //Only the selected lighting conditions are gathered
+                    for(unsigned int k = 0 ; k<m_images.size() ; ++k)
+                    {
+                        const float* condition = pixel + 3*m_images[k];
+
+                        relitPixel[0] += m_weightsBGR[3*k]*condition[0];
+                        relitPixel[1] += m_weightsBGR[3*k+1]*condition[1];
+                        relitPixel[2] += m_weightsBGR[3*k+2]*condition[2];
+                    }
+                }
+
+                if(m_accumulate)
+                {
+                    dst[3*c] += relitPixel[0];
+                    dst[3*c+1] += relitPixel[1];
+                    dst[3*c+2] += relitPixel[2];
+                }
+                else
+                {
+                    dst[3*c] = relitPixel[0];
+                    dst[3*c+1] = relitPixel[1];
+                    dst[3*c+2] = relitPixel[2];
+                }
+            }
+        }
+        else
+        {
+            //The row of the result stays in the cache while the rows of the images are streamed
+            if(!m_accumulate)
+                memset(dst, 0, 3*width*sizeof(float));
+
+            for(unsigned int k = 0 ; k<m_images.size() ; ++k)
+            {
+                const float* src = floatValues(m_reflectanceField, m_reflectanceField.imageRow(m_images[k], r), 3*width, &buffer[0]);
+                weightedSumRow(src, &m_weightsBGR[3*k], dst, width);
+            }
+        }
+    }
+}
+
+/**
+ * Constructor of the BatchWeightedSumKernel class.
+ * @brief BatchWeightedSumKernel
+ * @param INPUT : reflectanceField reflectance field (any layout).
+ * @param INPUT : weightsBatch weights of each output. weightsBatch[o][i] contains the R, G and B weights of image i for output o.
+ * @param OUTPUT : results CV_32FC3 images that have already been allocated with the size of the reflectance field. results[o] is output o.
+ */
+BatchWeightedSumKernel::BatchWeightedSumKernel(const ReflectanceField &reflectanceField, const vector<vector<vector<float> > > &weightsBatch,
+                                               vector<Mat> &results):
+    m_reflectanceField(reflectanceField), m_numberOfImages(reflectanceField.getNumberOfImages()), m_numberOfOutputs(weightsBatch.size()),
+    m_weightsBGR(3*m_numberOfImages*weightsBatch.size(), 0.0f), m_results(results)
+{
+    bool pixelMajor = (m_reflectanceField.getLayout() == PIXEL_MAJOR);
+
+    //IMAGE_MAJOR : the weights are stored image by image so that the inner loop over the outputs reads them contiguously
+    //PIXEL_MAJOR : the weights are stored output by output so that each dot product reads them contiguously
+    //OpenCV uses images in BGR format
+    //The scale factor of the quantized images is applied to the weights
+    for(unsigned int i = 0 ; i<m_numberOfImages ; ++i)
+    {
+        float scale = m_reflectanceField.getScale(i);
+
+        for(unsigned int o = 0 ; o<m_numberOfOutputs ; ++o)
+        {
+            unsigned int index = pixelMajor ? 3*(o*m_numberOfImages+i) : 3*(i*m_numberOfOutputs+o);
+
+            m_weightsBGR[index] = scale*weightsBatch[o][i][2];
+            m_weightsBGR[index+1] = scale*weightsBatch[o][i][1];
+            m_weightsBGR[index+2] = scale*weightsBatch[o][i][0];
+        }
+    }
+}
+
+/**
+ * Computes the linear combinations for the rows in the range.
+ * @brief operator ()
+ * @param INPUT : rows range of rows of the results computed by the calling thread.
+ */
+void BatchWeightedSumKernel::operator()(const Range &rows) const
+{
+    if(m_numberOfOutputs == 0)
+        return;
+
+    int width = m_results[0].cols;
+    bool pixelMajor = (m_reflectanceField.getLayout() == PIXEL_MAJOR);
+    vector<float*> dst(m_numberOfOutputs);
+
+    //Dequantized values of a pixel (PIXEL_MAJOR) or of a block of an image (IMAGE_MAJOR)
+    vector<float> buffer(pixelMajor ? 3*m_numberOfImages : 3*RELIGHTING_PIXELS_PER_BLOCK);
+
+    for(int r = rows.start ; r<rows.end ; ++r)
+    {
+        for(unsigned int o = 0 ; o<m_numberOfOutputs ; ++o)
+        {
+            dst[o] = (float*) m_results[o].ptr<float>(r);
+        }
+
+        if(pixelMajor)
+        {
+            //The lighting conditions of the pixel are read once from memory and stay in the cache for all the outputs
+            for(int c = 0 ; c<width ; ++c)
+            {
+                const float* pixel = floatValues(m_reflectanceField, m_reflectanceField.pixel(r, c), 3*m_numberOfImages, &buffer[0]);
+
+                for(unsigned int o = 0 ; o<m_numberOfOutputs ; ++o)
+                {
+                    dotProductBGR(pixel, &m_weightsBGR[3*o*m_numberOfImages], m_numberOfImages, dst[o]+3*c);
+                }
+            }
+
+            continue;
+        }
+
+        for(int jStart = 0 ; jStart<width ; jStart += RELIGHTING_PIXELS_PER_BLOCK)
+        {
+            int blockWidth = min(RELIGHTING_PIXELS_PER_BLOCK, width-jStart);
+
+            for(unsigned int o = 0 ; o<m_numberOfOutputs ; ++o)
+            {
+                memset(dst[o]+3*jStart, 0, 3*blockWidth*sizeof(float));
+            }
+
+            //The block of image i is read once from memory and stays in the cache for all the outputs
+            for(unsigned int i = 0 ; i<m_numberOfImages ; ++i)
+            {
+                const float* src = floatValues(m_reflectanceField, m_reflectanceField.imageRow(i, r, jStart), 3*blockWidth, &buffer[0]);
+                const float* weights = &m_weightsBGR[3*i*m_numberOfOutputs];
+
+                for(unsigned int o = 0 ; o<m_numberOfOutputs ; ++o)
+                {
+                    weightedSumRow(src, weights+3*o, dst[o]+3*jStart, blockWidth);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Constructor of the LowRankFactorizationKernel class.
+ * @brief LowRankFactorizationKernel
+ * @param INPUT : reflectanceField reflectance field to approximate.
+ * @param OUTPUT : lowRankReflectanceField low rank reflectance field whose tiles have already been allocated.
+ */
+LowRankFactorizationKernel::LowRankFactorizationKernel(const ReflectanceField &reflectanceField, LowRankReflectanceField &lowRankReflectanceField):
+    m_reflectanceField(reflectanceField), m_lowRankReflectanceField(lowRankReflectanceField)
+{
+
+}
+
+/**
+ * Computes the PCA of the tiles in the range.
+ * @brief operator ()
+ * @param INPUT : tiles range of tiles computed by the calling thread.
+ */
+void LowRankFactorizationKernel::operator()(const Range &tiles) const
+{
+    //Each tile is written by one thread only
+    for(int t = tiles.start ; t<tiles.end ; ++t)
+    {
+        m_lowRankReflectanceField.computeTile(t, m_reflectanceField);
+    }
+}
+
+/**
+ * Constructor of the LowRankWeightedSumKernel class.
+ * @brief LowRankWeightedSumKernel
+ * @param INPUT : lowRankReflectanceField low rank reflectance field.
+ * @param INPUT : weightsRGB weights of each image. weightsRGB[i] contains the R, G and B weights of image i.
+ * @param OUTPUT : result CV_32FC3 image that has already been allocated with the size of the reflectance field.
+ */
+LowRankWeightedSumKernel::LowRankWeightedSumKernel(const LowRankReflectanceField &lowRankReflectanceField, const vector<vector<float> > &weightsRGB, Mat &result):
+    m_lowRankReflectanceField(lowRankReflectanceField), m_weightsBGR(3*lowRankReflectanceField.getNumberOfImages(), 0.0f), m_result(result)
+{
+    //OpenCV uses images in BGR format
+    for(unsigned int i = 0 ; i<m_lowRankReflectanceField.getNumberOfImages() ; ++i)
+    {
+        m_weightsBGR[3*i] = weightsRGB[i][2];
+        m_weightsBGR[3*i+1] = weightsRGB[i][1];
+        m_weightsBGR[3*i+2] = weightsRGB[i][0];
+    }
+}
+
+/**
+ * Computes the linear combination for the tiles in the range.
+ * @brief operator ()
+ * @param INPUT : tiles range of tiles of the result computed by the calling thread.
+ */
+void LowRankWeightedSumKernel::operator()(const Range &tiles) const
+{
+    Mat result = m_result;
+
+    for(int t = tiles.start ; t<tiles.end ; ++t)
+    {
+        m_lowRankReflectanceField.relightTile(t, &m_weightsBGR[0], result);
+    }
+}
+
+/**
+ * Constructor of the BackgroundKernel class.
+ * @brief BackgroundKernel
+ * @param INPUT : pixels index (row*width+column) of each background pixel in the result.
+ * @param INPUT : rows row of the environment map seen by each background pixel.
+ * @param INPUT : phi azimuthal angle (without offset) of the direction of each background pixel.
+ * @param INPUT : environmentMap CV_32FC3 latitude longitude environment map.
+ * @param INPUT : offset rotation of the environment map.
+ * @param INPUT : applyGamma if true the gamma correction is applied to the background.
+ * @param INPUT : gamma gamma of the correction.
+ * @param OUTPUT : result CV_32FC3 continuous relit result.
+ */
+BackgroundKernel::BackgroundKernel(const vector<int> &pixels, const vector<int> &rows, const vector<float> &phi, const Mat &environmentMap,
+                                   float offset, bool applyGamma, double gamma, Mat &result):
+    m_pixels(pixels), m_rows(rows), m_phi(phi), m_environmentMap(environmentMap), m_offset(offset), m_applyGamma(applyGamma), m_gamma(gamma), m_result(result)
+{
+
+}
+
+/**
+ * Copies the environment map in the background pixels of the range.
+ * @brief operator ()
+ * @param INPUT : range range of background pixels computed by the calling thread.
+ */
+void BackgroundKernel::operator()(const Range &range) const
+{
+    int environmentMapWidth = m_environmentMap.cols;
+    float* result = (float*) m_result.ptr<float>();
+
+    for(int k = range.start ; k<range.end ; ++k)
+    {
+        //The offset is a rotation around the vertical axis : only the column of the environment map changes
+        float phi = moduloRealNumber(m_phi[k] + m_offset, 2.0*M_PI);
+        int J = min((int) floor(environmentMapWidth*phi/(2.0*M_PI)), environmentMapWidth-1);
+
+        const float* src = m_environmentMap.ptr<float>(m_rows[k]) + 3*J;
+        float* dst = result + 3*m_pixels[k];
+
+        if(m_applyGamma)
+        {
+            dst[0] = pow(src[0], 1.0/m_gamma);
+            dst[1] = pow(src[1], 1.0/m_gamma);
+            dst[2] = pow(src[2], 1.0/m_gamma);
+        }
+        else
+        {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+    }
+}
+
+/**
+ * Constructor of the OutputStageKernel class.
+ * @brief OutputStageKernel
+ * @param INPUT : relitResult CV_32FC3 linear relit result.
+ * @param INPUT : thresholds increasing linear values. The output value is the number of thresholds lower or equal to the linear value (0 for NaN).
+ * @param INPUT : absoluteValues true to convert the negative values as their absolute value, false to clamp them to 0.
+ * @param OUTPUT : output CV_8UC3 or CV_16UC3 image that has already been allocated with the size of the relit result.
+ */
+OutputStageKernel::OutputStageKernel(const Mat &relitResult, const vector<float> &thresholds, bool absoluteValues, Mat &output):
+    m_relitResult(relitResult), m_thresholds(thresholds), m_absoluteValues(absoluteValues), m_output(output)
+{
+
+}
+
+/**
+ * Converts the rows in the range.
+ * @brief operator ()
+ * @param INPUT : rows range of rows computed by the calling thread.
+ */
+void OutputStageKernel::operator()(const Range &rows) const
+{
+    int numberOfValues = 3*m_relitResult.cols;
+    const float* thresholdsBegin = &m_thresholds[0];
+    const float* thresholdsEnd = thresholdsBegin + m_thresholds.size();
+
+    for(int r = rows.start ; r<rows.end ; ++r)
+    {
+        const float* src = m_relitResult.ptr<float>(r);
+
+        if(m_output.depth() == CV_8U)
+        {
+            uchar* dst = (uchar*) m_output.ptr<uchar>(r);
+
+            for(int k = 0 ; k<numberOfValues ; ++k)
+            {
+                //NaN values are mapped to 0 (upper_bound would map them to the maximum value)
+                float value = m_absoluteValues ? fabs(src[k]) : src[k];
+                dst[k] = (value == value) ? (uchar) (upper_bound(thresholdsBegin, thresholdsEnd, value) - thresholdsBegin) : 0;
+            }
+        }
+        else
+        {
+            ushort* dst = (ushort*) m_output.ptr<ushort>(r);
+
+            for(int k = 0 ; k<numberOfValues ; ++k)
+            {
+                //NaN values are mapped to 0 (upper_bound would map them to the maximum value)
+                float value = m_absoluteValues ? fabs(src[k]) : src[k];
+                dst[k] = (value == value) ? (ushort) (upper_bound(thresholdsBegin, thresholdsEnd, value) - thresholdsBegin) : 0;
+            }
+        }
+    }
+}
+
+/**
+ * Returns the values of the reflectance field as floats. 32 bits floats are read in place, other storages are dequantized in the buffer.
+ * @brief floatValues
+ * @param INPUT : reflectanceField reflectance field.
+ * @param INPUT : data pointer returned by imageRow or pixel.
+ * @param INPUT : numberOfValues number of values needed.
+ * @param OUTPUT : buffer memory of at least numberOfValues floats used for the dequantization.
+ * @return a pointer on the values as floats.
+ */
+const float* floatValues(const ReflectanceField &reflectanceField, const uchar* data, int numberOfValues, float* buffer)
+{
+    if(reflectanceField.getStorage() == STORAGE_FLOAT32)
+        return (const float*) data;
+
+    reflectanceField.dequantize(data, numberOfValues, buffer);
+
+    return buffer;
+}
+
+/**
+ * Multiply-accumulate a row of BGR floats with the weights of one image : dst += w*src.
+ * @brief weightedSumRow
+ * @param INPUT : src row of the image of the reflectance field.
+ * @param INPUT : weightsBGR the three weights of the image in BGR order.
+ * @param INPUT/OUTPUT : dst row of the result.
+ * @param INPUT : numberOfPixels number of pixels in the row.
+ */
+void weightedSumRow(const float* src, const float* weightsBGR, float* dst, int numberOfPixels)
+{
+    int k = 0;
+    int length = 3*numberOfPixels;
+
+#if CV_SSE2
+    //4 pixels (12 floats) per iteration. The BGR pattern of the weights repeats every 3 registers.
+    __m128 w0 = _mm_setr_ps(weightsBGR[0], weightsBGR[1], weightsBGR[2], weightsBGR[0]);
+    __m128 w1 = _mm_setr_ps(weightsBGR[1], weightsBGR[2], weightsBGR[0], weightsBGR[1]);
+    __m128 w2 = _mm_setr_ps(weightsBGR[2], weightsBGR[0], weightsBGR[1], weightsBGR[2]);
+
+    for( ; k<=length-12 ; k += 12)
+    {
+        __m128 d0 = _mm_add_ps(_mm_loadu_ps(dst+k), _mm_mul_ps(_mm_loadu_ps(src+k), w0));
+        __m128 d1 = _mm_add_ps(_mm_loadu_ps(dst+k+4), _mm_mul_ps(_mm_loadu_ps(src+k+4), w1));
+        __m128 d2 = _mm_add_ps(_mm_loadu_ps(dst+k+8), _mm_mul_ps(_mm_loadu_ps(src+k+8), w2));
+
+        _mm_storeu_ps(dst+k, d0);
+        _mm_storeu_ps(dst+k+4, d1);
+        _mm_storeu_ps(dst+k+8, d2);
+    }
+#endif
+
+    for( ; k<length ; k += 3)
+    {
+        dst[k] += weightsBGR[0]*src[k];
+        dst[k+1] += weightsBGR[1]*src[k+1];
+        dst[k+2] += weightsBGR[2]*src[k+2];
+    }
+}
+
+/**
+ * Dot product between the lighting conditions of a pixel and the weights (PIXEL_MAJOR layout) : result = sum over i of w[i]*pixel[i] for each channel.
+ * @brief dotProductBGR
+ * @param INPUT : pixel lighting conditions of the pixel (3*numberOfImages floats in BGR order).
+ * @param INPUT : weightsBGR weights of the images (3*numberOfImages floats in BGR order).
+ * @param INPUT : numberOfImages number of images in the reflectance field.
+ * @param OUTPUT : result the relit pixel (3 floats in BGR order).
+ */
+void dotProductBGR(const float* pixel, const float* weightsBGR, int numberOfImages, float* result)
+{
+    int k = 0;
+    int length = 3*numberOfImages;
+    float b = 0.0f, g = 0.0f, r = 0.0f;
+
+#if CV_SSE2
+    //4 lighting conditions (12 floats) per iteration.
+    //The channels of the lanes are (B,G,R,B) for a0, (G,R,B,G) for a1 and (R,B,G,R) for a2.
+    __m128 a0 = _mm_setzero_ps();
+    __m128 a1 = _mm_setzero_ps();
+    __m128 a2 = _mm_setzero_ps();
+
+    for( ; k<=length-12 ; k += 12)
+    {
+        a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(pixel+k), _mm_loadu_ps(weightsBGR+k)));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(pixel+k+4), _mm_loadu_ps(weightsBGR+k+4)));
+        a2 = _mm_add_ps(a2, _mm_mul_ps(_mm_loadu_ps(pixel+k+8), _mm_loadu_ps(weightsBGR+k+8)));
+    }
+
+    float s0[4], s1[4], s2[4];
+    _mm_storeu_ps(s0, a0);
+    _mm_storeu_ps(s1, a1);
+    _mm_storeu_ps(s2, a2);
+
+    b = s0[0] + s0[3] + s1[2] + s2[1];
+    g = s0[1] + s1[0] + s1[3] + s2[2];
+    r = s0[2] + s1[1] + s2[0] + s2[3];
+#endif
+
+    for( ; k<length ; k += 3)
+    {
+        b += weightsBGR[k]*pixel[k];
+        g += weightsBGR[k+1]*pixel[k+1];
+        r += weightsBGR[k+2]*pixel[k+2];
+    }
+
+    result[0] = b;
+    result[1] = g;
+    result[2] = r;
+}
+
+/**
+ * Computes the number of stripes given to cv::parallel_for_ so that each stripe contains about RELIGHTING_ROWS_PER_TILE rows.
+ * @brief numberOfRowTiles
+ * @param INPUT : numberOfRows number of rows of the image.
+ * @return the number of stripes.
+ */
+double numberOfRowTiles(int numberOfRows)
+{
+    return max(1.0, ceil((double) numberOfRows/RELIGHTING_ROWS_PER_TILE));
+}
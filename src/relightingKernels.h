@@ -0,0 +1,316 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file relightingKernels.h
+ * \brief Multithreaded kernels used in the hot loops of the relighting.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The kernels are OpenCV ParallelLoopBody objects. They are executed with cv::parallel_for_ and each thread processes a tile of rows of the final result.
+ */
+
+#ifndef RELIGHTINGKERNELS_H
+#define RELIGHTINGKERNELS_H
+
+#define _USE_MATH_DEFINES //for PI
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+
+#include <opencv2/core/core.hpp>
+
+#include "reflectanceField.h"
+#include "lowRankReflectanceField.h"
+#include "mathsFunctions.h"
+
+//Number of rows of the final result processed by each thread at a time
+#define RELIGHTING_ROWS_PER_TILE 16
+
+//Number of pixels of a row processed at a time in the batch relighting. The block of the reflectance field is reused for all the outputs while it is in the cache.
+#define RELIGHTING_PIXELS_PER_BLOCK 64
+
+/**
+ * Kernel that computes the linear combination of the reflectance field with the RGB weights.
+ * Each pixel of the reflectance field is read once and multiplied-accumulated with the weights of its image (SSE2 when available).
+ * With the PIXEL_MAJOR layout each relit pixel is a contiguous dot product between the pixel and the weights.
+ * Quantized reflectance fields are dequantized on the fly and accumulated in 32 bits floats.
+ * The linear combination can be restricted to a subset of the images (sparse relighting).
+ */
+class WeightedSumKernel : public cv::ParallelLoopBody
+{
+    public:
+        /**
+         * Constructor of the WeightedSumKernel class. All the images are used in the linear combination.
+         * @brief WeightedSumKernel
+         * @param INPUT : reflectanceField reflectance field (any layout).
+         * @param INPUT : weightsRGB weights of each image. weightsRGB[i] contains the R, G and B weights of image i.
+         * @param OUTPUT : result CV_32FC3 image that has already been allocated with the size of the reflectance field.
+         */
+        WeightedSumKernel(const ReflectanceField &reflectanceField, const std::vector<std::vector<float> > &weightsRGB, cv::Mat &result);
+
+        /**
+         * Constructor of the WeightedSumKernel class. Only a subset of the images is used in the linear combination.
+         * @brief WeightedSumKernel
+         * @param INPUT : reflectanceField reflectance field (any layout).
+         * @param INPUT : weightsRGB weights of each image. weightsRGB[i] contains the R, G and B weights of image i.
+         * @param OUTPUT : result CV_32FC3 image that has already been allocated with the size of the reflectance field.
+         * @param INPUT : images numbers of the images used in the linear combination. The linear combination is 0 if it is empty.
+         * @param INPUT : accumulate if true the linear combination is added to the values already in result.
+         */
+        WeightedSumKernel(const ReflectanceField &reflectanceField, const std::vector<std::vector<float> > &weightsRGB, cv::Mat &result,
+                          const std::vector<unsigned int> &images, bool accumulate = false);
+
+        /**
+         * Computes the linear combination for the rows in the range.
+         * @brief operator ()
+         * @param INPUT : rows range of rows of the result computed by the calling thread.
+         */
+        virtual void operator()(const cv::Range &rows) const;
+
+    private:
+        /**
+         * Stores the weights of the images used in the linear combination in BGR order and multiplied by the scale factors of the images.
+         * @brief setWeights
+         * @param INPUT : weightsRGB weights of each image.
+         */
+        void setWeights(const std::vector<std::vector<float> > &weightsRGB);
+
+        const ReflectanceField &m_reflectanceField; /*!< Reflectance field*/
+        unsigned int m_numberOfImages; /*!< Number of images in the reflectance field*/
+        std::vector<unsigned int> m_images; /*!< Numbers of the images used in the linear combination*/
+        bool m_allImages; /*!< True if all the images are used*/
+        bool m_accumulate; /*!< True if the linear combination is added to the result*/
+        std::vector<float> m_weightsBGR; /*!< Weights stored in BGR order to match OpenCV images. m_weightsBGR[3*k+c] is the weight of channel c of image m_images[k]*/
+        cv::Mat m_result; /*!< Header on the final result*/
+};
+
+/**
+ * Kernel that computes several linear combinations of the reflectance field at once (one per lighting environment).
+ * This is the matrix product (pixels x lighting conditions) by (lighting conditions x outputs) computed per color channel.
+ * The product is blocked : each block of pixels of the reflectance field is read once from memory and reused for every output.
+ * With the PIXEL_MAJOR layout the block is a single pixel (all its lighting conditions).
+ */
+class BatchWeightedSumKernel : public cv::ParallelLoopBody
+{
+    public:
+        /**
+         * Constructor of the BatchWeightedSumKernel class.
+         * @brief BatchWeightedSumKernel
+         * @param INPUT : reflectanceField reflectance field (any layout).
+         * @param INPUT : weightsBatch weights of each output. weightsBatch[o][i] contains the R, G and B weights of image i for output o.
+         * @param OUTPUT : results CV_32FC3 images that have already been allocated with the size of the reflectance field. results[o] is output o.
+         */
+        BatchWeightedSumKernel(const ReflectanceField &reflectanceField, const std::vector<std::vector<std::vector<float> > > &weightsBatch,
+                               std::vector<cv::Mat> &results);
+
+        /**
+         * Computes the linear combinations for the rows in the range.
+         * @brief operator ()
+         * @param INPUT : rows range of rows of the results computed by the calling thread.
+         */
+        virtual void operator()(const cv::Range &rows) const;
+
+    private:
+        const ReflectanceField &m_reflectanceField; /*!< Reflectance field*/
+        unsigned int m_numberOfImages; /*!< Number of images in the reflectance field*/
+        unsigned int m_numberOfOutputs; /*!< Number of linear combinations computed*/
+        std::vector<float> m_weightsBGR; /*!< Weight matrix in BGR order. IMAGE_MAJOR : m_weightsBGR[3*(i*m_numberOfOutputs+o)+c], PIXEL_MAJOR : m_weightsBGR[3*(o*m_numberOfImages+i)+c] is the weight of channel c of image i for output o*/
+        std::vector<cv::Mat> m_results; /*!< Headers on the results*/
+};
+
+/**
+ * Kernel that computes the PCA of the tiles of a reflectance field (low rank approximation).
+ */
+class LowRankFactorizationKernel : public cv::ParallelLoopBody
+{
+    public:
+        /**
+         * Constructor of the LowRankFactorizationKernel class.
+         * @brief LowRankFactorizationKernel
+         * @param INPUT : reflectanceField reflectance field to approximate.
+         * @param OUTPUT : lowRankReflectanceField low rank reflectance field whose tiles have already been allocated.
+         */
+        LowRankFactorizationKernel(const ReflectanceField &reflectanceField, LowRankReflectanceField &lowRankReflectanceField);
+
+        /**
+         * Computes the PCA of the tiles in the range.
+         * @brief operator ()
+         * @param INPUT : tiles range of tiles computed by the calling thread.
+         */
+        virtual void operator()(const cv::Range &tiles) const;
+
+    private:
+        const ReflectanceField &m_reflectanceField; /*!< Reflectance field*/
+        LowRankReflectanceField &m_lowRankReflectanceField; /*!< Low rank approximation*/
+};
+
+/**
+ * Kernel that computes the linear combination of the reflectance field in the compressed domain of a low rank reflectance field.
+ * The cost per tile is proportional to the rank instead of the number of images.
+ */
+class LowRankWeightedSumKernel : public cv::ParallelLoopBody
+{
+    public:
+        /**
+         * Constructor of the LowRankWeightedSumKernel class.
+         * @brief LowRankWeightedSumKernel
+         * @param INPUT : lowRankReflectanceField low rank reflectance field.
+         * @param INPUT : weightsRGB weights of each image. weightsRGB[i] contains the R, G and B weights of image i.
+         * @param OUTPUT : result CV_32FC3 image that has already been allocated with the size of the reflectance field.
+         */
+        LowRankWeightedSumKernel(const LowRankReflectanceField &lowRankReflectanceField, const std::vector<std::vector<float> > &weightsRGB, cv::Mat &result);
+
+        /**
+         * Computes the linear combination for the tiles in the range.
+         * @brief operator ()
+         * @param INPUT : tiles range of tiles of the result computed by the calling thread.
+         */
+        virtual void operator()(const cv::Range &tiles) const;
+
+    private:
+        const LowRankReflectanceField &m_lowRankReflectanceField; /*!< Low rank reflectance field*/
+        std::vector<float> m_weightsBGR; /*!< Weights stored in BGR order. m_weightsBGR[3*i+c] is the weight of channel c of image i*/
+        cv::Mat m_result; /*!< Header on the final result*/
+};
+
+/**
+ * Kernel that copies the environment map in the background pixels of the relit result given a precomputed table of directions.
+ */
+class BackgroundKernel : public cv::ParallelLoopBody
+{
+    public:
+        /**
+         * Constructor of the BackgroundKernel class.
+         * @brief BackgroundKernel
+         * @param INPUT : pixels index (row*width+column) of each background pixel in the result.
+         * @param INPUT : rows row of the environment map seen by each background pixel.
+         * @param INPUT : phi azimuthal angle (without offset) of the direction of each background pixel.
+         * @param INPUT : environmentMap CV_32FC3 latitude longitude environment map.
+         * @param INPUT : offset rotation of the environment map.
+         * @param INPUT : applyGamma if true the gamma correction is applied to the background.
+         * @param INPUT : gamma gamma of the correction.
+         * @param OUTPUT : result CV_32FC3 continuous relit result.
+         */
+        BackgroundKernel(const std::vector<int> &pixels, const std::vector<int> &rows, const std::vector<float> &phi, const cv::Mat &environmentMap,
+                         float offset, bool applyGamma, double gamma, cv::Mat &result);
+
+        /**
+         * Copies the environment map in the background pixels of the range.
+         * @brief operator ()
+         * @param INPUT : range range of background pixels computed by the calling thread.
+         */
+        virtual void operator()(const cv::Range &range) const;
+
+    private:
+        const std::vector<int> &m_pixels; /*!< Index of each background pixel*/
+        const std::vector<int> &m_rows; /*!< Row of the environment map of each background pixel*/
+        const std::vector<float> &m_phi; /*!< Azimuthal angle of each background pixel*/
+        cv::Mat m_environmentMap; /*!< Header on the environment map*/
+        float m_offset; /*!< Rotation of the environment map*/
+        bool m_applyGamma; /*!< True to apply the gamma correction*/
+        double m_gamma; /*!< Gamma of the correction*/
+        cv::Mat m_result; /*!< Header on the relit result*/
+};
+
+/**
+ * Kernel that converts the linear relit result to the saved image : exposure, gamma, clamp and quantization in a single pass.
+ * The transfer function is monotonic : it is tabulated by the linear values where the output changes and applied with a binary search (no pow per pixel).
+ * Negative values are clamped to 0, or converted as their absolute value to match a gamma correction computed with cv::pow (non integer power).
+ */
+class OutputStageKernel : public cv::ParallelLoopBody
+{
+    public:
+        /**
+         * Constructor of the OutputStageKernel class.
+         * @brief OutputStageKernel
+         * @param INPUT : relitResult CV_32FC3 linear relit result.
+         * @param INPUT : thresholds increasing linear values. The output value is the number of thresholds lower or equal to the linear value (0 for NaN).
+         * @param INPUT : absoluteValues true to convert the negative values as their absolute value, false to clamp them to 0.
+         * @param OUTPUT : output CV_8UC3 or CV_16UC3 image that has already been allocated with the size of the relit result.
+         */
+        OutputStageKernel(const cv::Mat &relitResult, const std::vector<float> &thresholds, bool absoluteValues, cv::Mat &output);
+
+        /**
+         * Converts the rows in the range.
+         * @brief operator ()
+         * @param INPUT : rows range of rows computed by the calling thread.
+         */
+        virtual void operator()(const cv::Range &rows) const;
+
+    private:
+        cv::Mat m_relitResult; /*!< Header on the linear relit result*/
+        const std::vector<float> &m_thresholds; /*!< Linear values where the output value changes*/
+        bool m_absoluteValues; /*!< True to convert the negative values as their absolute value*/
+        cv::Mat m_output; /*!< Header on the output image*/
+};
+
+/**
+ * Multiply-accumulate a row of BGR floats with the weights of one image : dst += w*src.
+ * @brief weightedSumRow
+ * @param INPUT : src row of the image of the reflectance field.
+ * @param INPUT : weightsBGR the three weights of the image in BGR order.
+ * @param INPUT/OUTPUT : dst row of the result.
+ * @param INPUT : numberOfPixels number of pixels in the row.
+ */
+void weightedSumRow(const float* src, const float* weightsBGR, float* dst, int numberOfPixels);
+
+/**
+ * Returns the values of the reflectance field as floats. 32 bits floats are read in place, other storages are dequantized in the buffer.
+ * @brief floatValues
+ * @param INPUT : reflectanceField reflectance field.
+ * @param INPUT : data pointer returned by imageRow or pixel.
+ * @param INPUT : numberOfValues number of values needed.
+ * @param OUTPUT : buffer memory of at least numberOfValues floats used for the dequantization.
+ * @return a pointer on the values as floats.
+ */
+const float* floatValues(const ReflectanceField &reflectanceField, const uchar* data, int numberOfValues, float* buffer);
+
+/**
+ * Dot product between the lighting conditions of a pixel and the weights (PIXEL_MAJOR layout) : result = sum over i of w[i]*pixel[i] for each channel.
+ * @brief dotProductBGR
+ * @param INPUT : pixel lighting conditions of the pixel (3*numberOfImages floats in BGR order).
+ * @param INPUT : weightsBGR weights of the images (3*numberOfImages floats in BGR order).
+ * @param INPUT : numberOfImages number of images in the reflectance field.
+ * @param OUTPUT : result the relit pixel (3 floats in BGR order).
+ */
+void dotProductBGR(const float* pixel, const float* weightsBGR, int numberOfImages, float* result);
+
+/**
+ * Computes the number of stripes given to cv::parallel_for_ so that each stripe contains about RELIGHTING_ROWS_PER_TILE rows.
+ * @brief numberOfRowTiles
+ * @param INPUT : numberOfRows number of rows of the image.
+ * @return the number of stripes.
+ */
+double numberOfRowTiles(int numberOfRows);
+
+#endif // RELIGHTINGKERNELS_H
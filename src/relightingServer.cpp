@@ -0,0 +1,314 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file relightingServer.cpp
+ * \brief Resident relighting server that answers the requests of other processes on a local socket.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The server keeps one light stage relighting per object. Each of them keeps its reflectance field, its environment maps and its Voronoi label map in memory.
+ */
+
+#include "relightingServer.h"
+
+using namespace std;
+using namespace cv;
+
+//Sockets written by the signal handler and read in the event loop (only async-signal-safe functions can be called in a signal handler)
+static int signalSockets[2] = {-1, -1};
+
+/**
+ * Handler of SIGINT and SIGTERM : wakes up the event loop through signalSockets.
+ * @brief stopSignalHandler
+ */
+static void stopSignalHandler(int)
+{
+    char signalByte = 1;
+    ssize_t written = ::write(signalSockets[0], &signalByte, sizeof(signalByte));
+    (void) written;
+}
+
+/**
+ * Constructor of the RelightingServer class.
+ * @brief RelightingServer
+ */
+RelightingServer::RelightingServer(): QObject(), m_server(new QLocalServer(this)), m_signalNotifier(NULL), m_relightings(QMap<QString, LightStageRelighting*>())
+{
+    QObject::connect(m_server, SIGNAL(newConnection()), this, SLOT(acceptConnections()));
+}
+
+/**
+ * Destructor of the RelightingServer class. Releases the memory.
+ * @brief ~RelightingServer
+ */
+RelightingServer::~RelightingServer()
+{
+    m_server->close();
+    qDeleteAll(m_relightings);
+
+    //The default handlers are restored before the sockets of the signal handler are closed
+    if(m_signalNotifier != NULL)
+    {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        ::close(signalSockets[0]);
+        ::close(signalSockets[1]);
+        signalSockets[0] = -1;
+        signalSockets[1] = -1;
+    }
+}
+
+/**
+ * Starts listening on the local socket called name. A socket left by a server that crashed is removed.
+ * SIGINT and SIGTERM then stop the event loop of the application.
+ * @brief listen
+ * @param INPUT : name name of the local socket (or path of the Unix socket).
+ * @param INPUT : dataRoot folder of the data. If empty, the folder of the application is used.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the server could not listen.
+ */
+bool RelightingServer::listen(const QString &name, const QString &dataRoot)
+{
+    if(!dataRoot.isEmpty())
+        setDataRootPath(dataRoot.toStdString());
+
+    QLocalServer::removeServer(name);
+
+    if(!m_server->listen(name))
+    {
+        cerr << "Could not listen on " << name.toStdString() << " : " << m_server->errorString().toStdString() << endl;
+        return EXIT_FAILURE;
+    }
+
+    //SIGINT and SIGTERM stop the event loop so that the program ends normally
+    if(m_signalNotifier == NULL && ::socketpair(AF_UNIX, SOCK_STREAM, 0, signalSockets) == 0)
+    {
+        m_signalNotifier = new QSocketNotifier(signalSockets[1], QSocketNotifier::Read, this);
+        QObject::connect(m_signalNotifier, SIGNAL(activated(int)), this, SLOT(stopOnSignal()));
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = stopSignalHandler;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+    }
+
+    cout << "Data folder : " << dataRootPath() << endl;
+    cout << "Listening on " << m_server->fullServerName().toStdString() << endl;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Returns the size in bytes of the data kept in memory by the server for all the objects.
+ * @brief residentMemory
+ */
+size_t RelightingServer::residentMemory()
+{
+    size_t memory = 0;
+
+    for(QMap<QString, LightStageRelighting*>::const_iterator it = m_relightings.constBegin() ; it != m_relightings.constEnd() ; ++it)
+    {
+        memory += it.value()->residentMemory();
+    }
+
+    return memory;
+}
+
+/**
+ * Qt slot that accepts the new connections.
+ * @brief acceptConnections
+ */
+void RelightingServer::acceptConnections()
+{
+    while(m_server->hasPendingConnections())
+    {
+        QLocalSocket* socket = m_server->nextPendingConnection();
+
+        QObject::connect(socket, SIGNAL(readyRead()), this, SLOT(readRequests()));
+        QObject::connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+/**
+ * Qt slot that answers the complete requests received by a connection.
+ * @brief readRequests
+ */
+void RelightingServer::readRequests()
+{
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(this->sender());
+
+    if(socket == NULL)
+        return;
+
+    //A request is only processed once its whole line has been received
+    while(socket->canReadLine())
+    {
+        QByteArray line = socket->readLine(SERVER_MAXIMUM_REQUEST_LENGTH + 1);
+
+        //The line has been cut before its end
+        if(!line.endsWith('\n'))
+        {
+            this->dropConnection(socket);
+            return;
+        }
+
+        QString request = QString::fromUtf8(line).trimmed();
+
+        if(!request.isEmpty())
+            this->processRequest(socket, request);
+    }
+
+    //A line without end that is already too long is not buffered any further
+    if(socket->bytesAvailable() > SERVER_MAXIMUM_REQUEST_LENGTH)
+        this->dropConnection(socket);
+}
+
+/**
+ * Qt slot called in the event loop when SIGINT or SIGTERM has been received. Stops the event loop of the application.
+ * @brief stopOnSignal
+ */
+void RelightingServer::stopOnSignal()
+{
+    char signalByte = 0;
+    ssize_t bytesRead = ::read(signalSockets[1], &signalByte, sizeof(signalByte));
+    (void) bytesRead;
+
+    cout << "Signal received : stopping the server" << endl;
+    QCoreApplication::quit();
+}
+
+/**
+ * Answers one request.
+ * @brief processRequest
+ * @param INPUT : socket connection on which the request has been received.
+ * @param INPUT : request line of the request (without the end of line).
+ */
+void RelightingServer::processRequest(QLocalSocket* socket, const QString &request)
+{
+    QStringList fields = request.split(';');
+    QString command = fields[0].trimmed().toLower();
+
+    if(command == "memory" && fields.size() == 1)
+    {
+        socket->write(QString("OK %1\n").arg((qulonglong) this->residentMemory()).toUtf8());
+        return;
+    }
+
+    if(command == "shutdown" && fields.size() == 1)
+    {
+        //The event loop stops once the answer has been sent
+        cout << "Shutdown requested" << endl;
+        socket->write("OK\n");
+        socket->flush();
+        QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+        return;
+    }
+
+    if(command != "relight" || fields.size() != 6)
+    {
+        this->sendError(socket, "Unknown request : " + request);
+        return;
+    }
+
+    QString object = fields[1].trimmed();
+    QString environmentMap = fields[2].trimmed();
+    QString lightType = fields[4].trimmed();
+    bool rotationValid = false, exposureValid = false;
+    double rotation = fields[3].toDouble(&rotationValid);
+    double exposure = fields[5].toDouble(&exposureValid);
+
+    if(!rotationValid || !exposureValid)
+    {
+        this->sendError(socket, "Invalid rotation or exposure : " + request);
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    //The first request on an object loads its reflectance field
+    bool newObject = !m_relightings.contains(object);
+
+    if(newObject)
+    {
+        LightStageRelighting* relighting = new LightStageRelighting();
+        relighting->setNumberOfLightingConditions(253);
+        relighting->setResidentEnvironmentMaps(true);
+
+        m_relightings.insert(object, relighting);
+    }
+
+    Mat result;
+
+    if(m_relightings.value(object)->relight(object, environmentMap, (float) (rotation*M_PI/180.0), lightType, exposure, result) == EXIT_FAILURE)
+    {
+        if(newObject)
+            delete m_relightings.take(object);
+
+        this->sendError(socket, "Relighting failed : " + request);
+        return;
+    }
+
+    size_t bytes = result.total()*result.elemSize();
+
+    socket->write(QString("OK %1 %2 %3\n").arg(result.rows).arg(result.cols).arg((qulonglong) bytes).toUtf8());
+    socket->write((const char*) result.data, bytes);
+
+    cout << request.toStdString() << " : " << timer.elapsed() << " ms" << endl;
+}
+
+/**
+ * Sends an error to a connection and prints it.
+ * @brief sendError
+ * @param INPUT : socket connection on which the error is sent.
+ * @param INPUT : message description of the error.
+ */
+void RelightingServer::sendError(QLocalSocket* socket, const QString &message)
+{
+    cerr << message.toStdString() << endl;
+    socket->write(QString("ERROR " + message + "\n").toUtf8());
+}
+
+/**
+ * Answers an error to a connection whose request line is longer than SERVER_MAXIMUM_REQUEST_LENGTH and closes it.
+ * @brief dropConnection
+ * @param INPUT : socket connection to close.
+ */
+void RelightingServer::dropConnection(QLocalSocket* socket)
+{
+    this->sendError(socket, QString("Request longer than %1 bytes : connection closed").arg(SERVER_MAXIMUM_REQUEST_LENGTH));
+
+    //The error is sent before the connection is closed (the socket is deleted once disconnected)
+    socket->disconnectFromServer();
+}
@@ -0,0 +1,166 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file relightingServer.h
+ * \brief Resident relighting server that answers the requests of other processes on a local socket.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The server keeps the reflectance field of each object, the environment maps (at most RESIDENT_ENVIRONMENT_MAPS_MAXIMUM per object) and the label map of the Voronoi diagram in memory :
+ * after the first request on an object, a request only computes the weights and the linear combination (light stage relighting).
+ *
+ * The requests are lines of text whose fields are separated by semicolons :
+ *
+ * relight;Helmet;Grace Cathedral;90;Point;0.0   (object, environment map, rotation in degrees, light type, exposure in stops)
+ * memory                                         (memory used by the data kept by the server)
+ * shutdown                                       (stops the server once the answer is sent)
+ *
+ * Answer to relight : a line "OK rows cols bytes" followed by the bytes of the linear relit image (rows*cols pixels, 3 floats per pixel in BGR order, native byte order).
+ * Answer to memory : a line "OK bytes".
+ * Answer to shutdown : a line "OK". SIGINT and SIGTERM also stop the server : the event loop returns and the program ends normally (trace written).
+ * A request that fails is answered by a line "ERROR message".
+ * A line longer than SERVER_MAXIMUM_REQUEST_LENGTH bytes is answered by an error and the connection is closed (the line is never buffered whole).
+ */
+
+#ifndef RELIGHTINGSERVER_H
+#define RELIGHTINGSERVER_H
+
+#define SERVER_MAXIMUM_REQUEST_LENGTH 4096 //Maximum length in bytes of a request line (end of line included)
+
+#include "lightStageRelighting.h"
+#include "loadFiles.h"
+
+#include <cstdlib>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMap>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QString>
+#include <QStringList>
+
+class RelightingServer : public QObject
+{
+    Q_OBJECT
+
+    public:
+
+        /**
+         * Constructor of the RelightingServer class.
+         * @brief RelightingServer
+         */
+        RelightingServer();
+
+        /**
+         * Destructor of the RelightingServer class. Releases the memory.
+         * @brief ~RelightingServer
+         */
+        virtual ~RelightingServer();
+
+        /**
+         * Starts listening on the local socket called name. A socket left by a server that crashed is removed.
+         * SIGINT and SIGTERM then stop the event loop of the application.
+         * @brief listen
+         * @param INPUT : name name of the local socket (or path of the Unix socket).
+         * @param INPUT : dataRoot folder of the data. If empty, the folder of the application is used.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the server could not listen.
+         */
+        bool listen(const QString &name, const QString &dataRoot = QString());
+
+        /**
+         * Returns the size in bytes of the data kept in memory by the server for all the objects.
+         * @brief residentMemory
+         */
+        size_t residentMemory();
+
+    private slots:
+
+        /**
+         * Qt slot that accepts the new connections.
+         * @brief acceptConnections
+         */
+        void acceptConnections();
+
+        /**
+         * Qt slot that answers the complete requests received by a connection.
+         * @brief readRequests
+         */
+        void readRequests();
+
+        /**
+         * Qt slot called in the event loop when SIGINT or SIGTERM has been received. Stops the event loop of the application.
+         * @brief stopOnSignal
+         */
+        void stopOnSignal();
+
+    private:
+
+        /**
+         * Answers one request.
+         * @brief processRequest
+         * @param INPUT : socket connection on which the request has been received.
+         * @param INPUT : request line of the request (without the end of line).
+         */
+        void processRequest(QLocalSocket* socket, const QString &request);
+
+        /**
+         * Sends an error to a connection and prints it.
+         * @brief sendError
+         * @param INPUT : socket connection on which the error is sent.
+         * @param INPUT : message description of the error.
+         */
+        void sendError(QLocalSocket* socket, const QString &message);
+
+        /**
+         * Answers an error to a connection whose request line is longer than SERVER_MAXIMUM_REQUEST_LENGTH and closes it.
+         * @brief dropConnection
+         * @param INPUT : socket connection to close.
+         */
+        void dropConnection(QLocalSocket* socket);
+
+        QLocalServer* m_server; /*!< Local server that accepts the connections*/
+        QSocketNotifier* m_signalNotifier; /*!< Notifier of the socket written by the handler of SIGINT and SIGTERM (NULL before listen)*/
+        QMap<QString, LightStageRelighting*> m_relightings; /*!< Relighting of each object, which keeps the data of the object in memory*/
+};
+
+#endif // RELIGHTINGSERVER_H
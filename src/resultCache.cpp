@@ -0,0 +1,324 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file resultCache.cpp
+ * \brief Cache on disk of the weights and of the linear relit results, addressed by a hash of the inputs of the relighting.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The entries are listed once, then the order of use and the size of the cache are kept in memory.
+ */
+
+#include "resultCache.h"
+
+using namespace std;
+using namespace cv;
+
+//Number of unsigned int in the header
+#define RESULT_CACHE_HEADER_SIZE 5
+
+/**
+ * Default constructor of the ResultCache class. No folder is set : every lookup is a miss.
+ * @brief ResultCache
+ */
+ResultCache::ResultCache(): m_folder(string()), m_folderRead(false), m_maximumSize(1024*1024*1024), m_size(0),
+    m_recentlyUsed(list<string>()), m_fileSizes(map<string, size_t>()), m_hits(0), m_misses(0)
+{
+
+}
+
+/**
+ * Sets the folder of the cache. The folder is created and its entries are listed the first time the cache is used.
+ * @brief setFolder
+ * @param INPUT : folder path of the folder of the cache.
+ */
+void ResultCache::setFolder(const string &folder)
+{
+    if(folder == m_folder)
+        return;
+
+    m_folder = folder;
+    m_folderRead = false;
+    m_size = 0;
+    m_recentlyUsed.clear();
+    m_fileSizes.clear();
+}
+
+/**
+ * Sets the maximum size in bytes of the files of the cache. The least recently used entries are removed above this size.
+ * @brief setMaximumSize
+ * @param INPUT : maximumSize maximum size in bytes.
+ */
+void ResultCache::setMaximumSize(size_t maximumSize)
+{
+    m_maximumSize = maximumSize;
+
+    if(m_folderRead)
+        this->evict();
+}
+
+/**
+ * Reads the entry of a key. Counts a hit or a miss. The modification time of the file of a hit is updated (least recently used order of the next runs).
+ * @brief load
+ * @param INPUT : key key of the entry (hash of the inputs).
+ * @param OUTPUT : weights RGB weights of the entry.
+ * @param OUTPUT : result linear relit result of the entry.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the entry does not exist or could not be read.
+ */
+bool ResultCache::load(const QByteArray &key, vector<vector<float> > &weights, Mat &result)
+{
+    if(m_folder.empty())
+    {
+        m_misses++;
+        return EXIT_FAILURE;
+    }
+
+    if(!m_folderRead)
+        this->readFolder();
+
+    string name = key.toHex().constData();
+
+    if(m_fileSizes.find(name) == m_fileSizes.end())
+    {
+        m_misses++;
+        return EXIT_FAILURE;
+    }
+
+    ifstream file(this->filePath(name).c_str(), ios::in | ios::binary);
+
+    char magic[4] = {0, 0, 0, 0};
+    unsigned int header[RESULT_CACHE_HEADER_SIZE] = {0, 0, 0, 0, 0};
+
+    file.read(magic, 4*sizeof(char));
+    file.read((char*) header, RESULT_CACHE_HEADER_SIZE*sizeof(unsigned int));
+
+    bool valid = file && strncmp(magic, "RCCH", 4) == 0 && header[0] == RESULT_CACHE_VERSION;
+    vector<vector<float> > entryWeights;
+    Mat entryResult;
+
+    if(valid)
+    {
+        entryWeights.assign(header[1], vector<float>(3, 0.0));
+
+        for(unsigned int k = 0 ; k<header[1] ; k++)
+        {
+            file.read((char*) &entryWeights[k][0], 3*sizeof(float));
+        }
+
+        entryResult.create(header[2], header[3], header[4]);
+        file.read((char*) entryResult.data, entryResult.total()*entryResult.elemSize());
+
+        valid = !file.fail();
+    }
+
+    //An entry that cannot be read is removed
+    if(!valid)
+    {
+        cerr << "Invalid result cache entry : " << this->filePath(name) << endl;
+        file.close();
+        QFile::remove(QString::fromStdString(this->filePath(name)));
+        this->forget(name);
+        m_misses++;
+        return EXIT_FAILURE;
+    }
+
+    weights = entryWeights;
+    result = entryResult;
+
+    //Most recently used, also for the next runs that read the folder
+    file.close();
+    utime(this->filePath(name).c_str(), NULL);
+
+    m_recentlyUsed.remove(name);
+    m_recentlyUsed.push_front(name);
+    m_hits++;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Writes the entry of a key and removes the least recently used entries if the cache is too large.
+ * @brief store
+ * @param INPUT : key key of the entry (hash of the inputs).
+ * @param INPUT : weights RGB weights.
+ * @param INPUT : result linear relit result.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the entry could not be written.
+ */
+bool ResultCache::store(const QByteArray &key, const vector<vector<float> > &weights, const Mat &result)
+{
+    if(m_folder.empty() || result.empty())
+        return EXIT_FAILURE;
+
+    if(!m_folderRead)
+        this->readFolder();
+
+    string name = key.toHex().constData();
+    Mat resultContinuous = result.isContinuous() ? result : result.clone();
+
+    unsigned int header[RESULT_CACHE_HEADER_SIZE] = {RESULT_CACHE_VERSION, (unsigned int) weights.size(), (unsigned int) resultContinuous.rows,
+                                                     (unsigned int) resultContinuous.cols, (unsigned int) resultContinuous.type()};
+
+    ofstream file(this->filePath(name).c_str(), ios::out | ios::trunc | ios::binary);
+
+    if(!file)
+    {
+        cerr << "Could not write the file : " << this->filePath(name) << endl;
+        return EXIT_FAILURE;
+    }
+
+    //Written as an invalid entry until the end : an interrupted write is never read
+    file.write("RCCW", 4*sizeof(char));
+    file.write((char*) header, RESULT_CACHE_HEADER_SIZE*sizeof(unsigned int));
+
+    for(unsigned int k = 0 ; k<weights.size() ; k++)
+    {
+        float rgb[3] = {weights[k][0], weights[k][1], weights[k][2]};
+        file.write((char*) rgb, 3*sizeof(float));
+    }
+
+    file.write((const char*) resultContinuous.data, resultContinuous.total()*resultContinuous.elemSize());
+
+    file.seekp(0);
+    file.write("RCCH", 4*sizeof(char));
+
+    if(!file)
+    {
+        cerr << "Could not write the file : " << this->filePath(name) << endl;
+        return EXIT_FAILURE;
+    }
+
+    this->forget(name);
+
+    size_t fileSize = 4*sizeof(char) + RESULT_CACHE_HEADER_SIZE*sizeof(unsigned int) + 3*weights.size()*sizeof(float)
+                      + resultContinuous.total()*resultContinuous.elemSize();
+
+    m_recentlyUsed.push_front(name);
+    m_fileSizes[name] = fileSize;
+    m_size += fileSize;
+
+    this->evict();
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Returns the number of lookups that found their entry.
+ * @brief getHits
+ */
+unsigned int ResultCache::getHits() const
+{
+    return m_hits;
+}
+
+/**
+ * Returns the number of lookups that did not find their entry.
+ * @brief getMisses
+ */
+unsigned int ResultCache::getMisses() const
+{
+    return m_misses;
+}
+
+/**
+ * Returns the size in bytes of the files of the cache.
+ * @brief getSize
+ */
+size_t ResultCache::getSize() const
+{
+    return m_size;
+}
+
+/**
+ * Creates the folder and lists its entries from the most recently to the least recently modified.
+ * @brief readFolder
+ */
+void ResultCache::readFolder()
+{
+    QDir folder(QString::fromStdString(m_folder));
+    folder.mkpath(".");
+
+    QFileInfoList entries = folder.entryInfoList(QStringList("*.rcache"), QDir::Files, QDir::Time);
+
+    for(int e = 0 ; e<entries.size() ; e++)
+    {
+        string name = entries[e].completeBaseName().toStdString();
+
+        m_recentlyUsed.push_back(name);
+        m_fileSizes[name] = entries[e].size();
+        m_size += entries[e].size();
+    }
+
+    m_folderRead = true;
+
+    this->evict();
+}
+
+/**
+ * Removes an entry from the list of entries.
+ * @brief forget
+ * @param INPUT : name name of the entry.
+ */
+void ResultCache::forget(const string &name)
+{
+    map<string, size_t>::iterator entry = m_fileSizes.find(name);
+
+    if(entry == m_fileSizes.end())
+        return;
+
+    m_size -= entry->second;
+    m_fileSizes.erase(entry);
+    m_recentlyUsed.remove(name);
+}
+
+/**
+ * Removes the least recently used entries until the size of the cache is under the maximum size. The most recent entry is kept.
+ * @brief evict
+ */
+void ResultCache::evict()
+{
+    while(m_size > m_maximumSize && m_recentlyUsed.size() > 1)
+    {
+        string name = m_recentlyUsed.back();
+
+        QFile::remove(QString::fromStdString(this->filePath(name)));
+        this->forget(name);
+    }
+}
+
+/**
+ * Returns the path of the file of an entry.
+ * @brief filePath
+ * @param INPUT : name name of the entry.
+ */
+string ResultCache::filePath(const string &name) const
+{
+    return m_folder + "/" + name + ".rcache";
+}
@@ -0,0 +1,167 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file resultCache.h
+ * \brief Cache on disk of the weights and of the linear relit results, addressed by a hash of the inputs of the relighting.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * Each entry is a file named after the key (hexadecimal) that contains the RGB weights and the linear relit result of one offset.
+ * The entries are removed in least recently used order when the size of the folder is over the maximum size.
+ * The order of the entries written by a previous run is given by the modification times of the files : a file is touched each time its entry is read.
+ * File format : "RCCH", header (unsigned int) : version, number of weights, rows, cols, type, weights (3 floats each), values of the result.
+ */
+
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#define RESULT_CACHE_VERSION 1
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <utime.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+#include <QStringList>
+
+class ResultCache
+{
+    public:
+
+        /**
+         * Default constructor of the ResultCache class. No folder is set : every lookup is a miss.
+         * @brief ResultCache
+         */
+        ResultCache();
+
+        /**
+         * Sets the folder of the cache. The folder is created and its entries are listed the first time the cache is used.
+         * @brief setFolder
+         * @param INPUT : folder path of the folder of the cache.
+         */
+        void setFolder(const std::string &folder);
+
+        /**
+         * Sets the maximum size in bytes of the files of the cache. The least recently used entries are removed above this size.
+         * @brief setMaximumSize
+         * @param INPUT : maximumSize maximum size in bytes.
+         */
+        void setMaximumSize(size_t maximumSize);
+
+        /**
+         * Reads the entry of a key. Counts a hit or a miss. The modification time of the file of a hit is updated (least recently used order of the next runs).
+         * @brief load
+         * @param INPUT : key key of the entry (hash of the inputs).
+         * @param OUTPUT : weights RGB weights of the entry.
+         * @param OUTPUT : result linear relit result of the entry.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the entry does not exist or could not be read.
+         */
+        bool load(const QByteArray &key, std::vector<std::vector<float> > &weights, cv::Mat &result);
+
+        /**
+         * Writes the entry of a key and removes the least recently used entries if the cache is too large.
+         * @brief store
+         * @param INPUT : key key of the entry (hash of the inputs).
+         * @param INPUT : weights RGB weights.
+         * @param INPUT : result linear relit result.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the entry could not be written.
+         */
+        bool store(const QByteArray &key, const std::vector<std::vector<float> > &weights, const cv::Mat &result);
+
+        /**
+         * Returns the number of lookups that found their entry.
+         * @brief getHits
+         */
+        unsigned int getHits() const;
+
+        /**
+         * Returns the number of lookups that did not find their entry.
+         * @brief getMisses
+         */
+        unsigned int getMisses() const;
+
+        /**
+         * Returns the size in bytes of the files of the cache.
+         * @brief getSize
+         */
+        size_t getSize() const;
+
+    private:
+
+        /**
+         * Creates the folder and lists its entries from the most recently to the least recently modified.
+         * @brief readFolder
+         */
+        void readFolder();
+
+        /**
+         * Removes an entry from the list of entries.
+         * @brief forget
+         * @param INPUT : name name of the entry.
+         */
+        void forget(const std::string &name);
+
+        /**
+         * Removes the least recently used entries until the size of the cache is under the maximum size. The most recent entry is kept.
+         * @brief evict
+         */
+        void evict();
+
+        /**
+         * Returns the path of the file of an entry.
+         * @brief filePath
+         * @param INPUT : name name of the entry.
+         */
+        std::string filePath(const std::string &name) const;
+
+        std::string m_folder; /*!< Folder of the cache (empty if the cache has no folder)*/
+        bool m_folderRead; /*!< True once the entries of the folder have been listed*/
+        size_t m_maximumSize; /*!< Maximum size in bytes of the files of the cache*/
+        size_t m_size; /*!< Size in bytes of the files of the cache*/
+        std::list<std::string> m_recentlyUsed; /*!< Names of the entries from the most recently to the least recently used*/
+        std::map<std::string, size_t> m_fileSizes; /*!< Size in bytes of the file of each entry*/
+        unsigned int m_hits; /*!< Number of lookups that found their entry*/
+        unsigned int m_misses; /*!< Number of lookups that did not find their entry*/
+};
+
+#endif // RESULTCACHE_H
@@ -0,0 +1,267 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file sphericalHarmonics.cpp
+ * \brief Real spherical harmonics : evaluation, projection of latitude longitude maps and rotation of the coefficients.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The spherical harmonics use the spherical coordinates of mathsFunctions.h : theta is measured from the y axis and phi = atan2(x, z).
+ * A function projected on the first bands is described by bands*bands coefficients. The coefficient of the band l and order m (-l <= m <= l) is at index l*l + l + m.
+ * The coefficients of a rotated function are a matrix-vector product : the matrix is block diagonal (one block per band).
+ */
+
+#include "sphericalHarmonics.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Returns the number of coefficients of the first bands of the spherical harmonics (bands*bands).
+ * @brief numberOfSHCoefficients
+ * @param INPUT : bands number of bands.
+ * @return the number of coefficients.
+ */
+int numberOfSHCoefficients(int bands)
+{
+    return bands*bands;
+}
+
+/**
+ * Evaluates the real spherical harmonics of the first bands in the direction (theta, phi).
+ * @brief evaluateSH
+ * @param INPUT : bands number of bands (at most SH_MAXIMUM_BANDS).
+ * @param INPUT : theta polar angle (from the y axis) in the range [0:Pi].
+ * @param INPUT : phi azimuthal angle in the range [0:2Pi].
+ * @param OUTPUT : values value of each spherical harmonic (bands*bands values).
+ */
+void evaluateSH(int bands, double theta, double phi, vector<double> &values)
+{
+    values.assign(numberOfSHCoefficients(bands), 0.0);
+
+    double cosTheta = cos(theta);
+    double sinTheta = sin(theta);
+
+    //Associated Legendre polynomials P(l,m) of cos(theta) for 0 <= m <= l (recurrence on l for each m)
+    double legendre[SH_MAXIMUM_BANDS][SH_MAXIMUM_BANDS];
+    double pmm = 1.0;
+
+    for(int m = 0 ; m<bands ; m++)
+    {
+        if(m > 0)
+            pmm *= -(2.0*m-1.0)*sinTheta;
+
+        legendre[m][m] = pmm;
+
+        if(m+1 < bands)
+            legendre[m+1][m] = cosTheta*(2.0*m+1.0)*pmm;
+
+        for(int l = m+2 ; l<bands ; l++)
+            legendre[l][m] = (cosTheta*(2.0*l-1.0)*legendre[l-1][m] - (l+m-1.0)*legendre[l-2][m])/(l-m);
+    }
+
+    for(int l = 0 ; l<bands ; l++)
+    {
+        for(int m = 0 ; m<=l ; m++)
+        {
+            //Normalisation sqrt((2l+1)/(4Pi) * (l-m)!/(l+m)!)
+            double factorialRatio = 1.0;
+
+            for(int k = l-m+1 ; k<=l+m ; k++)
+                factorialRatio /= k;
+
+            double normalisation = sqrt((2.0*l+1.0)*factorialRatio/(4.0*M_PI));
+
+            if(m == 0)
+            {
+                values[l*l+l] = normalisation*legendre[l][0];
+            }
+            else
+            {
+                values[l*l+l+m] = sqrt(2.0)*normalisation*cos(m*phi)*legendre[l][m];
+                values[l*l+l-m] = sqrt(2.0)*normalisation*sin(m*phi)*legendre[l][m];
+            }
+        }
+    }
+}
+
+/**
+ * Evaluates the real spherical harmonics of the first bands in the direction (x, y, z). The direction does not need to be normalised.
+ * @brief evaluateSHDirection
+ * @param INPUT : bands number of bands (at most SH_MAXIMUM_BANDS).
+ * @param INPUT : direction direction in the cartesian coordinate system.
+ * @param OUTPUT : values value of each spherical harmonic (bands*bands values).
+ */
+void evaluateSHDirection(int bands, const Vec3d &direction, vector<double> &values)
+{
+    double r = norm(direction);
+    double y = (r > 0.0) ? direction[1]/r : 1.0;
+
+    //Same spherical coordinates as cartesianToSpherical
+    double theta = acos(std::max(-1.0, std::min(1.0, y)));
+    double phi = atan2(direction[0], direction[2]);
+
+    evaluateSH(bands, theta, phi, values);
+}
+
+/**
+ * Projects a latitude longitude environment map on the first bands of the spherical harmonics (integral over the sphere, each pixel is weighted by its solid angle).
+ * NaN values of the environment map are ignored.
+ * @brief projectEnvironmentMapSH
+ * @param INPUT : environmentMap is an OpenCV Mat of floats (CV_32FC3, BGR) containing the HDR values of the environment map.
+ * @param INPUT : bands number of bands (at most SH_MAXIMUM_BANDS).
+ * @param OUTPUT : coefficients RGB coefficients of the projection (bands*bands x 1, CV_64FC3, RGB order).
+ */
+void projectEnvironmentMapSH(const Mat &environmentMap, int bands, Mat &coefficients)
+{
+    int numberOfCoefficients = numberOfSHCoefficients(bands);
+    int width = environmentMap.cols;
+    int height = environmentMap.rows;
+
+    coefficients = Mat::zeros(numberOfCoefficients, 1, CV_64FC3);
+
+    //Solid angle of a pixel : sin(theta) dtheta dphi
+    double pixelArea = (M_PI/height)*(2.0*M_PI/width);
+    vector<double> values;
+
+    for(int i = 0 ; i<height ; i++)
+    {
+        const Vec3f* environmentMapRow = environmentMap.ptr<Vec3f>(i);
+        double theta = M_PI*(i+0.5)/height;
+        double solidAngle = sin(theta)*pixelArea;
+
+        for(int j = 0 ; j<width ; j++)
+        {
+            const Vec3f &pixel = environmentMapRow[j];
+
+            //OpenCV uses BGR
+            Vec3d value(isnan(pixel[2]) ? 0.0 : pixel[2], isnan(pixel[1]) ? 0.0 : pixel[1], isnan(pixel[0]) ? 0.0 : pixel[0]);
+            value *= solidAngle;
+
+            evaluateSH(bands, theta, 2.0*M_PI*(j+0.5)/width, values);
+
+            for(int k = 0 ; k<numberOfCoefficients ; k++)
+            {
+                coefficients.at<Vec3d>(k) += value*values[k];
+            }
+        }
+    }
+}
+
+/**
+ * Computes the matrix that transforms the coefficients of a function f into the coefficients of the rotated function g(w) = f(rotation*w).
+ * Each block (band l) is fitted by least squares on directions spread over the sphere : the rotation of a band is exact, the fit only adds rounding errors.
+ * @brief rotationMatrixSH
+ * @param INPUT : bands number of bands (at most SH_MAXIMUM_BANDS).
+ * @param INPUT : rotation 3D rotation matrix.
+ * @param OUTPUT : rotationSH block diagonal matrix (bands*bands x bands*bands, CV_64F).
+ */
+void rotationMatrixSH(int bands, const Matx33d &rotation, Mat &rotationSH)
+{
+    int numberOfCoefficients = numberOfSHCoefficients(bands);
+    int numberOfDirections = 2*numberOfCoefficients + 8;
+
+    rotationSH = Mat::zeros(numberOfCoefficients, numberOfCoefficients, CV_64F);
+
+    //Y(inverse*d) = M Y(d) for each direction d : sampled on a Fibonacci lattice
+    Matx33d inverse = rotation.t();
+    Mat harmonics(numberOfDirections, numberOfCoefficients, CV_64F);
+    Mat rotatedHarmonics(numberOfDirections, numberOfCoefficients, CV_64F);
+    vector<double> values;
+
+    for(int s = 0 ; s<numberOfDirections ; s++)
+    {
+        double y = 1.0 - 2.0*(s+0.5)/numberOfDirections;
+        double radius = sqrt(1.0 - y*y);
+        double angle = s*M_PI*(3.0-sqrt(5.0));
+        Vec3d direction(radius*sin(angle), y, radius*cos(angle));
+
+        evaluateSHDirection(bands, direction, values);
+        for(int k = 0 ; k<numberOfCoefficients ; k++)
+            harmonics.at<double>(s, k) = values[k];
+
+        evaluateSHDirection(bands, inverse*direction, values);
+        for(int k = 0 ; k<numberOfCoefficients ; k++)
+            rotatedHarmonics.at<double>(s, k) = values[k];
+    }
+
+    //A rotation does not mix the bands : one least squares problem per band
+    for(int l = 0 ; l<bands ; l++)
+    {
+        Range band(l*l, (l+1)*(l+1));
+        Mat transposedBlock;
+
+        solve(harmonics.colRange(band), rotatedHarmonics.colRange(band), transposedBlock, DECOMP_SVD);
+
+        Mat block = rotationSH(band, band);
+        Mat(transposedBlock.t()).copyTo(block);
+    }
+}
+
+/**
+ * Rotation around the y axis (vertical axis of the environment maps) : the angle phi of a direction is increased by angle.
+ * @brief rotationY
+ * @param INPUT : angle angle of the rotation in radians.
+ * @return the rotation matrix.
+ */
+Matx33d rotationY(double angle)
+{
+    double c = cos(angle);
+    double s = sin(angle);
+
+    return Matx33d(c, 0.0, s,
+                   0.0, 1.0, 0.0,
+                   -s, 0.0, c);
+}
+
+/**
+ * Rotation given by its Euler angles : rotation around x, then around y, then around z (R = Rz*Ry*Rx).
+ * @brief eulerRotation
+ * @param INPUT : angleX angle around the x axis in radians.
+ * @param INPUT : angleY angle around the y axis in radians.
+ * @param INPUT : angleZ angle around the z axis in radians.
+ * @return the rotation matrix.
+ */
+Matx33d eulerRotation(double angleX, double angleY, double angleZ)
+{
+    double cx = cos(angleX), sx = sin(angleX);
+    double cz = cos(angleZ), sz = sin(angleZ);
+
+    Matx33d rotationX(1.0, 0.0, 0.0,
+                      0.0, cx, -sx,
+                      0.0, sx, cx);
+
+    Matx33d rotationZ(cz, -sz, 0.0,
+                      sz, cz, 0.0,
+                      0.0, 0.0, 1.0);
+
+    return rotationZ*rotationY(angleY)*rotationX;
+}
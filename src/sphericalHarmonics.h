@@ -0,0 +1,120 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file sphericalHarmonics.h
+ * \brief Real spherical harmonics : evaluation, projection of latitude longitude maps and rotation of the coefficients.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The spherical harmonics use the spherical coordinates of mathsFunctions.h : theta is measured from the y axis and phi = atan2(x, z).
+ * A function projected on the first bands is described by bands*bands coefficients. The coefficient of the band l and order m (-l <= m <= l) is at index l*l + l + m.
+ * The coefficients of a rotated function are a matrix-vector product : the matrix is block diagonal (one block per band).
+ */
+
+#ifndef SPHERICALHARMONICS_H
+#define SPHERICALHARMONICS_H
+
+#define _USE_MATH_DEFINES
+#define SH_MAXIMUM_BANDS 10
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Returns the number of coefficients of the first bands of the spherical harmonics (bands*bands).
+ * @brief numberOfSHCoefficients
+ * @param INPUT : bands number of bands.
+ * @return the number of coefficients.
+ */
+int numberOfSHCoefficients(int bands);
+
+/**
+ * Evaluates the real spherical harmonics of the first bands in the direction (theta, phi).
+ * @brief evaluateSH
+ * @param INPUT : bands number of bands (at most SH_MAXIMUM_BANDS).
+ * @param INPUT : theta polar angle (from the y axis) in the range [0:Pi].
+ * @param INPUT : phi azimuthal angle in the range [0:2Pi].
+ * @param OUTPUT : values value of each spherical harmonic (bands*bands values).
+ */
+void evaluateSH(int bands, double theta, double phi, std::vector<double> &values);
+
+/**
+ * Evaluates the real spherical harmonics of the first bands in the direction (x, y, z). The direction does not need to be normalised.
+ * @brief evaluateSHDirection
+ * @param INPUT : bands number of bands (at most SH_MAXIMUM_BANDS).
+ * @param INPUT : direction direction in the cartesian coordinate system.
+ * @param OUTPUT : values value of each spherical harmonic (bands*bands values).
+ */
+void evaluateSHDirection(int bands, const cv::Vec3d &direction, std::vector<double> &values);
+
+/**
+ * Projects a latitude longitude environment map on the first bands of the spherical harmonics (integral over the sphere, each pixel is weighted by its solid angle).
+ * NaN values of the environment map are ignored.
+ * @brief projectEnvironmentMapSH
+ * @param INPUT : environmentMap is an OpenCV Mat of floats (CV_32FC3, BGR) containing the HDR values of the environment map.
+ * @param INPUT : bands number of bands (at most SH_MAXIMUM_BANDS).
+ * @param OUTPUT : coefficients RGB coefficients of the projection (bands*bands x 1, CV_64FC3, RGB order).
+ */
+void projectEnvironmentMapSH(const cv::Mat &environmentMap, int bands, cv::Mat &coefficients);
+
+/**
+ * Computes the matrix that transforms the coefficients of a function f into the coefficients of the rotated function g(w) = f(rotation*w).
+ * Each block (band l) is fitted by least squares on directions spread over the sphere : the rotation of a band is exact, the fit only adds rounding errors.
+ * @brief rotationMatrixSH
+ * @param INPUT : bands number of bands (at most SH_MAXIMUM_BANDS).
+ * @param INPUT : rotation 3D rotation matrix.
+ * @param OUTPUT : rotationSH block diagonal matrix (bands*bands x bands*bands, CV_64F).
+ */
+void rotationMatrixSH(int bands, const cv::Matx33d &rotation, cv::Mat &rotationSH);
+
+/**
+ * Rotation around the y axis (vertical axis of the environment maps) : the angle phi of a direction is increased by angle.
+ * @brief rotationY
+ * @param INPUT : angle angle of the rotation in radians.
+ * @return the rotation matrix.
+ */
+cv::Matx33d rotationY(double angle);
+
+/**
+ * Rotation given by its Euler angles : rotation around x, then around y, then around z (R = Rz*Ry*Rx).
+ * @brief eulerRotation
+ * @param INPUT : angleX angle around the x axis in radians.
+ * @param INPUT : angleY angle around the y axis in radians.
+ * @param INPUT : angleZ angle around the z axis in radians.
+ * @return the rotation matrix.
+ */
+cv::Matx33d eulerRotation(double angleX, double angleY, double angleZ);
+
+#endif // SPHERICALHARMONICS_H
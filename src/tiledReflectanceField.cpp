@@ -0,0 +1,446 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file tiledReflectanceField.cpp
+ * \brief Reflectance field stored on disk in tiles of rows for the out-of-core relighting.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The images are cut in tiles of full rows. A tile contains its rows for all the lighting conditions (one image after the other, 32 bits floats).
+ * The relighting reads one tile at a time : the memory used by the reflectance field is bounded by the budget given when the file is created.
+ */
+
+#include "tiledReflectanceField.h"
+#include "relightingKernels.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Default constructor of the TiledReflectanceField class. No file is opened.
+ * @brief TiledReflectanceField
+ */
+TiledReflectanceField::TiledReflectanceField(): m_file(), m_filePath(), m_tile(), m_numberOfImages(0), m_rows(0), m_cols(0), m_tileRows(0), m_sourceSignature()
+{
+
+}
+
+/**
+ * Destructor of the TiledReflectanceField class. Closes the file.
+ */
+TiledReflectanceField::~TiledReflectanceField()
+{
+    this->close();
+}
+
+/**
+ * Creates a new file for a reflectance field. The images are then written one at a time with writeImage.
+ * The number of rows of the tiles is the largest number such that a tile (all the images) fits in memoryBudget bytes.
+ * @brief create
+ * @param INPUT : filePath path of the file (replaced if it exists).
+ * @param INPUT : numberOfImages number of images (lighting conditions).
+ * @param INPUT : rows height of the images.
+ * @param INPUT : cols width of the images.
+ * @param INPUT : memoryBudget maximum size in bytes of a tile in memory.
+ * @param INPUT : sourceSignature signature of the images written in the file (see Relighting::sourceImagesSignature).
+ * @return EXIT_SUCCESS or EXIT_FAILURE if one row of the images does not fit in memoryBudget bytes or if the file could not be created.
+ */
+bool TiledReflectanceField::create(const string &filePath, unsigned int numberOfImages, int rows, int cols, size_t memoryBudget, const string &sourceSignature)
+{
+    this->close();
+
+    size_t rowSize = (size_t) numberOfImages*cols*3*sizeof(float);
+
+    if(numberOfImages == 0 || rows <= 0 || cols <= 0)
+    {
+        cerr << "Invalid size of the tiled reflectance field" << endl;
+        return EXIT_FAILURE;
+    }
+
+    //A tile contains at least one row : the budget is not exceeded silently
+    int tileRows = (int) min((size_t) rows, memoryBudget/rowSize);
+
+    if(tileRows < 1)
+    {
+        cerr << "The memory budget (" << memoryBudget << " bytes) is smaller than one row of the reflectance field (" << rowSize << " bytes) : "
+             << "increase the memory budget of the out-of-core relighting" << endl;
+        return EXIT_FAILURE;
+    }
+
+    m_file.open(filePath.c_str(), ios::in | ios::out | ios::trunc | ios::binary);
+
+    if(!m_file)
+    {
+        cerr << "Could not write the file : " << filePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    m_filePath = filePath;
+    m_numberOfImages = numberOfImages;
+    m_rows = rows;
+    m_cols = cols;
+    m_tileRows = tileRows;
+
+    //The signature is padded with zeros
+    m_sourceSignature = sourceSignature;
+    m_sourceSignature.resize(SOURCE_SIGNATURE_SIZE, '\0');
+
+    unsigned int header[4] = {m_numberOfImages, (unsigned int) m_rows, (unsigned int) m_cols, (unsigned int) m_tileRows};
+
+    //The file is marked as complete by finish
+    m_file.write("TRFW", 4*sizeof(char));
+    m_file.write((char*) header, 4*sizeof(unsigned int));
+    m_file.write(m_sourceSignature.data(), SOURCE_SIGNATURE_SIZE*sizeof(char));
+
+    //The file is extended to its final size : the images are written at their position in each tile
+    m_file.seekp(this->tileOffset(this->getNumberOfTiles(), 0) - 1);
+    m_file.put(0);
+
+    if(!m_file)
+    {
+        cerr << "Could not allocate the file : " << filePath << endl;
+        this->close();
+        return EXIT_FAILURE;
+    }
+
+    cout << "Tiled reflectance field : " << this->getNumberOfTiles() << " tiles of " << m_tileRows << " rows (" << this->tileMemorySize()/(1024*1024) << " MB in memory)" << endl;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Opens a file written by create and writeImage.
+ * @brief open
+ * @param INPUT : filePath path of the file.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be read.
+ */
+bool TiledReflectanceField::open(const string &filePath)
+{
+    this->close();
+
+    m_file.open(filePath.c_str(), ios::in | ios::binary);
+
+    if(!m_file)
+        return EXIT_FAILURE;
+
+    char type[4];
+    unsigned int header[4];
+    char signature[SOURCE_SIGNATURE_SIZE];
+
+    m_file.read(type, 4*sizeof(char));
+    m_file.read((char*) header, 4*sizeof(unsigned int));
+    m_file.read(signature, SOURCE_SIGNATURE_SIZE*sizeof(char));
+
+    //Files without signature (TRFS) are written again
+    if(!m_file || strncmp(type, "TRF2", 4) != 0 || header[0] == 0 || header[1] == 0 || header[2] == 0 || header[3] == 0)
+    {
+        cerr << "Invalid tiled reflectance field : " << filePath << endl;
+        this->close();
+        return EXIT_FAILURE;
+    }
+
+    m_filePath = filePath;
+    m_numberOfImages = header[0];
+    m_rows = header[1];
+    m_cols = header[2];
+    m_tileRows = header[3];
+    m_sourceSignature = string(signature, SOURCE_SIGNATURE_SIZE);
+
+    //The file must contain all the tiles
+    m_file.seekg(0, ios::end);
+
+    if(m_file.tellg() < this->tileOffset(this->getNumberOfTiles(), 0))
+    {
+        cerr << "Truncated tiled reflectance field : " << filePath << endl;
+        this->close();
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Closes the file.
+ * @brief close
+ */
+void TiledReflectanceField::close()
+{
+    if(m_file.is_open())
+        m_file.close();
+
+    m_file.clear();
+    m_filePath.clear();
+    m_tile.release();
+    m_numberOfImages = 0;
+    m_rows = 0;
+    m_cols = 0;
+    m_tileRows = 0;
+    m_sourceSignature.clear();
+}
+
+/**
+ * Writes image i in the tiles of the file.
+ * @brief writeImage
+ * @param INPUT : i number of the image.
+ * @param INPUT : image CV_32FC3 image with the size of the reflectance field.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the image does not have the correct size or could not be written.
+ */
+bool TiledReflectanceField::writeImage(unsigned int i, const Mat &image)
+{
+    if(i >= m_numberOfImages || image.rows != m_rows || image.cols != m_cols || image.type() != CV_32FC3)
+    {
+        cerr << "Image " << i << " does not match the size of the tiled reflectance field" << endl;
+        return EXIT_FAILURE;
+    }
+
+    for(unsigned int t = 0 ; t<this->getNumberOfTiles() ; ++t)
+    {
+        int firstRow = t*m_tileRows;
+        int lastRow = min(m_rows, firstRow + m_tileRows);
+
+        m_file.seekp(this->tileOffset(t, i));
+
+        for(int r = firstRow ; r<lastRow ; ++r)
+        {
+            m_file.write((const char*) image.ptr<float>(r), 3*m_cols*sizeof(float));
+        }
+    }
+
+    if(!m_file)
+    {
+        cerr << "Could not write image " << i << " in the file : " << m_filePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Marks the file as complete once all the images have been written.
+ * @brief finish
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be written.
+ */
+bool TiledReflectanceField::finish()
+{
+    m_file.seekp(0);
+    m_file.write("TRF2", 4*sizeof(char));
+    m_file.flush();
+
+    if(!m_file)
+    {
+        cerr << "Could not write the file : " << m_filePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Computes the linear combination of the images with the RGB weights. The tiles are read one after the other.
+ * @brief relight
+ * @param INPUT : weightsRGB weights of each image. weightsRGB[i] contains the R, G and B weights of image i.
+ * @param OUTPUT : result CV_32FC3 relit result.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if a tile could not be read.
+ */
+bool TiledReflectanceField::relight(const vector<vector<float> > &weightsRGB, Mat &result)
+{
+    result.create(m_rows, m_cols, CV_32FC3);
+
+    for(unsigned int t = 0 ; t<this->getNumberOfTiles() ; ++t)
+    {
+        if(this->readTile(t) == EXIT_FAILURE)
+            return EXIT_FAILURE;
+
+        //The tile is relit in the rows of the result it covers
+        Mat resultTile = result.rowRange(t*m_tileRows, t*m_tileRows + m_tile.rows());
+
+        WeightedSumKernel weightedSum(m_tile, weightsRGB, resultTile);
+        parallel_for_(Range(0, resultTile.rows), weightedSum, numberOfRowTiles(resultTile.rows));
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Computes several linear combinations at once. Each tile is read once for the whole batch.
+ * @brief relightBatch
+ * @param INPUT : weightsBatch weightsBatch[o] contains the RGB weights of relighting o.
+ * @param OUTPUT : results results[o] is the relit result (CV_32FC3) computed with weightsBatch[o].
+ * @return EXIT_SUCCESS or EXIT_FAILURE if a tile could not be read.
+ */
+bool TiledReflectanceField::relightBatch(const vector<vector<vector<float> > > &weightsBatch, vector<Mat> &results)
+{
+    results.resize(weightsBatch.size());
+    for(unsigned int o = 0 ; o<weightsBatch.size() ; ++o)
+    {
+        results[o].create(m_rows, m_cols, CV_32FC3);
+    }
+
+    vector<Mat> resultTiles(weightsBatch.size());
+
+    for(unsigned int t = 0 ; t<this->getNumberOfTiles() ; ++t)
+    {
+        if(this->readTile(t) == EXIT_FAILURE)
+            return EXIT_FAILURE;
+
+        for(unsigned int o = 0 ; o<weightsBatch.size() ; ++o)
+        {
+            resultTiles[o] = results[o].rowRange(t*m_tileRows, t*m_tileRows + m_tile.rows());
+        }
+
+        BatchWeightedSumKernel batchWeightedSum(m_tile, weightsBatch, resultTiles);
+        parallel_for_(Range(0, m_tile.rows()), batchWeightedSum, numberOfRowTiles(m_tile.rows()));
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Returns true if no file is opened.
+ * @brief empty
+ */
+bool TiledReflectanceField::empty() const
+{
+    return !m_file.is_open();
+}
+
+/**
+ * Getter that returns the number of images.
+ * @brief getNumberOfImages
+ */
+unsigned int TiledReflectanceField::getNumberOfImages() const
+{
+    return m_numberOfImages;
+}
+
+/**
+ * Getter that returns the signature of the images written in the file.
+ * @brief getSourceSignature
+ */
+const string &TiledReflectanceField::getSourceSignature() const
+{
+    return m_sourceSignature;
+}
+
+/**
+ * Getter that returns the number of rows of a tile.
+ * @brief getTileRows
+ */
+int TiledReflectanceField::getTileRows() const
+{
+    return m_tileRows;
+}
+
+/**
+ * Getter that returns the number of tiles.
+ * @brief getNumberOfTiles
+ */
+unsigned int TiledReflectanceField::getNumberOfTiles() const
+{
+    if(m_tileRows == 0)
+        return 0;
+
+    return (m_rows + m_tileRows - 1)/m_tileRows;
+}
+
+/**
+ * Getter that returns the height of the images.
+ * @brief rows
+ */
+int TiledReflectanceField::rows() const
+{
+    return m_rows;
+}
+
+/**
+ * Getter that returns the width of the images.
+ * @brief cols
+ */
+int TiledReflectanceField::cols() const
+{
+    return m_cols;
+}
+
+/**
+ * Returns the size in bytes of a tile in memory.
+ * @brief tileMemorySize
+ */
+size_t TiledReflectanceField::tileMemorySize() const
+{
+    return (size_t) m_numberOfImages*m_tileRows*m_cols*3*sizeof(float);
+}
+
+/**
+ * Returns the position in the file of the rows of image i in tile t.
+ * All the tiles before t have m_tileRows rows. The rows of the images of a tile are stored one image after the other.
+ * tileOffset(getNumberOfTiles(), 0) is the size of the file.
+ * @brief tileOffset
+ */
+streamoff TiledReflectanceField::tileOffset(unsigned int t, unsigned int i) const
+{
+    streamoff headerSize = 4*sizeof(char) + 4*sizeof(unsigned int) + SOURCE_SIGNATURE_SIZE*sizeof(char);
+    streamoff rowSize = (streamoff) 3*m_cols*sizeof(float);
+    streamoff firstRow = min((streamoff) t*m_tileRows, (streamoff) m_rows);
+    streamoff tileRows = min((streamoff) m_rows - firstRow, (streamoff) m_tileRows);
+
+    return headerSize + firstRow*m_numberOfImages*rowSize + (streamoff) i*tileRows*rowSize;
+}
+
+/**
+ * Reads tile t in m_tile.
+ * @brief readTile
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the tile could not be read.
+ */
+bool TiledReflectanceField::readTile(unsigned int t)
+{
+    int tileRows = min(m_rows - (int) t*m_tileRows, m_tileRows);
+
+    //The memory of the tile is reused from one tile to the next (only the last tile can be smaller)
+    m_tile.create(m_numberOfImages, tileRows, m_cols);
+
+    //The images of the tile are contiguous in the file
+    m_file.seekg(this->tileOffset(t, 0));
+
+    for(unsigned int i = 0 ; i<m_numberOfImages ; ++i)
+    {
+        Mat image = m_tile.image(i);
+        m_file.read((char*) image.ptr<float>(), image.total()*3*sizeof(float));
+    }
+
+    if(!m_file)
+    {
+        cerr << "Could not read tile " << t << " of the file : " << m_filePath << endl;
+        m_file.clear();
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
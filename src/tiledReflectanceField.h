@@ -0,0 +1,208 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file tiledReflectanceField.h
+ * \brief Reflectance field stored on disk in tiles of rows for the out-of-core relighting.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The images are cut in tiles of full rows. A tile contains its rows for all the lighting conditions (one image after the other, 32 bits floats).
+ * The number of rows of a tile is chosen from a memory budget when the file is created : the relighting reads one tile at a time
+ * so the memory used by the reflectance field is bounded by the budget instead of the size of the dataset.
+ * File format : "TRF2", numberOfImages, rows, cols, tileRows (unsigned int), signature of the source images (SOURCE_SIGNATURE_SIZE bytes) followed by the tiles.
+ * The type is "TRFW" until all the images have been written (finish) : an incomplete file is never opened.
+ * Files without signature ("TRFS") are not opened.
+ */
+
+#ifndef TILEDREFLECTANCEFIELD_H
+#define TILEDREFLECTANCEFIELD_H
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "reflectanceField.h"
+
+class TiledReflectanceField
+{
+    public:
+
+        /**
+         * Default constructor of the TiledReflectanceField class. No file is opened.
+         * @brief TiledReflectanceField
+         */
+        TiledReflectanceField();
+
+        /**
+         * Destructor of the TiledReflectanceField class. Closes the file.
+         */
+        ~TiledReflectanceField();
+
+        /**
+         * Creates a new file for a reflectance field. The images are then written one at a time with writeImage.
+         * The number of rows of the tiles is the largest number such that a tile (all the images) fits in memoryBudget bytes.
+         * @brief create
+         * @param INPUT : filePath path of the file (replaced if it exists).
+         * @param INPUT : numberOfImages number of images (lighting conditions).
+         * @param INPUT : rows height of the images.
+         * @param INPUT : cols width of the images.
+         * @param INPUT : memoryBudget maximum size in bytes of a tile in memory.
+         * @param INPUT : sourceSignature signature of the images written in the file (see Relighting::sourceImagesSignature).
+         * @return EXIT_SUCCESS or EXIT_FAILURE if one row of the images does not fit in memoryBudget bytes or if the file could not be created.
+         */
+        bool create(const std::string &filePath, unsigned int numberOfImages, int rows, int cols, size_t memoryBudget, const std::string &sourceSignature);
+
+        /**
+         * Opens a file written by create and writeImage.
+         * @brief open
+         * @param INPUT : filePath path of the file.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be read.
+         */
+        bool open(const std::string &filePath);
+
+        /**
+         * Closes the file.
+         * @brief close
+         */
+        void close();
+
+        /**
+         * Writes image i in the tiles of the file.
+         * @brief writeImage
+         * @param INPUT : i number of the image.
+         * @param INPUT : image CV_32FC3 image with the size of the reflectance field.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the image does not have the correct size or could not be written.
+         */
+        bool writeImage(unsigned int i, const cv::Mat &image);
+
+        /**
+         * Marks the file as complete once all the images have been written.
+         * @brief finish
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the file could not be written.
+         */
+        bool finish();
+
+        /**
+         * Computes the linear combination of the images with the RGB weights. The tiles are read one after the other.
+         * @brief relight
+         * @param INPUT : weightsRGB weights of each image. weightsRGB[i] contains the R, G and B weights of image i.
+         * @param OUTPUT : result CV_32FC3 relit result.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if a tile could not be read.
+         */
+        bool relight(const std::vector<std::vector<float> > &weightsRGB, cv::Mat &result);
+
+        /**
+         * Computes several linear combinations at once. Each tile is read once for the whole batch.
+         * @brief relightBatch
+         * @param INPUT : weightsBatch weightsBatch[o] contains the RGB weights of relighting o.
+         * @param OUTPUT : results results[o] is the relit result (CV_32FC3) computed with weightsBatch[o].
+         * @return EXIT_SUCCESS or EXIT_FAILURE if a tile could not be read.
+         */
+        bool relightBatch(const std::vector<std::vector<std::vector<float> > > &weightsBatch, std::vector<cv::Mat> &results);
+
+        /**
+         * Returns true if no file is opened.
+         * @brief empty
+         */
+        bool empty() const;
+
+        /**
+         * Getter that returns the number of images.
+         * @brief getNumberOfImages
+         */
+        unsigned int getNumberOfImages() const;
+
+        /**
+         * Getter that returns the signature of the images written in the file.
+         * @brief getSourceSignature
+         */
+        const std::string &getSourceSignature() const;
+
+        /**
+         * Getter that returns the number of rows of a tile.
+         * @brief getTileRows
+         */
+        int getTileRows() const;
+
+        /**
+         * Getter that returns the number of tiles.
+         * @brief getNumberOfTiles
+         */
+        unsigned int getNumberOfTiles() const;
+
+        /**
+         * Getter that returns the height of the images.
+         * @brief rows
+         */
+        int rows() const;
+
+        /**
+         * Getter that returns the width of the images.
+         * @brief cols
+         */
+        int cols() const;
+
+        /**
+         * Returns the size in bytes of a tile in memory.
+         * @brief tileMemorySize
+         */
+        size_t tileMemorySize() const;
+
+    private:
+        /**
+         * Returns the position in the file of the rows of image i in tile t.
+         * @brief tileOffset
+         */
+        std::streamoff tileOffset(unsigned int t, unsigned int i) const;
+
+        /**
+         * Reads tile t in m_tile.
+         * @brief readTile
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the tile could not be read.
+         */
+        bool readTile(unsigned int t);
+
+        std::fstream m_file; /*!< File of the tiles*/
+        std::string m_filePath; /*!< Path of the file*/
+        ReflectanceField m_tile; /*!< Tile currently in memory (all the images for the rows of the tile)*/
+        unsigned int m_numberOfImages; /*!< Number of images (lighting conditions)*/
+        int m_rows; /*!< Height of the images*/
+        int m_cols; /*!< Width of the images*/
+        int m_tileRows; /*!< Number of rows of a tile (the last tile can be smaller)*/
+        std::string m_sourceSignature; /*!< Signature of the images written in the file (SOURCE_SIGNATURE_SIZE bytes)*/
+};
+
+#endif // TILEDREFLECTANCEFIELD_H
@@ -0,0 +1,225 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file trace.cpp
+ * \brief Spans of the relighting stages written as Chrome trace events.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * A TraceScope records the time spent between its construction and its destruction, with the thread that executed it.
+ * Nothing is recorded until startTracing is called : a disabled scope only reads an atomic flag.
+ * stopTracing writes the recorded spans in the Chrome trace event format (JSON), readable with chrome://tracing or Perfetto.
+ */
+
+#include "trace.h"
+
+using namespace std;
+
+/**
+ * Span recorded by a TraceScope.
+ */
+struct TraceEvent
+{
+    const char* name; /*!< Name of the span*/
+    const char* category; /*!< Category of the span*/
+    qint64 start; /*!< Start in nanoseconds since startTracing*/
+    qint64 duration; /*!< Duration in nanoseconds*/
+    int thread; /*!< Number of the thread that executed the span*/
+};
+
+static QAtomicInt tracingEnabled(0);
+static QElapsedTimer tracingClock;
+static QMutex tracingMutex;
+static std::string tracingFilePath;
+static std::vector<TraceEvent> tracingEvents;
+static std::map<Qt::HANDLE, int> tracingThreads; /*!< Small number given to each thread, in order of appearance*/
+static unsigned int tracingDroppedEvents = 0;
+
+/**
+ * Writes the text between quotes with the characters that are not valid in a JSON string escaped.
+ * @brief writeJSONString
+ */
+static void writeJSONString(ofstream &file, const char* text)
+{
+    file << '"';
+
+    for(const char* c = text ; *c != '\0' ; c++)
+    {
+        if(*c == '"' || *c == '\\')
+            file << '\\' << *c;
+        else if((unsigned char) *c < 0x20)
+            file << ' ';
+        else
+            file << *c;
+    }
+
+    file << '"';
+}
+
+/**
+ * Starts recording the spans. The previous spans are discarded.
+ * @brief startTracing
+ * @param INPUT : filePath path of the JSON file written by stopTracing.
+ */
+void startTracing(const std::string &filePath)
+{
+    QMutexLocker locker(&tracingMutex);
+
+    tracingFilePath = filePath;
+    tracingEvents.clear();
+    tracingThreads.clear();
+    tracingDroppedEvents = 0;
+    tracingClock.start();
+
+    tracingEnabled.fetchAndStoreOrdered(1);
+}
+
+/**
+ * Stops recording the spans and writes them in the file given to startTracing.
+ * @brief stopTracing
+ * @return EXIT_SUCCESS or EXIT_FAILURE if tracing was not started or the file could not be written.
+ */
+bool stopTracing()
+{
+    if(tracingEnabled.fetchAndStoreOrdered(0) == 0)
+        return EXIT_FAILURE;
+
+    QMutexLocker locker(&tracingMutex);
+
+    ofstream file(tracingFilePath.c_str(), ios::out | ios::trunc);
+
+    if(!file)
+    {
+        cerr << "Could not write the trace : " << tracingFilePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    //Timestamps and durations are in microseconds
+    file << "{\"traceEvents\":[" << endl;
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"IBR_Framework\"}}";
+
+    for(std::map<Qt::HANDLE, int>::const_iterator it = tracingThreads.begin() ; it != tracingThreads.end() ; it++)
+    {
+        file << "," << endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << it->second
+             << ",\"args\":{\"name\":\"Thread " << it->second << "\"}}";
+    }
+
+    for(unsigned int e = 0 ; e<tracingEvents.size() ; e++)
+    {
+        const TraceEvent &event = tracingEvents[e];
+
+        file << "," << endl << "{\"name\":";
+        writeJSONString(file, event.name);
+        file << ",\"cat\":";
+        writeJSONString(file, event.category);
+        file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+             << ",\"ts\":" << event.start/1000 << "." << (event.start%1000)/100
+             << ",\"dur\":" << event.duration/1000 << "." << (event.duration%1000)/100 << "}";
+    }
+
+    file << endl << "],\"displayTimeUnit\":\"ms\"}" << endl;
+
+    if(tracingDroppedEvents > 0)
+        cerr << tracingDroppedEvents << " spans were not recorded (more than " << TRACE_MAXIMUM_EVENTS << " spans)" << endl;
+
+    tracingEvents.clear();
+    tracingThreads.clear();
+
+    if(!file)
+    {
+        cerr << "Could not write the trace : " << tracingFilePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    cout << "Trace written in " << tracingFilePath << endl;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Returns true if the spans are recorded.
+ * @brief isTracing
+ */
+bool isTracing()
+{
+    return tracingEnabled.loadAcquire() != 0;
+}
+
+/**
+ * Starts a span. The name and the category must remain valid until the end of the tracing (string literals).
+ * @brief TraceScope
+ * @param INPUT : name name of the span (e.g. "Voronoi::computeVoronoiWeightsRGB").
+ * @param INPUT : category category of the span (relighting, voronoi, optimisation...).
+ */
+TraceScope::TraceScope(const char* name, const char* category): m_name(name), m_category(category), m_start(-1)
+{
+    if(tracingEnabled.loadAcquire() != 0)
+        m_start = tracingClock.nsecsElapsed();
+}
+
+/**
+ * Ends the span and records it if tracing is enabled.
+ * @brief ~TraceScope
+ */
+TraceScope::~TraceScope()
+{
+    if(m_start < 0 || tracingEnabled.loadAcquire() == 0)
+        return;
+
+    qint64 end = tracingClock.nsecsElapsed();
+
+    QMutexLocker locker(&tracingMutex);
+
+    //Tracing may have been stopped while the lock was acquired
+    if(tracingEnabled.loadAcquire() == 0)
+        return;
+
+    if(tracingEvents.size() >= TRACE_MAXIMUM_EVENTS)
+    {
+        tracingDroppedEvents++;
+        return;
+    }
+
+    Qt::HANDLE threadId = QThread::currentThreadId();
+    std::map<Qt::HANDLE, int>::iterator thread = tracingThreads.find(threadId);
+
+    if(thread == tracingThreads.end())
+        thread = tracingThreads.insert(std::make_pair(threadId, (int) tracingThreads.size())).first;
+
+    TraceEvent event;
+    event.name = m_name;
+    event.category = m_category;
+    event.start = m_start;
+    event.duration = end - m_start;
+    event.thread = thread->second;
+
+    tracingEvents.push_back(event);
+}
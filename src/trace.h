@@ -0,0 +1,108 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file trace.h
+ * \brief Spans of the relighting stages written as Chrome trace events.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * A TraceScope records the time spent between its construction and its destruction, with the thread that executed it.
+ * Nothing is recorded until startTracing is called : a disabled scope only reads an atomic flag.
+ * stopTracing writes the recorded spans in the Chrome trace event format (JSON), readable with chrome://tracing or Perfetto.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_MAXIMUM_EVENTS 1000000
+
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+/**
+ * Starts recording the spans. The previous spans are discarded.
+ * @brief startTracing
+ * @param INPUT : filePath path of the JSON file written by stopTracing.
+ */
+void startTracing(const std::string &filePath);
+
+/**
+ * Stops recording the spans and writes them in the file given to startTracing.
+ * @brief stopTracing
+ * @return EXIT_SUCCESS or EXIT_FAILURE if tracing was not started or the file could not be written.
+ */
+bool stopTracing();
+
+/**
+ * Returns true if the spans are recorded.
+ * @brief isTracing
+ */
+bool isTracing();
+
+class TraceScope
+{
+    public:
+
+        /**
+         * Starts a span. The name and the category must remain valid until the end of the tracing (string literals).
+         * @brief TraceScope
+         * @param INPUT : name name of the span (e.g. "Voronoi::computeVoronoiWeightsRGB").
+         * @param INPUT : category category of the span (relighting, voronoi, optimisation...).
+         */
+        TraceScope(const char* name, const char* category = "relighting");
+
+        /**
+         * Ends the span and records it if tracing is enabled.
+         * @brief ~TraceScope
+         */
+        ~TraceScope();
+
+    private:
+        //Scopes are not copied (the span would be recorded twice)
+        TraceScope(const TraceScope &);
+        TraceScope& operator=(const TraceScope &);
+
+        const char* m_name; /*!< Name of the span*/
+        const char* m_category; /*!< Category of the span*/
+        qint64 m_start; /*!< Start of the span in nanoseconds since startTracing (-1 if tracing was disabled)*/
+};
+
+#endif // TRACE_H
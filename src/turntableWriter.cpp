@@ -0,0 +1,209 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file turntableWriter.cpp
+ * \brief Writes the frames of a turntable in order while they are computed in parallel.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The frames are computed in any order by a thread pool and given to the writer with submit. The writer keeps them in a reorder buffer
+ * and its own thread encodes them in order : in a video (cv::VideoWriter, Motion JPEG) or as an image sequence (one file per frame).
+ * The encoding of a frame overlaps the computation of the next frames.
+ * acquireFrame must be called before a frame is started : it waits while maxFramesInFlight frames are computed or waiting to be written,
+ * so that the reorder buffer stays bounded. The frames must be started in order (the next frame to write is always in flight).
+ */
+
+#include "turntableWriter.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Constructor of the TurntableWriter class.
+ * @brief TurntableWriter
+ * @param INPUT : maxFramesInFlight maximum number of frames computed or waiting in the reorder buffer (0 : twice the number of cores).
+ */
+TurntableWriter::TurntableWriter(int maxFramesInFlight): QThread(), m_video(), m_filePaths(std::vector<std::string>()), m_numberOfFrames(0), m_nextFrame(0),
+    m_reorderBuffer(std::map<unsigned int, Mat>()), m_maximumBufferedFrames(0), m_failed(false),
+    m_framesInFlight(maxFramesInFlight > 0 ? maxFramesInFlight : 2*QThread::idealThreadCount())
+{
+
+}
+
+/**
+ * Destructor of the TurntableWriter class. Waits for the writing thread.
+ */
+TurntableWriter::~TurntableWriter()
+{
+    this->wait();
+}
+
+/**
+ * Opens a video and starts the writing thread.
+ * @brief openVideo
+ * @param INPUT : filePath path of the video (e.g. .avi).
+ * @param INPUT : numberOfFrames number of frames of the turntable.
+ * @param INPUT : frameSize size of the frames.
+ * @param INPUT : framesPerSecond frame rate of the video.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if the video could not be opened.
+ */
+bool TurntableWriter::openVideo(const std::string &filePath, unsigned int numberOfFrames, Size frameSize, double framesPerSecond)
+{
+    if(numberOfFrames == 0 || !m_video.open(filePath, CV_FOURCC('M','J','P','G'), framesPerSecond, frameSize, true))
+    {
+        cerr << "Could not open the video : " << filePath << endl;
+        return EXIT_FAILURE;
+    }
+
+    m_filePaths.clear();
+    m_numberOfFrames = numberOfFrames;
+    m_nextFrame = 0;
+    m_failed = false;
+    this->start();
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Starts the writing thread for an image sequence.
+ * @brief openImageSequence
+ * @param INPUT : filePaths path of the file of each frame.
+ * @return EXIT_SUCCESS or EXIT_FAILURE if there are no frames.
+ */
+bool TurntableWriter::openImageSequence(const std::vector<std::string> &filePaths)
+{
+    if(filePaths.empty())
+        return EXIT_FAILURE;
+
+    m_filePaths = filePaths;
+    m_numberOfFrames = filePaths.size();
+    m_nextFrame = 0;
+    m_failed = false;
+    this->start();
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Waits for a free place for a new frame. Called in the order of the frames before the frame is computed.
+ * @brief acquireFrame
+ */
+void TurntableWriter::acquireFrame()
+{
+    m_framesInFlight.acquire();
+}
+
+/**
+ * Gives a computed frame to the writer. Can be called by any thread. An empty image skips the frame (cancelled frame).
+ * @brief submit
+ * @param INPUT : frame number of the frame.
+ * @param INPUT : image CV_8UC3 image of the frame (not copied : the caller must not modify it).
+ */
+void TurntableWriter::submit(unsigned int frame, const Mat &image)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_reorderBuffer[frame] = image;
+    m_maximumBufferedFrames = std::max(m_maximumBufferedFrames, (unsigned int) m_reorderBuffer.size());
+
+    //The writing thread only waits for the next frame
+    if(frame == m_nextFrame)
+        m_frameSubmitted.wakeOne();
+}
+
+/**
+ * Waits until all the frames have been written and closes the output.
+ * @brief finish
+ * @return EXIT_SUCCESS or EXIT_FAILURE if a frame could not be written.
+ */
+bool TurntableWriter::finish()
+{
+    this->wait();
+    m_video.release();
+
+    return m_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Getter that returns the largest number of frames that waited in the reorder buffer.
+ * @brief getMaximumBufferedFrames
+ */
+unsigned int TurntableWriter::getMaximumBufferedFrames() const
+{
+    return m_maximumBufferedFrames;
+}
+
+/**
+ * Writing thread : writes the frames in order as soon as they are in the reorder buffer.
+ * @brief run
+ */
+void TurntableWriter::run()
+{
+    while(m_nextFrame < m_numberOfFrames)
+    {
+        Mat image;
+
+        {
+            QMutexLocker locker(&m_mutex);
+
+            while(m_reorderBuffer.find(m_nextFrame) == m_reorderBuffer.end())
+                m_frameSubmitted.wait(&m_mutex);
+
+            image = m_reorderBuffer[m_nextFrame];
+            m_reorderBuffer.erase(m_nextFrame);
+        }
+
+        //The frame is encoded without the lock : the other frames can be submitted meanwhile
+        if(image.data)
+        {
+            TraceScope traceScope("TurntableWriter::writeFrame");
+
+            if(m_video.isOpened())
+            {
+                m_video.write(image);
+            }
+            else if(!imwrite(m_filePaths[m_nextFrame], image))
+            {
+                cerr << "Could not write the frame : " << m_filePaths[m_nextFrame] << endl;
+                m_failed = true;
+            }
+        }
+
+        image.release();
+
+        {
+            QMutexLocker locker(&m_mutex);
+            m_nextFrame++;
+        }
+
+        m_framesInFlight.release();
+    }
+}
@@ -0,0 +1,146 @@
+/*
+ *     Image-Based Relighting Framework
+ *
+ *     Author:  Antoine TOISOUL LE CANN
+ *
+ *     Copyright © 2016 Antoine TOISOUL LE CANN, Imperial College London
+ *              All rights reserved
+ *
+ *
+ * Image-Based Relighting Framework is free software: you can redistribute it and/or modify
+ *
+ * it under the terms of the GNU Lesser General Public License as published by
+ *
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Image-Based Relighting Framework is distributed in the hope that it will be useful,
+ *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file turntableWriter.h
+ * \brief Writes the frames of a turntable in order while they are computed in parallel.
+ * \author agent
+ * \date October, 16th, 2026
+ *
+ * The frames are computed in any order by a thread pool and given to the writer with submit. The writer keeps them in a reorder buffer
+ * and its own thread encodes them in order : in a video (cv::VideoWriter, Motion JPEG) or as an image sequence (one file per frame).
+ * The encoding of a frame overlaps the computation of the next frames.
+ * acquireFrame must be called before a frame is started : it waits while maxFramesInFlight frames are computed or waiting to be written,
+ * so that the reorder buffer stays bounded. The frames must be started in order (the next frame to write is always in flight).
+ */
+
+#ifndef TURNTABLEWRITER_H
+#define TURNTABLEWRITER_H
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv/highgui.h>
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "trace.h"
+
+class TurntableWriter : public QThread
+{
+    public:
+
+        /**
+         * Constructor of the TurntableWriter class.
+         * @brief TurntableWriter
+         * @param INPUT : maxFramesInFlight maximum number of frames computed or waiting in the reorder buffer (0 : twice the number of cores).
+         */
+        TurntableWriter(int maxFramesInFlight = 0);
+
+        /**
+         * Destructor of the TurntableWriter class. Waits for the writing thread.
+         */
+        ~TurntableWriter();
+
+        /**
+         * Opens a video and starts the writing thread.
+         * @brief openVideo
+         * @param INPUT : filePath path of the video (e.g. .avi).
+         * @param INPUT : numberOfFrames number of frames of the turntable.
+         * @param INPUT : frameSize size of the frames.
+         * @param INPUT : framesPerSecond frame rate of the video.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if the video could not be opened.
+         */
+        bool openVideo(const std::string &filePath, unsigned int numberOfFrames, cv::Size frameSize, double framesPerSecond);
+
+        /**
+         * Starts the writing thread for an image sequence.
+         * @brief openImageSequence
+         * @param INPUT : filePaths path of the file of each frame.
+         * @return EXIT_SUCCESS or EXIT_FAILURE if there are no frames.
+         */
+        bool openImageSequence(const std::vector<std::string> &filePaths);
+
+        /**
+         * Waits for a free place for a new frame. Called in the order of the frames before the frame is computed.
+         * @brief acquireFrame
+         */
+        void acquireFrame();
+
+        /**
+         * Gives a computed frame to the writer. Can be called by any thread. An empty image skips the frame (cancelled frame).
+         * @brief submit
+         * @param INPUT : frame number of the frame.
+         * @param INPUT : image CV_8UC3 image of the frame (not copied : the caller must not modify it).
+         */
+        void submit(unsigned int frame, const cv::Mat &image);
+
+        /**
+         * Waits until all the frames have been written and closes the output.
+         * @brief finish
+         * @return EXIT_SUCCESS or EXIT_FAILURE if a frame could not be written.
+         */
+        bool finish();
+
+        /**
+         * Getter that returns the largest number of frames that waited in the reorder buffer.
+         * @brief getMaximumBufferedFrames
+         */
+        unsigned int getMaximumBufferedFrames() const;
+
+    protected:
+        /**
+         * Writing thread : writes the frames in order as soon as they are in the reorder buffer.
+         * @brief run
+         */
+        virtual void run();
+
+    private:
+        cv::VideoWriter m_video; /*!< Video written (not opened for an image sequence)*/
+        std::vector<std::string> m_filePaths; /*!< Path of each frame of an image sequence (empty for a video)*/
+        unsigned int m_numberOfFrames; /*!< Number of frames of the turntable*/
+        unsigned int m_nextFrame; /*!< Next frame to write*/
+        std::map<unsigned int, cv::Mat> m_reorderBuffer; /*!< Frames computed but not written yet*/
+        unsigned int m_maximumBufferedFrames; /*!< Largest size of the reorder buffer*/
+        bool m_failed; /*!< True if a frame could not be written*/
+        QMutex m_mutex; /*!< Protects the reorder buffer*/
+        QWaitCondition m_frameSubmitted; /*!< Wakes the writing thread when a frame is submitted*/
+        QSemaphore m_framesInFlight; /*!< Free places for frames being computed or buffered*/
+};
+
+#endif // TURNTABLEWRITER_H
@@ -47,7 +47,11 @@ using namespace cv;
  * @brief Voronoi
  */
 Voronoi::Voronoi(): m_basis(LightingBasis()), m_numberOfPixelsInVoronoiCell(vector<int>()), m_voronoiSubdivision(Subdiv2D()),
-    m_cellNumberPerPicture(vector<vector<int> >()), m_intensity(vector<float >()), m_rgbWeights(vector<vector<float> >()), m_envMapWidth(1024), m_envMapHeight(512)
+    m_cellNumberPerPicture(vector<vector<int> >()), m_intensity(vector<float >()), m_rgbWeights(vector<vector<float> >()), m_envMapWidth(1024), m_envMapHeight(512), m_labelMap(Mat()),
+    m_rotationWeightTable(Mat()), m_rotationTableEnvironmentMap(Mat()), m_rotationTableOutputs(ROTATION_TABLE_CELLS),
+    m_shBasis(Mat()), m_lightIntensitiesRGB(vector<Vec3d>()), m_waveletBasis(vector<SparseWaveletCoefficient>()),
+    m_labelRuns(vector<Vec2i>()), m_labelRunRows(vector<int>()),
+    m_pyramidTolerance(0.0), m_environmentMapPyramid(EnvironmentMapPyramid()), m_labelPyramid(LabelMapPyramid()), m_cancelToken(NULL)
 {
     //Initialising the voronoi subdivision
     Rect boundingBoxEnvMap(0,0,m_envMapWidth,m_envMapHeight);
@@ -65,7 +69,11 @@ Voronoi::Voronoi(): m_basis(LightingBasis()), m_numberOfPixelsInVoronoiCell(vect
 Voronoi::Voronoi(LightingBasis& basis, unsigned int envMapWidth, unsigned int envMapHeight, vector<vector<int> >& cellNumberPerPicture):
     m_basis(basis), m_numberOfPixelsInVoronoiCell(vector<int>()), m_voronoiSubdivision(Subdiv2D()),
     m_cellNumberPerPicture(cellNumberPerPicture), m_intensity(vector<float >()),
-    m_rgbWeights(vector<vector<float> >()), m_envMapWidth(envMapWidth), m_envMapHeight(envMapHeight)
+    m_rgbWeights(vector<vector<float> >()), m_envMapWidth(envMapWidth), m_envMapHeight(envMapHeight), m_labelMap(Mat()),
+    m_rotationWeightTable(Mat()), m_rotationTableEnvironmentMap(Mat()), m_rotationTableOutputs(ROTATION_TABLE_CELLS),
+    m_shBasis(Mat()), m_lightIntensitiesRGB(vector<Vec3d>()), m_waveletBasis(vector<SparseWaveletCoefficient>()),
+    m_labelRuns(vector<Vec2i>()), m_labelRunRows(vector<int>()),
+    m_pyramidTolerance(0.0), m_environmentMapPyramid(EnvironmentMapPyramid()), m_labelPyramid(LabelMapPyramid()), m_cancelToken(NULL)
 {
     //Initialising the voronoi subdivision
     Rect boundingBoxEnvMap(0,0,m_envMapWidth,m_envMapHeight);
@@ -97,7 +105,13 @@ void Voronoi::addPointLight(Point2i lightPosition)
     {
         m_basis.addPointLight(lightPosition);
         m_voronoiSubdivision.insert(lightPosition); /*!< The Voronoi subdivision*/
-
+        m_labelMap.release();
+        m_rotationWeightTable.release();
+        m_shBasis.release();
+        m_waveletBasis = vector<SparseWaveletCoefficient>();
+        m_labelRuns = vector<Vec2i>();
+        m_labelRunRows = vector<int>();
+        m_labelPyramid.clear();
     }
     this->numberOfPixelsPerVoronoiCell();
 }
@@ -114,6 +128,13 @@ void Voronoi::addAreaLight(Point2i startingPoint, Point2i endingPoint)
 
     Point2i center = (startingPoint+endingPoint)*0.5;
     m_voronoiSubdivision.insert(center);
+    m_labelMap.release();
+    m_rotationWeightTable.release();
+    m_shBasis.release();
+    m_waveletBasis = vector<SparseWaveletCoefficient>();
+    m_labelRuns = vector<Vec2i>();
+    m_labelRunRows = vector<int>();
+    m_labelPyramid.clear();
     this->numberOfPixelsPerVoronoiCell();
 }
 
@@ -124,6 +145,16 @@ void Voronoi::addAreaLight(Point2i startingPoint, Point2i endingPoint)
  */
 void Voronoi::setVoronoi(vector<Point2i> &pointLightSourcePosition)
 {
+    TraceScope traceScope("Voronoi::setVoronoi", "voronoi");
+
+    m_labelMap.release();
+    m_rotationWeightTable.release();
+    m_shBasis.release();
+    m_waveletBasis = vector<SparseWaveletCoefficient>();
+    m_labelRuns = vector<Vec2i>();
+    m_labelRunRows = vector<int>();
+    m_labelPyramid.clear();
+
     unsigned int numberOfPointLights = pointLightSourcePosition.size();
     m_basis.addPointLights(pointLightSourcePosition);
 
@@ -150,6 +181,16 @@ void Voronoi::setVoronoi(vector<Point2i> &pointLightSourcePosition)
  */
 void Voronoi::setVoronoi(vector<Point2i> &pointLightSourcePosition, vector<vector<int> > &cellNumberPerPicture)
 {
+    TraceScope traceScope("Voronoi::setVoronoi", "voronoi");
+
+    m_labelMap.release();
+    m_rotationWeightTable.release();
+    m_shBasis.release();
+    m_waveletBasis = vector<SparseWaveletCoefficient>();
+    m_labelRuns = vector<Vec2i>();
+    m_labelRunRows = vector<int>();
+    m_labelPyramid.clear();
+
     unsigned int numberOfPointLights = pointLightSourcePosition.size();
     m_basis.addPointLights(pointLightSourcePosition);
     m_cellNumberPerPicture = cellNumberPerPicture;
@@ -182,6 +223,13 @@ void Voronoi::clearVoronoi()
 
     m_intensity =  vector<float >();
     m_rgbWeights = vector<vector<float> >();
+    m_labelMap.release();
+    m_rotationWeightTable.release();
+    m_shBasis.release();
+    m_waveletBasis = vector<SparseWaveletCoefficient>();
+    m_labelRuns = vector<Vec2i>();
+    m_labelRunRows = vector<int>();
+    m_labelPyramid.clear();
 }
 
 /**
@@ -191,6 +239,8 @@ void Voronoi::clearVoronoi()
  */
 void Voronoi::numberOfPixelsPerVoronoiCell()
 {
+    TraceScope traceScope("Voronoi::numberOfPixelsPerVoronoiCell", "voronoi");
+
         //Initialise the vector with zeros
         m_numberOfPixelsInVoronoiCell.assign(m_basis.getNumberOfPointLights(), 0);
 
@@ -282,11 +332,7 @@ void Voronoi::paintLightStageIntensities(Mat& img)
     vector<vector<float> > lightIntensities;
 
     ostringstream osstream;
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
     osstream << "/light_intensities.txt";
 
     readFile(osstream.str(), lightIntensities);
@@ -504,6 +550,8 @@ void Voronoi::paintVoronoiIntensity(Mat& img)
 */
 void Voronoi::computeVoronoiIntensity(Mat &environmentMap)
 {
+    TraceScope traceScope("Voronoi::computeVoronoiIntensity", "voronoi");
+
     float R = 0.0, G = 0.0, B = 0.0;
     int numberOfPointLights = m_basis.getNumberOfPointLights();
     int cellNumber = -1;
@@ -515,11 +563,7 @@ void Voronoi::computeVoronoiIntensity(Mat &environmentMap)
     vector<vector<float> > lightIntensities;
     ostringstream osstream;
 
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
     osstream << "/light_intensities.txt";
 
     readFile(osstream.str(), lightIntensities);
@@ -552,6 +596,8 @@ void Voronoi::computeVoronoiIntensity(Mat &environmentMap)
 */
 void Voronoi::computeVoronoiWeightsRGB(const Mat &environmentMap, float offset)
 {
+    TraceScope traceScope("Voronoi::computeVoronoiWeightsRGB", "voronoi");
+
     float R = 0.0, G = 0.0, B = 0.0;
     int cellNumber = -1;
     int numberOfPointLights = m_basis.getNumberOfPointLights();
@@ -568,17 +614,30 @@ void Voronoi::computeVoronoiWeightsRGB(const Mat &environmentMap, float offset)
     vector<vector<float> > lightIntensities;
     ostringstream osstream;
 
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
     osstream << "/light_intensities.txt";
 
     readFile(osstream.str(), lightIntensities);
 
+    vector<PyramidIntegral> integrals;
+
+    if(this->integratePyramid(environmentMap, jOffset, integrals))
+    {
+        for(int c = 0 ; c<numberOfPointLights ; c++)
+        {
+            m_rgbWeights[c][0] += integrals[c].sum[0]*lightIntensities[c][0];
+            m_rgbWeights[c][1] += integrals[c].sum[1]*lightIntensities[c][1];
+            m_rgbWeights[c][2] += integrals[c].sum[2]*lightIntensities[c][2];
+        }
+
+        return;
+    }
+
     for(unsigned int i = 0 ; i<m_envMapHeight ; i++)
     {
+        if(this->isCancelled())
+            return;
+
         for(unsigned int j = 0 ; j< m_envMapWidth ; j++)
         {
             cellNumber = this->findNearestLightSource(j,i);
@@ -619,6 +678,8 @@ void Voronoi::computeVoronoiWeightsRGB(const Mat &environmentMap, float offset)
 */
 void Voronoi::computeVoronoiWeightsGaussian(const Mat &environmentMap, const float offset)
 {
+    TraceScope traceScope("Voronoi::computeVoronoiWeightsGaussian", "voronoi");
+
     float R = 0.0, G = 0.0, B = 0.0;
     int cellNumber = -1;
     int numberOfPointLights = m_basis.getNumberOfPointLights();
@@ -640,11 +701,7 @@ void Voronoi::computeVoronoiWeightsGaussian(const Mat &environmentMap, const flo
     int jOffset = floor(offset*m_envMapWidth/(2.0*M_PI));
     ostringstream osstream;
 
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
     osstream << "/light_intensities.txt";
 
     readFile(osstream.str(), lightIntensities);
@@ -654,6 +711,9 @@ void Voronoi::computeVoronoiWeightsGaussian(const Mat &environmentMap, const flo
 
     for(unsigned int i = 0 ; i<m_envMapHeight ; i++)
     {
+        if(this->isCancelled())
+            return;
+
         for(unsigned int j = 0 ; j< m_envMapWidth ; j++)
         {
 
@@ -692,6 +752,8 @@ void Voronoi::computeVoronoiWeightsGaussian(const Mat &environmentMap, const flo
 */
 void Voronoi::computeVoronoiWeightsOR(const Mat &environmentMap, const float offset)
 {
+    TraceScope traceScope("Voronoi::computeVoronoiWeightsOR", "voronoi");
+
     float R = 0.0, G = 0.0, B = 0.0;
     int cellNumber = -1;
     int imageNumber = -1;
@@ -709,8 +771,31 @@ void Voronoi::computeVoronoiWeightsOR(const Mat &environmentMap, const float off
 
     int jOffset = floor(offset*m_envMapWidth/(2.0*M_PI));
 
+    vector<PyramidIntegral> integrals;
+
+    if(this->integratePyramid(environmentMap, jOffset, integrals))
+    {
+        for(unsigned int c = 0 ; c<integrals.size() ; c++)
+        {
+            //Given a cell number, which image does the cell correspond to ?
+            imageNumber = this->findImageNumber(c);
+
+            if(imageNumber != -1)
+            {
+                m_rgbWeights[imageNumber][0] += integrals[c].sum[0];
+                m_rgbWeights[imageNumber][1] += integrals[c].sum[1];
+                m_rgbWeights[imageNumber][2] += integrals[c].sum[2];
+            }
+        }
+
+        return;
+    }
+
     for(unsigned int i = 0 ; i<m_envMapHeight ; i++)
     {
+        if(this->isCancelled())
+            return;
+
         for(unsigned int j = 0 ; j<m_envMapWidth ; j++)
         {
             currentPoint = Point2i(j,i);
@@ -751,6 +836,8 @@ void Voronoi::computeVoronoiWeightsOR(const Mat &environmentMap, const float off
  */
 void Voronoi::computeVoronoiWeightsGaussianOR(const Mat &environmentMap, const float offset, float varianceX[], float varianceY[])
 {
+    TraceScope traceScope("Voronoi::computeVoronoiWeightsGaussianOR", "voronoi");
+
     float R = 0.0, G = 0.0, B = 0.0;
     int cellNumber = -1;
     int imageNumber = -1;
@@ -807,6 +894,9 @@ void Voronoi::computeVoronoiWeightsGaussianOR(const Mat &environmentMap, const f
 
     for(unsigned int i = 0 ; i<m_envMapHeight ; i++)
     {
+        if(this->isCancelled())
+            return;
+
         for(unsigned int j = 0 ; j< m_envMapWidth ; j++)
         {
             currentPoint = Point2i(j,i);
@@ -861,6 +951,11 @@ void Voronoi::computeVoronoiWeightsGaussianOR(const Mat &environmentMap, const f
 void Voronoi::setCellNumberPerPicture(vector<vector<int> > &cellNumberPerPicture)
 {
     this->m_cellNumberPerPicture = cellNumberPerPicture;
+    m_rotationWeightTable.release();
+    m_shBasis.release();
+    m_waveletBasis = vector<SparseWaveletCoefficient>();
+    m_labelRuns = vector<Vec2i>();
+    m_labelRunRows = vector<int>();
 }
 
 /*****************************************************************
@@ -900,6 +995,9 @@ int Voronoi::findLightSource(int x, int y)
 */
 int Voronoi::findNearestLightSource(int x, int y)
 {
+    if(!m_labelMap.empty())
+        return m_labelMap.at<int>(y,x);
+
     Point2f result;
     Point2i currentPoint(x,y);
 
@@ -941,11 +1039,7 @@ void Voronoi::saveVoronoi()
 
     ostringstream osstream;
 
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
 
     osstream << "/voronoi.txt";
 
@@ -993,11 +1087,7 @@ void Voronoi::loadVoronoi()
     //Load the voronoi diagram
     ostringstream osstream;
 
-#if defined(__APPLE__) && defined(__MACH__)
-    osstream << qApp->applicationDirPath().toStdString() << "/../../..";
-#else
-    osstream << qApp->applicationDirPath().toStdString();
-#endif
+    osstream << dataRootPath();
     osstream << "/voronoi.txt";
 
     //Open the file and delete all the text inside
@@ -1048,6 +1138,636 @@ void Voronoi::setEnvironmentMapSize(unsigned int width, unsigned int height)
     this->m_envMapHeight = height;
     Rect boundingBoxEnvMap(0,0,m_envMapWidth,m_envMapHeight);
     m_voronoiSubdivision = Subdiv2D(boundingBoxEnvMap);
+    m_labelMap.release();
+    m_rotationWeightTable.release();
+    m_shBasis.release();
+    m_waveletBasis = vector<SparseWaveletCoefficient>();
+    m_labelRuns = vector<Vec2i>();
+    m_labelRunRows = vector<int>();
+    m_labelPyramid.clear();
+}
+
+/**
+ * Computes the label map of the Voronoi diagram : the number of the nearest light source of every pixel of the environment map.
+ * findNearestLightSource then reads the label map instead of searching the subdivision.
+ * The label map is released when the diagram or the size of the environment map changes.
+ * @brief computeLabelMap
+ */
+void Voronoi::computeLabelMap()
+{
+    TraceScope traceScope("Voronoi::computeLabelMap", "voronoi");
+
+    m_labelMap.release();
+    m_rotationWeightTable.release();
+    m_shBasis.release();
+    m_waveletBasis = vector<SparseWaveletCoefficient>();
+    m_labelRuns = vector<Vec2i>();
+    m_labelRunRows = vector<int>();
+    m_labelPyramid.clear();
+    Mat labelMap(m_envMapHeight, m_envMapWidth, CV_32SC1);
+
+    for(unsigned int i = 0 ; i<m_envMapHeight ; i++)
+    {
+        int* labelRow = labelMap.ptr<int>(i);
+
+        for(unsigned int j = 0 ; j<m_envMapWidth ; j++)
+        {
+            labelRow[j] = this->findNearestLightSource(j,i);
+        }
+    }
+
+    m_labelMap = labelMap;
+}
+
+/**
+ * Returns true if the label map of the current Voronoi diagram has been computed for an environment map of the given size.
+ * @brief hasLabelMap
+ * @param INPUT : width width of the environment map.
+ * @param INPUT : height height of the environment map.
+ */
+bool Voronoi::hasLabelMap(unsigned int width, unsigned int height) const
+{
+    return !m_labelMap.empty() && m_labelMap.cols == (int) width && m_labelMap.rows == (int) height;
+}
+
+/**
+ * Returns the size in bytes of the label map, of the rotation weight table and of the projections of the cells on the spherical harmonics and the Haar wavelets and of the pyramids (0 if they have not been computed).
+ * @brief labelMapMemorySize
+ */
+size_t Voronoi::labelMapMemorySize() const
+{
+    return m_labelMap.total()*m_labelMap.elemSize() + m_rotationWeightTable.total()*m_rotationWeightTable.elemSize() + m_shBasis.total()*m_shBasis.elemSize()
+            + m_waveletBasis.size()*sizeof(SparseWaveletCoefficient) + m_labelRuns.size()*sizeof(Vec2i) + m_labelRunRows.size()*sizeof(int)
+            + m_environmentMapPyramid.memorySize() + m_labelPyramid.memorySize();
+}
+
+/**
+ * Computes the weights of every output for all the integer rotations of the environment map at once (rotation weight table).
+ * A rotation by s columns shifts each row of the environment map : the weight of a run of pixels [a ; b[ of a cell in row i is P(b+s) - P(a+s),
+ * where P is the circular prefix sum of row i multiplied by the solid angle. The cost is (number of runs) x width per row instead of a scan of the map per rotation.
+ * The weights are those of computeVoronoiWeightsRGB (ROTATION_TABLE_CELLS) or computeVoronoiWeightsOR (ROTATION_TABLE_IMAGES) for each offset.
+ * The label map is computed if needed. The table is released when the diagram changes.
+ * @brief computeRotationWeightTable
+ * @param INPUT : environmentMap is an OpenCV Mat of floats containing the HDR values of the environment map.
+ * @param INPUT : outputs ROTATION_TABLE_CELLS (one weight per cell, normalised by the light intensities) or ROTATION_TABLE_IMAGES (one weight per picture).
+ */
+void Voronoi::computeRotationWeightTable(const Mat &environmentMap, rotationTableOutputs outputs)
+{
+    TraceScope traceScope("Voronoi::computeRotationWeightTable", "voronoi");
+
+    if(!this->hasLabelMap(m_envMapWidth, m_envMapHeight))
+        this->computeLabelMap();
+
+    int width = m_envMapWidth;
+    int height = m_envMapHeight;
+    int numberOfPointLights = m_basis.getNumberOfPointLights();
+
+    //Output and RGB factor of each cell
+    vector<int> outputOfCell(numberOfPointLights, -1);
+    vector<Vec3d> factorOfCell(numberOfPointLights, Vec3d(1.0, 1.0, 1.0));
+    int numberOfOutputs = 0;
+
+    if(outputs == ROTATION_TABLE_CELLS)
+    {
+        //Load light intentisities in order to normalize each light by its intensity
+        vector<vector<float> > lightIntensities;
+        readFile(dataRootPath() + "/light_intensities.txt", lightIntensities);
+
+        numberOfOutputs = numberOfPointLights;
+
+        for(int c = 0 ; c<numberOfPointLights ; c++)
+        {
+            outputOfCell[c] = c;
+
+            if(c < (int) lightIntensities.size() && lightIntensities[c].size() >= 3)
+                factorOfCell[c] = Vec3d(lightIntensities[c][0], lightIntensities[c][1], lightIntensities[c][2]);
+        }
+    }
+    else
+    {
+        numberOfOutputs = m_cellNumberPerPicture.size();
+
+        for(int c = 0 ; c<numberOfPointLights ; c++)
+        {
+            outputOfCell[c] = this->findImageNumber(c);
+        }
+    }
+
+    //Row o contains the weights of output o for the rotations of 0, 1, ..., width-1 columns
+    Mat table = Mat::zeros(numberOfOutputs, width, CV_64FC3);
+    vector<Vec3d> prefixSum(2*width+1);
+
+    for(int i = 0 ; i<height ; i++)
+    {
+        //The table is not stored if the relighting is cancelled
+        if(this->isCancelled())
+            return;
+
+        const Vec3f* environmentMapRow = environmentMap.ptr<Vec3f>(i);
+        const int* labelRow = m_labelMap.ptr<int>(i);
+        double solidAngle = sin((float) i*M_PI/height);
+
+        //Circular prefix sum of the row (two periods) in RGB order. NaN values of the environment map are ignored
+        prefixSum[0] = Vec3d(0.0, 0.0, 0.0);
+
+        for(int k = 0 ; k<2*width ; k++)
+        {
+            const Vec3f &pixel = environmentMapRow[k%width];
+            Vec3d value(isnan(pixel[2]) ? 0.0 : pixel[2], isnan(pixel[1]) ? 0.0 : pixel[1], isnan(pixel[0]) ? 0.0 : pixel[0]);
+
+            prefixSum[k+1] = prefixSum[k] + value*solidAngle;
+        }
+
+        //Runs of pixels of the same cell
+        int start = 0;
+
+        while(start < width)
+        {
+            int cell = labelRow[start];
+            int end = start+1;
+
+            while(end < width && labelRow[end] == cell)
+                end++;
+
+            int output = cell >= 0 ? outputOfCell[cell] : -1;
+
+            if(output >= 0)
+            {
+                Vec3d* tableRow = table.ptr<Vec3d>(output);
+                const Vec3d &factor = factorOfCell[cell];
+
+                for(int s = 0 ; s<width ; s++)
+                {
+                    Vec3d runSum = prefixSum[end+s] - prefixSum[start+s];
+
+                    tableRow[s][0] += runSum[0]*factor[0];
+                    tableRow[s][1] += runSum[1]*factor[1];
+                    tableRow[s][2] += runSum[2]*factor[2];
+                }
+            }
+
+            start = end;
+        }
+    }
+
+    m_rotationWeightTable = table;
+    m_rotationTableEnvironmentMap = environmentMap;
+    m_rotationTableOutputs = outputs;
+}
+
+/**
+ * Returns true if the rotation weight table has been computed for this environment map and these outputs.
+ * @brief hasRotationWeightTable
+ * @param INPUT : environmentMap environment map (compared by its data).
+ * @param INPUT : outputs outputs of the table.
+ */
+bool Voronoi::hasRotationWeightTable(const Mat &environmentMap, rotationTableOutputs outputs) const
+{
+    //The table keeps a header on its environment map : the data cannot be reused by another environment map
+    return !m_rotationWeightTable.empty() && m_rotationTableEnvironmentMap.data == environmentMap.data && m_rotationTableOutputs == outputs
+            && m_rotationWeightTable.cols == (int) m_envMapWidth;
+}
+
+/**
+ * Reads the weights of a rotation of the environment map in the rotation weight table (number of outputs x 3 values).
+ * @brief getRotationWeights
+ * @param INPUT : offset is the offset added for the rotation of the environment map.
+ * @param OUTPUT : rgbWeights weights of each output (same format as getRGBWeights).
+ */
+void Voronoi::getRotationWeights(float offset, vector<vector<float> > &rgbWeights) const
+{
+    int width = m_rotationWeightTable.cols;
+    rgbWeights.assign(m_rotationWeightTable.rows, vector<float>(3, 0.0));
+
+    if(width == 0)
+        return;
+
+    //Same rotation as computeVoronoiWeightsRGB
+    int jOffset = floor(offset*m_envMapWidth/(2.0*M_PI));
+    int s = ((jOffset % width) + width) % width;
+
+    for(int o = 0 ; o<m_rotationWeightTable.rows ; o++)
+    {
+        const Vec3d &weight = m_rotationWeightTable.at<Vec3d>(o, s);
+
+        rgbWeights[o][0] = weight[0];
+        rgbWeights[o][1] = weight[1];
+        rgbWeights[o][2] = weight[2];
+    }
+}
+
+/**
+ * Reads the weights of a rotation of the environment map in the rotation weight table (see getRotationWeights). The result is stored in the RGB weights.
+ * @brief computeVoronoiWeightsRotationTable
+ * @param INPUT : offset is the offset added for the rotation of the environment map.
+ */
+void Voronoi::computeVoronoiWeightsRotationTable(float offset)
+{
+    this->getRotationWeights(offset, m_rgbWeights);
+}
+
+/**
+ * Projects the indicator function of each Voronoi cell (weighted by the solid angle as in computeVoronoiWeightsRGB) on the first bands of the spherical harmonics.
+ * The weight of a cell for an environment map is then the dot product of its projection with the projection of the environment map (see getSHWeights).
+ * The label map is computed if needed. The projection is released when the diagram changes.
+ * @brief computeSHBasis
+ * @param INPUT : bands number of bands (at most SH_MAXIMUM_BANDS).
+ */
+void Voronoi::computeSHBasis(int bands)
+{
+    TraceScope traceScope("Voronoi::computeSHBasis", "voronoi");
+
+    if(!this->hasLabelMap(m_envMapWidth, m_envMapHeight))
+        this->computeLabelMap();
+
+    int numberOfPointLights = m_basis.getNumberOfPointLights();
+    int numberOfCoefficients = numberOfSHCoefficients(bands);
+
+    this->readLightIntensitiesRGB();
+
+    Mat basis = Mat::zeros(numberOfPointLights, numberOfCoefficients, CV_64F);
+    vector<double> values;
+
+    for(unsigned int i = 0 ; i<m_envMapHeight ; i++)
+    {
+        const int* labelRow = m_labelMap.ptr<int>(i);
+        double solidAngle = sin((float) i*M_PI/m_envMapHeight);
+        double theta = M_PI*(i+0.5)/m_envMapHeight;
+
+        for(unsigned int j = 0 ; j<m_envMapWidth ; j++)
+        {
+            int cellNumber = labelRow[j];
+
+            if(cellNumber < 0 || cellNumber >= numberOfPointLights)
+                continue;
+
+            evaluateSH(bands, theta, 2.0*M_PI*(j+0.5)/m_envMapWidth, values);
+
+            double* basisRow = basis.ptr<double>(cellNumber);
+            for(int k = 0 ; k<numberOfCoefficients ; k++)
+            {
+                basisRow[k] += values[k]*solidAngle;
+            }
+        }
+    }
+
+    m_shBasis = basis;
+}
+
+/**
+ * Returns true if the projection of the cells on the spherical harmonics has been computed with this number of bands.
+ * @brief hasSHBasis
+ * @param INPUT : bands number of bands.
+ */
+bool Voronoi::hasSHBasis(int bands) const
+{
+    return !m_shBasis.empty() && m_shBasis.cols == numberOfSHCoefficients(bands);
+}
+
+/**
+ * Computes the RGB weight of each cell (normalised by the light intensities, same format as getRGBWeights) from the projection of an environment map on the spherical harmonics.
+ * Low frequency approximation of computeVoronoiWeightsRGB : the cost does not depend on the size of the environment map and any 3D rotation can be applied.
+ * @brief getSHWeights
+ * @param INPUT : environmentMapSH coefficients of the environment map (see projectEnvironmentMapSH).
+ * @param INPUT : rotationSH rotation of the coefficients (see rotationMatrixSH).
+ * @param OUTPUT : rgbWeights weights of each cell.
+ */
+void Voronoi::getSHWeights(const Mat &environmentMapSH, const Mat &rotationSH, vector<vector<float> > &rgbWeights) const
+{
+    rgbWeights.assign(m_shBasis.rows, vector<float>(3, 0.0));
+
+    if(m_shBasis.empty())
+        return;
+
+    //One column per channel : the rotation and the projection are two matrix products
+    Mat rotatedEnvironmentMapSH = rotationSH*environmentMapSH.reshape(1);
+    Mat weights = m_shBasis*rotatedEnvironmentMapSH;
+
+    for(int c = 0 ; c<weights.rows ; c++)
+    {
+        for(int k = 0 ; k<3 ; k++)
+        {
+            rgbWeights[c][k] = weights.at<double>(c, k)*m_lightIntensitiesRGB[c][k];
+        }
+    }
+}
+
+/**
+ * Computes the RGB weight of each cell from the projection of an environment map on the spherical harmonics (see getSHWeights). The result is stored in the RGB weights.
+ * @brief computeVoronoiWeightsSH
+ * @param INPUT : environmentMapSH coefficients of the environment map (see projectEnvironmentMapSH).
+ * @param INPUT : rotationSH rotation of the coefficients (see rotationMatrixSH).
+ */
+void Voronoi::computeVoronoiWeightsSH(const Mat &environmentMapSH, const Mat &rotationSH)
+{
+    TraceScope traceScope("Voronoi::computeVoronoiWeightsSH", "voronoi");
+
+    this->getSHWeights(environmentMapSH, rotationSH, m_rgbWeights);
+}
+
+/**
+ * Compares the position of a coefficient of a cell with a position (binary search in the wavelet transform of the cells).
+ * @brief lessWaveletIndex
+ */
+static bool lessWaveletIndex(const SparseWaveletCoefficient &coefficient, int index)
+{
+    return coefficient.index < index;
+}
+
+/**
+ * Compares the first column of a run with a column (binary search in the runs of a row of the label map).
+ * @brief lessRunColumn
+ */
+static bool lessRunColumn(int column, const Vec2i &run)
+{
+    return column < run[0];
+}
+
+/**
+ * Computes the Haar wavelet transform of the indicator function of each Voronoi cell (sparse, see labelMapWavelet) and the runs of pixels of the same cell in each row of the label map.
+ * The label map is computed if needed. The transform and the runs are released when the diagram changes.
+ * @brief computeWaveletBasis
+ */
+void Voronoi::computeWaveletBasis()
+{
+    TraceScope traceScope("Voronoi::computeWaveletBasis", "voronoi");
+
+    if(!this->hasLabelMap(m_envMapWidth, m_envMapHeight))
+        this->computeLabelMap();
+
+    this->readLightIntensitiesRGB();
+    labelMapWavelet(m_labelMap, m_waveletBasis);
+
+    //Runs of pixels of the same cell (first column, label), used by the rotations of the environment map
+    m_labelRuns.clear();
+    m_labelRunRows.assign(1, 0);
+
+    for(int i = 0 ; i<m_labelMap.rows ; i++)
+    {
+        const int* labelRow = m_labelMap.ptr<int>(i);
+
+        for(int j = 0 ; j<m_labelMap.cols ; j++)
+        {
+            if(j == 0 || labelRow[j] != labelRow[j-1])
+                m_labelRuns.push_back(Vec2i(j, labelRow[j]));
+        }
+
+        m_labelRunRows.push_back(m_labelRuns.size());
+    }
+}
+
+/**
+ * Returns true if the Haar wavelet transform of the cells has been computed.
+ * @brief hasWaveletBasis
+ */
+bool Voronoi::hasWaveletBasis() const
+{
+    return !m_waveletBasis.empty() && !m_labelRunRows.empty();
+}
+
+/**
+ * Computes the RGB weight of each cell (normalised by the light intensities, same format as getRGBWeights) from the largest wavelet coefficients of an environment map rotated by offset.
+ * Without rotation, this is the sparse dot product of the coefficients kept with the transform of each cell. With a rotation, the cells are rotated instead of the environment map :
+ * each basis function is constant on a few rectangles (see waveletSupport) and the area of each cell in a rectangle is counted on the runs of the rows of the label map.
+ * The environment map is transformed once for all the offsets. With all the coefficients, the weights are those of computeVoronoiWeightsRGB.
+ * @brief getWaveletWeights
+ * @param INPUT : approximation largest coefficients of the environment map (see environmentMapWavelet).
+ * @param INPUT : offset is the offset added for the rotation of the environment map.
+ * @param OUTPUT : rgbWeights weights of each cell.
+ */
+void Voronoi::getWaveletWeights(const WaveletApproximation &approximation, float offset, vector<vector<float> > &rgbWeights) const
+{
+    int numberOfPointLights = m_lightIntensitiesRGB.size();
+    vector<Vec3d> weights(numberOfPointLights, Vec3d(0.0, 0.0, 0.0));
+
+    int width = m_labelMap.cols;
+    int height = m_labelMap.rows;
+
+    //Same rotation as computeVoronoiWeightsRGB : the column j of the rotated environment map is read in the cell of the column j-jOffset
+    int jOffset = floor(offset*m_envMapWidth/(2.0*M_PI));
+    int shift = (width > 0) ? ((jOffset % width) + width) % width : 0;
+
+    if(shift == 0)
+    {
+        //The coefficients of the cells are sorted by index : binary search of each position kept in the approximation
+        vector<SparseWaveletCoefficient>::const_iterator coefficient = m_waveletBasis.begin();
+
+        for(unsigned int k = 0 ; k<approximation.indices.size() ; k++)
+        {
+            int index = approximation.indices[k];
+
+            coefficient = lower_bound(coefficient, m_waveletBasis.end(), index, lessWaveletIndex);
+
+            for( ; coefficient != m_waveletBasis.end() && coefficient->index == index ; ++coefficient)
+            {
+                if(coefficient->label < numberOfPointLights)
+                    weights[coefficient->label] += approximation.coefficients[k]*coefficient->value;
+            }
+        }
+    }
+    else
+    {
+        int paddedWidth = waveletSize(width);
+        int paddedHeight = waveletSize(height);
+
+        Rect rectangles[4];
+        double values[4];
+
+        for(unsigned int k = 0 ; k<approximation.indices.size() ; k++)
+        {
+            //The weights are incomplete if the relighting is cancelled
+            if(this->isCancelled())
+                break;
+
+            int numberOfRectangles = waveletSupport(approximation.indices[k], paddedWidth, paddedHeight, rectangles, values);
+
+            for(int r = 0 ; r<numberOfRectangles ; r++)
+            {
+                //Part of the rectangle inside the environment map (the padding does not belong to any cell)
+                int rowEnd = std::min(rectangles[r].y + rectangles[r].height, height);
+                int columnStart = rectangles[r].x;
+                int columnEnd = std::min(rectangles[r].x + rectangles[r].width, width);
+
+                if(columnStart >= columnEnd)
+                    continue;
+
+                Vec3d value = approximation.coefficients[k]*values[r];
+
+                //Columns of the label map read by the rectangle : [start ; end[ shifted circularly (at most two intervals)
+                int start = columnStart - shift;
+
+                if(start < 0)
+                    start += width;
+
+                int intervals[2][2] = {{start, std::min(start + columnEnd - columnStart, width)}, {0, start + columnEnd - columnStart - width}};
+
+                for(int i = rectangles[r].y ; i<rowEnd ; i++)
+                {
+                    const Vec2i* runsBegin = m_labelRuns.empty() ? NULL : &m_labelRuns[0] + m_labelRunRows[i];
+                    const Vec2i* runsEnd = m_labelRuns.empty() ? NULL : &m_labelRuns[0] + m_labelRunRows[i+1];
+
+                    for(int n = 0 ; n<2 ; n++)
+                    {
+                        int a = intervals[n][0];
+                        int b = intervals[n][1];
+
+                        if(a >= b)
+                            continue;
+
+                        //Run that contains the column a, then the next runs until the column b
+                        const Vec2i* run = upper_bound(runsBegin, runsEnd, a, lessRunColumn) - 1;
+
+                        for( ; run != runsEnd && (*run)[0] < b ; ++run)
+                        {
+                            int runEnd = (run+1 != runsEnd) ? (*(run+1))[0] : width;
+                            int label = (*run)[1];
+
+                            if(label >= 0 && label < numberOfPointLights)
+                                weights[label] += value*(std::min(runEnd, b) - std::max((*run)[0], a));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    rgbWeights.assign(numberOfPointLights, vector<float>(3, 0.0));
+
+    for(int c = 0 ; c<numberOfPointLights ; c++)
+    {
+        for(int k = 0 ; k<3 ; k++)
+        {
+            rgbWeights[c][k] = weights[c][k]*m_lightIntensitiesRGB[c][k];
+        }
+    }
+}
+
+/**
+ * Computes the RGB weight of each cell from the largest wavelet coefficients of an environment map rotated by offset (see getWaveletWeights). The result is stored in the RGB weights.
+ * @brief computeVoronoiWeightsWavelet
+ * @param INPUT : approximation largest coefficients of the environment map (see environmentMapWavelet).
+ * @param INPUT : offset is the offset added for the rotation of the environment map.
+ */
+void Voronoi::computeVoronoiWeightsWavelet(const WaveletApproximation &approximation, float offset)
+{
+    TraceScope traceScope("Voronoi::computeVoronoiWeightsWavelet", "voronoi");
+
+    this->getWaveletWeights(approximation, offset, m_rgbWeights);
+}
+
+/**
+ * Reads the RGB intensity of the light source of each cell from light_intensities.txt (1 if missing).
+ * @brief readLightIntensitiesRGB
+ */
+void Voronoi::readLightIntensitiesRGB()
+{
+    int numberOfPointLights = m_basis.getNumberOfPointLights();
+
+    //Load light intentisities in order to normalize each light by its intensity
+    vector<vector<float> > lightIntensities;
+    readFile(dataRootPath() + "/light_intensities.txt", lightIntensities);
+
+    m_lightIntensitiesRGB.assign(numberOfPointLights, Vec3d(1.0, 1.0, 1.0));
+
+    for(int c = 0 ; c<numberOfPointLights && c<(int) lightIntensities.size() ; c++)
+    {
+        if(lightIntensities[c].size() >= 3)
+            m_lightIntensitiesRGB[c] = Vec3d(lightIntensities[c][0], lightIntensities[c][1], lightIntensities[c][2]);
+    }
+}
+
+/**
+ * Integrates a rotated environment map over each cell on the pyramids. The pyramids are computed if needed.
+ * @brief integratePyramid
+ * @param INPUT : environmentMap is an OpenCV Mat of floats containing the HDR values of the environment map.
+ * @param INPUT : columnOffset rotation of the environment map in pixels.
+ * @param OUTPUT : integrals integral of the environment map over each cell.
+ * @return false if the pyramids are disabled or if no coarser level is accurate enough (the weights must be computed at full resolution).
+ */
+bool Voronoi::integratePyramid(const Mat &environmentMap, int columnOffset, vector<PyramidIntegral> &integrals)
+{
+    if(m_pyramidTolerance <= 0.0 || environmentMap.cols != (int) m_envMapWidth || environmentMap.rows != (int) m_envMapHeight)
+        return false;
+
+    if(!this->hasLabelMap(m_envMapWidth, m_envMapHeight))
+        this->computeLabelMap();
+
+    if(m_labelPyramid.empty())
+        m_labelPyramid.build(m_labelMap);
+
+    //The level is limited by the rotation : the blocks must stay aligned with the columns of the environment map
+    unsigned int level = m_labelPyramid.selectLevel(m_pyramidTolerance, columnOffset, m_labelPyramid.getNumberOfLevels()-1);
+
+    if(level == 0)
+        return false;
+
+    TraceScope traceScope("Voronoi::integratePyramid", "voronoi");
+
+    if(!m_environmentMapPyramid.isBuiltFrom(environmentMap))
+        m_environmentMapPyramid.build(environmentMap, m_labelPyramid.getNumberOfLevels());
+
+    if(level >= m_environmentMapPyramid.getNumberOfLevels())
+        return false;
+
+    integrateLabels(m_environmentMapPyramid, m_labelPyramid, level, columnOffset, m_basis.getNumberOfPointLights(), integrals);
+
+    return true;
+}
+
+/**
+ * Sets the tolerance of the integration of the weights on the pyramids of the environment map and of the label map (see environmentMapPyramid.h).
+ * computeVoronoiWeightsRGB and computeVoronoiWeightsOR integrate the environment map at the coarsest level whose fraction of the solid angle given to a wrong cell is below the tolerance.
+ * The weights are exact at full resolution : 0 (default) disables the pyramids.
+ * @brief setPyramidTolerance
+ * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong cell.
+ */
+void Voronoi::setPyramidTolerance(double tolerance)
+{
+    m_pyramidTolerance = tolerance;
+}
+
+/**
+ * Sets the cancel token checked once per row of the environment map by the computations of the weights. They stop as soon as the token is not 0 (the weights are then incomplete).
+ * @brief setCancelToken
+ * @param INPUT : cancelToken cancel token of the relighting (NULL : the computations are never cancelled).
+ */
+void Voronoi::setCancelToken(const QAtomicInt* cancelToken)
+{
+    m_cancelToken = cancelToken;
+}
+
+/**
+ * Returns true if the cancel token has been set.
+ * @brief isCancelled
+ */
+bool Voronoi::isCancelled() const
+{
+    return m_cancelToken != NULL && m_cancelToken->load() != 0;
+}
+
+/**
+ * Writes the positions of the light sources and the cell numbers of each picture in a stream. Two diagrams with the same text are identical.
+ * @brief writeBasis
+ * @param OUTPUT : stream stream in which the text is written.
+ */
+void Voronoi::writeBasis(ostream &stream)
+{
+    vector<Point2i> pointLightSourcePosition = m_basis.getPointLightSourcePosition();
+
+    for(unsigned int i = 0 ; i<pointLightSourcePosition.size() ; i++)
+    {
+        stream << pointLightSourcePosition[i].x << "," << pointLightSourcePosition[i].y << ";";
+    }
+
+    for(unsigned int k = 0 ; k<m_cellNumberPerPicture.size() ; k++)
+    {
+        stream << "|";
+
+        for(unsigned int l = 0 ; l<m_cellNumberPerPicture[k].size() ; l++)
+        {
+            stream << m_cellNumberPerPicture[k][l] << ",";
+        }
+    }
 }
 
 /**
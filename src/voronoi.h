@@ -41,10 +41,21 @@
 #define VORONOI_H_INCLUDED
 
 #include <cstdio>
+#include <ostream>
 #include <vector>
 
 #include "LightingBasis.h"
 #include "imageProcessing.h"
+#include "trace.h"
+#include "sphericalHarmonics.h"
+#include "haarWavelet.h"
+#include "environmentMapPyramid.h"
+
+#include <QAtomicInt>
+
+#define ROTATION_TABLE_MINIMUM_OFFSETS 16 //Number of offsets above which the rotation weight table is faster than one scan of the environment map per offset
+
+enum rotationTableOutputs{ ROTATION_TABLE_CELLS, ROTATION_TABLE_IMAGES};
 
 class Voronoi
 {
@@ -273,6 +284,153 @@ class Voronoi
      */
     void clearWeights();
 
+    /**
+     * Computes the label map of the Voronoi diagram : the number of the nearest light source of every pixel of the environment map.
+     * findNearestLightSource then reads the label map instead of searching the subdivision.
+     * The label map is released when the diagram or the size of the environment map changes.
+     * @brief computeLabelMap
+     */
+    void computeLabelMap();
+
+    /**
+     * Returns true if the label map of the current Voronoi diagram has been computed for an environment map of the given size.
+     * @brief hasLabelMap
+     * @param INPUT : width width of the environment map.
+     * @param INPUT : height height of the environment map.
+     */
+    bool hasLabelMap(unsigned int width, unsigned int height) const;
+
+    /**
+     * Returns the size in bytes of the label map, of the rotation weight table and of the projections of the cells on the spherical harmonics and the Haar wavelets and of the pyramids (0 if they have not been computed).
+     * @brief labelMapMemorySize
+     */
+    size_t labelMapMemorySize() const;
+
+    /**
+     * Computes the weights of every output for all the integer rotations of the environment map at once (rotation weight table).
+     * A rotation by s columns shifts each row of the environment map : the weight of a run of pixels [a ; b[ of a cell in row i is P(b+s) - P(a+s),
+     * where P is the circular prefix sum of row i multiplied by the solid angle. The cost is (number of runs) x width per row instead of a scan of the map per rotation.
+     * The weights are those of computeVoronoiWeightsRGB (ROTATION_TABLE_CELLS) or computeVoronoiWeightsOR (ROTATION_TABLE_IMAGES) for each offset.
+     * The label map is computed if needed. The table is released when the diagram changes.
+     * @brief computeRotationWeightTable
+     * @param INPUT : environmentMap is an OpenCV Mat of floats containing the HDR values of the environment map.
+     * @param INPUT : outputs ROTATION_TABLE_CELLS (one weight per cell, normalised by the light intensities) or ROTATION_TABLE_IMAGES (one weight per picture).
+     */
+    void computeRotationWeightTable(const cv::Mat &environmentMap, rotationTableOutputs outputs);
+
+    /**
+     * Returns true if the rotation weight table has been computed for this environment map and these outputs.
+     * @brief hasRotationWeightTable
+     * @param INPUT : environmentMap environment map (compared by its data).
+     * @param INPUT : outputs outputs of the table.
+     */
+    bool hasRotationWeightTable(const cv::Mat &environmentMap, rotationTableOutputs outputs) const;
+
+    /**
+     * Reads the weights of a rotation of the environment map in the rotation weight table (number of outputs x 3 values).
+     * @brief getRotationWeights
+     * @param INPUT : offset is the offset added for the rotation of the environment map.
+     * @param OUTPUT : rgbWeights weights of each output (same format as getRGBWeights).
+     */
+    void getRotationWeights(float offset, std::vector<std::vector<float> > &rgbWeights) const;
+
+    /**
+     * Reads the weights of a rotation of the environment map in the rotation weight table (see getRotationWeights). The result is stored in the RGB weights.
+     * @brief computeVoronoiWeightsRotationTable
+     * @param INPUT : offset is the offset added for the rotation of the environment map.
+     */
+    void computeVoronoiWeightsRotationTable(float offset);
+
+    /**
+     * Projects the indicator function of each Voronoi cell (weighted by the solid angle as in computeVoronoiWeightsRGB) on the first bands of the spherical harmonics.
+     * The weight of a cell for an environment map is then the dot product of its projection with the projection of the environment map (see getSHWeights).
+     * The label map is computed if needed. The projection is released when the diagram changes.
+     * @brief computeSHBasis
+     * @param INPUT : bands number of bands (at most SH_MAXIMUM_BANDS).
+     */
+    void computeSHBasis(int bands);
+
+    /**
+     * Returns true if the projection of the cells on the spherical harmonics has been computed with this number of bands.
+     * @brief hasSHBasis
+     * @param INPUT : bands number of bands.
+     */
+    bool hasSHBasis(int bands) const;
+
+    /**
+     * Computes the RGB weight of each cell (normalised by the light intensities, same format as getRGBWeights) from the projection of an environment map on the spherical harmonics.
+     * Low frequency approximation of computeVoronoiWeightsRGB : the cost does not depend on the size of the environment map and any 3D rotation can be applied.
+     * @brief getSHWeights
+     * @param INPUT : environmentMapSH coefficients of the environment map (see projectEnvironmentMapSH).
+     * @param INPUT : rotationSH rotation of the coefficients (see rotationMatrixSH).
+     * @param OUTPUT : rgbWeights weights of each cell.
+     */
+    void getSHWeights(const cv::Mat &environmentMapSH, const cv::Mat &rotationSH, std::vector<std::vector<float> > &rgbWeights) const;
+
+    /**
+     * Computes the RGB weight of each cell from the projection of an environment map on the spherical harmonics (see getSHWeights). The result is stored in the RGB weights.
+     * @brief computeVoronoiWeightsSH
+     * @param INPUT : environmentMapSH coefficients of the environment map (see projectEnvironmentMapSH).
+     * @param INPUT : rotationSH rotation of the coefficients (see rotationMatrixSH).
+     */
+    void computeVoronoiWeightsSH(const cv::Mat &environmentMapSH, const cv::Mat &rotationSH);
+
+    /**
+     * Computes the Haar wavelet transform of the indicator function of each Voronoi cell (sparse, see labelMapWavelet) and the runs of pixels of the same cell in each row of the label map.
+     * The label map is computed if needed. The transform and the runs are released when the diagram changes.
+     * @brief computeWaveletBasis
+     */
+    void computeWaveletBasis();
+
+    /**
+     * Returns true if the Haar wavelet transform of the cells has been computed.
+     * @brief hasWaveletBasis
+     */
+    bool hasWaveletBasis() const;
+
+    /**
+     * Computes the RGB weight of each cell (normalised by the light intensities, same format as getRGBWeights) from the largest wavelet coefficients of an environment map rotated by offset.
+     * Without rotation, this is the sparse dot product of the coefficients kept with the transform of each cell. With a rotation, the cells are rotated instead of the environment map :
+     * each basis function is constant on a few rectangles (see waveletSupport) and the area of each cell in a rectangle is counted on the runs of the rows of the label map.
+     * The environment map is transformed once for all the offsets. With all the coefficients, the weights are those of computeVoronoiWeightsRGB.
+     * @brief getWaveletWeights
+     * @param INPUT : approximation largest coefficients of the environment map (see environmentMapWavelet).
+     * @param INPUT : offset is the offset added for the rotation of the environment map.
+     * @param OUTPUT : rgbWeights weights of each cell.
+     */
+    void getWaveletWeights(const WaveletApproximation &approximation, float offset, std::vector<std::vector<float> > &rgbWeights) const;
+
+    /**
+     * Computes the RGB weight of each cell from the largest wavelet coefficients of an environment map rotated by offset (see getWaveletWeights). The result is stored in the RGB weights.
+     * @brief computeVoronoiWeightsWavelet
+     * @param INPUT : approximation largest coefficients of the environment map (see environmentMapWavelet).
+     * @param INPUT : offset is the offset added for the rotation of the environment map.
+     */
+    void computeVoronoiWeightsWavelet(const WaveletApproximation &approximation, float offset);
+
+    /**
+     * Sets the tolerance of the integration of the weights on the pyramids of the environment map and of the label map (see environmentMapPyramid.h).
+     * computeVoronoiWeightsRGB and computeVoronoiWeightsOR integrate the environment map at the coarsest level whose fraction of the solid angle given to a wrong cell is below the tolerance.
+     * The weights are exact at full resolution : 0 (default) disables the pyramids.
+     * @brief setPyramidTolerance
+     * @param INPUT : tolerance maximum fraction of the solid angle given to a wrong cell.
+     */
+    void setPyramidTolerance(double tolerance);
+
+    /**
+     * Sets the cancel token checked once per row of the environment map by the computations of the weights. They stop as soon as the token is not 0 (the weights are then incomplete).
+     * @brief setCancelToken
+     * @param INPUT : cancelToken cancel token of the relighting (NULL : the computations are never cancelled).
+     */
+    void setCancelToken(const QAtomicInt* cancelToken);
+
+    /**
+     * Writes the positions of the light sources and the cell numbers of each picture in a stream. Two diagrams with the same text are identical.
+     * @brief writeBasis
+     * @param OUTPUT : stream stream in which the text is written.
+     */
+    void writeBasis(std::ostream &stream);
+
     /**
      * Getter that returns the RGB weights of each voronoi cell.
      * @brief getRGBWeights
@@ -290,6 +448,28 @@ class Voronoi
 
     private:
 
+    /**
+     * Reads the RGB intensity of the light source of each cell from light_intensities.txt (1 if missing).
+     * @brief readLightIntensitiesRGB
+     */
+    void readLightIntensitiesRGB();
+
+    /**
+     * Integrates a rotated environment map over each cell on the pyramids. The pyramids are computed if needed.
+     * @brief integratePyramid
+     * @param INPUT : environmentMap is an OpenCV Mat of floats containing the HDR values of the environment map.
+     * @param INPUT : columnOffset rotation of the environment map in pixels.
+     * @param OUTPUT : integrals integral of the environment map over each cell.
+     * @return false if the pyramids are disabled or if no coarser level is accurate enough (the weights must be computed at full resolution).
+     */
+    bool integratePyramid(const cv::Mat &environmentMap, int columnOffset, std::vector<PyramidIntegral> &integrals);
+
+    /**
+     * Returns true if the cancel token has been set.
+     * @brief isCancelled
+     */
+    bool isCancelled() const;
+
     LightingBasis m_basis; /*!< The lighting basis corresponding to the Voronoi tesselation*/
     std::vector<int> m_numberOfPixelsInVoronoiCell; /*!< A vector containing the number of pixels in each Voronoi cell*/
     cv::Subdiv2D m_voronoiSubdivision; /*!< The Voronoi subdivision*/
@@ -300,6 +480,20 @@ class Voronoi
 
     unsigned int m_envMapWidth; /*!< The width of the environment map*/
     unsigned int m_envMapHeight; /*!< The height of the environment map*/
+
+    cv::Mat m_labelMap; /*!< Number of the nearest light source of each pixel of the environment map (CV_32SC1, empty if not computed)*/
+    cv::Mat m_rotationWeightTable; /*!< RGB weight of each output (row) for each rotation in columns (column) (CV_64FC3, empty if not computed)*/
+    cv::Mat m_rotationTableEnvironmentMap; /*!< Header on the environment map of the rotation weight table*/
+    rotationTableOutputs m_rotationTableOutputs; /*!< Outputs of the rotation weight table*/
+    cv::Mat m_shBasis; /*!< Projection of each cell (row) on the spherical harmonics (CV_64F, empty if not computed)*/
+    std::vector<cv::Vec3d> m_lightIntensitiesRGB; /*!< RGB intensity of the light source of each cell used by getSHWeights and getWaveletWeights*/
+    std::vector<SparseWaveletCoefficient> m_waveletBasis; /*!< Haar wavelet transform of the indicator of each cell, sorted by index (empty if not computed)*/
+    std::vector<cv::Vec2i> m_labelRuns; /*!< Runs of pixels of the same cell in the rows of the label map (first column, label), computed with m_waveletBasis*/
+    std::vector<int> m_labelRunRows; /*!< Position of the first run of each row in m_labelRuns (rows+1 values, empty if not computed)*/
+    double m_pyramidTolerance; /*!< Maximum fraction of the solid angle given to a wrong cell by the pyramids (0 : disabled)*/
+    EnvironmentMapPyramid m_environmentMapPyramid; /*!< Pyramid of the last environment map integrated on the pyramids*/
+    LabelMapPyramid m_labelPyramid; /*!< Pyramid of the label map (empty if not computed)*/
+    const QAtomicInt* m_cancelToken; /*!< Cancel token of the relighting checked by the computations of the weights (NULL : never cancelled)*/
 };
 
 #endif // VORONOI_H_INCLUDED